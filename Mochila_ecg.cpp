@@ -3,7 +3,22 @@
 #include <SPI.h>
 #include <SD.h>
 #include <XSpaceBioV10.h>
-#include <XSControl.h>
+#include <esp_timer.h>
+#include "ecg_hal_esp32.h"
+#include "ecg_catalog.h"
+#include "ecg_classifier.h"
+#include "ecg_denoise.h"
+#include "ecg_filter.h"
+#include "ecg_input.h"
+#include "ecg_memory.h"
+#include "ecg_pipeline.h"
+#include "ecg_playback.h"
+#include "ecg_profile.h"
+#include "ecg_record.h"
+#include "ecg_stream_writer.h"
+#if ECG_CLASSIFIER
+#include "ecg_model_data.h" // Lo genera host/ecg_model_export.py
+#endif
 
 // Definiciones para la pantalla TFT y la SD
 #define TFT_CS     17
@@ -20,145 +35,137 @@
 #define BTN_SELECT 32
 #define VBAT_LVL   36
 
+// Descomentar para comparar y medir los filtros (float32, Q15, Q31) al arrancar
+// #define ECG_FILTER_BENCH
+
+// Durante la captura se envían las muestras en paquetes binarios (ver
+// host/ecg_serial_rx.cpp). Descomentar para volver al texto "d1 d2 d3".
+// #define ECG_SERIAL_ASCII
+// 115200 alcanza para el flujo binario a 250 o 500 Hz; se puede subir (p. ej. a
+// 921600) si el adaptador USB-serie y el receptor lo soportan
+const unsigned long serialBaud = 115200;
+// Frecuencia en Hz de lo que se graba y de lo que dibuja el barrido
+// (divisores de 1000, ver ecg_decimate.h); sin definir quedan en 250
+// #define ECG_STORAGE_RATE 500
+// #define ECG_DISPLAY_RATE 250
+
 // Variables globales
 bool isPaused = false;
 
 // Inicializa la pantalla
 Adafruit_ILI9341 tft = Adafruit_ILI9341(TFT_CS, TFT_DC, TFT_RST);
-File root;
-File dataFile;
 // Variables de estado
 int fileIndex = 0;
 int totalFiles = 0;
 int displayOffset = 0; // Offset para el scroll de archivos
 const int filesPerPage = 8; // Número de archivos que pueden ser mostrados en una página
-String fileNames[500]; // Suponemos un máximo de 50 archivos en la SD
+EcgCatalogEntry pageEntries[filesPerPage]; // Página visible del catálogo
+int pageShown = 0; // Entradas válidas en pageEntries
+EcgRecordReader recordReader; // Lector de archivos .ecg (su chunk va en ecgArena)
+EcgRecordSource recordSource(recordReader);
+EcgTextSource textSource;     // Archivos de texto de versiones anteriores
+EcgPlaybackViewer viewer;
+EcgPyramidReader pyramidReader; // Índice .pyr que acompaña a cada .ecg
+EcgFile *playbackFile = NULL;
+EcgFile *pyramidFile = NULL;
+EcgPlaybackSource *playbackSource = NULL; // Fuente abierta en la reproducción
+const uint32_t textSampleRate = 200; // Los .txt se grababan a ~200 Hz
 // Instancia de la placa XSpaceBioV10 para interactuar con la placa
 XSpaceBioV10Board Board;
-XSFilter Filter1;
-XSFilter Filter2;
-XSFilter Filter3;
-XSFilter Filter4;
-XSFilter Filter5;
-XSFilter Filter6;
-XSFilter Filter7;
+
+// Backends de la HAL para esta placa
+Esp32Adc boardAdc(Board);
+Esp32Display boardDisplay(tft);
+Esp32Storage boardStorage;
+Esp32Clock boardClock;
+Esp32Tasks boardTasks;
+Esp32Serial boardSerial;
 
 // Variables del menú
 int currentMenu = 0;
-const int menuItems = 3;
-String menuOptions[menuItems] = {"Nueva medicion", "Antiguas mediciones", "Creditos"};
-
-// Variables de debouncing
-unsigned long lastDebounceTimeUp = 0;
-unsigned long lastDebounceTimeDown = 0;
-unsigned long lastDebounceTimeSelect = 0;
-unsigned long lastDebounceTimeLongPress = 0;
-unsigned long debounceDelay = 200; // 200 ms de delay para el debouncing
-bool longPressActive = false;
+const int menuItems = 4;
+const char *const menuOptions[menuItems] = {"Nueva medicion", "Monitor de eventos", "Antiguas mediciones",
+                                            "Creditos"};
+
+// Botones: esp_timer los muestrea cada 5 ms y deja los eventos en una cola
+EcgButtonScanner buttons;
+esp_timer_handle_t buttonTimer;
+uint32_t buttonsHeld = 0;      // Botones apretados según los eventos ya atendidos
+uint32_t ignoredButtons = 0;   // Apretados al cambiar de pantalla: se ignoran hasta soltarlos
+EcgUiLatency uiLatency;        // Evento -> fin del redibujo
+
+// Pulsaciones largas (SELECT) y tiempos de las pantallas temporizadas
+const uint16_t deletePressMs = 4000;
+const uint16_t exitPlaybackPressMs = 1000;
+const uint32_t saveResultMs = 2000;
+const uint32_t creditsMs = 7000;
 
 // Variables de la opción de guardar
 int saveOption = 0; // 0 = "Sí", 1 = "No"
-
-// Estado del menú: 0 = menú principal, 1 = medición EKG, 2 = confirmación de guardado, 3 = mediciones antiguas
-int menuState = 0;
-
-// Array para almacenar las lecturas del EKG
-const int maxReadings = 1500; // Ajusta según sea necesario
-double ekgReadings1[maxReadings], ekgReadings2[maxReadings], ekgReadings3[maxReadings];
-int readingIndex = 0;
-
-// Variables globales para almacenar los valores ECG
-double raw_ecg = 0;
-double filtered_ecg = 0;
-double raw_ecg_2 = 0;
-double filtered_ecg_2 = 0;
-double ecg_2_minus_ecg1 = 0;
-double filtered_ecg_3 = 0;
-double filtered_ecg_1_2 = 0;
-double filtered_ecg_2_2 = 0;
-double filtered_ecg_1_3 = 0;
-double filtered_ecg_2_3 = 0;
-
-// Variables para el ploteo
-const int graphWidth = 320;
-const int graphHeight = 240;
-const int screenWidth = 320;
-const int screenHeight = 240;
-int xPos = 0;
-int prevXPos = 0;
-
-// Posiciones Y anteriores para cada derivación
-int prevYPos1 = screenHeight / 6;
-int prevYPos2 = screenHeight / 2;
-int prevYPos3 = (5 * screenHeight) / 6;
-
-///Variables para BPM
-const float UpperThreshold =2.45; //2.60 
-const float LowerThreshold = 2.60; //2.40
-float BPM = 0.0;
-bool IgnoreReading = false;
-int pulseCount = 0;
-unsigned long pulseTimes[4] = {0, 0, 0, 0};
-unsigned long PulseInterval = 0;
-unsigned long lastBpmUpdateTime = 0;
-
-// Variables para almacenar BPM y calcular el promedio
-const int bpmBufferSize = 7;  // Ajustar a 7 para promediar los últimos 7 valores
-float bpmBuffer[bpmBufferSize] = {0};
-int bpmBufferIndex = 0;
+int deleteOption = 0; // 0 = "Sí", 1 = "No"
+
+// Pantallas de la interfaz. Cada una reacciona a eventos de botones y a
+// tiempos desde que se entró, sin esperar en ningún lado.
+enum UiState {
+  UI_MAIN_MENU,
+  UI_CAPTURE,         // Medición en curso
+  UI_MONITOR,         // Monitor de eventos (ecg_event.h)
+  UI_SAVE_PROMPT,     // ¿Guardar medición?
+  UI_SAVE_RESULT,     // Resultado del guardado durante saveResultMs
+  UI_CREDITS,
+  UI_FILE_LIST,       // Mediciones antiguas
+  UI_DELETE_PROMPT,
+  UI_PLAYBACK         // Reproducción de una medición
+};
+UiState uiState = UI_MAIN_MENU;
+unsigned long stateEnteredAt = 0;
 
 // Prototipos de funciones
+void sampleButtons(void *arg);
+void enterState(UiState state);
+void handleButtonEvent(const EcgButtonEvent &event);
+void updateState();
 void drawMenu();
 void selectMenuOption();
 void startEKGMeasurement();
 void endEKGMeasurement();
+void startEventMonitor();
+void endEventMonitor();
+void drawMonitorStatus();
 void displaySaveOption();
 void handleSaveOption();
 void displayCredits();
 void displayPreviousMeasurements();
-void plotEKGValue(int value1, int value2, int value3);
-void drawGraphAxes();
 void enterFileName();
-float calculateAverageBPM();
-void loadFileNames();
-void displayMenu();
-void plotSelectedFile();
-bool debounce(int pin, unsigned long &lastDebounceTime);
-void handleMainButtonPresses();
-void handlePreviousMeasurementsButtonPresses();
-void handleLongPress();
+bool selectedFilePath(char *out, size_t size);
+bool openSelectedFile();
+void closePlayback();
+void handleMainMenuEvent(const EcgButtonEvent &event);
+void handleSavePromptEvent(const EcgButtonEvent &event);
+void handleFileListEvent(const EcgButtonEvent &event);
+void handleDeletePromptEvent(const EcgButtonEvent &event);
+void handlePlaybackEvent(const EcgButtonEvent &event);
+void displayDeleteOption();
+void deleteSelectedFile();
 void resetToMainMenu();
+void reportMemory();
+void printClassification(const EcgClassification &result);
+void classifyPlayback();
 
 bool menuActive = false;
 int menuSelection = 0; // 0: Restart, 1: Exit
 bool sdDetected = false;
-
-void FilterTask(void *pv) {
-  while (1) {
-    // Leer el voltaje crudo del ECG del primer AD8232
-    raw_ecg = Board.AD8232_GetVoltage(AD8232_XS1);
-    // Aplicar filtro de paso bajo de segundo orden
-    filtered_ecg = Filter6.SecondOrderLPF(raw_ecg, 40, 0.001);
-
-    // Leer el voltaje crudo del ECG del segundo AD8232
-    raw_ecg_2 = Board.AD8232_GetVoltage(AD8232_XS2);
-    // Aplicar filtro de paso bajo de segundo orden
-    filtered_ecg_2 = Filter7.SecondOrderLPF(raw_ecg_2, 40, 0.001);
-
-    // Calcular la tercera derivación como la diferencia entre las dos primeras
-    ecg_2_minus_ecg1 = filtered_ecg_2 - filtered_ecg;
-    filtered_ecg_3 = Filter3.SecondOrderLPF(ecg_2_minus_ecg1, 40, 0.001);
-
-    // Esperar 1 milisegundo antes de la siguiente iteración
-    vTaskDelay(1);
-  }
-  // Nunca se llega aquí
-  vTaskDelete(NULL);
-}
+uint32_t heapAfterSetup = 0; // Heap libre al terminar setup(), para ver si algo lo usa después
+EcgClassification captureClass; // Últimos 10 s de la captura (ecg_classifier.h)
+bool captureClassified = false;
+// Lo que muestra la barra de estado del monitor, para redibujarla solo si cambia
+bool shownRecording = false;
+uint32_t shownEvents = 0;
+uint32_t shownEventErrors = 0;
 
 void setup() {
   // Inicializar comunicación serial
-  Serial.begin(115200);
+  Serial.begin(serialBaud);
   // Configura los pines de los botones como entradas con resistencias pull-up internas
   pinMode(BTN_UP, INPUT_PULLUP);
   pinMode(BTN_DOWN, INPUT_PULLUP);
@@ -172,6 +179,46 @@ void setup() {
   // Inicializa la tarjeta SD
   sdDetected = SD.begin(SD_CS);
   
+  // Conecta el pipeline con el hardware de la placa
+  hal.adc = &boardAdc;
+  hal.display = &boardDisplay;
+  hal.storage = &boardStorage;
+  hal.clock = &boardClock;
+  hal.tasks = &boardTasks;
+  hal.serial = &boardSerial;
+
+#ifdef ECG_FILTER_BENCH
+  benchmarkFilters(5000);
+  benchmarkWaveletDenoiser(5000, acquisitionRate);
+  benchmarkDecimator(5000, acquisitionRate, acquisitionRate / defaultStorageRate);
+#endif
+#ifdef ECG_SERIAL_ASCII
+  serialMode = ECG_SERIAL_ASCII;
+#endif
+#if ECG_WAVELET_DENOISE
+  waveletDenoiseLevel = ECG_WAVELET_DENOISE;
+#endif
+  // Frecuencia de la grabación y del barrido (divisores de acquisitionRate)
+#ifdef ECG_STORAGE_RATE
+  storageRate = ECG_STORAGE_RATE;
+#endif
+#ifdef ECG_DISPLAY_RATE
+  displayRate = ECG_DISPLAY_RATE;
+#endif
+
+  // Buffers permanentes en ecgArena antes de crear FilterTask, que usa la
+  // ventana de la limpieza por wavelets; desde aquí solo se reservan por fase
+  reservePipelineMemory();
+  ecgArena.seal();
+  // Con PSRAM el buffer del monitor de eventos va ahí (una sola vez, no se
+  // libera) y cubre eventPreSeconds; sin ella sale de ecgArena
+  // (ECG_EVENT_ARENA_FRAMES en total)
+  if (psramFound()) {
+    uint32_t eventBytes = ecgEventBufferBytes((eventPreSeconds + ECG_EVENT_MARGIN_SECONDS) * storageRate);
+    uint8_t *eventMemory = (uint8_t *)ps_malloc(eventBytes);
+    setEventMemory(eventMemory, eventBytes);
+  }
+
   // Inicializa la placa XSpace Bio v1.0
   Board.init();
   // Activa el sensor AD8232 en la ranura XS1 para empezar a monitorear
@@ -179,21 +226,197 @@ void setup() {
   // Activa el sensor AD8232 en la ranura XS2 para empezar a monitorear
   Board.AD8232_Wake(AD8232_XS2);
 
-  // Crea la tarea de filtrado con un tamaño de pila de 3000 bytes
-  xTaskCreate(FilterTask, "FilterTask", 3000, NULL, 1, NULL);
+  // Adquisición por temporizador, sola en su núcleo y con la mayor prioridad
+  hal.tasks->createTask(AcquisitionTask, "AcquisitionTask", acquisitionStackBytes, NULL, acquisitionPriority,
+                        acquisitionCore);
+  // Filtrado y QRS en el otro núcleo, por encima de loop() (pantalla y botones)
+  hal.tasks->createTask(FilterTask, "FilterTask", filterStackBytes, NULL, filterPriority, processingCore);
+  // Tarea que vacía a la SD los bloques de la grabación en streaming
+  hal.tasks->createTask(StorageTask, "StorageTask", storageStackBytes, NULL, storagePriority, processingCore);
+
+  // Abre el catálogo de mediciones (se reconstruye solo si falta o está dañado)
+  catalog.begin(catalogFile);
+
+  // Muestreo periódico de los botones (antirrebote y pulsación larga en ecg_input)
+  esp_timer_create_args_t timerArgs = {};
+  timerArgs.callback = sampleButtons;
+  timerArgs.name = "buttons";
+  esp_timer_create(&timerArgs, &buttonTimer);
+  esp_timer_start_periodic(buttonTimer, ECG_BUTTON_SCAN_US);
+
+#if ECG_CLASSIFIER
+  if (!infarctClassifier.begin(ecgModelData, sizeof(ecgModelData))) {
+    Serial.println("Modelo de clasificacion invalido");
+  }
+#endif
 
-  // Carga los nombres de los archivos
-  loadFileNames();
+  heapAfterSetup = ESP.getFreeHeap();
+  reportMemory();
 
   // Dibuja el menú inicial
-  drawMenu();
+  enterState(UI_MAIN_MENU);
 }
 
+// Corre en la tarea de esp_timer: solo lee los pines y encola eventos
+void sampleButtons(void *arg) {
+  uint32_t pressed = 0;
+  if (digitalRead(BTN_UP) == LOW) {
+    pressed |= 1u << ECG_BUTTON_UP;
+  }
+  if (digitalRead(BTN_DOWN) == LOW) {
+    pressed |= 1u << ECG_BUTTON_DOWN;
+  }
+  if (digitalRead(BTN_SELECT) == LOW) {
+    pressed |= 1u << ECG_BUTTON_SELECT;
+  }
+  buttons.sample(pressed, micros());
+}
+
+// Cada vuelta atiende los eventos pendientes y avanza la pantalla actual
+// (la captura procesa un lote de muestras). Ningún paso espera a un botón,
+// así que la latencia de un evento es a lo sumo una vuelta más su redibujo.
 void loop() {
-  if (menuState == 3) {
-    handlePreviousMeasurementsButtonPresses();
-  } else {
-    handleMainButtonPresses();
+  EcgButtonEvent events[8];
+  uint32_t count = buttons.events.popBatch(events, 8);
+  for (uint32_t i = 0; i < count; i++) {
+    handleButtonEvent(events[i]);
+    if (uiLatency.add(events[i], micros())) {
+      Serial.print("Latencia boton-pantalla max (us): ");
+      Serial.println(uiLatency.maxUs);
+    }
+  }
+  // Comandos por el puerto serie: los del perfil (p, r, o, e; ver
+  // ecg_profile.h), m para el informe de memoria y c para clasificar la
+  // pantalla de la reproducción
+  int c;
+  while ((c = hal.serial->read()) >= 0) {
+    if (ecgProfiler.command((char)c)) {
+      continue;
+    }
+    if (c == 'm') {
+      reportMemory();
+    } else if (c == 'c') {
+      classifyPlayback();
+    }
+  }
+  updateState();
+  if (count == 0 && uiState != UI_CAPTURE && uiState != UI_MONITOR) {
+    hal.tasks->delayTick(); // stepEKGCapture() y stepEKGMonitor() ya ceden el procesador
+  }
+}
+
+// Cambia de pantalla y la dibuja
+void enterState(UiState state) {
+  uiState = state;
+  stateEnteredAt = millis();
+  // Un botón que sigue apretado desde la pantalla anterior no cuenta aquí
+  ignoredButtons = buttonsHeld;
+  switch (state) {
+    case UI_MAIN_MENU:
+      drawMenu();
+      break;
+    case UI_SAVE_PROMPT:
+      displaySaveOption();
+      break;
+    case UI_CREDITS:
+      displayCredits();
+      break;
+    case UI_FILE_LIST:
+      displayPreviousMeasurements();
+      break;
+    case UI_DELETE_PROMPT:
+      deleteOption = 0;
+      displayDeleteOption();
+      break;
+    default:
+      break;  // La captura, el guardado y el visor se dibujan al empezar
+  }
+}
+
+void handleButtonEvent(const EcgButtonEvent &event) {
+  uint32_t bit = 1u << event.button;
+  if (event.action == ECG_BUTTON_PRESS) {
+    buttonsHeld |= bit;
+    ignoredButtons &= ~bit;
+  } else if (event.action == ECG_BUTTON_RELEASE) {
+    buttonsHeld &= ~bit;
+    if (ignoredButtons & bit) {
+      ignoredButtons &= ~bit;
+      return;
+    }
+  }
+  if (ignoredButtons & bit) {
+    return;
+  }
+  switch (uiState) {
+    case UI_MAIN_MENU:
+      handleMainMenuEvent(event);
+      break;
+    case UI_CAPTURE:
+      if (event.button == ECG_BUTTON_SELECT && event.action == ECG_BUTTON_PRESS) {
+        endEKGMeasurement();
+      }
+      break;
+    case UI_MONITOR:
+      // SELECT sale; UP o DOWN guardan un evento (o alargan el que se graba)
+      if (event.action == ECG_BUTTON_PRESS) {
+        if (event.button == ECG_BUTTON_SELECT) {
+          endEventMonitor();
+        } else {
+          triggerEKGEvent(ECG_EVENT_BUTTON);
+          drawMonitorStatus();
+        }
+      }
+      break;
+    case UI_SAVE_PROMPT:
+      handleSavePromptEvent(event);
+      break;
+    case UI_SAVE_RESULT:
+    case UI_CREDITS:
+      // SELECT vuelve antes de tiempo
+      if (event.button == ECG_BUTTON_SELECT && event.action == ECG_BUTTON_PRESS) {
+        resetToMainMenu();
+      }
+      break;
+    case UI_FILE_LIST:
+      handleFileListEvent(event);
+      break;
+    case UI_DELETE_PROMPT:
+      handleDeletePromptEvent(event);
+      break;
+    case UI_PLAYBACK:
+      handlePlaybackEvent(event);
+      break;
+  }
+}
+
+// Trabajo de la pantalla actual que no depende de botones
+void updateState() {
+  unsigned long elapsed = millis() - stateEnteredAt;
+  switch (uiState) {
+    case UI_CAPTURE:
+      if (!stepEKGCapture()) {
+        endEKGMeasurement(); // La SD falló: se ofrece guardar lo grabado
+      }
+      break;
+    case UI_MONITOR:
+      stepEKGMonitor();
+      if (eventRecording() != shownRecording || eventsSaved != shownEvents || eventsFailed != shownEventErrors) {
+        drawMonitorStatus();
+      }
+      break;
+    case UI_SAVE_RESULT:
+      if (elapsed >= saveResultMs) {
+        resetToMainMenu();
+      }
+      break;
+    case UI_CREDITS:
+      if (elapsed >= creditsMs) {
+        resetToMainMenu();
+      }
+      break;
+    default:
+      break;
   }
 }
 
@@ -227,143 +450,80 @@ void selectMenuOption() {
       startEKGMeasurement();
       break;
     case 1:
-      menuState = 3;
-      displayPreviousMeasurements();
+      startEventMonitor();
       break;
     case 2:
-      displayCredits();
+      enterState(UI_FILE_LIST);
+      break;
+    case 3:
+      enterState(UI_CREDITS);
       break;
   }
 }
 
 void startEKGMeasurement() {
-  tft.fillScreen(ILI9341_BLACK);
-  drawGraphAxes(); // Dibuja los ejes de la gráfica
-  menuState = 1; // Cambia el estado del menú
-
-  // Realiza las lecturas del EKG y dibuja la gráfica
-  readingIndex = 0; // Reinicia el índice de lectura
-
-  while (readingIndex < maxReadings) {
-    // Borrar la columna actual para sobreescribir la señal
-    tft.drawFastVLine(xPos, 0, screenHeight, ILI9341_BLACK);
-    // Redibujar ejes y leyendas
-    tft.drawLine(xPos, screenHeight / 3, xPos + 1, screenHeight / 3, ILI9341_WHITE); // Eje X para la primera derivación
-    tft.drawLine(xPos, 2*(screenHeight)/3, xPos + 1, 2*(screenHeight)/3, ILI9341_WHITE); // Eje X para la segunda derivación
-    tft.drawLine(xPos, screenHeight, xPos + 1, screenHeight, ILI9341_WHITE); // Eje X para la tercera derivación
-    // Mapeo de los valores filtrados de las derivaciones en la pantalla TFT
-    int yPos1 = map(filtered_ecg * 15000, -11000, 2000, (screenHeight / 3) + 10, (screenHeight / 3) - 10);  // Derivación 1
-    int yPos2 = map(filtered_ecg_2 * 15000, -11000, 2000, ((3*screenHeight) / 4) + 10, ((3*screenHeight) / 4) - 10);  // Derivación 2
-    int yPos3 = map(filtered_ecg_3 * 15000, -11000, 2000, (4 * screenHeight / 5) + 10, (4 * screenHeight / 5) - 10);  // Derivación 3
-
-    // Dibujar líneas desde las posiciones anteriores a las nuevas posiciones
-    tft.drawLine(prevXPos, prevYPos1, xPos, yPos1, ILI9341_RED); // Derivación 1
-    tft.drawLine(prevXPos, prevYPos2, xPos, yPos2, ILI9341_GREEN); // Derivación 2
-    tft.drawLine(prevXPos, prevYPos3, xPos, yPos3, ILI9341_BLUE); // Derivación 3
-
-    // Actualizar las posiciones anteriores
-    prevXPos = xPos;
-    prevYPos1 = yPos1;
-    prevYPos2 = yPos2;
-    prevYPos3 = yPos3;
-
-    // Mover la posición x
-    xPos++;
-    ekgReadings1[readingIndex] = filtered_ecg;
-    ekgReadings2[readingIndex] = filtered_ecg_2;
-    ekgReadings3[readingIndex] = filtered_ecg_3;
-    readingIndex++;
-    if (xPos >= screenWidth) {
-      xPos = 0;
-      prevXPos = 0;
-      drawGraphAxes();
-    }
-
-    // Detección de picos y cálculo de BPM
-    if(filtered_ecg >= UpperThreshold && !IgnoreReading) {
-      for (int i = 0; i < 3; i++) {
-        pulseTimes[i] = pulseTimes[i + 1];
-      }
-      pulseTimes[3] = millis();
-      pulseCount++;
-      IgnoreReading = true;
-    }
-
-    if(filtered_ecg < LowerThreshold) {
-      IgnoreReading = false;
-    }
+  drawSweepLayout(); // Barra de BPM, leyendas y ejes del barrido
+  tft.setTextColor(ILI9341_WHITE);
+  tft.setTextSize(1);
+  tft.setCursor(210, 10);
+  tft.print("SELECT: terminar");
 
-    if (pulseCount >= 4 && millis() > 2000) { 
-      PulseInterval = pulseTimes[2] - pulseTimes[0];
-      float tempBPM = (3.0 / (PulseInterval / 1000.0)) * 60.0;
-      if (tempBPM >= 29 && tempBPM <= 330) {
-        BPM = tempBPM;
-        bpmBuffer[bpmBufferIndex] = BPM;
-        bpmBufferIndex = (bpmBufferIndex + 1) % bpmBufferSize;
-      } else {
-        // Ajustar la matriz si el valor de BPM no es correcto
-        for (int i = 0; i < 3; i++) {
-          pulseTimes[i] = pulseTimes[i + 1];
-        }
-        pulseCount = 3;
-      }
-    }
+  // Graba en la SD y dibuja la gráfica: updateState() avanza la captura en
+  // cada vuelta de loop() hasta que se presione SELECT
+  startEKGCapture();
+  enterState(UI_CAPTURE);
+}
 
-    // Calcular el BPM promedio
-    float avgBPM = calculateAverageBPM();
+// Cierra la grabación y pregunta si se desea guardar
+void endEKGMeasurement() {
+  finishEKGCapture();
+  // Sin modelo la ventana no se llena y no se clasifica
+  captureClassified = infarctClassifier.classifyWindow(captureClass);
+  if (captureClassified) {
+    printClassification(captureClass);
+  }
+  saveOption = 0;
+  enterState(UI_SAVE_PROMPT);
+}
 
-    // Muestra el BPM en la pantalla si ha sido actualizado
-    tft.fillRect(10, 10, 120, 20, ILI9341_BLACK); // Limpiar área donde se mostrará el BPM
-    tft.setTextColor(ILI9341_GREEN);
-    tft.setTextSize(2);
-    tft.setCursor(10, 10);
-    tft.print("BPM: ");
-    tft.print(avgBPM,0); // Mostrar BPM promedio sin decimales
-
-    // Mostrar el BPM en la esquina superior derecha
-    tft.setTextSize(1);
-    tft.setCursor(0, screenHeight / 3 - 10);
-    tft.print("Derivacion 1");
-    tft.setCursor(0, (2*screenHeight) / 3 - 10);
-    tft.print("Derivacion 2");
-    tft.setCursor(0, (4 * screenHeight) / 4 - 10);
-    tft.print("Derivacion 3");
-
-    // Imprimir valores en el monitor serial para depuración
-    Serial.print(filtered_ecg, 6);
-    Serial.print(" ");
-    Serial.print(filtered_ecg_2, 6);
-    Serial.print(" ");
-    Serial.println(filtered_ecg_3, 6);
-    delay(5); // Ajusta según sea necesario
-  }
-
-  // Después de la medición, solicita si se desea guardar
-  menuState = 2;
-  displaySaveOption();
-}
-
-void drawGraphAxes() {
-  // Dibujar ejes en la pantalla
-  tft.drawLine(0, screenHeight / 3, screenWidth, screenHeight / 3, ILI9341_WHITE); // Eje X para la primera derivación
-  tft.drawLine(0, 2*(screenHeight)/3, screenWidth, 2*(screenHeight)/3, ILI9341_WHITE); // Eje X para la segunda derivación
-  tft.drawLine(0, screenHeight, screenWidth, screenHeight, ILI9341_WHITE); // Eje X para la tercera derivación
-  // Dibujar leyendas
+// Igual que la medición, pero sin fin: las muestras van al buffer de eventos
+// y solo se guarda lo que rodea a cada disparo
+void startEventMonitor() {
+  drawSweepLayout();
   tft.setTextColor(ILI9341_WHITE);
   tft.setTextSize(1);
-  tft.setCursor(0, screenHeight / 3 - 10);
-  tft.print("Derivacion 1");
-  tft.setCursor(0, (2*screenHeight) / 3 - 10);
-  tft.print("Derivacion 2");
-  tft.setCursor(0, (4 * screenHeight) / 4 - 10);
-  tft.print("Derivacion 3");
+  tft.setCursor(210, 4);
+  tft.print("UP: guardar evento");
+  startEKGMonitor();
+  drawMonitorStatus();
+  enterState(UI_MONITOR);
 }
 
-void endEKGMeasurement() {
-  menuState = 0; // Vuelve al menú principal
+// Termina de guardar el evento en curso y vuelve al menú
+void endEventMonitor() {
+  finishEKGMonitor();
   resetToMainMenu();
 }
 
+void drawMonitorStatus() {
+  shownRecording = eventRecording();
+  shownEvents = eventsSaved;
+  shownEventErrors = eventsFailed;
+  char text[24];
+  if (shownRecording) {
+    snprintf(text, sizeof(text), "Grabando evento");
+  } else if (shownEventErrors > 0) {
+    snprintf(text, sizeof(text), "Eventos: %u (%u err)", (unsigned)shownEvents, (unsigned)shownEventErrors);
+  } else {
+    snprintf(text, sizeof(text), "Eventos: %u", (unsigned)shownEvents);
+  }
+  tft.fillRect(210, 14, 110, 8, ILI9341_BLACK);
+  tft.setTextSize(1);
+  tft.setTextColor(shownRecording ? ILI9341_RED : ILI9341_WHITE);
+  tft.setCursor(210, 14);
+  tft.print(text);
+}
+
 void displaySaveOption() {
   tft.fillScreen(ILI9341_BLACK);
   
@@ -372,7 +532,7 @@ void displaySaveOption() {
   tft.setCursor(10, 10); // Posición del mensaje de guardado
   tft.print("Guardar medicion?");
   
-  String options[2] = {"Si", "No"};
+  const char *const options[2] = {"Si", "No"};
   
   int initialY = 60; // Posición y inicial para las opciones, ajustada para dejar un espacio
   int ySpacing = 30; // Espaciado entre las opciones
@@ -385,13 +545,24 @@ void displaySaveOption() {
     tft.setCursor(10, initialY + i * ySpacing);
     tft.print(options[i]);
   }
+  // Resultado del clasificador sobre los últimos 10 s
+  if (captureClassified) {
+    tft.setTextColor(ILI9341_WHITE);
+    tft.setCursor(10, 150);
+    tft.print("IA: ");
+    tft.print(EcgInfarctClassifier::className(captureClass.label));
+    tft.print(" ");
+    tft.print((int)(captureClass.scores[captureClass.label] * 100));
+    tft.print("%");
+  }
 }
 
 void handleSaveOption() {
   if (saveOption == 0) {
     enterFileName();
   } else {
-    endEKGMeasurement();
+    discardEKGRecording();
+    resetToMainMenu();
   }
 }
 
@@ -404,18 +575,10 @@ void enterFileName() {
   tft.print("Guardando...");
 
   // Genera un nombre de archivo único basado en el tiempo
-  String fileName = "/ECG_" + String(millis()) + ".txt";
+  char fileName[32];
+  snprintf(fileName, sizeof(fileName), "/ECG_%lu.ecg", millis());
   
-  File dataFile = SD.open(fileName.c_str(), FILE_WRITE);
-  if (dataFile) {
-    for (int i = 0; i < readingIndex; i++) {
-      dataFile.print(ekgReadings1[i]);
-      dataFile.print(",");
-      dataFile.print(ekgReadings2[i]);
-      dataFile.print(",");
-      dataFile.println(ekgReadings3[i]);
-    }
-    dataFile.close();
+  if (keepEKGRecording(fileName)) {
     tft.setCursor(10, 50);
     tft.print("Guardado en ");
     tft.print(fileName);
@@ -423,8 +586,8 @@ void enterFileName() {
     tft.setCursor(10, 50);
     tft.print("Error guardando datos");
   }
-  delay(2000); // Espera para mostrar el mensaje
-  endEKGMeasurement();
+  // El mensaje queda saveResultMs (updateState() vuelve al menú)
+  enterState(UI_SAVE_RESULT);
 }
 
 void displayCredits() {
@@ -464,9 +627,7 @@ void displayCredits() {
   tft.println("Domingo Flores, Mag.");
   tft.setCursor(10, 210);
   tft.println("Julissa Venancio, Ing.");
-
-  delay(7000); // Muestra los créditos por 7 segundos
-  drawMenu();
+  // Se muestran creditsMs (updateState() vuelve al menú)
 }
 
 void displayPreviousMeasurements() {
@@ -481,15 +642,30 @@ void displayPreviousMeasurements() {
   int initialY = 60; // Posición y inicial para las opciones, ajustada para dejar un espacio
   int ySpacing = 20; // Espaciado entre las opciones
 
-  // Mostrar los archivos con el offset aplicado
-  for (int i = displayOffset; i < min(displayOffset + filesPerPage, totalFiles); i++) {
+  // Solo se leen del catálogo las entradas de la página visible
+  totalFiles = catalog.count();
+  pageShown = catalog.read(displayOffset, pageEntries, filesPerPage);
+  totalFiles = catalog.count(); // Pudo cambiar si se reconstruyó
+  for (int i = displayOffset; i < displayOffset + pageShown; i++) {
+    const EcgCatalogEntry &entry = pageEntries[i - displayOffset];
     if (i == fileIndex) {
       tft.setTextColor(ILI9341_YELLOW);
     } else {
       tft.setTextColor(ILI9341_WHITE);
     }
     tft.setCursor(10, initialY + (i - displayOffset) * ySpacing);
-    tft.print(fileNames[i]);
+    tft.print(entry.name);
+    // Duración y BPM medio, si se conocen
+    char info[24] = "";
+    if (entry.frameCount > 0 && entry.sampleRate > 0) {
+      uint32_t seconds = entry.frameCount / entry.sampleRate;
+      snprintf(info, sizeof(info), "%2u:%02u", (unsigned)(seconds / 60), (unsigned)(seconds % 60));
+      if (entry.averageBpm > 0) {
+        snprintf(info + strlen(info), sizeof(info) - strlen(info), "  %3d BPM", (int)(entry.averageBpm + 0.5f));
+      }
+    }
+    tft.setCursor(170, initialY + (i - displayOffset) * ySpacing);
+    tft.print(info);
   }
 
   // Opción de volver al menú principal
@@ -508,211 +684,151 @@ void displayPreviousMeasurements() {
   tft.fillRect(screenWidth - 10, 60 + scrollBarPosition, 5, scrollBarHeight, ILI9341_WHITE);
 }
 
-float calculateAverageBPM() {
-  float sum = 0.0;
-  int count = 0;
-  for (int i = 0; i < bpmBufferSize; i++) {
-    if (bpmBuffer[i] > 0) {
-      sum += bpmBuffer[i];
-      count++;
-    }
+// Ruta del archivo seleccionado en la página visible; false si la selección
+// no cae en las entradas que se leyeron del catálogo
+bool selectedFilePath(char *out, size_t size) {
+  int slot = fileIndex - displayOffset;
+  if (slot < 0 || slot >= pageShown) {
+    return false;
   }
-  return (count > 0) ? sum / count : 0.0;
+  snprintf(out, size, "/%s", pageEntries[slot].name);
+  return true;
 }
 
-void loadFileNames() {
-  root = SD.open("/");
-  totalFiles = 0;
-
-  while (true) {
-    File entry = root.openNextFile();
-    if (!entry) {
-      // No hay más archivos
-      break;
-    }
-    if (!entry.isDirectory()) {
-      String fileName = entry.name();
-      Serial.print("Archivo encontrado: ");
-      Serial.println(fileName);  // Mostrar nombres de archivos en el monitor serie
-      if (fileName.endsWith(".txt") && totalFiles < 50) {
-        fileNames[totalFiles++] = fileName;
+// Abre el archivo seleccionado y dibuja la primera pantalla. Los .ecg se leen
+// por la tabla de chunks (y por su índice .pyr con zoom alejado); los .txt se
+// indexan una vez al abrir.
+bool openSelectedFile() {
+  char filePath[ECG_CATALOG_NAME_MAX + 2];
+  bool selected = selectedFilePath(filePath, sizeof(filePath));
+  // La reproducción reutiliza la memoria de la captura
+  ecgArena.beginPhase("reproduccion");
+  playbackFile = selected ? hal.storage->open(filePath, ECG_OPEN_READ) : NULL;
+  EcgPlaybackSource *source = NULL;
+  EcgPyramidReader *pyramid = NULL;
+  if (playbackFile) {
+    size_t len = strlen(filePath);
+    if (len >= 4 && !strcmp(filePath + len - 4, ".ecg")) {
+      source = recordSource.open(playbackFile) ? &recordSource : NULL;
+      char pyramidPath[64];
+      ecgPyramidPath(filePath, pyramidPath, sizeof(pyramidPath));
+      pyramidFile = source ? hal.storage->open(pyramidPath, ECG_OPEN_READ) : NULL;
+      if (pyramidFile && pyramidReader.open(pyramidFile) &&
+          pyramidReader.header().frameCount == recordSource.frameCount()) {
+        pyramid = &pyramidReader;
       }
+    } else {
+      source = textSource.open(playbackFile, textSampleRate) ? &textSource : NULL;
     }
-    entry.close();
   }
-  root.close();
-}
-
-void plotSelectedFile() {
-  tft.fillScreen(ILI9341_BLACK);
-  drawGraphAxes(); // Dibujar ejes y leyendas
-  String filePath = "/" + fileNames[fileIndex];
-  dataFile = SD.open(filePath.c_str());
-  if (dataFile) {
-    Serial.print("Abriendo archivo: ");
-    Serial.println(filePath);  // Mostrar en el monitor serie
-    int x = 0;
-    float prevXPos = 0, prevYPos1 = 0, prevYPos2 = 0, prevYPos3 = 0;
-    bool firstDataPoint = true;
-
-    while (dataFile.available()) {
-      String dataLine = dataFile.readStringUntil('\n');
-      Serial.println(dataLine);  // Mostrar cada línea en el monitor serie
-      int commaIndex1 = dataLine.indexOf(',');
-      int commaIndex2 = dataLine.lastIndexOf(',');
-      if (commaIndex1 > 0 && commaIndex2 > commaIndex1) {
-        float xData = dataLine.substring(0, commaIndex1).toFloat();
-        float yData = dataLine.substring(commaIndex1 + 1, commaIndex2).toFloat();
-        float zData = dataLine.substring(commaIndex2 + 1).toFloat();
-
-        // Mapeo de los valores filtrados de las derivaciones en la pantalla TFT
-        int screenHeight = tft.height();
-        int yPos1 = map(xData * 15000, -11000, 2000, (screenHeight / 3) + 10, (screenHeight / 3) - 10);  // Derivación 1
-        int yPos2 = map(yData * 15000, -11000, 2000, ((3 * screenHeight) / 4) + 10, ((3 * screenHeight) / 4) - 10);  // Derivación 2
-        int yPos3 = map(zData * 15000, -11000, 2000, (4 * screenHeight / 5) + 10, (4 * screenHeight / 5) - 10);  // Derivación 3
-
-        // Dibujar líneas desde las posiciones anteriores a las nuevas posiciones
-        if (!firstDataPoint) {
-          tft.drawLine(prevXPos, prevYPos1, x, yPos1, ILI9341_RED); // Derivación 1
-          tft.drawLine(prevXPos, prevYPos2, x, yPos2, ILI9341_GREEN); // Derivación 2
-          tft.drawLine(prevXPos, prevYPos3, x, yPos3, ILI9341_BLUE); // Derivación 3
-        } else {
-          firstDataPoint = false;
-        }
-
-        // Actualizar las posiciones anteriores
-        prevXPos = x;
-        prevYPos1 = yPos1;
-        prevYPos2 = yPos2;
-        prevYPos3 = yPos3;
-
-        // Mover la posición x
-        x++;
-        if (x >= tft.width()) {
-          break;
-        }
-      }
-    }
-    dataFile.close();
-  } else {
+  playbackSource = source;
+  if (!source) {
+    closePlayback();
+    tft.fillScreen(ILI9341_BLACK);
+    tft.setTextColor(ILI9341_WHITE);
+    tft.setTextSize(2);
+    tft.setCursor(10, 10);
     tft.println("Error abriendo el archivo");
     Serial.print("Error abriendo el archivo: ");
     Serial.println(filePath);  // Mostrar el nombre del archivo que falla
+    return false;
   }
+  viewer.open(source, &sweepRenderer, pyramid);
+  viewer.draw();
+  return true;
 }
 
-// Función para manejar el debouncing de botones
-bool debounce(int pin, unsigned long &lastDebounceTime) {
-  bool buttonState = digitalRead(pin);
-  if ((millis() - lastDebounceTime) > debounceDelay) {
-    if (buttonState == LOW) {
-      lastDebounceTime = millis();
-      while (digitalRead(pin) == LOW); // Esperar a que se suelte el botón
-      return true;
-    }
+void closePlayback() {
+  playbackSource = NULL;
+  if (playbackFile) {
+    playbackFile->close();
+    playbackFile = NULL;
+  }
+  if (pyramidFile) {
+    pyramidFile->close();
+    pyramidFile = NULL;
   }
-  return false;
 }
 
-// Función para manejar las pulsaciones de botones en el menú principal
-void handleMainButtonPresses() {
-  unsigned long currentTime = millis();
-  // Detecta la pulsación de los botones con debouncing
-  if (digitalRead(BTN_UP) == LOW && (currentTime - lastDebounceTimeUp) > debounceDelay) {
-    if (menuState == 0) {
-      currentMenu = (currentMenu - 1 + menuItems) % menuItems;
-      drawMenu();
-    } else if (menuState == 2) {
-      saveOption = (saveOption - 1 + 2) % 2;
-      displaySaveOption();
-    }
-    lastDebounceTimeUp = currentTime; // Actualiza el tiempo del último cambio
+// Menú principal: UP/DOWN mueven la selección (se repite mientras se
+// mantienen) y SELECT elige la opción
+void handleMainMenuEvent(const EcgButtonEvent &event) {
+  if (event.action == ECG_BUTTON_RELEASE) {
+    return;
   }
-  if (digitalRead(BTN_DOWN) == LOW && (currentTime - lastDebounceTimeDown) > debounceDelay) {
-    if (menuState == 0) {
-      currentMenu = (currentMenu + 1) % menuItems;
-      drawMenu();
-    } else if (menuState == 2) {
-      saveOption = (saveOption + 1) % 2;
-      displaySaveOption();
-    }
-    lastDebounceTimeDown = currentTime; // Actualiza el tiempo del último cambio
+  if (event.button == ECG_BUTTON_UP) {
+    currentMenu = (currentMenu - 1 + menuItems) % menuItems;
+    drawMenu();
+  } else if (event.button == ECG_BUTTON_DOWN) {
+    currentMenu = (currentMenu + 1) % menuItems;
+    drawMenu();
+  } else if (event.action == ECG_BUTTON_PRESS) {
+    selectMenuOption();
   }
-  if (digitalRead(BTN_SELECT) == LOW && (currentTime - lastDebounceTimeSelect) > debounceDelay) {
-    if (menuState == 0) {
-      selectMenuOption();
-    } else if (menuState == 2) {
-      handleSaveOption();
-    }
-    lastDebounceTimeSelect = currentTime; // Actualiza el tiempo del último cambio
+}
+
+void handleSavePromptEvent(const EcgButtonEvent &event) {
+  if (event.action != ECG_BUTTON_PRESS) {
+    return;
+  }
+  if (event.button == ECG_BUTTON_SELECT) {
+    handleSaveOption();
+  } else {
+    saveOption = (saveOption + 1) % 2;
+    displaySaveOption();
   }
 }
 
-// Función para manejar las pulsaciones de botones en el menú de mediciones antiguas
-void handlePreviousMeasurementsButtonPresses() {
-  unsigned long currentTime = millis();
-  
-  if (debounce(BTN_UP, lastDebounceTimeUp)) {
+// Mediciones antiguas: UP/DOWN mueven la selección, SELECT corto abre el
+// archivo (o vuelve al menú) y mantener SELECT deletePressMs pide borrarlo
+void handleFileListEvent(const EcgButtonEvent &event) {
+  if (event.button == ECG_BUTTON_SELECT) {
+    if (event.action == ECG_BUTTON_HOLD && event.heldMs >= deletePressMs && fileIndex < totalFiles) {
+      enterState(UI_DELETE_PROMPT);
+    } else if (event.action == ECG_BUTTON_RELEASE && event.heldMs < deletePressMs) {
+      if (fileIndex == totalFiles) {
+        resetToMainMenu(); // Opción de volver al menú principal
+      } else if (openSelectedFile()) {
+        enterState(UI_PLAYBACK);
+      }
+    }
+    return;
+  }
+  if (event.action == ECG_BUTTON_RELEASE) {
+    return;
+  }
+  if (event.button == ECG_BUTTON_UP) {
     if (fileIndex > 0) {
       fileIndex--;
     } else {
       fileIndex = totalFiles; // Volver al final (opción de volver al menú principal)
     }
-    if (fileIndex < displayOffset) {
-      displayOffset = max(0, fileIndex - filesPerPage + 1);
-    }
-    displayPreviousMeasurements();
-  }
-
-  if (debounce(BTN_DOWN, lastDebounceTimeDown)) {
+  } else {
     if (fileIndex < totalFiles) {
       fileIndex++;
     } else {
       fileIndex = 0; // Volver al inicio
     }
-    if (fileIndex >= displayOffset + filesPerPage) {
-      displayOffset = min(fileIndex, totalFiles - filesPerPage);
-    }
-    displayPreviousMeasurements();
   }
-
-  if (digitalRead(BTN_SELECT) == LOW) {
-    if (!longPressActive) {
-      longPressActive = true;
-      lastDebounceTimeLongPress = currentTime;
-    } else if (currentTime - lastDebounceTimeLongPress > 4000) {
-      handleLongPress();
-    }
-  } else {
-    if (longPressActive) {
-      longPressActive = false;
-      if (currentTime - lastDebounceTimeLongPress < 4000) {
-        if (fileIndex == totalFiles) {
-          // Opción de volver al menú principal
-          menuState = 0;
-          resetToMainMenu();
-        } else {
-          // Plotea el archivo seleccionado
-          plotSelectedFile();
-        }
-      }
-    }
-    lastDebounceTimeSelect = currentTime; // Actualiza el tiempo del último cambio
+  // La página sigue a la selección también al dar la vuelta
+  if (fileIndex < displayOffset) {
+    displayOffset = fileIndex;
+  } else if (fileIndex >= displayOffset + filesPerPage) {
+    displayOffset = max(0, fileIndex + 1 - filesPerPage);
   }
+  displayPreviousMeasurements();
 }
 
-void handleLongPress() {
+void displayDeleteOption() {
   tft.fillScreen(ILI9341_BLACK);
   tft.setTextColor(ILI9341_WHITE);
   tft.setTextSize(2);
   tft.setCursor(10, 10);
   tft.print("Borrar archivo?");
-  String options[2] = {"Si", "No"};
-  
+  const char *const options[2] = {"Si", "No"};
+
   int initialY = 60; // Posición y inicial para las opciones, ajustada para dejar un espacio
   int ySpacing = 30; // Espaciado entre las opciones
-  int deleteOption = 0;
-  
   for (int i = 0; i < 2; i++) {
     if (i == deleteOption) {
       tft.setTextColor(ILI9341_YELLOW);
@@ -722,39 +838,110 @@ void handleLongPress() {
     tft.setCursor(10, initialY + i * ySpacing);
     tft.print(options[i]);
   }
-  
-  while (true) {
-    if (debounce(BTN_UP, lastDebounceTimeUp) || debounce(BTN_DOWN, lastDebounceTimeDown)) {
-      deleteOption = (deleteOption == 0) ? 1 : 0;
-      for (int i = 0; i < 2; i++) {
-        if (i == deleteOption) {
-          tft.setTextColor(ILI9341_YELLOW);
-        } else {
-          tft.setTextColor(ILI9341_WHITE);
-        }
-        tft.setCursor(10, initialY + i * ySpacing);
-        tft.print(options[i]);
-      }
+}
+
+void handleDeletePromptEvent(const EcgButtonEvent &event) {
+  if (event.action != ECG_BUTTON_PRESS) {
+    return;
+  }
+  if (event.button == ECG_BUTTON_SELECT) {
+    if (deleteOption == 0) {
+      deleteSelectedFile();
     }
-    if (debounce(BTN_SELECT, lastDebounceTimeSelect)) {
-      if (deleteOption == 0) {
-        String filePath = "/" + fileNames[fileIndex];
-        SD.remove(filePath.c_str());
-        loadFileNames();
-        displayPreviousMeasurements();
-      }
-      break;
+    enterState(UI_FILE_LIST);
+  } else {
+    deleteOption = (deleteOption == 0) ? 1 : 0;
+    displayDeleteOption();
+  }
+}
+
+void deleteSelectedFile() {
+  char filePath[ECG_CATALOG_NAME_MAX + 2];
+  if (!selectedFilePath(filePath, sizeof(filePath))) {
+    return;
+  }
+  SD.remove(filePath);
+  char pyramidPath[64];
+  ecgPyramidPath(filePath, pyramidPath, sizeof(pyramidPath));
+  SD.remove(pyramidPath); // Índice del visor, si lo tiene
+  catalog.remove(fileIndex);
+  totalFiles = catalog.count();
+  fileIndex = min(fileIndex, totalFiles);
+  displayOffset = max(0, min(displayOffset, totalFiles - filesPerPage));
+}
+
+// Reproducción: UP/DOWN retroceden/avanzan media pantalla (se repite mientras
+// se mantienen), SELECT corto cambia el zoom y SELECT largo vuelve a la lista
+void handlePlaybackEvent(const EcgButtonEvent &event) {
+  if (event.button == ECG_BUTTON_SELECT) {
+    if (event.action == ECG_BUTTON_HOLD && event.heldMs >= exitPlaybackPressMs) {
+      closePlayback();
+      enterState(UI_FILE_LIST);
+    } else if (event.action == ECG_BUTTON_RELEASE && event.heldMs < exitPlaybackPressMs) {
+      viewer.cycleZoom();
+      viewer.draw();
     }
+    return;
+  }
+  if (event.action == ECG_BUTTON_RELEASE) {
+    return;
+  }
+  uint32_t before = viewer.position();
+  viewer.scroll(event.button == ECG_BUTTON_UP ? -1 : 1);
+  if (viewer.position() != before) {
+    viewer.draw();
   }
 }
 
 void resetToMainMenu() {
   fileIndex = 0;
-  totalFiles = 0;
   displayOffset = 0;
   currentMenu = 0;
   saveOption = 0;
-  menuState = 0;
-  loadFileNames();
-  drawMenu();
+  enterState(UI_MAIN_MENU);
+}
+
+// Memoria por el puerto serie: heap, ecgArena, globales grandes y pilas
+void reportMemory() {
+  char line[80];
+  uint32_t freeHeap = ESP.getFreeHeap();
+  snprintf(line, sizeof(line), "Heap libre %u, minimo %u, usado desde setup %d\r\n", (unsigned)freeHeap,
+           (unsigned)ESP.getMinFreeHeap(), (int)(heapAfterSetup - freeHeap));
+  Serial.print(line);
+  ecgArena.print(hal.serial);
+  snprintf(line, sizeof(line), "Globales: colas %u, catalogo %u, lector .ecg %u, indice .pyr %u\r\n",
+           (unsigned)(sizeof(rawQueue) + sizeof(ecgQueue) + sizeof(beatQueue)), (unsigned)sizeof(catalog),
+           (unsigned)sizeof(recordReader), (unsigned)sizeof(pyramidReader));
+  Serial.print(line);
+  snprintf(line, sizeof(line), "Globales: barrido %u, visor %u, escritores SD %u, perfil %u\r\n",
+           (unsigned)sizeof(sweepRenderer), (unsigned)sizeof(viewer),
+           (unsigned)(sizeof(streamWriter) + sizeof(pyramidWriter)), (unsigned)sizeof(ecgProfiler));
+  Serial.print(line);
+  printTaskStacks(hal.serial);
+  // uxTaskGetStackHighWaterMark() devuelve bytes en el ESP32
+  snprintf(line, sizeof(line), "Pila loop(): minimo libre %u bytes\r\n",
+           (unsigned)uxTaskGetStackHighWaterMark(NULL));
+  Serial.print(line);
+}
+
+void printClassification(const EcgClassification &result) {
+  char line[80];
+  snprintf(line, sizeof(line), "Clasificacion: %s (%.0f %%), %u us preprocesamiento, %u us red\r\n",
+           EcgInfarctClassifier::className(result.label), result.scores[result.label] * 100,
+           (unsigned)result.featureUs, (unsigned)result.inferenceUs);
+  Serial.print(line);
+}
+
+// 10 s desde la izquierda de la pantalla de la reproducción
+void classifyPlayback() {
+  EcgClassification result;
+  if (uiState != UI_PLAYBACK || !playbackSource) {
+    Serial.println("Clasificacion: solo en la reproduccion");
+  } else if (!infarctClassifier.ready()) {
+    Serial.println("Clasificacion: sin modelo (ECG_CLASSIFIER)");
+  } else if (!infarctClassifier.classifySource(*playbackSource, viewer.position(), result)) {
+    Serial.println("Clasificacion: la grabacion es muy corta");
+  } else {
+    printClassification(result);
+  }
 }
@@ -0,0 +1,215 @@
+#include "ecg_catalog.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+EcgCatalog catalog;
+
+// FNV-1a sobre los bytes anteriores al campo checksum
+static uint32_t checksum(const void *data, uint32_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  uint32_t h = 2166136261u;
+  for (uint32_t i = 0; i < len; i++) {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  return h;
+}
+
+static uint32_t entryChecksum(const EcgCatalogEntry &e) {
+  return checksum(&e, offsetof(EcgCatalogEntry, checksum));
+}
+
+static bool hasSuffix(const char *name, const char *suffix) {
+  size_t n = strlen(name), m = strlen(suffix);
+  return n >= m && strcmp(name + n - m, suffix) == 0;
+}
+
+void ecgCatalogEntryFromRecord(EcgCatalogEntry &entry, const char *name, const EcgRecordHeader &header,
+                               uint32_t sizeBytes) {
+  memset(&entry, 0, sizeof(entry));
+  const char *base = strrchr(name, '/');
+  strncpy(entry.name, base ? base + 1 : name, ECG_CATALOG_NAME_MAX - 1);
+  entry.frameCount = header.frameCount;
+  entry.sampleRate = header.sampleRate;
+  entry.sizeBytes = sizeBytes;
+  entry.startMillis = header.startMillis;
+  entry.averageBpm = header.averageBpm;
+}
+
+bool EcgCatalog::begin(const char *catalogPath) {
+  path = catalogPath;
+  entries = 0;
+  EcgFile *file = hal.storage->open(path, ECG_OPEN_READ);
+  if (!file) {
+    return rebuild();
+  }
+  EcgCatalogHeader hdr;
+  bool ok = file->read((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) && memcmp(hdr.magic, "ECGL", 4) == 0 &&
+            hdr.version == ECG_CATALOG_VERSION && hdr.entrySize == sizeof(EcgCatalogEntry) &&
+            hdr.checksum == checksum(&hdr, offsetof(EcgCatalogHeader, checksum)) &&
+            file->size() >= sizeof(hdr) + hdr.count * sizeof(EcgCatalogEntry);
+  file->close();
+  if (!ok) {
+    hal.serial->println("Catalogo danado: reconstruyendo");
+    return rebuild();
+  }
+  entries = hdr.count;
+  return true;
+}
+
+bool EcgCatalog::writeHeader(EcgFile *file, uint32_t count) {
+  EcgCatalogHeader hdr;
+  memcpy(hdr.magic, "ECGL", 4);
+  hdr.version = ECG_CATALOG_VERSION;
+  hdr.entrySize = sizeof(EcgCatalogEntry);
+  hdr.count = count;
+  hdr.checksum = checksum(&hdr, offsetof(EcgCatalogHeader, checksum));
+  if (!file->seek(0) || file->write((const uint8_t *)&hdr, sizeof(hdr)) != sizeof(hdr)) {
+    return false;
+  }
+  entries = count;
+  return true;
+}
+
+uint32_t EcgCatalog::readEntries(uint32_t first, EcgCatalogEntry *out, uint32_t maxEntries, bool &damaged) {
+  damaged = false;
+  if (first >= entries) {
+    return 0;
+  }
+  if (maxEntries > entries - first) {
+    maxEntries = entries - first;
+  }
+  EcgFile *file = hal.storage->open(path, ECG_OPEN_READ);
+  if (!file) {
+    damaged = true;
+    return 0;
+  }
+  uint32_t bytes = maxEntries * sizeof(EcgCatalogEntry);
+  bool ok = file->seek(sizeof(EcgCatalogHeader) + first * sizeof(EcgCatalogEntry)) &&
+            file->read((uint8_t *)out, bytes) == bytes;
+  file->close();
+  for (uint32_t i = 0; ok && i < maxEntries; i++) {
+    ok = out[i].checksum == entryChecksum(out[i]) && out[i].name[ECG_CATALOG_NAME_MAX - 1] == 0;
+  }
+  damaged = !ok;
+  return ok ? maxEntries : 0;
+}
+
+uint32_t EcgCatalog::read(uint32_t first, EcgCatalogEntry *out, uint32_t maxEntries) {
+  bool damaged;
+  uint32_t count = readEntries(first, out, maxEntries, damaged);
+  if (damaged && rebuild()) {
+    count = readEntries(first, out, maxEntries, damaged);
+  }
+  return count;
+}
+
+bool EcgCatalog::add(EcgCatalogEntry &entry) {
+  if (!path) {
+    return false;
+  }
+  entry.checksum = entryChecksum(entry);
+  EcgFile *file = hal.storage->open(path, ECG_OPEN_UPDATE);
+  if (!file) {
+    return rebuild();  // La grabación ya está en la SD: la reconstrucción la incluye
+  }
+  // Primero la entrada y después la cuenta: si se corta en el medio, la
+  // entrada queda fuera del catálogo pero este sigue siendo válido
+  bool ok = file->seek(sizeof(EcgCatalogHeader) + entries * sizeof(EcgCatalogEntry)) &&
+            file->write((const uint8_t *)&entry, sizeof(entry)) == sizeof(entry) &&
+            writeHeader(file, entries + 1);
+  file->close();
+  return ok;
+}
+
+bool EcgCatalog::remove(uint32_t index) {
+  if (!path || index >= entries) {
+    return false;
+  }
+  EcgFile *file = hal.storage->open(path, ECG_OPEN_UPDATE);
+  if (!file) {
+    return rebuild();
+  }
+  bool ok = true;
+  uint32_t last = entries - 1;
+  if (index != last) {
+    EcgCatalogEntry moved;
+    ok = file->seek(sizeof(EcgCatalogHeader) + last * sizeof(EcgCatalogEntry)) &&
+         file->read((uint8_t *)&moved, sizeof(moved)) == sizeof(moved) &&
+         file->seek(sizeof(EcgCatalogHeader) + index * sizeof(EcgCatalogEntry)) &&
+         file->write((const uint8_t *)&moved, sizeof(moved)) == sizeof(moved);
+  }
+  ok = ok && writeHeader(file, last);
+  file->close();
+  return ok;
+}
+
+// ---------------------------------------------------------------- Reconstrucción
+
+struct RebuildState {
+  EcgFile *out;
+  uint32_t count;
+  bool ok;
+};
+
+static bool catalogFile(const char *name, uint32_t size, void *ctx) {
+  RebuildState *state = (RebuildState *)ctx;
+  const char *base = strrchr(name, '/');
+  base = base ? base + 1 : name;
+  bool record = hasSuffix(base, ".ecg");
+  if ((!record && !hasSuffix(base, ".txt")) || strlen(base) >= (size_t)ECG_CATALOG_NAME_MAX) {
+    return true;
+  }
+  EcgCatalogEntry entry;
+  EcgRecordHeader header;
+  memset(&header, 0, sizeof(header));
+  if (record) {
+    char path[ECG_CATALOG_NAME_MAX + 1];
+    snprintf(path, sizeof(path), "/%s", base);
+    EcgFile *file = hal.storage->open(path, ECG_OPEN_READ);
+    // Una grabación dañada se lista igual (sin datos) para poder borrarla
+    if (file) {
+      if (file->read((uint8_t *)&header, sizeof(header)) != sizeof(header) || memcmp(header.magic, "ECGB", 4) != 0) {
+        memset(&header, 0, sizeof(header));
+      }
+      file->close();
+    }
+  }
+  ecgCatalogEntryFromRecord(entry, base, header, size);
+  entry.checksum = entryChecksum(entry);
+  if (state->out->write((const uint8_t *)&entry, sizeof(entry)) != sizeof(entry)) {
+    state->ok = false;
+    return false;
+  }
+  state->count++;
+  return true;
+}
+
+bool EcgCatalog::rebuild() {
+  if (!path) {
+    return false;
+  }
+  rebuilds++;
+  entries = 0;
+  // Se arma aparte y se reemplaza al final para no dejar un catálogo a medias
+  char tmpPath[48];
+  snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+  RebuildState state = {hal.storage->open(tmpPath, ECG_OPEN_WRITE), 0, true};
+  if (!state.out) {
+    return false;
+  }
+  EcgCatalogHeader empty;
+  memset(&empty, 0, sizeof(empty));
+  state.out->write((const uint8_t *)&empty, sizeof(empty));
+  hal.storage->list("/", catalogFile, &state);
+  state.ok = state.ok && writeHeader(state.out, state.count);
+  state.out->close();
+  if (!state.ok) {
+    entries = 0;
+    hal.storage->remove(tmpPath);
+    return false;
+  }
+  hal.storage->remove(path);
+  return hal.storage->rename(tmpPath, path);
+}
@@ -0,0 +1,71 @@
+#ifndef ECG_CATALOG_H
+#define ECG_CATALOG_H
+
+#include <stdint.h>
+
+#include "ecg_hal.h"
+#include "ecg_record.h"
+
+// Catálogo de mediciones en la SD: una entrada de tamaño fijo por grabación
+// con lo que muestra la lista (duración, frecuencia, BPM y tamaño). La lista
+// lee solo las entradas de la página visible, así que el arranque y el menú no
+// dependen de cuántas grabaciones haya. Guardar agrega una entrada al final y
+// borrar mueve la última al hueco; ninguna operación recorre el directorio.
+//
+//   [EcgCatalogHeader] [EcgCatalogEntry] [EcgCatalogEntry] ...
+//
+// La cabecera y cada entrada llevan un checksum. Si falta el archivo o algo
+// no cierra, se reconstruye leyendo la cabecera de cada .ecg de la raíz.
+
+const uint16_t ECG_CATALOG_VERSION = 1;
+const int ECG_CATALOG_NAME_MAX = 24;
+
+struct EcgCatalogHeader {
+  char magic[4];            // "ECGL"
+  uint16_t version;
+  uint16_t entrySize;
+  uint32_t count;
+  uint32_t checksum;
+};
+
+struct EcgCatalogEntry {
+  char name[ECG_CATALOG_NAME_MAX];   // Sin "/" inicial
+  uint32_t frameCount;      // 0 si no se conoce (archivos .txt)
+  uint32_t sampleRate;
+  uint32_t sizeBytes;
+  uint32_t startMillis;
+  float averageBpm;         // 0 si no se midió
+  uint32_t checksum;
+};
+
+class EcgCatalog {
+public:
+  EcgCatalog() : rebuilds(0), path(0), entries(0) {}
+  // Abre el catálogo y lo reconstruye si falta o está dañado
+  bool begin(const char *path);
+  uint32_t count() const { return entries; }
+  // Lee hasta maxEntries desde `first`; devuelve cuántas leyó. Si encuentra
+  // una entrada dañada reconstruye el catálogo y vuelve a leer.
+  uint32_t read(uint32_t first, EcgCatalogEntry *out, uint32_t maxEntries);
+  bool add(EcgCatalogEntry &entry);
+  // La última entrada pasa a ocupar `index`
+  bool remove(uint32_t index);
+  bool rebuild();
+
+  uint32_t rebuilds;
+
+private:
+  bool writeHeader(EcgFile *file, uint32_t count);
+  uint32_t readEntries(uint32_t first, EcgCatalogEntry *out, uint32_t maxEntries, bool &damaged);
+
+  const char *path;
+  uint32_t entries;
+};
+
+// Entrada a partir de la cabecera de una grabación .ecg
+void ecgCatalogEntryFromRecord(EcgCatalogEntry &entry, const char *name, const EcgRecordHeader &header,
+                               uint32_t sizeBytes);
+
+extern EcgCatalog catalog;
+
+#endif
@@ -0,0 +1,194 @@
+#include "ecg_classifier.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "ecg_hal.h"
+
+EcgInfarctClassifier infarctClassifier;
+
+// Orden de label_map en IA_ISB.ipynb
+static const char *const classNames[] = {"infarto", "NORM"};
+
+bool ecgWaveletFeatures(const float *x, uint32_t n, float features[ECG_MODEL_FEATURES], float *coeffs,
+                        float *scratch) {
+  uint32_t lengths[ECG_WAVELET_MAX_LEVEL + 1];
+  if (ecgWavedec(x, n, ECG_MODEL_FEATURE_LEVEL, coeffs, lengths, scratch) == 0) {
+    return false;
+  }
+  // Bandas en el orden de pywt.wavedec: cA6, cD6, ..., cD1
+  const float *band = coeffs;
+  for (int b = 0; b <= ECG_MODEL_FEATURE_LEVEL; b++) {
+    uint32_t len = lengths[b];
+    double sum = 0, sumSq = 0;
+    float top = band[0], bottom = band[0];
+    for (uint32_t i = 0; i < len; i++) {
+      float v = band[i];
+      sum += v;
+      sumSq += (double)v * v;
+      top = v > top ? v : top;
+      bottom = v < bottom ? v : bottom;
+    }
+    double mean = sum / len;
+    double var = sumSq / len - mean * mean;   // np.std con ddof = 0
+    memcpy(scratch, band, len * sizeof(float));
+    float *f = features + 5 * b;
+    f[0] = (float)mean;
+    f[1] = (float)sqrt(var > 0 ? var : 0);
+    f[2] = top;
+    f[3] = bottom;
+    f[4] = ecgMedian(scratch, len);
+    band += len;
+  }
+  return true;
+}
+
+void ecgNormalizeFeatures(float *features, int count) {
+  float lo = features[0], hi = features[0];
+  for (int i = 1; i < count; i++) {
+    lo = features[i] < lo ? features[i] : lo;
+    hi = features[i] > hi ? features[i] : hi;
+  }
+  // numpy daría NaN con un vector constante; aquí queda en 0
+  float range = hi - lo;
+  for (int i = 0; i < count; i++) {
+    features[i] = range > 0 ? (features[i] - lo) / range : 0;
+  }
+}
+
+EcgInfarctClassifier::EcgInfarctClassifier() : ring(0), ringPos(0), ringCount(0), inputRate(0), phase(0) {
+  ringSlot.data = workSlot.data = 0;
+  ringSlot.phase = workSlot.phase = 0;
+}
+
+bool EcgInfarctClassifier::begin(const uint8_t *data, uint32_t size) {
+  if (!model.load(data, size)) {
+    return false;
+  }
+  if (model.inputLength() * model.inputChannels() != (uint32_t)ECG_MODEL_FEATURES) {
+    model.load(0, 0);
+    return false;
+  }
+  return true;
+}
+
+const char *EcgInfarctClassifier::className(int label) {
+  return label >= 0 && label < (int)(sizeof(classNames) / sizeof(classNames[0])) ? classNames[label] : "?";
+}
+
+uint32_t EcgInfarctClassifier::memoryBytes() const {
+  return (ECG_MODEL_WINDOW + ECG_CLASSIFIER_WORK) * sizeof(float) + model.arenaBytes();
+}
+
+float *EcgInfarctClassifier::workMemory() {
+  return (float *)ecgArena.take(workSlot, ECG_CLASSIFIER_WORK * sizeof(float), "trabajo clasificador");
+}
+
+void EcgInfarctClassifier::startWindow(uint32_t sampleRate) {
+  ring = 0;
+  ringPos = ringCount = 0;
+  phase = 0;
+  inputRate = sampleRate;
+  if (!ready() || sampleRate < ECG_MODEL_RATE) {
+    return;
+  }
+  ring = (float *)ecgArena.take(ringSlot, ECG_MODEL_WINDOW * sizeof(float), "ventana clasificador");
+}
+
+void EcgInfarctClassifier::addSample(float volts) {
+  if (!ring) {
+    return;
+  }
+  // Una de cada inputRate / ECG_MODEL_RATE muestras (con fracción acumulada)
+  phase += ECG_MODEL_RATE;
+  if (phase < inputRate) {
+    return;
+  }
+  phase -= inputRate;
+  ring[ringPos] = volts;
+  ringPos = ringPos + 1 == ECG_MODEL_WINDOW ? 0 : ringPos + 1;
+  if (ringCount < ECG_MODEL_WINDOW) {
+    ringCount++;
+  }
+}
+
+bool EcgInfarctClassifier::classifyWindow(EcgClassification &result) {
+  float *work = workMemory();
+  if (!windowFull() || !work) {
+    return false;
+  }
+  // Lo más viejo está en ringPos
+  uint32_t tail = ECG_MODEL_WINDOW - ringPos;
+  memcpy(work, ring + ringPos, tail * sizeof(float));
+  memcpy(work + tail, ring, ringPos * sizeof(float));
+  return classify(work, ECG_MODEL_WINDOW, result);
+}
+
+bool EcgInfarctClassifier::classifySource(EcgPlaybackSource &source, uint32_t firstFrame,
+                                          EcgClassification &result) {
+  float *work = workMemory();
+  uint32_t rate = source.sampleRate();
+  if (!work || rate < ECG_MODEL_RATE) {
+    return false;
+  }
+  // Si no quedan 10 s desde firstFrame se toman los últimos 10 s
+  uint32_t needed = (uint32_t)((uint64_t)ECG_MODEL_WINDOW * rate / ECG_MODEL_RATE);
+  uint32_t total = source.frameCount();
+  if (total < needed) {
+    return false;
+  }
+  if (firstFrame > total - needed) {
+    firstFrame = total - needed;
+  }
+  if (!source.seek(firstFrame)) {
+    return false;
+  }
+  float volts[32 * ECG_LEADS];
+  uint32_t n = 0;
+  uint32_t acc = rate;   // La primera muestra se toma
+  while (n < ECG_MODEL_WINDOW) {
+    uint32_t count = source.read(volts, 32);
+    if (count == 0) {
+      return false;
+    }
+    for (uint32_t f = 0; f < count && n < ECG_MODEL_WINDOW; f++) {
+      acc += ECG_MODEL_RATE;
+      if (acc >= rate) {
+        acc -= rate;
+        work[n++] = volts[f * ECG_LEADS + ECG_MODEL_LEAD];
+      }
+    }
+  }
+  return classify(work, n, result);
+}
+
+bool EcgInfarctClassifier::classify(const float *signal, uint32_t n, EcgClassification &result) {
+  float *work = workMemory();
+  if (!ready() || !work || n > ECG_MODEL_WINDOW) {
+    return false;
+  }
+  uint32_t start = hal.clock->micros();
+  float *coeffs = work + ECG_MODEL_WINDOW + 2;
+  float *scratch = coeffs + ECG_MODEL_WINDOW + 1 + ECG_MODEL_FEATURE_LEVEL * (ECG_WAVELET_TAPS - 1);
+  if (signal != work) {
+    memcpy(work, signal, n * sizeof(float));
+  }
+  uint32_t m = ecgWaveletDenoise(work, n, work, coeffs, scratch, ECG_MODEL_DENOISE_LEVEL);
+  if (m == 0 || !ecgWaveletFeatures(work, m, features, coeffs, scratch)) {
+    return false;
+  }
+  ecgNormalizeFeatures(features, ECG_MODEL_FEATURES);
+  uint32_t mid = hal.clock->micros();
+  if (!model.run(features, result.scores)) {
+    return false;
+  }
+  result.inferenceUs = hal.clock->micros() - mid;
+  result.featureUs = mid - start;
+  result.label = 0;
+  for (uint32_t c = 1; c < model.classCount(); c++) {
+    if (result.scores[c] > result.scores[result.label]) {
+      result.label = c;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,99 @@
+#ifndef ECG_CLASSIFIER_H
+#define ECG_CLASSIFIER_H
+
+#include <stdint.h>
+
+#include "ecg_memory.h"
+#include "ecg_nn.h"
+#include "ecg_playback.h"
+#include "ecg_wavelet.h"
+
+// Clasificador de infarto (IMI/ILMI) contra NORM de IA_ISB.ipynb en el
+// equipo. Para una ventana de 10 s de una derivación a 100 Hz (como los
+// registros de PTB-XL con que se entrenó) repite el preprocesamiento del
+// notebook y corre la red exportada con ecg_nn:
+//   aplicar_wavelet_denoising (sym4 nivel 4) -> extract_wavelet_features
+//   (sym4 nivel 6: media, desvío, máximo, mínimo y mediana de cada banda)
+//   -> normalización mín-máx del vector -> red -> softmax
+// La normalización hace que no importe la ganancia de la señal, así que las
+// grabaciones en voltios se usan tal cual. Otras frecuencias se llevan a
+// 100 Hz tomando la muestra más cercana (el pasa bajos de 40 Hz ya limita la
+// banda).
+//
+// Con ECG_CLASSIFIER en 1 el sketch incluye el modelo generado por
+// host/ecg_model_export.py (ecg_model_data.h) y ecg_memory.cpp reserva lugar
+// para la ventana; en 0 (lo normal, el modelo no viene con el código) todo
+// esto queda sin usar.
+
+#ifndef ECG_CLASSIFIER
+#define ECG_CLASSIFIER 0
+#endif
+
+const uint32_t ECG_MODEL_RATE = 100;
+const uint32_t ECG_MODEL_WINDOW = 1000;
+const int ECG_MODEL_LEAD = 1;             // D2
+const int ECG_MODEL_DENOISE_LEVEL = 4;
+const int ECG_MODEL_FEATURE_LEVEL = 6;
+const int ECG_MODEL_FEATURES = 5 * (ECG_MODEL_FEATURE_LEVEL + 1);
+
+// Floats de trabajo de una clasificación: señal (y su versión sin ruido, en
+// el mismo lugar), coeficientes y auxiliar
+const uint32_t ECG_CLASSIFIER_WORK =
+    (ECG_MODEL_WINDOW + 2) + (ECG_MODEL_WINDOW + 1 + ECG_MODEL_FEATURE_LEVEL * (ECG_WAVELET_TAPS - 1)) +
+    (ECG_MODEL_WINDOW + 1 + ECG_WAVELET_TAPS) / 2 + 2;
+
+struct EcgClassification {
+  int label;                              // Clase más probable
+  float scores[ECG_NN_MAX_CLASSES];       // Softmax
+  uint32_t featureUs;                     // Preprocesamiento
+  uint32_t inferenceUs;                   // Red
+};
+
+class EcgInfarctClassifier {
+public:
+  EcgInfarctClassifier();
+  // El modelo queda en su lugar (ver EcgNnModel::load); tiene que tener
+  // ECG_MODEL_FEATURES entradas
+  bool begin(const uint8_t *model, uint32_t size);
+  bool ready() const { return model.loaded(); }
+
+  // Ventana deslizante de la derivación ECG_MODEL_LEAD durante la captura,
+  // con muestras a sampleRate; no hace nada si no hay modelo
+  void startWindow(uint32_t sampleRate);
+  void addSample(float volts);
+  bool windowFull() const { return ring != 0 && ringCount >= ECG_MODEL_WINDOW; }
+  // Clasifica los últimos 10 s de la ventana
+  bool classifyWindow(EcgClassification &result);
+
+  // 10 s de una grabación guardada desde la muestra firstFrame
+  bool classifySource(EcgPlaybackSource &source, uint32_t firstFrame, EcgClassification &result);
+  // Señal ya a ECG_MODEL_RATE (n muestras, a lo sumo ECG_MODEL_WINDOW)
+  bool classify(const float *signal, uint32_t n, EcgClassification &result);
+
+  static const char *className(int label);
+  // Bytes de ecgArena de una clasificación (ventana, trabajo y activaciones)
+  uint32_t memoryBytes() const;
+
+  float features[ECG_MODEL_FEATURES];      // Entrada de la última clasificación
+  EcgNnModel model;
+
+private:
+  float *workMemory();
+
+  EcgArenaSlot ringSlot, workSlot;
+  float *ring;
+  uint32_t ringPos, ringCount;
+  uint32_t inputRate;
+  uint32_t phase;                          // Acumulador de la conversión a 100 Hz
+};
+
+// Características de extract_wavelet_features() (sin normalizar) de n
+// muestras; coeffs y scratch como en ecgWavedec()
+bool ecgWaveletFeatures(const float *x, uint32_t n, float features[ECG_MODEL_FEATURES], float *coeffs,
+                        float *scratch);
+// Normalización mín-máx de preprocess_data()
+void ecgNormalizeFeatures(float *features, int count);
+
+extern EcgInfarctClassifier infarctClassifier;
+
+#endif
@@ -0,0 +1,240 @@
+#include "ecg_codec.h"
+
+#include <string.h>
+
+static const int derivedLead = 2;       // Derivación 3 = d2 - d1
+static const int maxK = ECG_RICE_RAW_BITS - 1;
+
+static inline uint32_t zigzag(int32_t e) {
+  return ((uint32_t)e << 1) ^ (uint32_t)(e >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t u) {
+  return (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+}
+
+static inline uint32_t riceBits(uint32_t u, int k) {
+  uint32_t q = u >> k;
+  return q < ECG_RICE_ESCAPE ? q + 1 + k : ECG_RICE_ESCAPE + ECG_RICE_RAW_BITS;
+}
+
+static inline bool validMode(int mode, int lead) {
+  return mode < 2 || (mode == 2 && lead == derivedLead) || (mode == 3 && lead > 0);
+}
+
+// x[i - back] de una derivación: de la partición o de las dos muestras anteriores
+static inline int32_t past(const int16_t *frames, int32_t i, int back, int lead, const int32_t *prev1,
+                           const int32_t *prev2) {
+  int32_t j = i - back;
+  return j >= 0 ? frames[j * ECG_LEADS + lead] : (j == -1 ? prev1[lead] : prev2[lead]);
+}
+
+// Predicción de la muestra i, recortada al rango de int16 para que el
+// residuo entre en ECG_RICE_RAW_BITS
+static inline int32_t predict(int mode, const int16_t *frames, int32_t i, int lead, const int32_t *prev1,
+                              const int32_t *prev2) {
+  const int16_t *frame = frames + i * ECG_LEADS;
+  int32_t a = past(frames, i, 1, lead, prev1, prev2);
+  int32_t b = past(frames, i, 2, lead, prev1, prev2);
+  int32_t p;
+  if (mode == 0) {
+    p = a;
+  } else if (mode == 1) {
+    p = 2 * a - b;
+  } else if (mode == 2) {
+    p = frame[1] - frame[0];
+  } else {
+    int32_t a0 = past(frames, i, 1, 0, prev1, prev2);
+    int32_t b0 = past(frames, i, 2, 0, prev1, prev2);
+    p = frame[0] + 2 * (a - a0) - (b - b0);
+  }
+  return p > 32767 ? 32767 : (p < -32768 ? -32768 : p);
+}
+
+// Residuos de una derivación con el predictor `mode`; devuelve su suma
+static uint32_t residuals(const int16_t *frames, uint32_t start, uint32_t count, int lead, int mode,
+                          const int32_t *prev1, const int32_t *prev2, uint32_t *u) {
+  uint32_t sum = 0;
+  for (uint32_t i = start; i < count; i++) {
+    u[i] = zigzag(frames[i * ECG_LEADS + lead] - predict(mode, frames, i, lead, prev1, prev2));
+    sum += u[i];
+  }
+  return sum;
+}
+
+// ---------------------------------------------------------------- Codificación
+
+void EcgRiceEncoder::begin(uint8_t *buffer, uint32_t capacity) {
+  out = buffer;
+  capacityBits = capacity * 8;
+  bitPos = 0;
+  frameCount = 0;
+}
+
+void EcgRiceEncoder::putBits(uint32_t value, int bits) {
+  while (bits > 0) {
+    uint32_t used = bitPos & 7;
+    int room = 8 - used;
+    int n = bits < room ? bits : room;
+    uint8_t part = (value >> (bits - n)) & ((1u << n) - 1);
+    if (used == 0) {
+      out[bitPos >> 3] = 0;
+    }
+    out[bitPos >> 3] |= part << (room - n);
+    bitPos += n;
+    bits -= n;
+  }
+}
+
+bool EcgRiceEncoder::addPartition(const int16_t *frames, uint32_t count) {
+  if (count == 0 || count > (uint32_t)ECG_RICE_PARTITION) {
+    return count == 0;
+  }
+  // Primero se elige predictor y k de cada derivación y se cuenta el tamaño
+  // exacto; recién si entra se escribe
+  uint32_t u[ECG_LEADS][ECG_RICE_PARTITION];
+  uint32_t candidate[ECG_RICE_PARTITION];
+  int mode[ECG_LEADS], k[ECG_LEADS];
+  uint32_t start = frameCount == 0 ? 1 : 0;
+  int32_t p1[ECG_LEADS], p2[ECG_LEADS];
+  for (int l = 0; l < ECG_LEADS; l++) {
+    p1[l] = start ? frames[l] : prev1[l];
+    p2[l] = start ? frames[l] : prev2[l];
+  }
+  uint32_t bits = start ? 16 * ECG_LEADS : 0;
+  for (int l = 0; l < ECG_LEADS; l++) {
+    uint32_t best = 0xFFFFFFFF;
+    for (int m = 0; m < 4; m++) {
+      if (!validMode(m, l)) {
+        continue;
+      }
+      uint32_t sum = residuals(frames, start, count, l, m, p1, p2, candidate);
+      if (sum < best) {
+        best = sum;
+        mode[l] = m;
+        memcpy(u[l], candidate, sizeof(candidate));
+      }
+    }
+    // k tal que 2^k se acerque a la media del residuo
+    uint32_t n = count - start;
+    k[l] = 0;
+    while (k[l] < maxK && (uint64_t)n << (k[l] + 1) <= best) {
+      k[l]++;
+    }
+    bits += ECG_RICE_MODE_BITS + ECG_RICE_K_BITS;
+    for (uint32_t i = start; i < count; i++) {
+      bits += riceBits(u[l][i], k[l]);
+    }
+  }
+  if (bitPos + bits > capacityBits) {
+    return false;
+  }
+
+  if (start) {
+    for (int l = 0; l < ECG_LEADS; l++) {
+      putBits((uint16_t)frames[l], 16);
+    }
+  }
+  for (int l = 0; l < ECG_LEADS; l++) {
+    putBits(mode[l], ECG_RICE_MODE_BITS);
+    putBits(k[l], ECG_RICE_K_BITS);
+    uint32_t mask = (1u << k[l]) - 1;
+    for (uint32_t i = start; i < count; i++) {
+      uint32_t q = u[l][i] >> k[l];
+      if (q < ECG_RICE_ESCAPE) {
+        putBits(((1u << q) - 1) << 1, q + 1);
+        putBits(u[l][i] & mask, k[l]);
+      } else {
+        putBits((1u << ECG_RICE_ESCAPE) - 1, ECG_RICE_ESCAPE);
+        putBits(u[l][i], ECG_RICE_RAW_BITS);
+      }
+    }
+  }
+  for (int l = 0; l < ECG_LEADS; l++) {
+    prev2[l] = past(frames, count, 2, l, p1, p2);
+    prev1[l] = past(frames, count, 1, l, p1, p2);
+  }
+  frameCount += count;
+  return true;
+}
+
+// ---------------------------------------------------------------- Decodificación
+
+void EcgRiceDecoder::begin(const uint8_t *data, uint32_t bytes) {
+  in = data;
+  sizeBits = bytes * 8;
+  bitPos = 0;
+  frameCount = 0;
+  overrun = false;
+}
+
+uint32_t EcgRiceDecoder::getBits(int bits) {
+  if (bitPos + bits > sizeBits) {
+    overrun = true;
+    return 0;
+  }
+  uint32_t value = 0;
+  while (bits > 0) {
+    uint32_t used = bitPos & 7;
+    int room = 8 - used;
+    int n = bits < room ? bits : room;
+    value = (value << n) | ((in[bitPos >> 3] >> (room - n)) & ((1u << n) - 1));
+    bitPos += n;
+    bits -= n;
+  }
+  return value;
+}
+
+uint32_t EcgRiceDecoder::getUnary() {
+  uint32_t q = 0;
+  while (q < ECG_RICE_ESCAPE && bitPos < sizeBits &&
+         (in[bitPos >> 3] >> (7 - (bitPos & 7))) & 1) {
+    bitPos++;
+    q++;
+  }
+  if (q < ECG_RICE_ESCAPE) {
+    getBits(1);  // El cero que cierra el prefijo
+  }
+  return q;
+}
+
+bool EcgRiceDecoder::decodePartition(int16_t *frames, uint32_t count) {
+  if (count == 0 || count > (uint32_t)ECG_RICE_PARTITION) {
+    return count == 0;
+  }
+  uint32_t start = 0;
+  if (frameCount == 0) {
+    for (int l = 0; l < ECG_LEADS; l++) {
+      frames[l] = (int16_t)getBits(16);
+      prev1[l] = prev2[l] = frames[l];
+    }
+    start = 1;
+  }
+  // Por derivación en orden: los predictores entre derivaciones usan las
+  // anteriores ya decodificadas
+  for (int l = 0; l < ECG_LEADS; l++) {
+    int mode = getBits(ECG_RICE_MODE_BITS);
+    int k = getBits(ECG_RICE_K_BITS);
+    if (!validMode(mode, l) || k > maxK) {
+      return false;
+    }
+    for (uint32_t i = start; i < count; i++) {
+      uint32_t q = getUnary();
+      uint32_t u = q < ECG_RICE_ESCAPE ? (q << k) | getBits(k) : getBits(ECG_RICE_RAW_BITS);
+      int32_t x = predict(mode, frames, i, l, prev1, prev2) + unzigzag(u);
+      if (x < -32768 || x > 32767) {
+        return false;
+      }
+      frames[i * ECG_LEADS + l] = x;
+    }
+  }
+  int32_t p1[ECG_LEADS], p2[ECG_LEADS];
+  memcpy(p1, prev1, sizeof(p1));
+  memcpy(p2, prev2, sizeof(p2));
+  for (int l = 0; l < ECG_LEADS; l++) {
+    prev2[l] = past(frames, count, 2, l, p1, p2);
+    prev1[l] = past(frames, count, 1, l, p1, p2);
+  }
+  frameCount += count;
+  return !overrun;
+}
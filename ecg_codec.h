@@ -0,0 +1,78 @@
+#ifndef ECG_CODEC_H
+#define ECG_CODEC_H
+
+#include <stdint.h>
+
+#include "ecg_queue.h"
+
+// Codificación sin pérdida de los chunks .ecg (codec ECG_CODEC_RICE).
+//
+// Las muestras se agrupan en particiones de ECG_RICE_PARTITION muestras. Por
+// cada derivación y partición se elige el predictor que deja el residuo más
+// chico y el parámetro k de Rice:
+//
+//   0: x[n-1]                          (delta)
+//   1: 2 x[n-1] - x[n-2]               (lineal)
+//   2: d2[n] - d1[n]                   (solo la derivación 3, que es d2 - d1)
+//   3: d1[n] + lineal de (x - d1)      (derivaciones 2 y 3: ruido común con d1)
+//
+// El residuo e se pasa a sin signo (zigzag) y se escribe como q = u >> k unos,
+// un cero y los k bits bajos. Si q llega a ECG_RICE_ESCAPE se escriben
+// ECG_RICE_ESCAPE unos y el valor en ECG_RICE_RAW_BITS bits, así que ninguna
+// muestra ocupa más de 32 bits y el costo de una partición está acotado.
+//
+// La primera muestra de cada chunk va en crudo y el predictor arranca desde
+// ahí: cada chunk se decodifica sin mirar los anteriores.
+
+const int ECG_RICE_PARTITION = 32;      // Muestras por partición
+const int ECG_RICE_MODE_BITS = 2;
+const int ECG_RICE_K_BITS = 5;
+const uint32_t ECG_RICE_ESCAPE = 15;
+const int ECG_RICE_RAW_BITS = 17;       // Residuo con la predicción recortada a int16
+// Peor caso de una partición: cabeceras más todas las muestras escapadas
+const uint32_t ECG_RICE_PARTITION_MAX_BYTES =
+    (ECG_LEADS * (ECG_RICE_MODE_BITS + ECG_RICE_K_BITS + 16) +
+     ECG_RICE_PARTITION * ECG_LEADS * (ECG_RICE_ESCAPE + ECG_RICE_RAW_BITS) + 7) / 8;
+
+class EcgRiceEncoder {
+public:
+  // Empieza un bloque nuevo en `out` (capacidad en bytes)
+  void begin(uint8_t *out, uint32_t capacity);
+  // Agrega `count` muestras intercaladas (a lo sumo ECG_RICE_PARTITION).
+  // Si no entran en lo que queda del bloque no escribe nada y devuelve false.
+  bool addPartition(const int16_t *frames, uint32_t count);
+  uint32_t bytes() const { return (bitPos + 7) / 8; }
+  uint32_t frames() const { return frameCount; }
+
+private:
+  void putBits(uint32_t value, int bits);
+
+  uint8_t *out;
+  uint32_t capacityBits;
+  uint32_t bitPos;
+  uint32_t frameCount;
+  int32_t prev1[ECG_LEADS];     // x[n-1]
+  int32_t prev2[ECG_LEADS];     // x[n-2]
+};
+
+class EcgRiceDecoder {
+public:
+  void begin(const uint8_t *in, uint32_t bytes);
+  // Decodifica la siguiente partición de `count` muestras; false si los datos
+  // no alcanzan o no son válidos
+  bool decodePartition(int16_t *frames, uint32_t count);
+
+private:
+  uint32_t getBits(int bits);
+  uint32_t getUnary();
+
+  const uint8_t *in;
+  uint32_t sizeBits;
+  uint32_t bitPos;
+  uint32_t frameCount;
+  bool overrun;
+  int32_t prev1[ECG_LEADS];
+  int32_t prev2[ECG_LEADS];
+};
+
+#endif
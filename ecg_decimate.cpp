@@ -0,0 +1,183 @@
+#include "ecg_decimate.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include "ecg_hal.h"
+
+// Diferencia admitida entre la forma polifásica (float) y el FIR completo (double)
+static const double toleranceDecimator = 1e-5;
+
+// Función de Bessel modificada de orden 0 (serie de potencias) para la ventana de Kaiser
+static double besselI0(double x) {
+  double sum = 1, term = 1, q = x * x / 4;
+  for (int k = 1; k < 64 && term > 1e-12 * sum; k++) {
+    term *= q / ((double)k * k);
+    sum += term;
+  }
+  return sum;
+}
+
+// Coeficiente k del FIR sin normalizar: sinc con el corte en 0,4 de la
+// salida por la ventana de Kaiser. Se calcula uno por uno para no necesitar
+// un arreglo en la pila de FilterTask.
+static double decimationTap(int factor, int k) {
+  double center = ecgDecimatorDelay(factor);
+  double cutoff = 0.4 / factor;   // Ciclos por muestra de entrada
+  double beta = 0.1102 * (ECG_DECIM_STOP_DB - 8.7);
+  double t = k - center;
+  double sinc = t == 0 ? 2 * cutoff : sin(2 * M_PI * cutoff * t) / (M_PI * t);
+  double u = t / center;
+  return sinc * besselI0(beta * sqrt(1 - u * u)) / besselI0(beta);
+}
+
+void designDecimationFir(int factor, float *h) {
+  if (factor <= 1) {
+    h[0] = 1;
+    return;
+  }
+  int taps = 2 * ecgDecimatorDelay(factor) + 1;
+  double sum = 0;
+  for (int k = 0; k < taps; k++) {
+    sum += decimationTap(factor, k);
+  }
+  for (int k = 0; k < taps; k++) {
+    h[k] = (float)(decimationTap(factor, k) / sum);
+  }
+}
+
+bool EcgDecimator::begin(int factor) {
+  if (factor < 1 || factor > ECG_DECIM_MAX_FACTOR) {
+    this->factor = 0;
+    return false;
+  }
+  this->factor = factor;
+  if (factor > 1) {
+    int taps = 2 * ecgDecimatorDelay(factor) + 1;
+    double sum = 0;
+    for (int k = 0; k < taps; k++) {
+      sum += decimationTap(factor, k);
+    }
+    // El último lugar de la última rama queda en 0 (L = ramas * M - 1)
+    for (int r = 0; r < factor; r++) {
+      for (int j = 0; j < ECG_DECIM_PHASE_TAPS; j++) {
+        int k = r + j * factor;
+        branch[r][j] = k < taps ? (float)(decimationTap(factor, k) / sum) : 0.0f;
+      }
+    }
+  }
+  reset();
+  return true;
+}
+
+void EcgDecimator::reset() {
+  for (int j = 0; j < ECG_DECIM_PHASE_TAPS; j++) {
+    for (int l = 0; l < ECG_BANK_LANES; l++) {
+      acc[j][l] = 0;
+    }
+  }
+  head = 0;
+  nextSeq = 0;
+  started = false;
+}
+
+// Ritmo lento, red eléctrica y ruido seudoaleatorio
+static float decimationTestSignal(uint32_t i, uint32_t rate, uint32_t &noise) {
+  noise = noise * 1664525u + 1013904223u;
+  double t = (double)i / rate;
+  return (float)(0.8 * sin(2 * M_PI * 1.3 * t) + 0.2 * sin(2 * M_PI * 60 * t) +
+                 0.05 * ((double)(noise >> 8) / (1 << 24) - 0.5));
+}
+
+// Ganancia en dB de un tono a la salida, ya pasado el arranque del filtro
+static double toneGain(EcgDecimator &decimator, double hz, uint32_t rate) {
+  decimator.reset();
+  uint32_t settle = 2 * decimator.delay() + 1;
+  uint32_t total = settle + 4096;
+  double power = 0;
+  uint32_t outputs = 0;
+  for (uint32_t i = 0; i < total; i++) {
+    float v = (float)sin(2 * M_PI * hz * i / rate);
+    float in[ECG_LEADS] = {v, v, v}, out[ECG_LEADS];
+    if (decimator.process(i, in, out) && i >= settle) {
+      power += (double)out[0] * out[0];
+      outputs++;
+    }
+  }
+  // Un tono de amplitud 1 tiene potencia media 1/2
+  return outputs > 0 ? 10 * log10(power / outputs * 2 + 1e-30) : 0;
+}
+
+bool benchmarkDecimator(uint32_t samples, uint32_t rate, int factor) {
+  const uint32_t block = 1024;
+  static float x[block];
+  static float h[ECG_DECIM_PHASE_TAPS * ECG_DECIM_MAX_FACTOR];
+  static EcgDecimator decimator;
+  if (factor <= 1 || !decimator.begin(factor)) {
+    hal.serial->println("Decimacion: factor fuera de rango");
+    return false;
+  }
+  designDecimationFir(factor, h);
+  uint32_t taps = 2 * decimator.delay() + 1;
+
+  // Exactitud: cada salida contra el FIR completo en esa misma muestra
+  uint32_t noise = 1;
+  for (uint32_t i = 0; i < block; i++) {
+    x[i] = decimationTestSignal(i, rate, noise);
+  }
+  double maxError = 0;
+  bool aligned = true;
+  for (uint32_t i = 0; i < block; i++) {
+    float in[ECG_LEADS] = {x[i], -x[i], 0.5f * x[i]}, out[ECG_LEADS];
+    if (!decimator.process(i, in, out)) {
+      continue;
+    }
+    aligned = aligned && (i - decimator.delay()) % factor == 0;
+    double y = 0;
+    for (uint32_t k = 0; k < taps && k <= i; k++) {
+      y += (double)h[k] * x[i - k];
+    }
+    maxError = fmax(maxError, fabs(out[0] - y));
+    maxError = fmax(maxError, fabs(out[1] + y));
+    maxError = fmax(maxError, fabs(out[2] - 0.5 * y));
+  }
+
+  // Tonos: uno de la banda pasante y uno que al tomar una de cada M
+  // muestras cae sin atenuar en 0,4 de la salida
+  double outRate = (double)rate / factor;
+  double pass = toneGain(decimator, 0.2 * outRate, rate);
+  double folded = toneGain(decimator, 0.6 * outRate, rate);
+  bool ok = aligned && maxError <= toleranceDecimator && folded <= -(ECG_DECIM_STOP_DB - 6);
+
+  // Velocidad: las tres derivaciones como en FilterTask
+  decimator.reset();
+  uint32_t rounds = samples / block + 1;
+  float sink = 0;
+  uint32_t start = hal.clock->cycleCount();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (uint32_t i = 0; i < block; i++) {
+      float in[ECG_LEADS] = {x[i], -x[i], 0.5f * x[i]}, out[ECG_LEADS];
+      if (decimator.process(r * block + i, in, out)) {
+        sink += out[0];
+      }
+    }
+  }
+  uint32_t cycles = hal.clock->cycleCount() - start;
+
+  double perSample = (double)cycles / ((double)rounds * block);
+  double cpu = perSample * rate / (hal.clock->cyclesPerUs() * 1e6) * 100;
+  char line[128];
+  snprintf(line, sizeof(line), "Decimacion %u -> %.0f Hz (FIR de %u, retardo %u) ciclos/muestra: %.1f (%.2f %% del CPU)",
+           (unsigned)rate, outRate, (unsigned)taps, (unsigned)decimator.delay(), perSample, cpu);
+  hal.serial->print(line);
+  snprintf(line, sizeof(line), "  error max (uV): %.4f%s\r\n", maxError * 1e6, ok ? "  OK" : "  FUERA DE TOLERANCIA");
+  hal.serial->print(line);
+  snprintf(line, sizeof(line), "  tono de %.0f Hz: %.2f dB; de %.0f Hz (se pliega a %.0f Hz): %.1f dB, 0 dB con 1 de %d\r\n",
+           0.2 * outRate, pass, 0.6 * outRate, 0.4 * outRate, folded, factor);
+  hal.serial->print(line);
+  // Evita que el compilador descarte el lazo de medición
+  if (sink == 12345.0f) {
+    hal.serial->println("");
+  }
+  return ok;
+}
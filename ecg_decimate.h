@@ -0,0 +1,114 @@
+#ifndef ECG_DECIMATE_H
+#define ECG_DECIMATE_H
+
+#include <stdint.h>
+
+#include "ecg_filter.h"
+#include "ecg_queue.h"
+
+// Decimación polifásica de las tres derivaciones: un FIR pasa bajos de fase
+// lineal a la frecuencia de adquisición del que solo se calculan las salidas
+// que se usan. Los coeficientes h se reparten en `factor` ramas (h[r],
+// h[r + M], h[r + 2M], ...); cada entrada usa una sola rama y suma su aporte
+// a las ECG_DECIM_PHASE_TAPS salidas en curso (forma transpuesta), así que el
+// trabajo es el mismo en todas las muestras en vez de una ráfaga cada M.
+//
+// El FIR tiene L = ECG_DECIM_PHASE_TAPS * M - 1 coeficientes: con L impar el
+// retardo es un número entero de muestras, (L - 1) / 2, y cada salida lleva
+// el número de la entrada que le corresponde. Las salidas caen en las
+// muestras con seq múltiplo de M, de modo que la grilla no depende de cuándo
+// arrancó el filtro y los latidos (numerados en seq) quedan en su lugar.
+//
+// Ventana de Kaiser de ECG_DECIM_STOP_DB con el corte en 0,4 de la
+// frecuencia de salida: la transición mide menos de 0,2 de la salida, así
+// que la banda eliminada empieza en su Nyquist y nada se pliega sobre la
+// señal, como pasa al tomar una de cada M muestras.
+
+const int ECG_DECIM_PHASE_TAPS = 20;
+const int ECG_DECIM_MAX_FACTOR = 10;   // 1 kHz -> 100 Hz
+const float ECG_DECIM_STOP_DB = 60;
+
+// Retardo del FIR de decimación por `factor`, en muestras de entrada
+inline uint32_t ecgDecimatorDelay(int factor) {
+  return factor > 1 ? (uint32_t)(ECG_DECIM_PHASE_TAPS * factor - 2) / 2 : 0;
+}
+
+// Coeficientes del FIR de decimación por `factor` (ecgDecimatorDelay() * 2 + 1
+// valores, ganancia 1 en continua)
+void designDecimationFir(int factor, float *h);
+
+class EcgDecimator {
+public:
+  EcgDecimator() : factor(0), head(0), nextSeq(0), started(false) {}
+  // Diseña el FIR para dividir la frecuencia por `factor` (1 deja pasar las
+  // muestras); false si no está entre 1 y ECG_DECIM_MAX_FACTOR
+  bool begin(int factor);
+  void reset();
+  int decimation() const { return factor; }
+  uint32_t delay() const { return ecgDecimatorDelay(factor); }
+  // Una muestra de entrada con su número de secuencia; true cuando completa
+  // una salida, que corresponde a la entrada seq - delay() (múltiplo de
+  // decimation()); las que caen antes de la muestra 0 se descartan. Un salto
+  // en seq reinicia el filtro.
+  bool process(uint32_t seq, const float in[ECG_LEADS], float out[ECG_LEADS]) {
+    if (factor <= 1) {
+      for (int l = 0; l < ECG_LEADS; l++) {
+        out[l] = in[l];
+      }
+      return factor == 1;
+    }
+    if (started && seq != nextSeq) {
+      reset();
+    }
+    started = true;
+    nextSeq = seq + 1;
+    // Entradas que faltan para la próxima salida: elige la rama
+    int r = (int)((delay() % factor + factor - seq % factor) % factor);
+    const float *e = branch[r];
+    float x[ECG_BANK_LANES] = {0, 0, 0, 0};
+    for (int l = 0; l < ECG_LEADS; l++) {
+      x[l] = in[l];
+    }
+    int a = head;
+    for (int j = 0; j < ECG_DECIM_PHASE_TAPS; j++) {
+      const float c = e[j];
+      float *s = acc[a];
+      for (int l = 0; l < ECG_BANK_LANES; l++) {
+        s[l] += c * x[l];
+      }
+      a = a + 1 == ECG_DECIM_PHASE_TAPS ? 0 : a + 1;
+    }
+    if (r != 0) {
+      return false;
+    }
+    float *done = acc[head];
+    for (int l = 0; l < ECG_LEADS; l++) {
+      out[l] = done[l];
+    }
+    for (int l = 0; l < ECG_BANK_LANES; l++) {
+      done[l] = 0;
+    }
+    head = head + 1 == ECG_DECIM_PHASE_TAPS ? 0 : head + 1;
+    return seq >= delay();
+  }
+
+private:
+  int factor;
+  // branch[r][j] = h[r + j * factor]: la rama de las entradas a r de la salida
+  float branch[ECG_DECIM_MAX_FACTOR][ECG_DECIM_PHASE_TAPS];
+  // Salidas en curso, la próxima en head
+  float acc[ECG_DECIM_PHASE_TAPS][ECG_BANK_LANES];
+  int head;
+  uint32_t nextSeq;
+  bool started;
+};
+
+// Compara la forma polifásica con el FIR completo (convolución directa y una
+// de cada M salidas), mide la atenuación de un tono que se pliega y de uno
+// de la banda pasante contra tomar una de cada M muestras, y los ciclos por
+// muestra de entrada de las tres derivaciones. Imprime por hal.serial qué
+// parte del CPU ocupa a `rate` Hz y devuelve false si la diferencia sale de
+// tolerancia o el tono plegado no baja ECG_DECIM_STOP_DB - 6 dB.
+bool benchmarkDecimator(uint32_t samples, uint32_t rate, int factor);
+
+#endif
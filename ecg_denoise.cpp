@@ -0,0 +1,303 @@
+#include "ecg_denoise.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "ecg_hal.h"
+#include "ecg_queue.h"
+
+// Factorización de la matriz polifásica del análisis de sym4 en potencias de
+// z^-1 (algoritmo de Euclides sobre las fases de dec_lo), con
+// e[n] = x[2n] y o[n] = x[2n + 1]:
+//   o1 = o + s1 e;  e2 = e + s2 * o1;  o3 = o1 + s3 * e2;  e4 = e2 + s4 * o3
+//   cA[n] = K e4[n];  cD[n] = c0 e4[n] + c1 e4[n-1] + c2 e4[n-2] + E o3[n-3]
+// (sX * y = sX[0] y[n] + sX[1] y[n-1]). Todos los pasos son causales.
+static const float liftStep1 = -2.556583965518236f;
+static const float liftStep2[2] = {0.5094009179885117f, -0.01903120704679051f};
+static const float liftStep3[2] = {-3.7590621400699296f, -1.1740061152382701f};
+static const float liftStep4[2] = {-0.47217344059136335f, 7.009094841329189f};
+static const float liftScale = -0.0804838303031459f;
+static const float liftDetail[3] = {-0.034229711526802264f, -0.11941779418928933f, -1.7726762525514965f};
+static const float liftDelayed = 12.424855977105452f;
+
+static uint32_t nextPowerOfTwo(uint32_t v) {
+  uint32_t p = 1;
+  while (p < v) {
+    p <<= 1;
+  }
+  return p;
+}
+
+EcgWaveletDenoiser::EcgWaveletDenoiser()
+    : levels(0), window(0), sorted(0), arrival(0), count(0), arrivalPos(0), noiseFactor(0), noiseThreshold(0),
+      fixedThreshold(0), output(0), outputMask(0), inputCount(0) {
+  memory.data = 0;
+  memory.phase = 0;
+  memset(stages, 0, sizeof(stages));
+}
+
+bool EcgWaveletDenoiser::begin(int level, uint32_t windowSize, bool permanent) {
+  if (level < 1 || level > ECG_DENOISE_MAX_LEVEL || windowSize == 0) {
+    levels = 0;
+    return false;
+  }
+  float *mem =
+      (float *)ecgArena.take(memory, ecgDenoiseFloats(level, windowSize) * sizeof(float), "wavelet", permanent);
+  if (!mem) {
+    levels = 0;
+    return false;
+  }
+  levels = level;
+  window = windowSize;
+  sorted = mem;
+  arrival = sorted + window;
+  float *rings = arrival + window;
+  // El detalle k lo usa la síntesis de ese nivel hasta 7 * 2^(level - k) - 7
+  // coeficientes después de salir (el del último nivel, en el momento)
+  for (int k = 1; k <= levels; k++) {
+    uint32_t size = nextPowerOfTwo(7 * (1u << (levels - k)) - 6);
+    stages[k - 1].details = rings;
+    stages[k - 1].detailMask = size - 1;
+    rings += size;
+  }
+  // La síntesis entrega 2^level muestras juntas cada 2^level entradas
+  output = rings;
+  outputMask = (1u << levels) - 1;
+  noiseFactor = sqrtf(2.0f * logf(2.0f * window)) * 1.5f / 0.6745f;
+  reset();
+  return true;
+}
+
+void EcgWaveletDenoiser::reset() {
+  if (levels == 0) {
+    return;
+  }
+  // La síntesis del nivel k empieza en el índice -(6 * 2^(level - k) - 6):
+  // lo que reconstruye antes del primer detalle es el relleno inicial
+  for (int k = 1; k <= levels; k++) {
+    Stage &s = stages[k - 1];
+    float *details = s.details;
+    uint32_t mask = s.detailMask;
+    memset(&s, 0, sizeof(s));
+    s.details = details;
+    s.detailMask = mask;
+    s.next = 0u - 6 * ((1u << (levels - k)) - 1);
+    memset(details, 0, (mask + 1) * sizeof(float));
+  }
+  memset(output, 0, (outputMask + 1) * sizeof(float));
+  count = arrivalPos = 0;
+  noiseThreshold = 0;
+  inputCount = 0;
+}
+
+bool EcgWaveletDenoiser::analyze(Stage &s, float x, float &approx, float &detail) {
+  if (!s.haveEven) {
+    s.even = x;
+    s.haveEven = true;
+    return false;
+  }
+  s.haveEven = false;
+  float o1 = x + liftStep1 * s.even;
+  float e2 = s.even + liftStep2[0] * o1 + liftStep2[1] * s.o1Prev;
+  float o3 = o1 + liftStep3[0] * e2 + liftStep3[1] * s.e2Prev;
+  float e4 = e2 + liftStep4[0] * o3 + liftStep4[1] * s.o3[0];
+  approx = liftScale * e4;
+  detail = liftDetail[0] * e4 + liftDetail[1] * s.e4[0] + liftDetail[2] * s.e4[1] + liftDelayed * s.o3[2];
+  s.o1Prev = o1;
+  s.e2Prev = e2;
+  s.o3[2] = s.o3[1];
+  s.o3[1] = s.o3[0];
+  s.o3[0] = o3;
+  s.e4[1] = s.e4[0];
+  s.e4[0] = e4;
+  return true;
+}
+
+// Síntesis del nivel k con cA_k reconstruido y su detalle: deshace los pasos
+// en orden inverso y entrega x[2(i - 3)] y x[2(i - 3) + 1] al nivel k - 1
+void EcgWaveletDenoiser::rebuild(int k, float approx) {
+  Stage &s = stages[k - 1];
+  uint32_t i = s.next++;
+  float detail = s.details[i & s.detailMask];
+  float e4 = approx / liftScale;
+  float o3 = (detail - liftDetail[0] * e4 - liftDetail[1] * s.synE4[0] - liftDetail[2] * s.synE4[1]) / liftDelayed;
+  float e4Old = s.synE4[2];
+  s.synE4[2] = s.synE4[1];
+  s.synE4[1] = s.synE4[0];
+  s.synE4[0] = e4;
+  float e3 = e4Old - liftStep4[0] * o3 - liftStep4[1] * s.synO3Prev;
+  float o2 = o3 - liftStep3[0] * e3 - liftStep3[1] * s.synE3Prev;
+  float e1 = e3 - liftStep2[0] * o2 - liftStep2[1] * s.synO2Prev;
+  float o0 = o2 - liftStep1 * e1;
+  s.synO3Prev = o3;
+  s.synE3Prev = e3;
+  s.synO2Prev = o2;
+  if (k == 1) {
+    uint32_t m = 2 * (i - 3);
+    output[m & outputMask] = e1;
+    output[(m + 1) & outputMask] = o0;
+  } else {
+    rebuild(k - 1, e1);
+    rebuild(k - 1, o0);
+  }
+}
+
+void EcgWaveletDenoiser::trackNoise(float magnitude) {
+  uint32_t at;
+  if (count == window) {
+    // Reemplaza al más viejo corriendo solo lo que queda entre los dos lugares
+    float old = arrival[arrivalPos];
+    uint32_t from = std::lower_bound(sorted, sorted + count, old) - sorted;
+    uint32_t to = std::upper_bound(sorted, sorted + count, magnitude) - sorted;
+    if (to > from) {
+      to--;
+      memmove(sorted + from, sorted + from + 1, (to - from) * sizeof(float));
+    } else {
+      memmove(sorted + to + 1, sorted + to, (from - to) * sizeof(float));
+    }
+    at = to;
+  } else {
+    at = std::upper_bound(sorted, sorted + count, magnitude) - sorted;
+    memmove(sorted + at + 1, sorted + at, (count - at) * sizeof(float));
+    count++;
+  }
+  sorted[at] = magnitude;
+  arrival[arrivalPos] = magnitude;
+  arrivalPos = arrivalPos + 1 == window ? 0 : arrivalPos + 1;
+  // np.median: promedio de los dos del medio si son pares
+  float median = count % 2 ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+  noiseThreshold = median * noiseFactor;
+}
+
+float EcgWaveletDenoiser::process(float x) {
+  if (levels == 0) {
+    return x;
+  }
+  float v = x;
+  for (int k = 1; k <= levels; k++) {
+    Stage &s = stages[k - 1];
+    float approx, detail;
+    if (!analyze(s, v, approx, detail)) {
+      break;
+    }
+    if (k == 1) {
+      trackNoise(fabsf(detail));
+    }
+    // Umbral suave con el sigma de ahora
+    float t = threshold();
+    float m = fabsf(detail) - t;
+    s.details[s.produced++ & s.detailMask] = m > 0 ? (detail > 0 ? m : -m) : 0;
+    if (k == levels) {
+      rebuild(levels, approx);
+    }
+    v = approx;
+  }
+  return output[(inputCount++ - delay()) & outputMask];
+}
+
+bool ecgDenoiseSignal(EcgWaveletDenoiser &denoiser, const float *x, uint32_t n, float *out) {
+  uint32_t delay = denoiser.delay();
+  // Un prefijo múltiplo de 2^level deja cada nivel en la misma fase que pywt
+  uint32_t block = 1u << denoiser.level();
+  uint32_t prefix = (delay + block - 1) / block * block;
+  if (denoiser.level() == 0 || n < prefix) {
+    return false;
+  }
+  denoiser.reset();
+  // x[-1] = x[0], x[-2] = x[1], ... y lo mismo después del final
+  for (uint32_t i = prefix; i > 0; i--) {
+    denoiser.process(x[i - 1]);
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    float y = denoiser.process(x[i]);
+    if (i >= delay) {
+      out[i - delay] = y;
+    }
+  }
+  for (uint32_t j = 0; j < delay; j++) {
+    out[n - delay + j] = denoiser.process(x[n - 1 - j]);
+  }
+  return true;
+}
+
+// ---------------------------------------------------------------- Benchmark
+
+// Contra la versión por bloques con el mismo umbral (voltios). Los bordes no
+// se comparan: pywt refleja cada nivel y aquí se refleja solo la entrada.
+static const double toleranceDenoise = 20e-6;
+
+// Salida típica del banco: latidos de 1.2 Hz sin continua, 50 Hz y ruido
+static float denoiseTestSignal(uint32_t n, uint32_t rate, uint32_t &noise) {
+  double t = (double)n / rate;
+  double beat = pow(sin(M_PI * 1.2 * t), 40.0);
+  noise = noise * 1664525u + 1013904223u;
+  return (float)(0.9 * beat - 0.1 + 0.02 * sin(2 * M_PI * 50 * t) + ((noise >> 16) / 65536.0 - 0.5) * 0.05);
+}
+
+bool benchmarkWaveletDenoiser(uint32_t samples, uint32_t rate, int level) {
+  const uint32_t block = 1024;
+  static float x[block], ref[block + 1], out[block];
+  static float coeffs[block + ECG_WAVELET_MAX_LEVEL * (ECG_WAVELET_TAPS - 1)];
+  static float scratch[block / 2 + ECG_WAVELET_TAPS];
+  static EcgWaveletDenoiser leads[ECG_LEADS];
+  for (int l = 0; l < ECG_LEADS; l++) {
+    if (!leads[l].begin(level, ECG_DENOISE_LIVE_WINDOW)) {
+      hal.serial->println("Wavelet: sin memoria en ecgArena");
+      return false;
+    }
+  }
+
+  // Exactitud: el mismo bloque con el umbral que calcula la versión por bloques
+  uint32_t noise = 1;
+  for (uint32_t i = 0; i < block; i++) {
+    x[i] = denoiseTestSignal(i, rate, noise);
+  }
+  float threshold;
+  ecgWaveletDenoise(x, block, ref, coeffs, scratch, level, &threshold);
+  leads[0].setThreshold(threshold);
+  bool ok = ecgDenoiseSignal(leads[0], x, block, out);
+  leads[0].setThreshold(0);
+  uint32_t margin = 4u << level;
+  double maxError = 0;
+  for (uint32_t i = margin; ok && i + margin < block; i++) {
+    maxError = fmax(maxError, fabs(out[i] - ref[i]));
+  }
+  ok = ok && maxError <= toleranceDenoise;
+
+  // Velocidad: las tres derivaciones como en FilterTask, umbral estimado
+  for (int l = 0; l < ECG_LEADS; l++) {
+    leads[l].reset();
+  }
+  uint32_t rounds = samples / block + 1;
+  float sink = 0;
+  uint32_t start = hal.clock->cycleCount();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (uint32_t i = 0; i < block; i++) {
+      for (int l = 0; l < ECG_LEADS; l++) {
+        sink += leads[l].process(x[i]);
+      }
+    }
+  }
+  uint32_t cycles = hal.clock->cycleCount() - start;
+
+  double perSample = (double)cycles / ((double)rounds * block);
+  double cpu = perSample * rate / (hal.clock->cyclesPerUs() * 1e6) * 100;
+  hal.serial->print("Wavelet nivel ");
+  hal.serial->print(level, 0);
+  hal.serial->print(" x 3 derivaciones ciclos/muestra: ");
+  hal.serial->print(perSample, 1);
+  hal.serial->print(" (");
+  hal.serial->print(cpu, 2);
+  hal.serial->print(" % del CPU a ");
+  hal.serial->print(rate, 0);
+  hal.serial->print(" Hz)  error max (mV): ");
+  hal.serial->print(maxError * 1000.0, 4);
+  hal.serial->println(ok ? "  OK" : "  FUERA DE TOLERANCIA");
+  // Evita que el compilador descarte el lazo de medición
+  if (sink == 12345.0f) {
+    hal.serial->println("");
+  }
+  return ok;
+}
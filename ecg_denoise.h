@@ -0,0 +1,103 @@
+#ifndef ECG_DENOISE_H
+#define ECG_DENOISE_H
+
+#include <stdint.h>
+
+#include "ecg_memory.h"
+#include "ecg_wavelet.h"
+
+// Limpieza por wavelets en tiempo real: la misma cuenta que
+// ecgWaveletDenoise() (aplicar_wavelet_denoising de los notebooks) pero
+// muestra a muestra con retardo fijo, para la salida de FilterTask o para
+// recorrer una grabación.
+//
+// Cada nivel es sym4 con esquema de lifting: la matriz polifásica de
+// pywt.dwt factorizada en cuatro pasos de uno o dos coeficientes y un paso
+// final. Lejos de los bordes los coeficientes son los de pywt.wavedec (con
+// el mismo índice), la inversa es exacta por construcción y cada nivel
+// devuelve su entrada 3 pares después; en total ecgDenoiseDelay(level)
+// muestras.
+//
+// El umbral es el del notebook, sigma * sqrt(2 ln n) * 1.5, con sigma =
+// mediana(|cD1|) / 0.6745 sobre los últimos `window` coeficientes de cD1
+// (n = 2 * window muestras). La ventana se mantiene ordenada: cada
+// coeficiente nuevo reemplaza al más viejo con dos búsquedas binarias y un
+// corrimiento. Cada detalle se umbraliza con el sigma del momento en que sale.
+
+// Con ECG_WAVELET_DENOISE en un nivel (4 como el notebook) el sketch activa
+// la limpieza en FilterTask y ecg_memory.cpp reserva su ventana; en 0 queda
+// fuera.
+#ifndef ECG_WAVELET_DENOISE
+#define ECG_WAVELET_DENOISE 0
+#endif
+
+const int ECG_DENOISE_MAX_LEVEL = ECG_WAVELET_MAX_LEVEL;
+// Ventana de la mediana en la salida de FilterTask: 0,5 s de cD1 a 1 kHz
+const uint32_t ECG_DENOISE_LIVE_WINDOW = 256;
+
+// Retardo entre process(x) y la muestra limpia que devuelve
+inline uint32_t ecgDenoiseDelay(int level) { return 7 * ((1u << level) - 1); }
+// Floats de ecgArena que usa un EcgWaveletDenoiser (cota de los anillos)
+inline uint32_t ecgDenoiseFloats(int level, uint32_t window) { return 2 * window + (16u << level); }
+
+class EcgWaveletDenoiser {
+public:
+  EcgWaveletDenoiser();
+  // Toma la memoria de ecgArena (permanente para FilterTask, que no se
+  // detiene) y vuelve al estado inicial; false si no entra o el nivel no vale
+  bool begin(int level, uint32_t window, bool permanent = false);
+  // Estado inicial sin soltar la memoria
+  void reset();
+  // Una muestra; devuelve la limpia de delay() muestras atrás (0 al principio)
+  float process(float x);
+  uint32_t delay() const { return ecgDenoiseDelay(levels); }
+  int level() const { return levels; }
+  // Umbral fijo en vez de la mediana deslizante (0 vuelve a estimarlo)
+  void setThreshold(float threshold) { fixedThreshold = threshold; }
+  float threshold() const { return fixedThreshold > 0 ? fixedThreshold : noiseThreshold; }
+
+private:
+  // Estado de un nivel: historia de los pasos de lifting del análisis y de
+  // la síntesis, y anillo de detalles ya umbralizados hasta que la síntesis
+  // de ese nivel los usa
+  struct Stage {
+    float even;
+    bool haveEven;
+    float o1Prev, e2Prev, o3[3], e4[2];
+    float synE4[3], synO3Prev, synE3Prev, synO2Prev;
+    uint32_t produced;   // Índice del próximo detalle
+    uint32_t next;       // Índice de la próxima entrada de la síntesis
+    float *details;
+    uint32_t detailMask;
+  };
+  bool analyze(Stage &s, float x, float &approx, float &detail);
+  void rebuild(int k, float approx);
+  void trackNoise(float magnitude);
+
+  int levels;
+  uint32_t window;
+  Stage stages[ECG_DENOISE_MAX_LEVEL];
+  EcgArenaSlot memory;
+  float *sorted;         // |cD1| de la ventana, ordenados
+  float *arrival;        // Los mismos en orden de llegada (anillo)
+  uint32_t count, arrivalPos;
+  float noiseFactor;     // sqrt(2 ln n) * 1.5 / 0.6745
+  float noiseThreshold, fixedThreshold;
+  float *output;         // Anillo de 2^level muestras reconstruidas
+  uint32_t outputMask;
+  uint32_t inputCount;
+};
+
+// Limpia n muestras de una grabación ya entera: antes y después se pasa la
+// señal reflejada (como mode='symmetric' de pywt) y se descuenta el retardo,
+// así que out[i] corresponde a x[i]. out no puede ser x. Devuelve false si la
+// señal es más corta que el retardo.
+bool ecgDenoiseSignal(EcgWaveletDenoiser &denoiser, const float *x, uint32_t n, float *out);
+
+// Compara contra ecgWaveletDenoise() con el mismo umbral y mide ciclos por
+// muestra de las tres derivaciones con el nivel y la ventana de FilterTask,
+// como benchmarkFilters(). Imprime por hal.serial qué parte del CPU ocupa a
+// `rate` Hz y devuelve false si la diferencia sale de tolerancia.
+bool benchmarkWaveletDenoiser(uint32_t samples, uint32_t rate, int level = 4);
+
+#endif
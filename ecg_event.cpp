@@ -0,0 +1,70 @@
+#include "ecg_event.h"
+
+const char *ecgEventCauseText(EcgEventCause cause) {
+  return cause == ECG_EVENT_RHYTHM ? "ritmo" : "boton";
+}
+
+EcgEventBuffer::EcgEventBuffer() : samples(0), frames(1), written(0) {
+  memory.data = 0;
+  memory.phase = 0;
+}
+
+bool EcgEventBuffer::begin(uint32_t frames, uint8_t *external) {
+  written = 0;
+  uint8_t *mem = external;
+  if (!mem && frames > 0) {
+    mem = ecgArena.take(memory, ecgEventBufferBytes(frames), "eventos");
+  }
+  if (!mem || frames == 0) {
+    // Sin memoria todo queda como hueco
+    samples = 0;
+    this->frames = 1;
+    return false;
+  }
+  samples = (int16_t *)mem;
+  this->frames = frames;
+  return true;
+}
+
+void EcgEventBuffer::skip(uint32_t count) {
+  // Más de una vuelta es lo mismo que una
+  uint32_t marked = count < frames ? count : frames;
+  for (uint32_t i = 0; samples && i < marked; i++) {
+    samples[((written + count - marked + i) % frames) * ECG_LEADS] = ECG_EVENT_GAP;
+  }
+  written += count;
+}
+
+bool EcgEventBuffer::read(uint32_t index, float volts[ECG_LEADS]) const {
+  if (!samples || index >= written || index < oldest()) {
+    return false;
+  }
+  const int16_t *in = samples + (index % frames) * ECG_LEADS;
+  if (in[0] == ECG_EVENT_GAP) {
+    return false;
+  }
+  for (int l = 0; l < ECG_LEADS; l++) {
+    volts[l] = in[l] * ECG_EVENT_GAIN;
+  }
+  return true;
+}
+
+void EcgRhythmTrigger::begin(float minBpm, float maxBpm) {
+  this->minBpm = minBpm;
+  this->maxBpm = maxBpm;
+  outside = false;
+}
+
+bool EcgRhythmTrigger::update(float bpm) {
+  if (bpm <= 0) {
+    return false;
+  }
+  if (!outside) {
+    outside = bpm < minBpm || bpm > maxBpm;
+    return outside;
+  }
+  if (bpm >= minBpm + ECG_EVENT_BPM_HYSTERESIS && bpm <= maxBpm - ECG_EVENT_BPM_HYSTERESIS) {
+    outside = false;
+  }
+  return false;
+}
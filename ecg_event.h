@@ -0,0 +1,90 @@
+#ifndef ECG_EVENT_H
+#define ECG_EVENT_H
+
+#include <stdint.h>
+
+#include "ecg_memory.h"
+#include "ecg_queue.h"
+
+// Registrador de eventos (modo monitor). Las muestras grabadas de las tres
+// derivaciones entran sin parar en un buffer circular; un disparo (botón o
+// ritmo fuera de rango) guarda en la SD lo que quedó antes y lo que llega
+// después, sin detener la adquisición ni el barrido. El buffer se vacía a la
+// velocidad que la SD acepta: mientras tanto lo nuevo sigue entrando y solo se
+// pierde lo que se pisa antes de llegar a la grabación.
+
+// Atraso de la SD que tolera el buffer además de lo anterior al disparo
+const uint32_t ECG_EVENT_MARGIN_SECONDS = 5;
+// Sin memoria externa el buffer sale de ecgArena: 12 s a 250 Hz (7 s antes
+// del disparo); a otra storageRate cubre más o menos tiempo
+const uint32_t ECG_EVENT_ARENA_FRAMES = 3000;
+// Resolución del buffer: la misma que la escala por defecto del .ecg
+const float ECG_EVENT_GAIN = 0.0001f;
+// Cuenta que marca una muestra perdida (ecgQuantize no la produce aquí)
+const int16_t ECG_EVENT_GAP = -32768;
+// El ritmo vuelve a normal a esta distancia de los límites (evita disparos
+// repetidos con el BPM en el borde)
+const float ECG_EVENT_BPM_HYSTERESIS = 5;
+
+enum EcgEventCause {
+  ECG_EVENT_BUTTON,   // Lo pidió el usuario
+  ECG_EVENT_RHYTHM    // BPM fuera de [eventMinBpm, eventMaxBpm]
+};
+
+const char *ecgEventCauseText(EcgEventCause cause);
+
+inline uint32_t ecgEventBufferBytes(uint32_t frames) {
+  return frames * ECG_LEADS * sizeof(int16_t);
+}
+
+// Muestras numeradas desde begin(); guarda las últimas capacity()
+class EcgEventBuffer {
+public:
+  EcgEventBuffer();
+  // `frames` muestras en `memory` (la PSRAM del ESP32, por ejemplo) o, con
+  // memory NULL, en la fase actual de ecgArena
+  bool begin(uint32_t frames, uint8_t *memory = 0);
+  void push(const float volts[ECG_LEADS]) {
+    if (!samples) {
+      written++;
+      return;
+    }
+    int16_t *out = samples + (written % frames) * ECG_LEADS;
+    for (int l = 0; l < ECG_LEADS; l++) {
+      float raw = volts[l] / ECG_EVENT_GAIN;
+      raw = raw > 32767 ? 32767 : (raw < -32767 ? -32767 : raw);
+      out[l] = (int16_t)(raw + (raw >= 0 ? 0.5f : -0.5f));
+    }
+    written++;
+  }
+  // Hueco de `count` muestras perdidas antes de la próxima
+  void skip(uint32_t count);
+  uint32_t head() const { return written; }   // Número de la próxima muestra
+  uint32_t oldest() const { return written > frames ? written - frames : 0; }
+  uint32_t capacity() const { return frames; }
+  // Muestra `index` en voltios; false si es un hueco o ya se pisó
+  bool read(uint32_t index, float volts[ECG_LEADS]) const;
+
+private:
+  EcgArenaSlot memory;
+  int16_t *samples;
+  uint32_t frames;
+  uint32_t written;
+};
+
+// Disparo por ritmo: una vez al salir de [minBpm, maxBpm] y de nuevo solo
+// después de volver al rango con ECG_EVENT_BPM_HYSTERESIS de margen
+class EcgRhythmTrigger {
+public:
+  EcgRhythmTrigger() : minBpm(0), maxBpm(0), outside(false) {}
+  void begin(float minBpm, float maxBpm);
+  // bpm 0 (sin latidos recientes) no cambia nada
+  bool update(float bpm);
+  bool abnormal() const { return outside; }
+
+private:
+  float minBpm, maxBpm;
+  bool outside;
+};
+
+#endif
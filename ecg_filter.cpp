@@ -0,0 +1,251 @@
+#include "ecg_filter.h"
+
+#include <math.h>
+#include <XSControl.h>
+
+#include "ecg_hal.h"
+
+EcgBiquadCoeffs designSecondOrderLPF(double fc, double ts) {
+  // Butterworth de 2do orden (zeta = 0.707) discretizado con Euler hacia atrás:
+  // y[n] (1 + 2 zeta a + a^2) = a^2 x[n] + (2 + 2 zeta a) y[n-1] - y[n-2], a = wc Ts
+  const double zeta = 0.7071067811865476;
+  double a = 2.0 * M_PI * fc * ts;
+  double d = 1.0 + 2.0 * zeta * a + a * a;
+  EcgBiquadCoeffs c;
+  c.b0 = a * a / d;
+  c.b1 = 0;
+  c.b2 = 0;
+  c.a1 = -(2.0 + 2.0 * zeta * a) / d;
+  c.a2 = 1.0 / d;
+  return c;
+}
+
+EcgBiquadCoeffs designHighPass(double fc, double fs) {
+  double w0 = 2.0 * M_PI * fc / fs;
+  double alpha = sin(w0) / (2.0 * 0.7071067811865476);
+  double cw = cos(w0);
+  double a0 = 1.0 + alpha;
+  EcgBiquadCoeffs c;
+  c.b0 = (1.0 + cw) / 2.0 / a0;
+  c.b1 = -(1.0 + cw) / a0;
+  c.b2 = (1.0 + cw) / 2.0 / a0;
+  c.a1 = -2.0 * cw / a0;
+  c.a2 = (1.0 - alpha) / a0;
+  return c;
+}
+
+EcgBiquadCoeffs designNotch(double f0, double q, double fs) {
+  double w0 = 2.0 * M_PI * f0 / fs;
+  double alpha = sin(w0) / (2.0 * q);
+  double cw = cos(w0);
+  double a0 = 1.0 + alpha;
+  EcgBiquadCoeffs c;
+  c.b0 = 1.0 / a0;
+  c.b1 = -2.0 * cw / a0;
+  c.b2 = 1.0 / a0;
+  c.a1 = -2.0 * cw / a0;
+  c.a2 = (1.0 - alpha) / a0;
+  return c;
+}
+
+void EcgBiquadF32::setCoeffs(const EcgBiquadCoeffs &c) {
+  b0 = c.b0;
+  b1 = c.b1;
+  b2 = c.b2;
+  a1 = c.a1;
+  a2 = c.a2;
+}
+
+// Cuantiza los coeficientes con `bits` bits fraccionarios. Si el filtro tiene
+// ganancia DC unitaria se corrige b0 para que la conserve exactamente; si no,
+// un offset de 1.65 V saldría corrido varios mV por el redondeo.
+static void quantizeCoeffs(const EcgBiquadCoeffs &c, int bits, int32_t q[5]) {
+  double scale = (double)(1L << bits);
+  q[0] = (int32_t)lround(c.b0 * scale);
+  q[1] = (int32_t)lround(c.b1 * scale);
+  q[2] = (int32_t)lround(c.b2 * scale);
+  q[3] = (int32_t)lround(c.a1 * scale);
+  q[4] = (int32_t)lround(c.a2 * scale);
+  if (fabs((c.b0 + c.b1 + c.b2) - (1.0 + c.a1 + c.a2)) < 1e-12) {
+    q[0] = (int32_t)(1L << bits) + q[3] + q[4] - q[1] - q[2];
+  }
+}
+
+void EcgBiquadQ15::setCoeffs(const EcgBiquadCoeffs &c) {
+  int32_t q[5];
+  quantizeCoeffs(c, 14, q);
+  b0 = q[0];
+  b1 = q[1];
+  b2 = q[2];
+  a1 = q[3];
+  a2 = q[4];
+}
+
+void EcgBiquadQ31::setCoeffs(const EcgBiquadCoeffs &c) {
+  int32_t q[5];
+  quantizeCoeffs(c, 30, q);
+  b0 = q[0];
+  b1 = q[1];
+  b2 = q[2];
+  a1 = q[3];
+  a2 = q[4];
+}
+
+void EcgFilterBank::configure(const EcgFilterBankConfig &config) {
+  stages = 0;
+  // Orden: pasa altos (quita el offset de ~1.65 V), notch y pasa bajos
+  if (config.highPassHz > 0) {
+    addStage(designHighPass(config.highPassHz, config.sampleRate));
+  }
+  if (config.notchHz > 0) {
+    addStage(designNotch(config.notchHz, config.notchQ, config.sampleRate));
+  }
+  if (config.lowPassHz > 0) {
+    addStage(designSecondOrderLPF(config.lowPassHz, 1.0 / config.sampleRate));
+  }
+  reset();
+}
+
+void EcgFilterBank::addStage(const EcgBiquadCoeffs &c) {
+  if (stages == ECG_BANK_MAX_STAGES) {
+    return;
+  }
+  b0[stages] = c.b0;
+  b1[stages] = c.b1;
+  b2[stages] = c.b2;
+  a1[stages] = c.a1;
+  a2[stages] = c.a2;
+  stages++;
+}
+
+void EcgFilterBank::reset() {
+  for (int s = 0; s < ECG_BANK_MAX_STAGES; s++) {
+    for (int l = 0; l < ECG_BANK_LANES; l++) {
+      z1[s][l] = 0;
+      z2[s][l] = 0;
+    }
+  }
+}
+
+// ---------------------------------------------------------------- Benchmark
+
+// Tolerancias contra SecondOrderLPF en double (voltios)
+static const double toleranceF32 = 20e-6;
+static const double toleranceQ15 = 1e-3;     // ~8 LSB de Q15 con escala de 4 V (coeficientes Q14)
+static const double toleranceQ31 = 1e-6;
+
+// Señal de prueba: latidos de 1.2 Hz sobre 1.65 V, 50 Hz y ruido
+static float testSignal(uint32_t n, uint32_t &noise) {
+  double t = n * 0.001;
+  double beat = pow(sin(M_PI * 1.2 * t), 40.0);
+  noise = noise * 1664525u + 1013904223u;
+  return (float)(1.65 + 0.9 * beat + 0.05 * sin(2 * M_PI * 50 * t) + ((noise >> 16) / 65536.0 - 0.5) * 0.02);
+}
+
+static void printResult(const char *name, double cyclesPerSample, double maxError, double tolerance) {
+  hal.serial->print(name);
+  hal.serial->print(" ciclos/muestra: ");
+  hal.serial->print(cyclesPerSample, 1);
+  hal.serial->print("  error max (mV): ");
+  hal.serial->print(maxError * 1000.0, 4);
+  hal.serial->println(maxError <= tolerance ? "  OK" : "  FUERA DE TOLERANCIA");
+}
+
+bool benchmarkFilters(uint32_t samples) {
+  const double fc = 40, ts = 0.001;
+  EcgBiquadCoeffs c = designSecondOrderLPF(fc, ts);
+  XSFilter reference;
+  EcgBiquadF32 f32;
+  EcgBiquadQ15 q15;
+  EcgBiquadQ31 q31;
+  f32.setCoeffs(c);
+  q15.setCoeffs(c);
+  q31.setCoeffs(c);
+
+  // Exactitud: las tres versiones y la referencia sobre la misma señal
+  double errF32 = 0, errQ15 = 0, errQ31 = 0;
+  uint32_t noise = 1;
+  for (uint32_t n = 0; n < samples; n++) {
+    float x = testSignal(n, noise);
+    double ref = reference.SecondOrderLPF(x, fc, ts);
+    errF32 = fmax(errF32, fabs(f32.step(x) - ref));
+    errQ15 = fmax(errQ15, fabs(ecgQ15ToVolts(q15.step(ecgVoltsToQ15(x))) - ref));
+    errQ31 = fmax(errQ31, fabs(ecgQ31ToVolts(q31.step(ecgVoltsToQ31(x))) - ref));
+  }
+
+  // Velocidad: bloques de 256 muestras ya convertidas, sin contar la señal de prueba
+  const int block = 256;
+  static float inF[block], outF[block];
+  static int16_t in15[block], out15[block];
+  static int32_t in31[block], out31[block];
+  noise = 1;
+  for (int i = 0; i < block; i++) {
+    inF[i] = testSignal(i, noise);
+    in15[i] = ecgVoltsToQ15(inF[i]);
+    in31[i] = ecgVoltsToQ31(inF[i]);
+  }
+  uint32_t rounds = samples / block + 1;
+  uint32_t start = hal.clock->cycleCount();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (int i = 0; i < block; i++) {
+      outF[i] = (float)reference.SecondOrderLPF(inF[i], fc, ts);
+    }
+  }
+  uint32_t cyclesRef = hal.clock->cycleCount() - start;
+  start = hal.clock->cycleCount();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (int i = 0; i < block; i++) {
+      outF[i] = f32.step(inF[i]);
+    }
+  }
+  uint32_t cyclesF32 = hal.clock->cycleCount() - start;
+  start = hal.clock->cycleCount();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (int i = 0; i < block; i++) {
+      out15[i] = q15.step(in15[i]);
+    }
+  }
+  uint32_t cyclesQ15 = hal.clock->cycleCount() - start;
+  start = hal.clock->cycleCount();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (int i = 0; i < block; i++) {
+      out31[i] = q31.step(in31[i]);
+    }
+  }
+  uint32_t cyclesQ31 = hal.clock->cycleCount() - start;
+
+  // Banco completo (pasa altos + notch + pasa bajos) sobre las 3 derivaciones
+  EcgFilterBank bank;
+  bank.configure(ecgDefaultFilterConfig);
+  float frame[ECG_LEADS];
+  start = hal.clock->cycleCount();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (int i = 0; i < block; i++) {
+      frame[0] = inF[i];
+      frame[1] = inF[i];
+      frame[2] = 0;
+      bank.process(frame);
+      outF[i] = frame[0];
+    }
+  }
+  uint32_t cyclesBank = hal.clock->cycleCount() - start;
+
+  double total = (double)rounds * block;
+#ifdef XSCONTROL_HOST_STUB
+  hal.serial->println("Referencia: copia de SecondOrderLPF (host/XSControl.h), no valida contra XSControl");
+#endif
+  hal.serial->print("SecondOrderLPF ciclos/muestra: ");
+  hal.serial->println(cyclesRef / total, 1);
+  printResult("Biquad float32", cyclesF32 / total, errF32, toleranceF32);
+  printResult("Biquad Q15    ", cyclesQ15 / total, errQ15, toleranceQ15);
+  printResult("Biquad Q31    ", cyclesQ31 / total, errQ31, toleranceQ31);
+  hal.serial->print("Banco 3 derivaciones x ");
+  hal.serial->print(bank.stageCount(), 0);
+  hal.serial->print(" etapas ciclos/muestra: ");
+  hal.serial->println(cyclesBank / total, 1);
+  // Evita que el compilador descarte los lazos de medición
+  if (outF[0] == 12345.0f && out15[0] == 1 && out31[0] == 1) {
+    hal.serial->println("");
+  }
+  return errF32 <= toleranceF32 && errQ15 <= toleranceQ15 && errQ31 <= toleranceQ31;
+}
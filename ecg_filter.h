@@ -0,0 +1,161 @@
+#ifndef ECG_FILTER_H
+#define ECG_FILTER_H
+
+#include <stdint.h>
+
+#include "ecg_queue.h"
+
+// Biquads en forma directa II transpuesta con coeficientes precalculados.
+// Reemplazan a XSFilter::SecondOrderLPF, que recalcula los coeficientes en
+// double (emulado por software en el ESP32) en cada muestra.
+
+// Coeficientes normalizados (a0 = 1):
+//   y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+struct EcgBiquadCoeffs {
+  double b0, b1, b2, a1, a2;
+};
+
+// Mismo pasa bajos de 2do orden que XSFilter::SecondOrderLPF(x, fc, Ts)
+EcgBiquadCoeffs designSecondOrderLPF(double fc, double ts);
+
+// Pasa altos Butterworth de 2do orden (transformación bilineal), para la deriva de línea base
+EcgBiquadCoeffs designHighPass(double fc, double fs);
+// Rechaza banda (notch) de 2do orden centrado en f0 con factor de calidad q
+EcgBiquadCoeffs designNotch(double f0, double q, double fs);
+
+// Escala de las versiones de punto fijo: 1.0 (Q15/Q31) = ecgFixedFullScale voltios
+const float ecgFixedFullScale = 4.0f;
+
+inline int16_t ecgVoltsToQ15(float v) {
+  float q = v / ecgFixedFullScale * 32768.0f;
+  return q >= 32767.0f ? 32767 : (q <= -32768.0f ? -32768 : (int16_t)(q + (q >= 0 ? 0.5f : -0.5f)));
+}
+inline float ecgQ15ToVolts(int16_t q) { return q * (ecgFixedFullScale / 32768.0f); }
+inline int32_t ecgVoltsToQ31(float v) {
+  double q = (double)v / ecgFixedFullScale * 2147483648.0;
+  return q >= 2147483647.0 ? 2147483647 : (q <= -2147483648.0 ? (int32_t)-2147483648LL : (int32_t)q);
+}
+inline float ecgQ31ToVolts(int32_t q) { return (float)(q * (ecgFixedFullScale / 2147483648.0)); }
+
+// float32: en el ESP32 usa la FPU de precisión simple
+class EcgBiquadF32 {
+public:
+  EcgBiquadF32() : b0(1), b1(0), b2(0), a1(0), a2(0), z1(0), z2(0) {}
+  void setCoeffs(const EcgBiquadCoeffs &c);
+  void reset() { z1 = z2 = 0; }
+  float step(float x) {
+    float y = b0 * x + z1;
+    z1 = b1 * x - a1 * y + z2;
+    z2 = b2 * x - a2 * y;
+    return y;
+  }
+
+private:
+  float b0, b1, b2, a1, a2;
+  float z1, z2;
+};
+
+// Q15: muestras de 16 bits, coeficientes Q2.14 y estado de 32 bits.
+// La realimentación usa la salida con precisión completa (producto de 64 bits)
+// para que el redondeo no se amplifique con la ganancia del lazo.
+class EcgBiquadQ15 {
+public:
+  EcgBiquadQ15() : b0(1 << 14), b1(0), b2(0), a1(0), a2(0), z1(0), z2(0) {}
+  void setCoeffs(const EcgBiquadCoeffs &c);
+  void reset() { z1 = z2 = 0; }
+  int16_t step(int16_t x) {
+    int32_t acc = b0 * x + z1;  // Q29
+    z1 = b1 * x + z2 - (int32_t)(((int64_t)a1 * acc) >> 14);
+    z2 = b2 * x - (int32_t)(((int64_t)a2 * acc) >> 14);
+    int32_t y = (acc + (1 << 13)) >> 14;
+    return y > 32767 ? 32767 : (y < -32768 ? -32768 : (int16_t)y);
+  }
+
+private:
+  int32_t b0, b1, b2, a1, a2;
+  int32_t z1, z2;
+};
+
+// Q31: muestras de 32 bits, coeficientes Q2.30, acumulador de 64 bits
+class EcgBiquadQ31 {
+public:
+  EcgBiquadQ31() : b0(1 << 30), b1(0), b2(0), a1(0), a2(0), z1(0), z2(0) {}
+  void setCoeffs(const EcgBiquadCoeffs &c);
+  void reset() { z1 = z2 = 0; }
+  int32_t step(int32_t x) {
+    int64_t acc = (int64_t)b0 * x + z1;  // Q61
+    int64_t y = (acc + (1LL << 29)) >> 30;
+    if (y > 2147483647LL) y = 2147483647LL;
+    if (y < -2147483648LL) y = -2147483648LL;
+    z1 = (int64_t)b1 * x - (int64_t)a1 * y + z2;
+    z2 = (int64_t)b2 * x - (int64_t)a2 * y;
+    return (int32_t)y;
+  }
+
+private:
+  int32_t b0, b1, b2, a1, a2;
+  int64_t z1, z2;
+};
+
+// Configuración del banco de filtros; una frecuencia en 0 desactiva la etapa
+struct EcgFilterBankConfig {
+  float sampleRate;
+  float highPassHz;   // Deriva de línea base (respiración, movimiento)
+  float notchHz;      // Red eléctrica: 60 Hz en Perú, 50 Hz en otros países
+  float notchQ;
+  float lowPassHz;    // Mismo pasa bajos que XSFilter::SecondOrderLPF
+};
+
+const EcgFilterBankConfig ecgDefaultFilterConfig = {1000.0f, 0.5f, 60.0f, 30.0f, 40.0f};
+
+const int ECG_BANK_MAX_STAGES = 4;
+const int ECG_BANK_LANES = 4;  // Derivaciones rellenadas a 4 para vectorizar
+
+// Cascada de biquads float32 aplicada a todas las derivaciones a la vez.
+// El estado se guarda como estructura de arreglos (una fila de 4 carriles por
+// etapa) y los coeficientes se comparten, así que el lazo interno sobre las
+// derivaciones no tiene dependencias y el compilador lo puede vectorizar.
+class EcgFilterBank {
+public:
+  EcgFilterBank() : stages(0) {}
+  void configure(const EcgFilterBankConfig &config);
+  void reset();
+  int stageCount() const { return stages; }
+
+  // Filtra una muestra de todas las derivaciones en el lugar
+  void process(float lead[ECG_LEADS]) {
+    float x[ECG_BANK_LANES] = {0, 0, 0, 0};
+    for (int l = 0; l < ECG_LEADS; l++) {
+      x[l] = lead[l];
+    }
+    for (int s = 0; s < stages; s++) {
+      float *s1 = z1[s], *s2 = z2[s];
+      const float c0 = b0[s], c1 = b1[s], c2 = b2[s], d1 = a1[s], d2 = a2[s];
+      for (int l = 0; l < ECG_BANK_LANES; l++) {
+        float y = c0 * x[l] + s1[l];
+        s1[l] = c1 * x[l] - d1 * y + s2[l];
+        s2[l] = c2 * x[l] - d2 * y;
+        x[l] = y;
+      }
+    }
+    for (int l = 0; l < ECG_LEADS; l++) {
+      lead[l] = x[l];
+    }
+  }
+
+private:
+  void addStage(const EcgBiquadCoeffs &c);
+
+  int stages;
+  float b0[ECG_BANK_MAX_STAGES], b1[ECG_BANK_MAX_STAGES], b2[ECG_BANK_MAX_STAGES];
+  float a1[ECG_BANK_MAX_STAGES], a2[ECG_BANK_MAX_STAGES];
+  float z1[ECG_BANK_MAX_STAGES][ECG_BANK_LANES];
+  float z2[ECG_BANK_MAX_STAGES][ECG_BANK_LANES];
+};
+
+// Compara las tres versiones contra XSFilter::SecondOrderLPF con una señal de
+// prueba, mide ciclos por muestra con hal.clock->cycleCount() e imprime el
+// resultado por hal.serial. Devuelve false si alguna sale de su tolerancia.
+bool benchmarkFilters(uint32_t samples);
+
+#endif
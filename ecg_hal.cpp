@@ -0,0 +1,27 @@
+#include "ecg_hal.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Backends activos; setup() (o el main de Linux) los asigna antes de usar el pipeline
+EcgHal hal = {NULL, NULL, NULL, NULL, NULL, NULL};
+
+void EcgSerial::print(const char *text) {
+  write((const uint8_t *)text, strlen(text));
+}
+
+void EcgSerial::print(double value, int digits) {
+  char buf[32];
+  int len = snprintf(buf, sizeof(buf), "%.*f", digits, value);
+  write((const uint8_t *)buf, len);
+}
+
+void EcgSerial::println(const char *text) {
+  print(text);
+  write((const uint8_t *)"\r\n", 2);
+}
+
+void EcgSerial::println(double value, int digits) {
+  print(value, digits);
+  write((const uint8_t *)"\r\n", 2);
+}
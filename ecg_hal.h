@@ -0,0 +1,156 @@
+#ifndef ECG_HAL_H
+#define ECG_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Capa de abstracción del hardware. El código de adquisición, filtrado, BPM y
+// guardado (ecg_pipeline.cpp) solo habla con estas interfaces, así que corre
+// igual en el ESP32 (ecg_hal_esp32.h) y en Linux (host/ecg_hal_host.h).
+
+// Canales del AD8232 (equivalen a AD8232_XS1 y AD8232_XS2)
+const int ECG_ADC_XS1 = 0;
+const int ECG_ADC_XS2 = 1;
+
+// Colores RGB565 (los mismos valores que ILI9341_*)
+const uint16_t ECG_BLACK  = 0x0000;
+const uint16_t ECG_WHITE  = 0xFFFF;
+const uint16_t ECG_RED    = 0xF800;
+const uint16_t ECG_GREEN  = 0x07E0;
+const uint16_t ECG_BLUE   = 0x001F;
+const uint16_t ECG_YELLOW = 0xFFE0;
+
+// Fuente de voltaje del ECG (AD8232 en la placa, archivo o señal sintética en Linux)
+class EcgAdcSource {
+public:
+  virtual ~EcgAdcSource() {}
+  virtual float readVoltage(int channel) = 0;
+};
+
+// Pantalla: solo las primitivas que usa el trazado del ECG
+class EcgDisplay {
+public:
+  virtual ~EcgDisplay() {}
+  virtual int width() = 0;
+  virtual int height() = 0;
+  virtual void fillScreen(uint16_t color) = 0;
+  virtual void drawFastVLine(int x, int y, int h, uint16_t color) = 0;
+  virtual void drawLine(int x0, int y0, int x1, int y1, uint16_t color) = 0;
+  virtual void fillRect(int x, int y, int w, int h, uint16_t color) = 0;
+  virtual void setCursor(int x, int y) = 0;
+  virtual void setTextColor(uint16_t color) = 0;
+  virtual void setTextSize(int size) = 0;
+  virtual void print(const char *text) = 0;
+  // Copia un bloque de w x h píxeles (fila por fila) en una sola transferencia
+  virtual void pushRect(int x, int y, int w, int h, const uint16_t *pixels) = 0;
+};
+
+// Archivo abierto en el almacenamiento
+class EcgFile {
+public:
+  virtual ~EcgFile() {}
+  virtual size_t write(const uint8_t *data, size_t len) = 0;
+  virtual size_t read(uint8_t *data, size_t len) = 0;
+  virtual bool seek(uint32_t pos) = 0;
+  virtual uint32_t position() = 0;
+  virtual uint32_t size() = 0;
+  virtual void flush() = 0;
+  virtual void close() = 0;
+  // Reserva espacio hasta `bytes`. El backend puede hacerlo con ceros al
+  // final del archivo (la recuperación busca los chunks por su marca y los
+  // saltea) y los recorta al cerrar. Devuelve false si no lo soporta.
+  virtual bool preallocate(uint32_t bytes) { return false; }
+};
+
+enum EcgOpenMode {
+  ECG_OPEN_READ,
+  ECG_OPEN_WRITE,   // Crea o trunca
+  ECG_OPEN_APPEND,
+  ECG_OPEN_UPDATE   // Lectura y escritura en cualquier posición, sin truncar
+};
+
+// Recibe cada archivo de un directorio (sin subdirectorios); false corta el recorrido
+typedef bool (*EcgDirVisitor)(const char *name, uint32_t size, void *ctx);
+
+// Almacenamiento (tarjeta SD en la placa, un directorio en Linux).
+// open() devuelve NULL si falla; el archivo devuelto vive hasta close().
+class EcgStorage {
+public:
+  virtual ~EcgStorage() {}
+  virtual EcgFile *open(const char *path, EcgOpenMode mode) = 0;
+  virtual bool remove(const char *path) = 0;
+  virtual bool rename(const char *from, const char *to) = 0;
+  virtual bool exists(const char *path) = 0;
+  // Recorre los archivos de `dir`; `name` es el nombre sin el directorio
+  virtual bool list(const char *dir, EcgDirVisitor visit, void *ctx) = 0;
+};
+
+// Reloj del sistema
+class EcgClock {
+public:
+  virtual ~EcgClock() {}
+  virtual uint32_t millis() = 0;
+  virtual uint32_t micros() = 0;
+  virtual void delayMs(uint32_t ms) = 0;
+  // Contador de ciclos del CPU (CCOUNT en el ESP32) para medir tiempos cortos
+  virtual uint32_t cycleCount() = 0;
+  // Ciclos de cycleCount() por microsegundo, para pasar mediciones a tiempo
+  virtual float cyclesPerUs() = 0;
+};
+
+typedef void (*EcgTaskFunction)(void *arg);
+
+// Tareas (FreeRTOS en la placa, hilos en Linux)
+class EcgTasks {
+public:
+  virtual ~EcgTasks() {}
+  // core = -1 para no fijar núcleo
+  virtual bool createTask(EcgTaskFunction fn, const char *name, uint32_t stackBytes,
+                          void *arg, int priority, int core) = 0;
+  // Cede el procesador durante un tick (vTaskDelay(1) en la placa)
+  virtual void delayTick() = 0;
+  // Solo en Linux: pide a las tareas que terminen su lazo
+  virtual bool stopRequested() = 0;
+
+  // Temporizador periódico (de hardware en la placa) para una sola tarea.
+  // waitTimer() bloquea hasta el próximo disparo y devuelve cuántos periodos
+  // pasaron desde la llamada anterior (más de 1 si la tarea se atrasó).
+  virtual bool startTimer(uint32_t periodUs) = 0;
+  virtual uint32_t waitTimer() = 0;
+  virtual void stopTimer() = 0;
+
+  // Pila de la tarea `index` creada con createTask(): tamaño y lo mínimo que
+  // quedó libre desde que arrancó. false si no hay tal tarea o no se sabe.
+  virtual bool stackUsage(int index, const char *&name, uint32_t &stackBytes, uint32_t &freeBytes) {
+    return false;
+  }
+};
+
+// Puerto serie de depuración
+class EcgSerial {
+public:
+  virtual ~EcgSerial() {}
+  virtual size_t write(const uint8_t *data, size_t len) = 0;
+  // Bytes que write() acepta sin bloquear
+  virtual size_t availableForWrite() { return 4096; }
+  // Próximo byte recibido, -1 si no hay
+  virtual int read() { return -1; }
+  void print(const char *text);
+  void print(double value, int digits);
+  void println(const char *text);
+  void println(double value, int digits);
+};
+
+// Conjunto de backends que usa el pipeline; se llena en setup() o en el main de Linux
+struct EcgHal {
+  EcgAdcSource *adc;
+  EcgDisplay *display;
+  EcgStorage *storage;
+  EcgClock *clock;
+  EcgTasks *tasks;
+  EcgSerial *serial;
+};
+
+extern EcgHal hal;
+
+#endif
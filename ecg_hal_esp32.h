@@ -0,0 +1,252 @@
+#ifndef ECG_HAL_ESP32_H
+#define ECG_HAL_ESP32_H
+
+// Backends de la HAL para la placa XSpace Bio v1.0 (ESP32 + ILI9341 + SD).
+// Solo lo incluye el sketch; el pipeline no conoce estas clases.
+
+#include <Adafruit_ILI9341.h>
+#include <SD.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <XSpaceBioV10.h>
+#include "ecg_hal.h"
+
+class Esp32Adc : public EcgAdcSource {
+public:
+  explicit Esp32Adc(XSpaceBioV10Board &board) : board(board) {}
+  float readVoltage(int channel) {
+    return board.AD8232_GetVoltage(channel == ECG_ADC_XS1 ? AD8232_XS1 : AD8232_XS2);
+  }
+private:
+  XSpaceBioV10Board &board;
+};
+
+class Esp32Display : public EcgDisplay {
+public:
+  explicit Esp32Display(Adafruit_ILI9341 &tft) : tft(tft) {}
+  int width() { return tft.width(); }
+  int height() { return tft.height(); }
+  void fillScreen(uint16_t color) { tft.fillScreen(color); }
+  void drawFastVLine(int x, int y, int h, uint16_t color) { tft.drawFastVLine(x, y, h, color); }
+  void drawLine(int x0, int y0, int x1, int y1, uint16_t color) { tft.drawLine(x0, y0, x1, y1, color); }
+  void fillRect(int x, int y, int w, int h, uint16_t color) { tft.fillRect(x, y, w, h, color); }
+  void setCursor(int x, int y) { tft.setCursor(x, y); }
+  void setTextColor(uint16_t color) { tft.setTextColor(color); }
+  void setTextSize(int size) { tft.setTextSize(size); }
+  void print(const char *text) { tft.print(text); }
+  void pushRect(int x, int y, int w, int h, const uint16_t *pixels) {
+    // Una sola ventana de direcciones y una ráfaga SPI para todo el bloque
+    tft.startWrite();
+    tft.setAddrWindow(x, y, w, h);
+    tft.writePixels((uint16_t *)pixels, (uint32_t)w * h);
+    tft.endWrite();
+  }
+private:
+  Adafruit_ILI9341 &tft;
+};
+
+class Esp32File : public EcgFile {
+public:
+  File file;
+  bool inUse;
+  bool writable;      // Abierto con ECG_OPEN_WRITE: se puede reservar espacio
+  bool reservedTail;  // Hay ceros de reserva después de dataEnd
+  uint32_t dataEnd;   // Hasta dónde llegan los datos escritos
+  char fullPath[72];  // Ruta en el VFS ("/sd/..."), para recortar al cerrar
+  Esp32File() : inUse(false), writable(false), reservedTail(false), dataEnd(0) { fullPath[0] = 0; }
+  size_t write(const uint8_t *data, size_t len) {
+    size_t n = file.write(data, len);
+    uint32_t pos = file.position();
+    dataEnd = pos > dataEnd ? pos : dataEnd;
+    return n;
+  }
+  size_t read(uint8_t *data, size_t len) { return file.read(data, len); }
+  bool seek(uint32_t pos) { return file.seek(pos); }
+  uint32_t position() { return file.position(); }
+  uint32_t size() { return file.size(); }
+  void flush() { file.flush(); }
+  // La biblioteca SD no expone f_expand ni preAllocate: se escriben ceros al
+  // final y se hace flush para que los clusters y la FAT queden asignados
+  // ahora y no en cada bloque. Los ceros no tienen la marca de chunk, así que
+  // si se corta la energía la recuperación los descarta; close() los recorta.
+  bool preallocate(uint32_t bytes) {
+    static const uint8_t zeros[512] = {0};
+    if (!writable) {
+      return false;
+    }
+    uint32_t pos = file.position();
+    uint32_t end = file.size();
+    if (end >= bytes) {
+      return true;
+    }
+    bool ok = file.seek(end);
+    while (ok && end < bytes) {
+      uint32_t n = bytes - end < sizeof(zeros) ? bytes - end : sizeof(zeros);
+      ok = file.write(zeros, n) == n;
+      end += n;
+    }
+    file.flush();
+    reservedTail = reservedTail || end > dataEnd;
+    return file.seek(pos) && ok;
+  }
+  void close() {
+    file.close();
+    if (reservedTail) {
+      truncate(fullPath, dataEnd);
+    }
+    inUse = false;
+  }
+};
+
+class Esp32Storage : public EcgStorage {
+public:
+  EcgFile *open(const char *path, EcgOpenMode mode) {
+    // Pocos archivos abiertos a la vez: se usan ranuras fijas en lugar del heap
+    for (int i = 0; i < maxOpenFiles; i++) {
+      if (!files[i].inUse) {
+        const char *sdMode = mode == ECG_OPEN_READ ? FILE_READ
+                             : mode == ECG_OPEN_APPEND ? FILE_APPEND
+                             : mode == ECG_OPEN_UPDATE ? "r+" : FILE_WRITE;
+        files[i].file = SD.open(path, sdMode);
+        if (!files[i].file) {
+          return NULL;
+        }
+        files[i].inUse = true;
+        files[i].writable = mode == ECG_OPEN_WRITE;
+        files[i].reservedTail = false;
+        files[i].dataEnd = files[i].file.size();
+        snprintf(files[i].fullPath, sizeof(files[i].fullPath), "/sd%s", path);
+        return &files[i];
+      }
+    }
+    return NULL;
+  }
+  bool remove(const char *path) { return SD.remove(path); }
+  bool rename(const char *from, const char *to) { return SD.rename(from, to); }
+  bool exists(const char *path) { return SD.exists(path); }
+  bool list(const char *dir, EcgDirVisitor visit, void *ctx) {
+    File root = SD.open(dir);
+    if (!root) {
+      return false;
+    }
+    while (true) {
+      File entry = root.openNextFile();
+      if (!entry) {
+        break;
+      }
+      bool more = entry.isDirectory() || visit(entry.name(), entry.size(), ctx);
+      entry.close();
+      if (!more) {
+        break;
+      }
+    }
+    root.close();
+    return true;
+  }
+private:
+  static const int maxOpenFiles = 4;
+  Esp32File files[maxOpenFiles];
+};
+
+class Esp32Clock : public EcgClock {
+public:
+  uint32_t millis() { return ::millis(); }
+  uint32_t micros() { return ::micros(); }
+  void delayMs(uint32_t ms) { delay(ms); }
+  uint32_t cycleCount() { return ESP.getCycleCount(); }
+  float cyclesPerUs() { return ESP.getCpuFreqMHz(); }
+};
+
+// Tarea que espera el temporizador; la ISR le envía una notificación por disparo
+static volatile TaskHandle_t esp32TimerTask = NULL;
+
+static void IRAM_ATTR esp32TimerIsr() {
+  BaseType_t woken = pdFALSE;
+  if (esp32TimerTask) {
+    vTaskNotifyGiveFromISR(esp32TimerTask, &woken);
+  }
+  if (woken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+class Esp32Tasks : public EcgTasks {
+public:
+  Esp32Tasks() : timer(NULL), taskCount(0) {}
+  bool createTask(EcgTaskFunction fn, const char *name, uint32_t stackBytes,
+                  void *arg, int priority, int core) {
+    TaskHandle_t handle = NULL;
+    bool ok;
+    if (core < 0) {
+      ok = xTaskCreate(fn, name, stackBytes, arg, priority, &handle) == pdPASS;
+    } else {
+      ok = xTaskCreatePinnedToCore(fn, name, stackBytes, arg, priority, &handle, core) == pdPASS;
+    }
+    if (ok && taskCount < maxTasks) {
+      tasks[taskCount].name = name;
+      tasks[taskCount].stackBytes = stackBytes;
+      tasks[taskCount].handle = handle;
+      taskCount++;
+    }
+    return ok;
+  }
+  // En el ESP32 la pila se mide en bytes
+  bool stackUsage(int index, const char *&name, uint32_t &stackBytes, uint32_t &freeBytes) {
+    if (index >= taskCount) {
+      return false;
+    }
+    name = tasks[index].name;
+    stackBytes = tasks[index].stackBytes;
+    freeBytes = uxTaskGetStackHighWaterMark(tasks[index].handle);
+    return true;
+  }
+  void delayTick() { vTaskDelay(1); }
+  bool stopRequested() { return false; }
+
+  bool startTimer(uint32_t periodUs) {
+    // Timer 0 a 1 MHz (80 MHz / 80). La interrupción queda en el núcleo de la
+    // tarea que llama, así que debe llamarse desde la tarea que va a esperar.
+    esp32TimerTask = xTaskGetCurrentTaskHandle();
+    timer = timerBegin(0, 80, true);
+    if (!timer) {
+      return false;
+    }
+    timerAttachInterrupt(timer, esp32TimerIsr, true);
+    timerAlarmWrite(timer, periodUs, true);
+    timerAlarmEnable(timer);
+    return true;
+  }
+  uint32_t waitTimer() {
+    // La cuenta de la notificación acumula los disparos que no se atendieron
+    return ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+  void stopTimer() {
+    if (timer) {
+      timerAlarmDisable(timer);
+      timerDetachInterrupt(timer);
+      timerEnd(timer);
+      timer = NULL;
+    }
+    esp32TimerTask = NULL;
+  }
+
+private:
+  static const int maxTasks = 8;
+  struct Task {
+    const char *name;
+    uint32_t stackBytes;
+    TaskHandle_t handle;
+  };
+  hw_timer_t *timer;
+  Task tasks[maxTasks];
+  int taskCount;
+};
+
+class Esp32Serial : public EcgSerial {
+public:
+  size_t write(const uint8_t *data, size_t len) { return Serial.write(data, len); }
+  size_t availableForWrite() { return Serial.availableForWrite(); }
+  int read() { return Serial.read(); }
+};
+
+#endif
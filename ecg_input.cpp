@@ -0,0 +1,64 @@
+#include "ecg_input.h"
+
+EcgButtonScanner::EcgButtonScanner() : bounces(0), stable(0) {
+  for (int b = 0; b < ECG_BUTTON_COUNT; b++) {
+    changing[b] = 0;
+    changeUs[b] = 0;
+    pressUs[b] = 0;
+    repeatUs[b] = 0;
+  }
+}
+
+void EcgButtonScanner::push(int button, uint8_t action, uint32_t heldUs, uint32_t timeUs) {
+  EcgButtonEvent event;
+  event.button = button;
+  event.action = action;
+  uint32_t heldMs = heldUs / 1000;
+  event.heldMs = heldMs > 65535 ? 65535 : heldMs;
+  event.timeUs = timeUs;
+  events.push(event);  // Cola llena: el evento se cuenta como overrun
+}
+
+void EcgButtonScanner::sample(uint32_t pressed, uint32_t nowUs) {
+  for (int b = 0; b < ECG_BUTTON_COUNT; b++) {
+    uint32_t bit = 1u << b;
+    bool down = (stable & bit) != 0;
+    if (((pressed & bit) != 0) != down) {
+      if (changing[b]++ == 0) {
+        changeUs[b] = nowUs;
+      }
+      if (changing[b] < ECG_BUTTON_STABLE_SCANS) {
+        continue;
+      }
+      // Cambio aceptado: el evento lleva el instante en que empezó
+      changing[b] = 0;
+      stable ^= bit;
+      if (!down) {
+        pressUs[b] = changeUs[b];
+        repeatUs[b] = changeUs[b] + ECG_BUTTON_REPEAT_DELAY_MS * 1000;
+        push(b, ECG_BUTTON_PRESS, 0, changeUs[b]);
+      } else {
+        push(b, ECG_BUTTON_RELEASE, changeUs[b] - pressUs[b], changeUs[b]);
+      }
+      continue;
+    }
+    if (changing[b] > 0) {
+      bounces++;
+      changing[b] = 0;
+    }
+    if (down && (int32_t)(nowUs - repeatUs[b]) >= 0) {
+      repeatUs[b] += ECG_BUTTON_REPEAT_MS * 1000;
+      push(b, ECG_BUTTON_HOLD, nowUs - pressUs[b], nowUs);
+    }
+  }
+}
+
+bool EcgUiLatency::add(const EcgButtonEvent &event, uint32_t nowUs) {
+  count++;
+  lastUs = nowUs - event.timeUs;
+  if (lastUs <= maxUs) {
+    return false;
+  }
+  maxUs = lastUs;
+  return true;
+}
@@ -0,0 +1,70 @@
+#ifndef ECG_INPUT_H
+#define ECG_INPUT_H
+
+#include <stdint.h>
+
+#include "ecg_queue.h"
+
+// Botones de la interfaz como eventos. Un temporizador llama a
+// EcgButtonScanner::sample() cada ECG_BUTTON_SCAN_US con el estado de los
+// pines; el antirrebote, la pulsación larga y la repetición salen de contar
+// muestras, sin esperar en ningún lado. loop() saca los eventos de la cola y
+// cada pantalla reacciona a ellos sin bloquear.
+
+enum EcgButton {
+  ECG_BUTTON_UP,
+  ECG_BUTTON_DOWN,
+  ECG_BUTTON_SELECT,
+  ECG_BUTTON_COUNT
+};
+
+enum EcgButtonAction {
+  ECG_BUTTON_PRESS,     // Se apretó (ya sin rebote)
+  ECG_BUTTON_HOLD,      // Se sigue manteniendo: cada ECG_BUTTON_REPEAT_MS
+  ECG_BUTTON_RELEASE    // Se soltó; heldMs dice cuánto se mantuvo
+};
+
+struct EcgButtonEvent {
+  uint8_t button;
+  uint8_t action;
+  uint16_t heldMs;      // Tiempo apretado hasta este evento (satura en 65535)
+  uint32_t timeUs;      // micros() del primer muestreo que vio el cambio
+};
+
+const uint32_t ECG_BUTTON_SCAN_US = 5000;
+const uint8_t ECG_BUTTON_STABLE_SCANS = 4;          // 20 ms iguales para aceptar un cambio
+const uint32_t ECG_BUTTON_REPEAT_DELAY_MS = 400;    // Primer HOLD después del PRESS
+const uint32_t ECG_BUTTON_REPEAT_MS = 150;
+
+typedef SpscQueue<EcgButtonEvent, 32> EcgButtonQueue;
+
+class EcgButtonScanner {
+public:
+  EcgButtonScanner();
+  // Lado del temporizador: `pressed` tiene el bit (1 << EcgButton) de cada
+  // botón apretado
+  void sample(uint32_t pressed, uint32_t nowUs);
+
+  EcgButtonQueue events;
+  uint32_t bounces;     // Cambios que no llegaron a ECG_BUTTON_STABLE_SCANS
+
+private:
+  void push(int button, uint8_t action, uint32_t heldUs, uint32_t timeUs);
+
+  uint32_t stable;                          // Estado aceptado, un bit por botón
+  uint8_t changing[ECG_BUTTON_COUNT];       // Muestras seguidas distintas de `stable`
+  uint32_t changeUs[ECG_BUTTON_COUNT];
+  uint32_t pressUs[ECG_BUTTON_COUNT];
+  uint32_t repeatUs[ECG_BUTTON_COUNT];      // Próximo HOLD
+};
+
+// Latencia entre el evento y el final del redibujo que provocó
+struct EcgUiLatency {
+  uint32_t count;
+  uint32_t lastUs;
+  uint32_t maxUs;
+  // Devuelve true si es un máximo nuevo
+  bool add(const EcgButtonEvent &event, uint32_t nowUs);
+};
+
+#endif
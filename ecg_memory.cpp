@@ -0,0 +1,164 @@
+#include "ecg_memory.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ecg_classifier.h"
+#include "ecg_denoise.h"
+#include "ecg_event.h"
+#include "ecg_playback.h"
+#include "ecg_record.h"
+#include "ecg_render.h"
+#include "ecg_stats.h"
+#include "ecg_stream_writer.h"
+
+// Tamaño de cada zona a partir de los buffers que se reservan en ella
+static const uint32_t renderPoolBytes =
+    (ECG_STRIP_COLUMNS + ECG_STRIP_GAP) * ECG_SWEEP_MAX_HEIGHT * sizeof(uint16_t) + ECG_ARENA_ALIGN;
+// Captura: doble bloque del .ecg y del .pyr
+static const uint32_t capturePoolBytes = 2 * (2 * EcgStreamWriter::blockSize + ECG_ARENA_ALIGN);
+// Monitor: los bloques de la captura para cada evento y, sin PSRAM, el buffer
+// circular de ECG_EVENT_ARENA_FRAMES (ecgEventBufferBytes())
+#ifdef BOARD_HAS_PSRAM
+static const uint32_t eventPoolBytes = 0;
+#else
+static const uint32_t eventPoolBytes = ECG_EVENT_ARENA_FRAMES * ECG_LEADS * sizeof(int16_t) + ECG_ARENA_ALIGN;
+#endif
+static const uint32_t monitorPoolBytes = capturePoolBytes + eventPoolBytes;
+// Reproducción: payload de un chunk .ecg, índice y bloque de un .txt
+static const uint32_t parsePoolBytes = ECG_CHUNK_PAYLOAD_MAX + ECG_TEXT_INDEX_MAX * sizeof(uint32_t) +
+                                       ECG_TEXT_BLOCK_SIZE + 2 * ECG_ARENA_ALIGN;
+// Clasificador (ecg_classifier.h): ventana, trabajo y activaciones de la red,
+// en cualquiera de las dos fases
+static const uint32_t classifierPoolBytes = (ECG_MODEL_WINDOW + ECG_CLASSIFIER_WORK) * sizeof(float) +
+                                            2 * ECG_NN_MAX_TENSOR + 3 * ECG_ARENA_ALIGN;
+// Ventanas de signalMonitor (dos entradas crudas y tres derivaciones),
+// permanentes; ECG_MONITOR_BLOCKS es potencia de 2 (ecgWindowStatsBytes())
+static const uint32_t statsPoolBytes =
+    (2 + ECG_LEADS) * (ECG_MONITOR_BLOCKS * (sizeof(EcgStatsBlock) + 2 * sizeof(uint32_t)) + ECG_ARENA_ALIGN);
+// Limpieza por wavelets de FilterTask (ecg_denoise.h), permanente: la misma
+// cota que ecgDenoiseFloats() para las tres derivaciones
+#define ECG_DENOISE_POOL(level) \
+  (ECG_LEADS * ((2 * ECG_DENOISE_LIVE_WINDOW + (16u << (level))) * sizeof(float) + ECG_ARENA_ALIGN))
+
+#ifndef ECG_ARENA_BYTES
+#ifdef ARDUINO
+#if ECG_WAVELET_DENOISE
+static const uint32_t denoisePoolBytes = ECG_DENOISE_POOL(ECG_WAVELET_DENOISE);
+#else
+static const uint32_t denoisePoolBytes = 0;
+#endif
+#if ECG_CLASSIFIER
+#define ECG_PHASE_BYTES(pool) ((pool) + classifierPoolBytes)
+#else
+#define ECG_PHASE_BYTES(pool) (pool)
+#endif
+#define ECG_MAX(a, b) ((a) > (b) ? (a) : (b))
+#define ECG_ARENA_BYTES                                                                                 \
+  (renderPoolBytes + statsPoolBytes + denoisePoolBytes +                                                \
+   ECG_MAX(ECG_MAX(ECG_PHASE_BYTES(capturePoolBytes), ECG_PHASE_BYTES(parsePoolBytes)), monitorPoolBytes))
+#else
+// Las herramientas de Linux usan varios lectores y escritores a la vez, sin
+// fases, y cualquier nivel de limpieza (ecg_host --wavelet)
+#define ECG_ARENA_BYTES                                                                         \
+  (4 * (renderPoolBytes + capturePoolBytes + parsePoolBytes + classifierPoolBytes) + statsPoolBytes + \
+   eventPoolBytes + ECG_DENOISE_POOL(ECG_DENOISE_MAX_LEVEL))
+#endif
+#endif
+
+static const uint32_t permanentPhase = 0xFFFFFFFF;
+
+alignas(ECG_ARENA_ALIGN) static uint8_t arenaMemory[ECG_ARENA_BYTES];
+EcgArena ecgArena(arenaMemory, sizeof(arenaMemory));
+
+EcgArena::EcgArena(uint8_t *memory, uint32_t size)
+    : failures(0), lateReserves(0), memory(memory), capacity(size), low(0), high(size), peak(0), phase(1),
+      phaseName("inicio"), sealed(false), ownerCount(0) {}
+
+uint8_t *EcgArena::take(EcgArenaSlot &slot, uint32_t bytes, const char *owner, bool permanent) {
+  if (slot.data && slot.phase == (permanent ? permanentPhase : phase)) {
+    return slot.data;
+  }
+  bytes = (bytes + ECG_ARENA_ALIGN - 1) & ~(ECG_ARENA_ALIGN - 1);
+  if (bytes > high - low) {
+    failures++;
+    slot.data = NULL;
+    slot.phase = 0;
+    return NULL;
+  }
+  if (permanent) {
+    slot.data = memory + low;
+    slot.phase = permanentPhase;
+    low += bytes;
+    if (sealed) {
+      lateReserves++;
+    }
+  } else {
+    high -= bytes;
+    slot.data = memory + high;
+    slot.phase = phase;
+  }
+  if (low + capacity - high > peak) {
+    peak = low + capacity - high;
+  }
+  note(owner, bytes, permanent);
+  return slot.data;
+}
+
+void EcgArena::beginPhase(const char *name) {
+  high = capacity;
+  phase++;
+  phaseName = name;
+  for (int i = 0; i < ownerCount; i++) {
+    if (!owners[i].permanent) {
+      owners[i].phaseBytes = 0;
+    }
+  }
+}
+
+void EcgArena::note(const char *owner, uint32_t bytes, bool permanent) {
+  for (int i = 0; i < ownerCount; i++) {
+    if (!strcmp(owners[i].name, owner)) {
+      owners[i].phaseBytes += bytes;
+      if (owners[i].phaseBytes > owners[i].bytes) {
+        owners[i].bytes = owners[i].phaseBytes;
+      }
+      return;
+    }
+  }
+  if (ownerCount < ECG_ARENA_OWNERS) {
+    Owner &o = owners[ownerCount++];
+    o.name = owner;
+    o.bytes = bytes;
+    o.phaseBytes = bytes;
+    o.permanent = permanent;
+  }
+}
+
+void EcgArena::print(EcgSerial *serial) {
+  char line[80];
+  snprintf(line, sizeof(line), "Arena: %u bytes, permanente %u, fase '%s' %u, pico %u\r\n", (unsigned)capacity,
+           (unsigned)low, phaseName, (unsigned)(capacity - high), (unsigned)peak);
+  serial->print(line);
+  for (int i = 0; i < ownerCount; i++) {
+    snprintf(line, sizeof(line), "  %-22s %6u %s\r\n", owners[i].name, (unsigned)owners[i].bytes,
+             owners[i].permanent ? "permanente" : "fase");
+    serial->print(line);
+  }
+  if (failures > 0 || lateReserves > 0) {
+    snprintf(line, sizeof(line), "  sin lugar: %u, permanentes despues de setup: %u\r\n", (unsigned)failures,
+             (unsigned)lateReserves);
+    serial->print(line);
+  }
+}
+
+void printTaskStacks(EcgSerial *serial) {
+  char line[80];
+  const char *name;
+  uint32_t stackBytes, freeBytes;
+  for (int i = 0; hal.tasks->stackUsage(i, name, stackBytes, freeBytes); i++) {
+    snprintf(line, sizeof(line), "Pila %-16s %5u de %5u bytes (minimo libre %u)\r\n", name,
+             (unsigned)(stackBytes - freeBytes), (unsigned)stackBytes, (unsigned)freeBytes);
+    serial->print(line);
+  }
+}
@@ -0,0 +1,77 @@
+#ifndef ECG_MEMORY_H
+#define ECG_MEMORY_H
+
+#include <stdint.h>
+
+#include "ecg_hal.h"
+
+// Memoria de trabajo del firmware: un solo bloque estático (ecgArena) para
+// los buffers grandes, repartido en dos zonas:
+//
+//   [permanente ->            <- fase]
+//
+// La zona permanente se llena desde abajo en setup() (la tira del barrido) y
+// no se libera. La zona de fase se llena desde arriba y se vacía con
+// beginPhase(): la captura (bloques de la SD) y la reproducción (chunk del
+// .ecg, índice del .txt) nunca corren a la vez, así que comparten la misma
+// memoria. Nada de esto usa el heap.
+//
+// Cada objeto guarda su reserva en un EcgArenaSlot: si ya tiene memoria de
+// la fase actual take() la devuelve sin reservar otra vez, así que llamar a
+// begin()/open() muchas veces no agota el bloque. El tamaño (ECG_ARENA_BYTES)
+// sale de los buffers de cada zona; ver ecg_memory.cpp.
+
+const uint32_t ECG_ARENA_ALIGN = 8;
+
+struct EcgArenaSlot {
+  uint8_t *data;
+  uint32_t phase;   // Fase en la que se reservó (0: nunca)
+};
+
+const int ECG_ARENA_OWNERS = 12;
+
+class EcgArena {
+public:
+  EcgArena(uint8_t *memory, uint32_t size);
+  // Memoria de la fase actual (o permanente) para `slot`; NULL si no entra
+  uint8_t *take(EcgArenaSlot &slot, uint32_t bytes, const char *owner, bool permanent = false);
+  // Libera la zona de fase; los slots de la fase anterior dejan de valer
+  void beginPhase(const char *name);
+  // Fin de setup(): a partir de aquí una reserva permanente se informa
+  void seal() { sealed = true; }
+
+  void print(EcgSerial *serial);
+  uint32_t size() const { return capacity; }
+  uint32_t permanentBytes() const { return low; }
+  uint32_t phaseBytes() const { return capacity - high; }
+  uint32_t peakBytes() const { return peak; }
+
+  uint32_t failures;        // Reservas que no entraron
+  uint32_t lateReserves;    // Reservas permanentes después de seal()
+
+private:
+  struct Owner {
+    const char *name;
+    uint32_t bytes;         // Lo máximo que tuvo reservado en una fase
+    uint32_t phaseBytes;    // Lo que tiene reservado en la fase actual
+    bool permanent;
+  };
+  void note(const char *owner, uint32_t bytes, bool permanent);
+
+  uint8_t *memory;
+  uint32_t capacity;
+  uint32_t low, high;       // Fin de la zona permanente, comienzo de la de fase
+  uint32_t peak;
+  uint32_t phase;
+  const char *phaseName;
+  bool sealed;
+  int ownerCount;
+  Owner owners[ECG_ARENA_OWNERS];
+};
+
+extern EcgArena ecgArena;
+
+// Uso de la pila de cada tarea creada con hal.tasks (si el backend lo sabe)
+void printTaskStacks(EcgSerial *serial);
+
+#endif
@@ -0,0 +1,209 @@
+#include "ecg_nn.h"
+
+#include <math.h>
+#include <string.h>
+
+static inline uint32_t align4(uint32_t n) { return (n + 3) & ~3u; }
+
+static inline int8_t saturate(float v) {
+  long q = lrintf(v);
+  return q > 127 ? 127 : (q < -127 ? -127 : (int8_t)q);
+}
+
+// Producto interno int8; el lazo simple lo vectoriza el compilador en Linux
+static int32_t dotInt8(const int8_t *a, const int8_t *b, uint32_t n) {
+  int32_t acc = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    acc += (int32_t)a[i] * b[i];
+  }
+  return acc;
+}
+
+EcgNnModel::EcgNnModel() : header(0), layerCount(0), tensorBytes(0), macCount(0) {
+  memory.data = 0;
+  memory.phase = 0;
+}
+
+bool EcgNnModel::load(const uint8_t *blob, uint32_t size) {
+  layerCount = 0;
+  header = 0;
+  if (!blob || ((uintptr_t)blob & 3) != 0 || size < sizeof(EcgNnHeader)) {
+    return false;
+  }
+  const EcgNnHeader *h = (const EcgNnHeader *)blob;
+  if (h->magic != ECG_NN_MAGIC || h->version != ECG_NN_VERSION || h->totalBytes != size ||
+      h->layerCount == 0 || h->layerCount > ECG_NN_MAX_LAYERS || h->classCount == 0 ||
+      h->classCount > ECG_NN_MAX_CLASSES || h->inputScale <= 0) {
+    return false;
+  }
+  uint32_t length = h->inputLength, channels = h->inputChannels;
+  uint32_t largest = length * channels;
+  uint32_t pos = sizeof(EcgNnHeader);
+  macCount = 0;
+  for (int i = 0; i < h->layerCount; i++) {
+    if (pos + sizeof(EcgNnLayer) > size) {
+      return false;
+    }
+    const EcgNnLayer *info = (const EcgNnLayer *)(blob + pos);
+    pos += sizeof(EcgNnLayer);
+    Layer &l = layers[i];
+    l.info = info;
+    l.inLength = length;
+    l.inChannels = channels;
+    uint32_t expected = 0;
+    bool last = i == h->layerCount - 1;
+    // Salida 'same': ceil(entrada / paso), relleno repartido con lo impar a la derecha
+    if (info->type == ECG_NN_CONV1D || info->type == ECG_NN_MAXPOOL) {
+      if (info->kernel == 0 || info->stride == 0) {
+        return false;
+      }
+      l.outLength = (length + info->stride - 1) / info->stride;
+      int32_t pad = (int32_t)((l.outLength - 1) * info->stride + info->kernel) - (int32_t)length;
+      l.padLeft = pad > 0 ? pad / 2 : 0;
+      l.outChannels = info->type == ECG_NN_CONV1D ? info->outChannels : channels;
+    } else if (info->type == ECG_NN_DENSE) {
+      // Densa = convolución con un kernel del largo de la entrada
+      l.outLength = 1;
+      l.padLeft = 0;
+      l.outChannels = info->outChannels;
+    } else {
+      return false;
+    }
+    uint32_t kernel = info->type == ECG_NN_DENSE ? length : info->kernel;
+    if (info->type != ECG_NN_MAXPOOL) {
+      if (l.outChannels == 0) {
+        return false;
+      }
+      uint32_t weightBytes = align4(l.outChannels * kernel * channels);
+      expected = weightBytes + l.outChannels * (sizeof(int32_t) + 2 * sizeof(float));
+      l.weights = (const int8_t *)(blob + pos);
+      l.bias = (const int32_t *)(blob + pos + weightBytes);
+      l.mult = (const float *)(l.bias + l.outChannels);
+      l.offset = l.mult + l.outChannels;
+      macCount += l.outLength * l.outChannels * kernel * channels;
+    } else {
+      l.weights = 0;
+      l.bias = 0;
+      l.mult = l.offset = 0;
+    }
+    // Solo la última capa da logits, y tiene que darlos
+    bool floatOut = (info->flags & ECG_NN_FLOAT_OUT) != 0;
+    if (info->dataBytes != expected || pos + expected > size || floatOut != last ||
+        (last && (info->type == ECG_NN_MAXPOOL || l.outLength * l.outChannels != h->classCount))) {
+      return false;
+    }
+    pos += expected;
+    length = l.outLength;
+    channels = l.outChannels;
+    if (length * channels > largest) {
+      largest = length * channels;
+    }
+  }
+  if (pos != size || largest > ECG_NN_MAX_TENSOR) {
+    return false;
+  }
+  tensorBytes = align4(largest);
+  header = h;
+  layerCount = h->layerCount;
+  return true;
+}
+
+void EcgNnModel::runConv(const Layer &l, const int8_t *in, int8_t *out, float *logits) {
+  const EcgNnLayer &info = *l.info;
+  uint32_t kernel = info.type == ECG_NN_DENSE ? l.inLength : info.kernel;
+  uint32_t stride = info.type == ECG_NN_DENSE ? 1 : info.stride;
+  uint32_t rowBytes = kernel * l.inChannels;
+  bool relu = (info.flags & ECG_NN_RELU) != 0;
+  for (uint32_t t = 0; t < l.outLength; t++) {
+    // Taps válidos del kernel: el relleno vale 0 y no suma
+    int32_t start = (int32_t)(t * stride) - l.padLeft;
+    int32_t first = start < 0 ? -start : 0;
+    int32_t end = (int32_t)kernel;
+    if (start + end > (int32_t)l.inLength) {
+      end = (int32_t)l.inLength - start;
+    }
+    const int8_t *x = in + (start + first) * (int32_t)l.inChannels;
+    uint32_t span = (end - first) * l.inChannels;
+    for (uint32_t c = 0; c < l.outChannels; c++) {
+      const int8_t *w = l.weights + c * rowBytes + first * l.inChannels;
+      int32_t acc = l.bias[c] + dotInt8(x, w, span);
+      if (relu && acc < 0) {
+        acc = 0;
+      }
+      float v = l.mult[c] * acc + l.offset[c];
+      if (logits) {
+        logits[t * l.outChannels + c] = v;
+      } else {
+        out[t * l.outChannels + c] = saturate(v);
+      }
+    }
+  }
+}
+
+void EcgNnModel::runPool(const Layer &l, const int8_t *in, int8_t *out) {
+  const EcgNnLayer &info = *l.info;
+  for (uint32_t t = 0; t < l.outLength; t++) {
+    int32_t start = (int32_t)(t * info.stride) - l.padLeft;
+    int32_t first = start < 0 ? 0 : start;
+    int32_t end = start + info.kernel;
+    if (end > (int32_t)l.inLength) {
+      end = l.inLength;
+    }
+    int8_t *o = out + t * l.inChannels;
+    memcpy(o, in + first * l.inChannels, l.inChannels);
+    for (int32_t s = first + 1; s < end; s++) {
+      const int8_t *x = in + s * l.inChannels;
+      for (uint32_t c = 0; c < l.inChannels; c++) {
+        if (x[c] > o[c]) {
+          o[c] = x[c];
+        }
+      }
+    }
+  }
+}
+
+bool EcgNnModel::run(const float *input, float *scores) {
+  if (!loaded()) {
+    return false;
+  }
+  uint8_t *mem = ecgArena.take(memory, arenaBytes(), "activaciones red");
+  if (!mem) {
+    return false;
+  }
+  int8_t *a = (int8_t *)mem;
+  int8_t *b = a + tensorBytes;
+  uint32_t count = header->inputLength * header->inputChannels;
+  float inv = 1.0f / header->inputScale;
+  for (uint32_t i = 0; i < count; i++) {
+    a[i] = saturate(input[i] * inv);
+  }
+  float logits[ECG_NN_MAX_CLASSES];
+  for (int i = 0; i < layerCount; i++) {
+    const Layer &l = layers[i];
+    if (l.info->type == ECG_NN_MAXPOOL) {
+      runPool(l, a, b);
+    } else {
+      runConv(l, a, b, i == layerCount - 1 ? logits : 0);
+    }
+    int8_t *t = a;
+    a = b;
+    b = t;
+  }
+  // Softmax estable (se resta el máximo)
+  int classes = header->classCount;
+  float top = logits[0];
+  for (int c = 1; c < classes; c++) {
+    if (logits[c] > top) {
+      top = logits[c];
+    }
+  }
+  float sum = 0;
+  for (int c = 0; c < classes; c++) {
+    scores[c] = expf(logits[c] - top);
+    sum += scores[c];
+  }
+  for (int c = 0; c < classes; c++) {
+    scores[c] /= sum;
+  }
+  return true;
+}
@@ -0,0 +1,110 @@
+#ifndef ECG_NN_H
+#define ECG_NN_H
+
+#include <stdint.h>
+
+#include "ecg_memory.h"
+
+// Inferencia int8 de redes Conv1D/MaxPooling1D/Dense como las de los
+// notebooks (build_alexnet de IA_ISB.ipynb), exportadas con
+// host/ecg_model_export.py a un archivo .ecgm. Los pesos se usan en el lugar
+// donde está el modelo (un arreglo en la flash o un archivo cargado en
+// Linux); las activaciones van en dos buffers de ecgArena que se alternan
+// entre capas.
+//
+// Cuantización: pesos int8 simétricos por canal de salida, activaciones int8
+// simétricas por tensor (real = q * escala, el 0 real es el 0 cuantizado, así
+// que el relleno 'same' no necesita correcciones). Cada salida acumula en
+// int32 con su bias, aplica ReLU si corresponde y se recuantiza con un float
+// por canal: q = round(mult[c] * acc + offset[c]). La BatchNormalization que
+// sigue a una capa queda dentro de mult y offset. La última capa da logits en
+// float (mult y offset ya desescalan) y termina en softmax. Dropout y Flatten
+// no hacen nada en inferencia (las activaciones son [tiempo][canal], como Keras).
+//
+// Formato .ecgm (little endian, cada bloque alineado a 4 bytes):
+//   EcgNnHeader
+//   por capa, EcgNnLayer y sus datos:
+//     conv y densa: int8 pesos[salida][kernel][entrada] (relleno a 4 bytes),
+//                   int32 bias[salida], float mult[salida], float offset[salida]
+//     maxpool: nada
+
+const uint32_t ECG_NN_MAGIC = 0x4D474345;   // "ECGM"
+const uint16_t ECG_NN_VERSION = 1;
+const int ECG_NN_MAX_LAYERS = 16;
+const int ECG_NN_MAX_CLASSES = 8;
+const uint32_t ECG_NN_MAX_TENSOR = 4096;     // Bytes de la activación más grande
+
+enum EcgNnLayerType {
+  ECG_NN_CONV1D = 1,     // padding 'same'
+  ECG_NN_MAXPOOL = 2,    // padding 'same'
+  ECG_NN_DENSE = 3,      // Aplana la entrada
+};
+
+enum EcgNnLayerFlags {
+  ECG_NN_RELU = 1,
+  ECG_NN_FLOAT_OUT = 2,  // Logits en float (solo la última capa)
+};
+
+struct EcgNnHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t layerCount;
+  uint16_t inputLength;    // Pasos de tiempo
+  uint16_t inputChannels;
+  uint16_t classCount;
+  uint16_t reserved;
+  float inputScale;        // q = round(x / inputScale)
+  uint32_t totalBytes;     // Archivo completo
+};
+
+struct EcgNnLayer {
+  uint8_t type;
+  uint8_t flags;
+  uint16_t kernel;         // Conv y pool
+  uint16_t stride;
+  uint16_t outChannels;    // Conv y densa; el pool conserva los canales
+  uint32_t dataBytes;      // Datos que siguen a esta cabecera
+};
+
+class EcgNnModel {
+public:
+  EcgNnModel();
+  // Valida el modelo y calcula las formas; `blob` debe seguir existiendo
+  // (alineado a 4 bytes) mientras se use el modelo
+  bool load(const uint8_t *blob, uint32_t size);
+  bool loaded() const { return layerCount > 0; }
+  uint32_t inputLength() const { return header ? header->inputLength : 0; }
+  uint32_t inputChannels() const { return header ? header->inputChannels : 0; }
+  uint32_t classCount() const { return header ? header->classCount : 0; }
+  // Bytes de ecgArena que toma run() (dos veces la activación más grande)
+  uint32_t arenaBytes() const { return 2 * tensorBytes; }
+  // Multiplicaciones por inferencia
+  uint32_t macs() const { return macCount; }
+
+  // Entrada [tiempo][canal] en float; scores recibe las probabilidades.
+  // false si no hay modelo o no hay memoria.
+  bool run(const float *input, float *scores);
+
+private:
+  struct Layer {
+    const EcgNnLayer *info;
+    const int8_t *weights;
+    const int32_t *bias;
+    const float *mult;
+    const float *offset;
+    uint16_t inLength, inChannels;
+    uint16_t outLength, outChannels;
+    uint16_t padLeft;
+  };
+  void runConv(const Layer &l, const int8_t *in, int8_t *out, float *logits);
+  void runPool(const Layer &l, const int8_t *in, int8_t *out);
+
+  const EcgNnHeader *header;
+  Layer layers[ECG_NN_MAX_LAYERS];
+  int layerCount;
+  uint32_t tensorBytes;
+  uint32_t macCount;
+  EcgArenaSlot memory;
+};
+
+#endif
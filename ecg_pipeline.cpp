@@ -0,0 +1,814 @@
+#include "ecg_pipeline.h"
+
+#include <stdio.h>
+#include "ecg_catalog.h"
+#include "ecg_classifier.h"
+#include "ecg_decimate.h"
+#include "ecg_denoise.h"
+#include "ecg_filter.h"
+#include "ecg_memory.h"
+#include "ecg_profile.h"
+#include "ecg_pyramid.h"
+#include "ecg_qrs.h"
+#include "ecg_record.h"
+#include "ecg_render.h"
+#include "ecg_serial_stream.h"
+#include "ecg_stream_writer.h"
+
+// Pasa altos + notch + pasa bajos para las tres derivaciones en un solo banco
+EcgFilterBankConfig filterConfig = ecgDefaultFilterConfig;
+EcgFilterBank filterBank;
+// Detector de QRS sobre la derivación 1 a la frecuencia de adquisición
+EcgQrsDetector qrsDetector;
+int waveletDenoiseLevel = 0;
+static EcgWaveletDenoiser leadDenoiser[ECG_LEADS];
+// Decimación a la grabación y al barrido; con la misma frecuencia el barrido
+// usa las muestras de la grabación
+int storageRate = defaultStorageRate;
+int displayRate = defaultDisplayRate;
+static EcgDecimator storageDecimator;
+static EcgDecimator displayDecimator;
+
+const char *captureTempFile = "/captura.tmp";
+const char *pyramidTempFile = "/captura.pyr";
+const char *catalogFile = "/mediciones.cat";
+uint32_t recordedSamples = 0;
+EcgRecordEncoder recordEncoder;
+EcgPyramidBuilder pyramidBuilder;
+EcgSerialMode serialMode = ECG_SERIAL_BINARY;
+EcgSerialStreamer serialStreamer;
+
+EcgRawQueue rawQueue;
+EcgFrameQueue ecgQueue;
+uint32_t frameSeq = 0;
+uint32_t droppedFrames = 0;
+EcgBeatQueue beatQueue;
+EcgSignalMonitor signalMonitor;
+EcgStatusQueue statusQueue;
+// Cambio de escala o banderas que no entró en statusQueue: se reintenta
+static bool statusPending = false;
+
+EcgPeriodStats acquisitionStats = {0, 0, 0, 0, 0};
+static volatile bool periodStatsReset = true;
+static uint32_t lastAcquisitionUs = 0;
+static EcgProfilePeriod acquisitionPeriod(ECG_STAGE_ACQ_PERIOD);
+static EcgProfilePeriod filterPeriod(ECG_STAGE_FILTER_PERIOD);
+
+// Variables globales para almacenar los valores ECG
+float raw_ecg = 0;
+float filtered_ecg = 0;
+float raw_ecg_2 = 0;
+float filtered_ecg_2 = 0;
+float ecg_2_minus_ecg1 = 0;
+float filtered_ecg_3 = 0;
+
+// Barrido en pantalla a velocidad fija, independiente de acquisitionRate
+float sweepRate = 125;
+EcgSweepRenderer sweepRenderer;
+
+///Variables para BPM
+float BPM = 0.0;
+uint32_t lastBeatSeq = 0;
+uint32_t firstBeatSeq = 0;
+uint32_t beatCount = 0;
+
+// Modo monitor
+uint32_t eventPreSeconds = 30;
+uint32_t eventPostSeconds = 30;
+uint32_t eventMaxSeconds = 300;
+float eventMinBpm = 40;
+float eventMaxBpm = 150;
+uint32_t eventsSaved = 0;
+uint32_t eventsFailed = 0;
+static bool monitorMode = false;
+static EcgEventBuffer eventBuffer;
+static uint8_t *eventMemory = NULL;
+static uint32_t eventMemoryBytes = 0;
+static EcgRhythmTrigger rhythmTrigger;
+// Muestras del buffer que pasan a la grabación en una vuelta, como máximo
+static const uint32_t eventDrainFrames = 256;
+
+enum EcgEventState {
+  EVENT_IDLE,
+  EVENT_WRITING,   // Del buffer a la SD hasta eventEnd
+  EVENT_CLOSING,   // Esperando que StorageTask libere los bloques para el final
+  EVENT_FLUSHING   // Esperando que StorageTask escriba el final para cerrar
+};
+static EcgEventState eventState = EVENT_IDLE;
+static EcgEventCause eventCause;
+static uint32_t eventPreFrames;   // Lo que entra antes del disparo
+static uint32_t eventCursor;      // Próxima muestra del buffer que va a la grabación
+static uint32_t eventEnd;         // Primera que ya no va
+static uint32_t eventLimit;       // Tope de eventEnd (eventMaxSeconds)
+static uint32_t eventMillis;      // millis() del disparo, para el nombre
+static bool eventQueued;          // Disparo mientras se cerraba el anterior
+static EcgEventCause queuedCause;
+static uint32_t eventBeats, eventFirstBeat, eventLastBeat;
+
+void acquireSample(uint32_t periods) {
+  // Los periodos que no se atendieron quedan como hueco en la secuencia
+  if (periods > 1) {
+    acquisitionStats.missed += periods - 1;
+    frameSeq += periods - 1;
+    ecgProfileCount(ECG_COUNT_MISSED_PERIODS, periods - 1);
+  }
+  acquisitionPeriod.mark();
+  EcgRawSample sample;
+  sample.seq = frameSeq++;
+  sample.timeUs = hal.clock->micros();
+  {
+    // Leer el voltaje crudo del ECG de los dos AD8232
+    EcgProfileScope scope(ECG_STAGE_ADC);
+    sample.volts[0] = hal.adc->readVoltage(ECG_ADC_XS1);
+    sample.volts[1] = hal.adc->readVoltage(ECG_ADC_XS2);
+  }
+  rawQueue.push(sample);
+
+  // Periodo real entre lecturas para verificar la frecuencia de muestreo
+  if (periodStatsReset) {
+    acquisitionStats.count = 0;
+    acquisitionStats.missed = 0;
+    acquisitionStats.sumUs = 0;
+    periodStatsReset = false;
+  } else {
+    uint32_t period = sample.timeUs - lastAcquisitionUs;
+    if (acquisitionStats.count == 0 || period < acquisitionStats.minUs) {
+      acquisitionStats.minUs = period;
+    }
+    if (acquisitionStats.count == 0 || period > acquisitionStats.maxUs) {
+      acquisitionStats.maxUs = period;
+    }
+    acquisitionStats.sumUs += period;
+    acquisitionStats.count++;
+  }
+  lastAcquisitionUs = sample.timeUs;
+}
+
+// Salida de un decimador: el seq y la hora de la entrada que le corresponde
+static void publishFrame(const EcgFrame &frame, uint32_t delay, uint8_t use) {
+  EcgFrame out = frame;
+  out.seq = frame.seq - delay;
+  out.timeUs = frame.timeUs - delay * (1000000 / acquisitionRate);
+  out.use = use;
+  ecgQueue.push(out);
+}
+
+void filterSample(const EcgRawSample &sample) {
+  raw_ecg = sample.volts[0];
+  raw_ecg_2 = sample.volts[1];
+  // La tercera derivación es la diferencia entre las dos primeras; como el
+  // banco es lineal, filtrarla cruda equivale a restar las filtradas
+  ecg_2_minus_ecg1 = raw_ecg_2 - raw_ecg;
+
+  float lead[ECG_LEADS] = {raw_ecg, raw_ecg_2, ecg_2_minus_ecg1};
+  {
+    EcgProfileScope scope(ECG_STAGE_FILTER);
+    filterBank.process(lead);
+  }
+  filtered_ecg = lead[0];
+  filtered_ecg_2 = lead[1];
+  filtered_ecg_3 = lead[2];
+
+  // Publicar la muestra con la marca de tiempo de la lectura para el lazo de captura
+  EcgFrame frame;
+  frame.seq = sample.seq;
+  frame.timeUs = sample.timeUs;
+  bool beatFound;
+  {
+    EcgProfileScope scope(ECG_STAGE_QRS);
+    beatFound = qrsDetector.process(filtered_ecg);
+  }
+  if (waveletDenoiseLevel > 0) {
+    EcgProfileScope scope(ECG_STAGE_DENOISE);
+    for (int l = 0; l < ECG_LEADS; l++) {
+      lead[l] = leadDenoiser[l].process(lead[l]);
+    }
+  }
+  if (beatFound) {
+    // El pico R quedó algunas muestras atrás (retardo de la integración) y
+    // las derivaciones limpias llegan ecgDenoiseDelay() muestras después.
+    // La decimación no mueve nada: cada salida lleva el seq que le corresponde.
+    EcgBeat beat;
+    beat.seq = frame.seq - (qrsDetector.sampleCount() - 1 - qrsDetector.lastPeak());
+    if (waveletDenoiseLevel > 0) {
+      beat.seq += leadDenoiser[0].delay();
+    }
+    beat.heartRate = qrsDetector.heartRate();
+    beatQueue.push(beat);
+  }
+  {
+    EcgProfileScope scope(ECG_STAGE_DECIMATE);
+    bool shared = displayRate == storageRate;
+    if (storageDecimator.process(sample.seq, lead, frame.lead)) {
+      publishFrame(frame, storageDecimator.delay(), shared ? ECG_FRAME_STORE | ECG_FRAME_DISPLAY : ECG_FRAME_STORE);
+    }
+    if (!shared && displayDecimator.process(sample.seq, lead, frame.lead)) {
+      publishFrame(frame, displayDecimator.delay(), ECG_FRAME_DISPLAY);
+    }
+  }
+  {
+    EcgProfileScope scope(ECG_STAGE_STATS);
+    if (signalMonitor.add(sample.volts, lead) || statusPending) {
+      statusPending = !statusQueue.push(signalMonitor.status());
+    }
+  }
+}
+
+void setupFilters() {
+  // Los coeficientes se calculan una sola vez
+  filterConfig.sampleRate = acquisitionRate;
+  filterBank.configure(filterConfig);
+  qrsDetector.begin(acquisitionRate);
+  storageDecimator.begin(acquisitionRate / storageRate);
+  displayDecimator.begin(acquisitionRate / displayRate);
+  signalMonitor.reset();
+  for (int l = 0; l < ECG_LEADS; l++) {
+    leadDenoiser[l].reset();
+  }
+}
+
+void AcquisitionTask(void *pv) {
+  // El temporizador fija el periodo; si no se pudo crear se vuelve a pasos de un tick
+  bool timer = hal.tasks->startTimer(1000000 / acquisitionRate);
+  if (!timer) {
+    hal.serial->println("Sin temporizador: adquisicion con vTaskDelay");
+  }
+  while (!hal.tasks->stopRequested()) {
+    uint32_t periods = 1;
+    if (timer) {
+      periods = hal.tasks->waitTimer();
+    } else {
+      hal.tasks->delayTick();
+    }
+    acquireSample(periods);
+  }
+  hal.tasks->stopTimer();
+}
+
+void FilterTask(void *pv) {
+  setupFilters();
+  EcgRawSample samples[16];
+  while (!hal.tasks->stopRequested()) {
+    uint32_t count = rawQueue.popBatch(samples, 16);
+    if (count > 0) {
+      filterPeriod.mark();
+    }
+    for (uint32_t i = 0; i < count; i++) {
+      filterSample(samples[i]);
+    }
+    if (count == 0) {
+      // Cola vacía: esperar 1 tick a que AcquisitionTask lea más
+      hal.tasks->delayTick();
+    }
+  }
+}
+
+void resetPeriodStats() {
+  periodStatsReset = true;
+}
+
+// Toma los latidos que detectó FilterTask; sin latidos en 3 s el BPM vuelve a 0
+static void updateBPM(uint32_t currentSeq) {
+  EcgBeat beats[4];
+  uint32_t count;
+  ecgProfileCount(ECG_COUNT_BEAT_OVERRUNS, beatQueue.takeOverruns());
+  while ((count = beatQueue.popBatch(beats, 4)) > 0) {
+    for (uint32_t i = 0; i < count; i++) {
+      if (beatCount == 0) {
+        firstBeatSeq = beats[i].seq;
+      }
+      lastBeatSeq = beats[i].seq;
+      BPM = beats[i].heartRate;
+      beatCount++;
+      if (eventState == EVENT_WRITING) {
+        // BPM medio del evento: los latidos desde el disparo
+        if (eventBeats == 0) {
+          eventFirstBeat = beats[i].seq;
+        }
+        eventLastBeat = beats[i].seq;
+        eventBeats++;
+      }
+    }
+  }
+  // Con signo: el último latido puede ser posterior a la última muestra
+  // decimada, que sale con el retardo del FIR
+  if (beatCount == 0 || (int32_t)(currentSeq - lastBeatSeq) > 3 * acquisitionRate) {
+    BPM = 0;
+  }
+}
+
+// Al cerrar una grabación el último chunk, la tabla y las páginas pendientes
+// salen juntos y pueden no entrar en los dos bloques: ahí se espera a que
+// StorageTask libere uno en lugar de descartar. Solo al terminar la captura;
+// los eventos del monitor se cierran sin esperar (serviceEvent()).
+static bool waitForStorage = false;
+
+static bool appendTo(EcgStreamWriter &writer, const uint8_t *data, uint32_t len) {
+  while (waitForStorage && writer.isOpen() && !writer.failed() && writer.freeBytes() < len) {
+    hal.clock->delayMs(1);
+  }
+  if (!writer.append(data, len)) {
+    ecgProfileCount(ECG_COUNT_SD_DROPPED, len);
+    return false;
+  }
+  return true;
+}
+
+// Los chunks del .ecg van al escritor en streaming
+static bool appendToStream(const uint8_t *data, uint32_t len, void *ctx) {
+  return appendTo(streamWriter, data, len);
+}
+
+static bool appendToPyramid(const uint8_t *data, uint32_t len, void *ctx) {
+  return appendTo(pyramidWriter, data, len);
+}
+
+// Estado de la captura en curso entre llamadas a stepEKGCapture()
+static EcgFrame captureFrames[frameBatchSize];
+static EcgFrame lastFrame;
+static bool haveFrame;
+static bool firstCaptured;
+static uint32_t firstSeq;
+static uint32_t overlayMs;
+// Última escala y banderas que llegaron de FilterTask
+static EcgSignalStatus signalStatus;
+
+// Colas, BPM y posición de la grabación al empezar una captura o el monitor
+static void resetCaptureState() {
+  recordedSamples = 0;
+  droppedFrames = 0;
+  ecgQueue.clear(); // Descarta las muestras que llegaron antes de empezar
+  ecgQueue.takeOverruns();
+  rawQueue.takeOverruns();
+  resetPeriodStats();
+  beatQueue.clear();
+  beatQueue.takeOverruns();
+  beatCount = 0;
+  BPM = 0;
+  lastFrame = EcgFrame();
+  haveFrame = false;
+  firstCaptured = true;
+  firstSeq = 0;
+  overlayMs = hal.clock->millis();
+}
+
+void startEKGCapture() {
+  ecgArena.beginPhase("captura");
+  infarctClassifier.startWindow(storageRate);
+  if (!streamWriter.begin(captureTempFile)) {
+    hal.serial->println("Error abriendo el archivo de captura");
+  }
+  recordEncoder.begin(storageRate, hal.clock->millis(), appendToStream, NULL);
+  // El índice para el visor se arma a la par; si no se puede abrir la
+  // grabación se guarda igual, sin índice
+  pyramidWriter.begin(pyramidTempFile);
+  pyramidBuilder.begin(recordEncoder.header(), appendToPyramid, NULL);
+  if (serialMode == ECG_SERIAL_BINARY) {
+    serialStreamer.begin(recordEncoder.header());
+  }
+  resetCaptureState();
+}
+
+// Lleva al barrido los cambios de statusQueue; con `all` vuelve a aplicar
+// todas las escalas (después de begin(), que las deja fijas)
+static void updateSignalStatus(bool all) {
+  EcgSignalStatus latest = signalStatus;
+  while (statusQueue.popBatch(&latest, 1) == 1) {
+  }
+  uint8_t flags[ECG_LEADS];
+  for (int l = 0; l < ECG_LEADS; l++) {
+    const EcgLeadView &view = latest.lead[l];
+    if (all || view.low != signalStatus.lead[l].low || view.high != signalStatus.lead[l].high) {
+      sweepRenderer.setLeadScale(l, view.low, view.high);
+    }
+    flags[l] = view.flags;
+  }
+  signalStatus = latest;
+  sweepRenderer.setLeadFlags(flags);
+}
+
+// Procesa lo que haya en la cola; false si todavía no llegó ninguna muestra
+static bool processCaptureFrames() {
+  EcgProfileScope scope(ECG_STAGE_CAPTURE);
+  updateSignalStatus(false);
+  // Sacar de la cola todas las muestras pendientes
+  uint32_t count = ecgQueue.popBatch(captureFrames, frameBatchSize);
+  uint32_t frameOverruns = ecgQueue.takeOverruns();
+  uint32_t rawOverruns = rawQueue.takeOverruns();
+  droppedFrames += frameOverruns + rawOverruns;
+  ecgProfileCount(ECG_COUNT_FRAME_OVERRUNS, frameOverruns);
+  ecgProfileCount(ECG_COUNT_RAW_OVERRUNS, rawOverruns);
+  uint32_t decimation = acquisitionRate / storageRate;
+  for (uint32_t f = 0; f < count; f++) {
+    const EcgFrame &frame = captureFrames[f];
+
+    // Las muestras para grabar ya vienen decimadas, con seq múltiplo de la
+    // decimación (base de tiempo fija). Si se perdieron en la cola queda un
+    // hueco en la grabación.
+    if (frame.use & ECG_FRAME_STORE) {
+      if (firstCaptured) {
+        firstSeq = frame.seq;
+        firstCaptured = false;
+      }
+      uint32_t index = (frame.seq - firstSeq) / decimation;
+      EcgProfileScope encodeScope(ECG_STAGE_ENCODE);
+      if (monitorMode) {
+        // Al buffer de eventos; serviceEvent() lo pasa a la SD
+        if (index > recordedSamples) {
+          eventBuffer.skip(index - recordedSamples);
+          recordedSamples = index;
+        }
+        eventBuffer.push(frame.lead);
+      } else {
+        if (index > recordedSamples) {
+          recordEncoder.skipFrames(index - recordedSamples);
+          pyramidBuilder.skipFrames(index - recordedSamples);
+          if (serialMode == ECG_SERIAL_BINARY) {
+            serialStreamer.skipFrames(index - recordedSamples);
+          }
+          recordedSamples = index;
+        }
+        recordEncoder.addFrame(frame.lead);
+        pyramidBuilder.addFrame(frame.lead);
+        if (serialMode == ECG_SERIAL_BINARY) {
+          serialStreamer.addFrame(frame.lead);
+        }
+        infarctClassifier.addSample(frame.lead[ECG_MODEL_LEAD]);
+      }
+      recordedSamples++;
+    }
+    if (frame.use & ECG_FRAME_DISPLAY) {
+      EcgProfileScope sweepScope(ECG_STAGE_SWEEP);
+      sweepRenderer.addFrame(frame);
+    }
+    lastFrame = frame;
+    haveFrame = true;
+  }
+  if (!haveFrame) {
+    return false;
+  }
+  updateBPM(lastFrame.seq);
+  sweepRenderer.setHeartRate(calculateAverageBPM());
+
+  EcgProfileScope serialScope(ECG_STAGE_SERIAL);
+  if (serialMode == ECG_SERIAL_BINARY && !monitorMode) {
+    serialStreamer.service(); // Solo lo que entra en el puerto sin esperar
+  } else if (serialMode == ECG_SERIAL_ASCII) {
+    // Imprimir valores en el monitor serial para depuración
+    hal.serial->print(lastFrame.lead[0], 6);
+    hal.serial->print(" ");
+    hal.serial->print(lastFrame.lead[1], 6);
+    hal.serial->print(" ");
+    hal.serial->println(lastFrame.lead[2], 6);
+  }
+  return true;
+}
+
+static void drawProfileOverlay() {
+  if (ecgProfiler.overlay && hal.clock->millis() - overlayMs >= 1000) {
+    overlayMs = hal.clock->millis();
+    ecgProfiler.drawOverlay(hal.display);
+  }
+}
+
+bool stepEKGCapture() {
+  if (streamWriter.failed()) {
+    return false;
+  }
+  if (!processCaptureFrames()) {
+    hal.clock->delayMs(1); // Aún no llega ninguna muestra
+    return true;
+  }
+  drawProfileOverlay();
+  hal.clock->delayMs(5); // Ajusta según sea necesario
+  return true;
+}
+
+void finishEKGCapture() {
+  sweepRenderer.flush();
+
+  // Frecuencia media de toda la grabación para el catálogo
+  if (beatCount > 1 && lastBeatSeq > firstBeatSeq) {
+    recordEncoder.setAverageBpm((beatCount - 1) * 60.0f * acquisitionRate / (lastBeatSeq - firstBeatSeq));
+  }
+  waitForStorage = true;
+  recordEncoder.finish();
+  streamWriter.finish((const uint8_t *)&recordEncoder.header(), sizeof(EcgRecordHeader));
+  pyramidBuilder.finish();
+  pyramidWriter.finish((const uint8_t *)&pyramidBuilder.header(), sizeof(EcgPyramidHeader));
+  waitForStorage = false;
+  if (serialMode == ECG_SERIAL_BINARY) {
+    // Se vacía el flujo antes de los mensajes de texto (a lo sumo 1 s)
+    serialStreamer.finish(recordedSamples, recordEncoder.header().averageBpm);
+    uint32_t start = hal.clock->millis();
+    while (serialStreamer.pending() > 0 && hal.clock->millis() - start < 1000) {
+      serialStreamer.service();
+      hal.tasks->delayTick();
+    }
+  }
+
+  // Informar las muestras que se perdieron por cola llena o SD lenta
+  hal.serial->print("Muestras perdidas: ");
+  hal.serial->println(droppedFrames, 0);
+  hal.serial->print("Bytes descartados por SD: ");
+  hal.serial->println(streamWriter.droppedBytes, 0);
+  hal.serial->print("Peor escritura (us): ");
+  hal.serial->println(streamWriter.maxWriteUs, 0);
+  hal.serial->print("Periodo de muestreo min/max (us): ");
+  hal.serial->print(acquisitionStats.minUs, 0);
+  hal.serial->print(" / ");
+  hal.serial->println(acquisitionStats.maxUs, 0);
+  hal.serial->print("Periodos perdidos: ");
+  hal.serial->println(acquisitionStats.missed, 0);
+  hal.serial->print("Tiras por segundo: ");
+  hal.serial->println(sweepRenderer.stripsPerSecond(), 1);
+  hal.serial->print("Peor envio de tira (us): ");
+  hal.serial->println(sweepRenderer.pushUsMax, 0);
+  if (serialMode == ECG_SERIAL_BINARY) {
+    hal.serial->print("Paquetes serie enviados/descartados: ");
+    hal.serial->print(serialStreamer.packetsSent, 0);
+    hal.serial->print(" / ");
+    hal.serial->println(serialStreamer.droppedPackets, 0);
+  }
+}
+
+void runEKGCapture(bool (*stopCapture)()) {
+  startEKGCapture();
+  while (!stopCapture() && stepEKGCapture()) {
+  }
+  finishEKGCapture();
+}
+
+// Frecuencia a la que se puede decimar: acquisitionRate / rate entero y en
+// el rango de EcgDecimator
+static bool validRate(int rate) {
+  return rate > 0 && acquisitionRate % rate == 0 && acquisitionRate / rate <= ECG_DECIM_MAX_FACTOR;
+}
+
+void reservePipelineMemory() {
+  if (!validRate(storageRate)) {
+    hal.serial->println("Frecuencia de grabacion invalida: se usa la de por defecto");
+    storageRate = defaultStorageRate;
+  }
+  if (!validRate(displayRate)) {
+    hal.serial->println("Frecuencia del barrido invalida: se usa la de por defecto");
+    displayRate = defaultDisplayRate;
+  }
+  sweepRenderer.begin(displayRate, sweepRate);
+  if (!signalMonitor.begin(acquisitionRate)) {
+    hal.serial->println("Sin memoria para las estadisticas de la senal");
+  }
+  for (int l = 0; l < ECG_LEADS && waveletDenoiseLevel > 0; l++) {
+    if (!leadDenoiser[l].begin(waveletDenoiseLevel, ECG_DENOISE_LIVE_WINDOW, true)) {
+      hal.serial->println("Sin memoria para la limpieza por wavelets");
+      waveletDenoiseLevel = 0;
+    }
+  }
+}
+
+void drawSweepLayout() {
+  sweepRenderer.begin(displayRate, sweepRate);
+  sweepRenderer.drawLayout();
+  sweepRenderer.setHeartRate(0);
+  updateSignalStatus(true);
+}
+
+float calculateAverageBPM() {
+  // El detector ya promedia los últimos ECG_QRS_RR_HISTORY intervalos RR
+  return BPM;
+}
+
+bool keepEKGRecording(const char *fileName) {
+  if (!hal.storage->rename(captureTempFile, fileName)) {
+    return false;
+  }
+  EcgFile *file = hal.storage->open(fileName, ECG_OPEN_READ);
+  EcgCatalogEntry entry;
+  ecgCatalogEntryFromRecord(entry, fileName, recordEncoder.header(), file ? file->size() : 0);
+  if (file) {
+    file->close();
+  }
+  catalog.add(entry);
+  // Sin índice el visor lee las muestras: no es un error
+  char pyramidFile[64];
+  ecgPyramidPath(fileName, pyramidFile, sizeof(pyramidFile));
+  hal.storage->remove(pyramidFile);
+  hal.storage->rename(pyramidTempFile, pyramidFile);
+  return true;
+}
+
+void discardEKGRecording() {
+  hal.storage->remove(captureTempFile);
+  hal.storage->remove(pyramidTempFile);
+}
+
+// Hay lugar en los dos escritores para lo más que puede salir de una muestra:
+// un chunk del .ecg y un bloque de páginas del .pyr. Sin índice (no se pudo
+// abrir o falló) la grabación sigue igual que en la captura.
+static bool eventWritersReady() {
+  return streamWriter.freeBytes() >= ECG_RECORD_CHUNK_SIZE &&
+         (!pyramidWriter.isOpen() || pyramidWriter.failed() ||
+          pyramidWriter.freeBytes() >= EcgStreamWriter::blockSize);
+}
+
+void setEventMemory(uint8_t *memory, uint32_t bytes) {
+  eventMemory = memory;
+  eventMemoryBytes = memory ? bytes : 0;
+}
+
+void startEKGMonitor() {
+  ecgArena.beginPhase("monitor");
+  uint32_t rate = storageRate;
+  bool ok = eventMemory ? eventBuffer.begin(eventMemoryBytes / ecgEventBufferBytes(1), eventMemory)
+                        : eventBuffer.begin(ECG_EVENT_ARENA_FRAMES);
+  if (!ok) {
+    hal.serial->println("Sin memoria para el buffer de eventos");
+  }
+  // Lo anterior al disparo deja ECG_EVENT_MARGIN_SECONDS para el atraso de la SD
+  uint32_t margin = ECG_EVENT_MARGIN_SECONDS * rate;
+  uint32_t capacity = eventBuffer.capacity();
+  uint32_t room = capacity > 2 * margin ? capacity - margin : capacity / 2;
+  eventPreFrames = eventPreSeconds * rate < room ? eventPreSeconds * rate : room;
+  rhythmTrigger.begin(eventMinBpm, eventMaxBpm);
+  eventState = EVENT_IDLE;
+  eventQueued = false;
+  eventsSaved = 0;
+  eventsFailed = 0;
+  monitorMode = true;
+  resetCaptureState();
+}
+
+bool eventRecording() {
+  return eventState != EVENT_IDLE;
+}
+
+void triggerEKGEvent(EcgEventCause cause) {
+  if (!monitorMode) {
+    return;
+  }
+  uint32_t rate = storageRate;
+  uint32_t now = eventBuffer.head();
+  if (eventState == EVENT_WRITING) {
+    // Otro disparo durante la grabación la alarga
+    uint32_t end = now + eventPostSeconds * rate;
+    eventEnd = end < eventLimit ? end : eventLimit;
+    return;
+  }
+  if (eventState == EVENT_CLOSING || eventState == EVENT_FLUSHING) {
+    eventQueued = true;
+    queuedCause = cause;
+    return;
+  }
+  uint32_t first = now > eventPreFrames ? now - eventPreFrames : 0;
+  if (first < eventBuffer.oldest()) {
+    first = eventBuffer.oldest();
+  }
+  if (!streamWriter.begin(captureTempFile)) {
+    hal.serial->println("Error abriendo el archivo del evento");
+    eventsFailed++;
+    return;
+  }
+  eventMillis = hal.clock->millis();
+  // La grabación empieza en la primera muestra anterior al disparo
+  recordEncoder.begin(rate, eventMillis - (now - first) * 1000 / rate, appendToStream, NULL);
+  pyramidWriter.begin(pyramidTempFile);
+  pyramidBuilder.begin(recordEncoder.header(), appendToPyramid, NULL);
+  eventCause = cause;
+  eventCursor = first;
+  eventLimit = first + eventMaxSeconds * rate;
+  eventEnd = now + eventPostSeconds * rate < eventLimit ? now + eventPostSeconds * rate : eventLimit;
+  eventBeats = 0;
+  eventState = EVENT_WRITING;
+}
+
+// Final del evento con los dos escritores libres: el último chunk y la tabla
+// (hasta 5 KB) y las páginas pendientes del .pyr entran en sus bloques, que se
+// entregan a StorageTask sin esperar. Mientras los escribe el lazo sigue
+// pasando ecgQueue al buffer de eventos, así una SD lenta no pierde muestras.
+static void flushEvent() {
+  if (eventBeats > 1 && eventLastBeat > eventFirstBeat) {
+    recordEncoder.setAverageBpm((eventBeats - 1) * 60.0f * acquisitionRate / (eventLastBeat - eventFirstBeat));
+  }
+  recordEncoder.finish();
+  pyramidBuilder.finish();
+  streamWriter.flush();
+  pyramidWriter.flush();
+}
+
+// Con todo escrito finish() solo reescribe las cabeceras y cierra
+static void closeEvent() {
+  uint32_t rate = storageRate;
+  streamWriter.finish((const uint8_t *)&recordEncoder.header(), sizeof(EcgRecordHeader));
+  pyramidWriter.finish((const uint8_t *)&pyramidBuilder.header(), sizeof(EcgPyramidHeader));
+  char fileName[32];
+  snprintf(fileName, sizeof(fileName), "/EVT_%u.ecg", (unsigned)eventMillis);
+  char line[80];
+  if (!streamWriter.failed() && keepEKGRecording(fileName)) {
+    eventsSaved++;
+    snprintf(line, sizeof(line), "Evento (%s) guardado en %s: %u s\r\n", ecgEventCauseText(eventCause), fileName,
+             (unsigned)(recordEncoder.header().frameCount / rate));
+  } else {
+    discardEKGRecording();
+    eventsFailed++;
+    snprintf(line, sizeof(line), "Error guardando el evento (%s)\r\n", ecgEventCauseText(eventCause));
+  }
+  hal.serial->print(line);
+  eventState = EVENT_IDLE;
+  if (eventQueued) {
+    eventQueued = false;
+    triggerEKGEvent(queuedCause);
+  }
+}
+
+// Pasa el buffer a la grabación del evento solo mientras los escritores
+// tengan lugar, así que vaciar lo anterior al disparo no descarta bytes: si
+// la SD se atrasa las muestras esperan en el buffer, y solo se pierde lo que
+// se pisa antes de llegar (queda como hueco)
+static void serviceEvent() {
+  if (eventState != EVENT_IDLE && streamWriter.failed()) {
+    // Tarjeta llena o retirada: se pierde este evento, el monitor sigue
+    streamWriter.finish();
+    pyramidWriter.finish();
+    discardEKGRecording();
+    eventsFailed++;
+    eventQueued = false;
+    eventState = EVENT_IDLE;
+    hal.serial->println("Error de la SD grabando el evento");
+    return;
+  }
+  if (eventState == EVENT_WRITING) {
+    EcgProfileScope scope(ECG_STAGE_ENCODE);
+    if (eventCursor < eventBuffer.oldest()) {
+      uint32_t lost = eventBuffer.oldest() - eventCursor;
+      recordEncoder.skipFrames(lost);
+      pyramidBuilder.skipFrames(lost);
+      ecgProfileCount(ECG_COUNT_EVENT_LOST, lost);
+      eventCursor += lost;
+    }
+    uint32_t last = eventEnd < eventBuffer.head() ? eventEnd : eventBuffer.head();
+    for (uint32_t n = 0; n < eventDrainFrames && eventCursor < last && eventWritersReady(); n++) {
+      float volts[ECG_LEADS];
+      if (eventBuffer.read(eventCursor, volts)) {
+        recordEncoder.addFrame(volts);
+        pyramidBuilder.addFrame(volts);
+      } else {
+        recordEncoder.skipFrames(1);
+        pyramidBuilder.skipFrames(1);
+      }
+      eventCursor++;
+    }
+    if (eventCursor >= eventEnd) {
+      eventState = EVENT_CLOSING;
+    }
+  }
+  // Cada paso del cierre espera a que StorageTask no tenga bloques, sin
+  // bloquear el lazo
+  bool storageIdle = !streamWriter.busy() && !pyramidWriter.busy();
+  if (eventState == EVENT_CLOSING && storageIdle) {
+    flushEvent();
+    eventState = EVENT_FLUSHING;
+  } else if (eventState == EVENT_FLUSHING && storageIdle) {
+    closeEvent();
+  }
+}
+
+void stepEKGMonitor() {
+  bool haveFrames = processCaptureFrames();
+  // El ritmo cuenta con los electrodos puestos y el promedio de RR ya lleno
+  bool leadsOn = true;
+  for (int l = 0; l < ECG_LEADS; l++) {
+    if (signalStatus.lead[l].flags & ECG_SIGNAL_LEAD_OFF) {
+      leadsOn = false;
+    }
+  }
+  if (haveFrames && leadsOn && beatCount > (uint32_t)ECG_QRS_RR_HISTORY && rhythmTrigger.update(BPM)) {
+    triggerEKGEvent(ECG_EVENT_RHYTHM);
+  }
+  serviceEvent();
+  drawProfileOverlay();
+  // Mientras quede algo anterior al disparo por vaciar se vuelve enseguida
+  bool backlog = eventState == EVENT_WRITING && eventCursor + frameBatchSize < eventBuffer.head();
+  hal.clock->delayMs(haveFrames && !backlog ? 5 : 1);
+}
+
+void finishEKGMonitor() {
+  sweepRenderer.flush();
+  // El evento en curso se cierra con lo que ya llegó
+  eventQueued = false;
+  if (eventState == EVENT_WRITING && eventEnd > eventBuffer.head()) {
+    eventEnd = eventBuffer.head();
+  }
+  while (eventState != EVENT_IDLE) {
+    serviceEvent();
+    if (eventState != EVENT_IDLE) {
+      hal.clock->delayMs(1);
+    }
+  }
+  monitorMode = false;
+  hal.serial->print("Eventos guardados: ");
+  hal.serial->println(eventsSaved, 0);
+  hal.serial->print("Eventos con error: ");
+  hal.serial->println(eventsFailed, 0);
+  hal.serial->print("Muestras perdidas: ");
+  hal.serial->println(droppedFrames, 0);
+}
@@ -0,0 +1,176 @@
+#ifndef ECG_PIPELINE_H
+#define ECG_PIPELINE_H
+
+#include "ecg_decimate.h"
+#include "ecg_event.h"
+#include "ecg_filter.h"
+#include "ecg_hal.h"
+#include "ecg_qrs.h"
+#include "ecg_queue.h"
+#include "ecg_render.h"
+#include "ecg_serial_stream.h"
+#include "ecg_stats.h"
+
+// Adquisición, filtrado, BPM, trazado y guardado del ECG. Todo pasa por `hal`,
+// de modo que el mismo código corre en la placa y en Linux.
+
+// Variables para el ploteo
+const int screenWidth = 320;
+const int screenHeight = 240;
+
+// AcquisitionTask lee a 1 kHz con un temporizador de hardware. FilterTask
+// decima (ecg_decimate.h) a storageRate lo que se graba, se manda por el
+// puerto serie y entra al buffer de eventos, y a displayRate lo que dibuja el
+// barrido. Las dos tienen que dividir a acquisitionRate, hasta
+// ECG_DECIM_MAX_FACTOR veces; se fijan antes de reservePipelineMemory(), que
+// vuelve a las de por defecto si no valen.
+const int acquisitionRate = 1000;
+const int defaultStorageRate = 250;
+const int defaultDisplayRate = 250;
+extern int storageRate;
+extern int displayRate;
+const int frameBatchSize = 32; // Muestras que se sacan de la cola en cada vuelta del lazo
+
+// Reparto de tareas en el ESP32: la adquisición sola en el núcleo 0; el
+// filtrado, la SD y la captura/pantalla (loop(), prioridad 1) en el núcleo 1
+const int acquisitionCore = 0;
+const int processingCore = 1;
+const int acquisitionPriority = 5;
+const int filterPriority = 3;
+const int storagePriority = 2;
+// Pila de cada tarea en bytes (printTaskStacks() informa cuánto usan)
+const uint32_t acquisitionStackBytes = 3000;
+const uint32_t filterStackBytes = 3000;
+const uint32_t storageStackBytes = 4096;
+
+// La captura se graba en formato .ecg (ecg_record.h) en este archivo y al
+// final se renombra o se borra, junto con su índice .pyr (ecg_pyramid.h)
+extern const char *captureTempFile;
+extern const char *pyramidTempFile;
+// Catálogo de mediciones guardadas (ecg_catalog.h)
+extern const char *catalogFile;
+extern uint32_t recordedSamples;
+
+// Qué manda la captura por el puerto serie: las muestras grabadas en paquetes
+// binarios (por defecto, ecg_serial_stream.h) o texto para depuración
+extern EcgSerialMode serialMode;
+extern EcgSerialStreamer serialStreamer;
+
+// Colas acotadas: AcquisitionTask -> rawQueue -> FilterTask -> ecgQueue -> runEKGCapture
+extern EcgRawQueue rawQueue;
+extern EcgFrameQueue ecgQueue;
+extern uint32_t frameSeq;
+extern uint32_t droppedFrames;
+
+// Latidos (pico R) que detecta FilterTask con EcgQrsDetector
+extern EcgBeatQueue beatQueue;
+extern uint32_t beatCount;
+
+// Escala de cada franja y banderas de calidad (ecg_stats.h) que calcula
+// FilterTask sobre la ventana de los últimos 2,56 s; statusQueue lleva los
+// cambios al lazo de captura
+extern EcgSignalMonitor signalMonitor;
+extern EcgStatusQueue statusQueue;
+
+// Etapas del banco de filtros; se puede cambiar antes de crear FilterTask
+// (p. ej. notchHz = 50 donde la red es de 50 Hz)
+extern EcgFilterBankConfig filterConfig;
+
+// Nivel de la limpieza por wavelets (ecg_denoise.h) de las tres derivaciones
+// después del banco; 0 la desactiva. Se fija antes de reservePipelineMemory()
+// y atrasa lo que se ve y se graba ecgDenoiseDelay(nivel) muestras (los
+// latidos se corrigen). El QRS sigue sobre la salida del banco.
+extern int waveletDenoiseLevel;
+
+// Periodo medido entre lecturas de AcquisitionTask desde la última
+// resetPeriodStats() (runEKGCapture la llama al empezar)
+struct EcgPeriodStats {
+  uint32_t count;
+  uint32_t minUs;
+  uint32_t maxUs;
+  uint64_t sumUs;
+  uint32_t missed;   // Disparos del temporizador que no se atendieron a tiempo
+};
+extern EcgPeriodStats acquisitionStats;
+void resetPeriodStats();
+
+// Lectura de los AD8232 en cada disparo del temporizador
+void AcquisitionTask(void *pv);
+// Filtrado y detección de QRS de lo que llega por rawQueue
+void FilterTask(void *pv);
+
+// Calcula los coeficientes del banco (FilterTask lo llama al iniciar)
+void setupFilters();
+
+// Lee una muestra y la publica en rawQueue (periods > 1 si hubo atraso)
+void acquireSample(uint32_t periods);
+// Filtra una muestra y publica en ecgQueue las que salen de la decimación
+// (y el latido en beatQueue)
+void filterSample(const EcgRawSample &sample);
+
+// Velocidad del barrido en columnas por segundo y su renderizador
+extern float sweepRate;
+extern EcgSweepRenderer sweepRenderer;
+
+// Limpia la pantalla y dibuja la barra de estado y los ejes del barrido
+void drawSweepLayout();
+
+// Revisa storageRate y displayRate y reserva en ecgArena los buffers
+// permanentes del pipeline (la tira del barrido, las ventanas de
+// signalMonitor y la de la limpieza por wavelets); va en setup(), antes de
+// ecgArena.seal() y de crear FilterTask
+void reservePipelineMemory();
+
+// Graba en streaming a captureTempFile dibujando el barrido y el BPM en la
+// pantalla, hasta que stopCapture() devuelva true o la SD falle.
+// Requiere que StorageTask esté corriendo y drawSweepLayout() antes.
+void runEKGCapture(bool (*stopCapture)());
+
+// La misma captura por pasos, para que quien llama siga atendiendo otras
+// cosas: stepEKGCapture() procesa lo que haya en la cola (a lo sumo
+// frameBatchSize muestras y una espera de 5 ms) y devuelve false si la SD
+// falló; finishEKGCapture() cierra la grabación y su índice.
+// startEKGCapture() abre la fase "captura" de ecgArena, así que los buffers
+// de la reproducción dejan de valer.
+void startEKGCapture();
+bool stepEKGCapture();
+void finishEKGCapture();
+
+float calculateAverageBPM();
+
+// Decisión de guardado al terminar la captura. keepEKGRecording deja el
+// índice como <nombre>.pyr al lado de la grabación y la agrega al catálogo.
+bool keepEKGRecording(const char *fileName);
+void discardEKGRecording();
+
+// Modo monitor (registrador de eventos, ecg_event.h): el barrido y el BPM
+// siguen como en la captura, pero las muestras van a un buffer circular en
+// lugar de a la SD. Cada disparo guarda eventPreSeconds antes y
+// eventPostSeconds después como /EVT_<millis>.ecg (con su .pyr y en el
+// catálogo); otro disparo mientras se graba la alarga hasta eventMaxSeconds.
+// El BPM fuera de [eventMinBpm, eventMaxBpm] dispara solo con los electrodos
+// puestos. Sin flujo binario por el puerto serie: el texto informa cada evento.
+extern uint32_t eventPreSeconds;
+extern uint32_t eventPostSeconds;
+extern uint32_t eventMaxSeconds;
+extern float eventMinBpm;
+extern float eventMaxBpm;
+extern uint32_t eventsSaved;
+extern uint32_t eventsFailed;
+
+// Memoria externa para el buffer de eventos (la PSRAM del ESP32), en setup().
+// Sin ella el buffer sale de la fase "monitor" de ecgArena y guarda
+// ECG_EVENT_ARENA_FRAMES muestras en total.
+void setEventMemory(uint8_t *memory, uint32_t bytes);
+
+// Igual que la captura por pasos; requiere StorageTask y drawSweepLayout()
+// antes. finishEKGMonitor() termina de guardar el evento en curso con lo que
+// ya llegó.
+void startEKGMonitor();
+void stepEKGMonitor();
+void finishEKGMonitor();
+void triggerEKGEvent(EcgEventCause cause);
+// Hay un evento grabándose (incluye vaciar lo anterior al disparo)
+bool eventRecording();
+
+#endif
@@ -0,0 +1,446 @@
+#include "ecg_playback.h"
+
+#include <stdio.h>
+#include <string.h>
+
+uint32_t EcgRecordSource::read(float *volts, uint32_t maxFrames) {
+  uint32_t done = 0;
+  // El lector ya saltó los huecos; acá se corta hasta que skipGap() los cuente
+  while (done < maxFrames && reader.position() == next) {
+    uint32_t want = maxFrames - done < batchFrames ? maxFrames - done : batchFrames;
+    uint32_t count = reader.read(raw, want);
+    if (count == 0) {
+      break;
+    }
+    for (uint32_t i = 0; i < count * ECG_LEADS; i++) {
+      volts[done * ECG_LEADS + i] = reader.toVolts(raw[i], i % ECG_LEADS);
+    }
+    done += count;
+    next += count;
+  }
+  return done;
+}
+
+uint32_t EcgRecordSource::skipGap() {
+  uint32_t at = reader.position();
+  if (at <= next) {
+    return 0;
+  }
+  uint32_t gap = at - next;
+  next = at;
+  return gap;
+}
+
+// ---------------------------------------------------------------- Texto
+
+const char *ecgParseNumber(const char *p, const char *end, float &value) {
+  while (p < end && (*p == ' ' || *p == '\t')) {
+    p++;
+  }
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  const char *digits = p;
+  float v = 0;
+  while (p < end && *p >= '0' && *p <= '9') {
+    v = v * 10 + (*p++ - '0');
+  }
+  if (p < end && *p == '.') {
+    p++;
+    float scale = 0.1f;
+    while (p < end && *p >= '0' && *p <= '9') {
+      v += (*p++ - '0') * scale;
+      scale *= 0.1f;
+    }
+  }
+  if (p == digits) {
+    return NULL;
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool negExp = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      negExp = *p == '-';
+      p++;
+    }
+    int e = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+      e = e * 10 + (*p++ - '0');
+    }
+    while (e-- > 0) {
+      v = negExp ? v * 0.1f : v * 10;
+    }
+  }
+  value = negative ? -v : v;
+  return p;
+}
+
+bool ecgParseTextLine(const char *line, uint32_t len, float v[ECG_LEADS]) {
+  const char *p = line, *end = line + len;
+  for (int i = 0; i < ECG_LEADS; i++) {
+    p = ecgParseNumber(p, end, v[i]);
+    if (!p) {
+      return false;
+    }
+    while (p < end && (*p == ' ' || *p == '\t')) {
+      p++;
+    }
+    if (i < ECG_LEADS - 1) {
+      if (p == end || *p != ',') {
+        return false;
+      }
+      p++;
+    }
+  }
+  return true;
+}
+
+bool EcgTextSource::open(EcgFile *f, uint32_t sampleRate) {
+  file = f;
+  rate = sampleRate;
+  lines = 0;
+  stride = 1;
+  indexCount = 0;
+  blockLen = blockPos = 0;
+  if (!file) {
+    return false;
+  }
+  uint8_t *mem = ecgArena.take(memory, ECG_TEXT_INDEX_MAX * sizeof(uint32_t) + ECG_TEXT_BLOCK_SIZE, "indice .txt");
+  if (!mem) {
+    return false;
+  }
+  index = (uint32_t *)mem;
+  block = mem + ECG_TEXT_INDEX_MAX * sizeof(uint32_t);
+  // Una pasada contando saltos de línea, sin parsear números
+  uint32_t offset = 0;
+  bool lineStarted = false;
+  uint32_t n;
+  while ((n = file->read(block, ECG_TEXT_BLOCK_SIZE)) > 0) {
+    for (uint32_t i = 0; i < n; i++) {
+      if (!lineStarted) {
+        lineStarted = true;
+        if (lines % stride == 0) {
+          if (indexCount == ECG_TEXT_INDEX_MAX) {
+            for (uint32_t k = 0; k < ECG_TEXT_INDEX_MAX / 2; k++) {
+              index[k] = index[2 * k];
+            }
+            indexCount = ECG_TEXT_INDEX_MAX / 2;
+            stride *= 2;
+          }
+          if (lines % stride == 0) {
+            index[indexCount++] = offset + i;
+          }
+        }
+      }
+      if (block[i] == '\n') {
+        lines++;
+        lineStarted = false;
+      }
+    }
+    offset += n;
+  }
+  if (lineStarted) {
+    lines++;  // Última línea sin salto
+  }
+  return seek(0);
+}
+
+bool EcgTextSource::refill() {
+  blockPos = 0;
+  blockLen = file->read(block, ECG_TEXT_BLOCK_SIZE);
+  return blockLen > 0;
+}
+
+int EcgTextSource::nextChar() {
+  if (blockPos == blockLen && !refill()) {
+    return -1;
+  }
+  return block[blockPos++];
+}
+
+bool EcgTextSource::seek(uint32_t frame) {
+  if (indexCount == 0) {
+    return false;
+  }
+  uint32_t k = frame / stride;
+  if (k >= indexCount) {
+    k = indexCount - 1;
+  }
+  if (!file->seek(index[k])) {
+    return false;
+  }
+  blockLen = blockPos = 0;
+  // Saltar las líneas que faltan hasta `frame`
+  for (uint32_t line = k * stride; line < frame; line++) {
+    int c;
+    while ((c = nextChar()) >= 0 && c != '\n') {
+    }
+    if (c < 0) {
+      break;
+    }
+  }
+  return true;
+}
+
+bool EcgTextSource::parseLine(float v[ECG_LEADS]) {
+  char line[64];
+  uint32_t len = 0;
+  int c;
+  while ((c = nextChar()) >= 0 && c != '\n') {
+    if (len < sizeof(line)) {
+      line[len++] = (char)c;
+    }
+  }
+  if (c < 0 && len == 0) {
+    return false;
+  }
+  if (!ecgParseTextLine(line, len, v)) {
+    // Línea que no es una muestra: se dibuja como 0 para no correr el tiempo
+    for (int i = 0; i < ECG_LEADS; i++) {
+      v[i] = 0;
+    }
+  }
+  return true;
+}
+
+uint32_t EcgTextSource::read(float *volts, uint32_t maxFrames) {
+  uint32_t done = 0;
+  while (done < maxFrames && parseLine(volts + done * ECG_LEADS)) {
+    done++;
+  }
+  return done;
+}
+
+// ---------------------------------------------------------------- Visor
+
+void EcgPlaybackViewer::open(EcgPlaybackSource *src, EcgSweepRenderer *r, EcgPyramidReader *p) {
+  source = src;
+  renderer = r;
+  pyramid = p;
+  lastLevel = -1;
+  first = 0;
+  zoomLevel = 0;
+  lastDrawUs = 0;
+  statusText[0] = 0;
+  for (int l = 0; l < ECG_LEADS; l++) {
+    views[l].low = views[l].high = 0;
+    views[l].flags = 0;
+  }
+  renderer->begin(1, 1);
+  renderer->drawLayout();
+}
+
+void EcgPlaybackViewer::draw() {
+  uint32_t start = hal.clock->micros();
+  lastLevel = pyramidLevel();
+  float lo[ECG_LEADS], hi[ECG_LEADS];
+  measureScreen(lo, hi);
+  for (int l = 0; l < ECG_LEADS; l++) {
+    if (lo[l] <= hi[l]) {
+      ecgAutoScale(lo[l], hi[l], views[l]);
+    }
+  }
+  if (lastLevel >= 0) {
+    drawEntries(lastLevel);
+  } else {
+    drawSamples();
+  }
+  // Final del archivo antes del borde derecho: el resto queda vacío
+  renderer->padToEnd();
+  drawStatus();
+  lastDrawUs = hal.clock->micros() - start;
+}
+
+int EcgPlaybackViewer::pyramidLevel() const {
+  if (!pyramid) {
+    return -1;
+  }
+  for (int level = 0; level < ECG_PYRAMID_LEVELS; level++) {
+    if (pyramid->entryFrames(level) == (uint32_t)zoom()) {
+      return level;
+    }
+  }
+  return -1;
+}
+
+void EcgPlaybackViewer::measureScreen(float lo[ECG_LEADS], float hi[ECG_LEADS]) {
+  for (int l = 0; l < ECG_LEADS; l++) {
+    lo[l] = 1;
+    hi[l] = 0;
+  }
+  uint32_t span = (uint32_t)hal.display->width() * zoom();
+  if (pyramid) {
+    // El nivel más grueso que todavía da 16 entradas o más en la pantalla
+    int level = 0;
+    while (level + 1 < ECG_PYRAMID_LEVELS && pyramid->entryFrames(level + 1) * 16 <= span) {
+      level++;
+    }
+    uint32_t frames = pyramid->entryFrames(level);
+    uint32_t entry = first / frames, last = (first + span - 1) / frames;
+    while (entry <= last) {
+      uint32_t want = last + 1 - entry < 32 ? last + 1 - entry : 32;
+      uint32_t count = pyramid->read(level, entry, entries, want);
+      if (count == 0) {
+        break;
+      }
+      for (uint32_t i = 0; i < count; i++) {
+        for (int l = 0; l < ECG_LEADS; l++) {
+          if (entries[i].lo[l] > entries[i].hi[l]) {
+            continue;
+          }
+          float a = pyramid->toVolts(entries[i].lo[l], l), b = pyramid->toVolts(entries[i].hi[l], l);
+          if (lo[l] > hi[l]) {
+            lo[l] = a;
+            hi[l] = b;
+          } else {
+            lo[l] = a < lo[l] ? a : lo[l];
+            hi[l] = b > hi[l] ? b : hi[l];
+          }
+        }
+      }
+      entry += count;
+    }
+    return;
+  }
+  // Sin índice: una pasada más por las muestras de la pantalla
+  source->seek(first);
+  uint32_t done = 0;
+  while (done < span) {
+    uint32_t count = source->read(buffer, span - done < 64 ? span - done : 64);
+    if (count == 0) {
+      // Los huecos de la grabación no cuentan para la escala
+      uint32_t gap = source->skipGap();
+      if (gap == 0) {
+        break;
+      }
+      done += gap;
+      continue;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+      for (int l = 0; l < ECG_LEADS; l++) {
+        float v = buffer[i * ECG_LEADS + l];
+        if (lo[l] > hi[l]) {
+          lo[l] = hi[l] = v;
+        } else if (v < lo[l]) {
+          lo[l] = v;
+        } else if (v > hi[l]) {
+          hi[l] = v;
+        }
+      }
+    }
+    done += count;
+  }
+}
+
+void EcgPlaybackViewer::applyScale() {
+  for (int l = 0; l < ECG_LEADS; l++) {
+    renderer->setLeadScale(l, views[l].low, views[l].high);
+  }
+}
+
+void EcgPlaybackViewer::drawEntries(int level) {
+  // Una entrada por columna: lo que se lee depende del ancho, no del largo
+  int width = hal.display->width();
+  renderer->begin(1, 1);
+  applyScale();
+  uint32_t entry = first / pyramid->entryFrames(level);
+  int done = 0;
+  while (done < width) {
+    uint32_t want = width - done < 32 ? width - done : 32;
+    uint32_t count = pyramid->read(level, entry + done, entries, want);
+    if (count == 0) {
+      break;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+      float lo[ECG_LEADS], hi[ECG_LEADS];
+      for (int l = 0; l < ECG_LEADS; l++) {
+        lo[l] = pyramid->toVolts(entries[i].lo[l], l);
+        hi[l] = entries[i].lo[l] > entries[i].hi[l] ? lo[l] - 1 : pyramid->toVolts(entries[i].hi[l], l);
+      }
+      renderer->addColumn(lo, hi);
+    }
+    done += count;
+  }
+}
+
+void EcgPlaybackViewer::drawSamples() {
+  int width = hal.display->width();
+  int z = zoom();
+  renderer->begin(z, 1);
+  applyScale();
+  source->seek(first);
+  uint32_t wanted = (uint32_t)width * z;
+  uint32_t done = 0;
+  while (done < wanted) {
+    uint32_t want = wanted - done < 64 ? wanted - done : 64;
+    uint32_t count = source->read(buffer, want);
+    if (count == 0) {
+      // Hueco de la grabación: columnas vacías, igual que en el índice .pyr
+      uint32_t gap = source->skipGap();
+      if (gap == 0) {
+        break;
+      }
+      gap = gap < wanted - done ? gap : wanted - done;
+      renderer->addGap(gap);
+      done += gap;
+      continue;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+      EcgFrame frame;
+      frame.seq = first + done + i;
+      frame.timeUs = 0;
+      for (int l = 0; l < ECG_LEADS; l++) {
+        frame.lead[l] = buffer[i * ECG_LEADS + l];
+      }
+      renderer->addFrame(frame);
+    }
+    done += count;
+  }
+}
+
+void EcgPlaybackViewer::drawStatus() {
+  float rate = source->sampleRate() > 0 ? source->sampleRate() : 1;
+  char text[sizeof(statusText)];
+  snprintf(text, sizeof(text), "%.1f/%.1fs x%d", first / rate, source->frameCount() / rate, zoom());
+  if (strcmp(text, statusText) == 0) {
+    return;
+  }
+  strcpy(statusText, text);
+  EcgDisplay *tft = hal.display;
+  tft->fillRect(190, 6, 130, 16, ECG_BLACK);
+  tft->setTextColor(ECG_WHITE);
+  tft->setTextSize(1);
+  tft->setCursor(190, 10);
+  tft->print(text);
+}
+
+void EcgPlaybackViewer::clampPosition(int64_t wanted) {
+  uint32_t span = (uint32_t)hal.display->width() * zoom();
+  uint32_t total = source->frameCount();
+  int64_t last = total > span ? (int64_t)(total - span) : 0;
+  if (wanted > last) {
+    wanted = last;
+  }
+  first = wanted < 0 ? 0 : (uint32_t)wanted;
+}
+
+void EcgPlaybackViewer::scroll(int halfPages) {
+  int64_t step = (int64_t)(hal.display->width() / 2) * zoom();
+  clampPosition((int64_t)first + halfPages * step);
+}
+
+void EcgPlaybackViewer::cycleZoom() {
+  int width = hal.display->width();
+  int64_t center = (int64_t)first + (int64_t)width * zoom() / 2;
+  // Sin índice el zoom llega hasta 64; en cualquier caso vuelve a 1 cuando ya
+  // se veía la grabación completa
+  int levels = pyramid ? zoomLevels : rawZoomLevels;
+  if (zoomLevel + 1 >= levels || (uint32_t)width * zoom() >= source->frameCount()) {
+    zoomLevel = 0;
+  } else {
+    zoomLevel++;
+  }
+  clampPosition(center - (int64_t)width * zoom() / 2);
+}
@@ -0,0 +1,134 @@
+#ifndef ECG_PLAYBACK_H
+#define ECG_PLAYBACK_H
+
+#include <stdint.h>
+
+#include "ecg_hal.h"
+#include "ecg_memory.h"
+#include "ecg_pyramid.h"
+#include "ecg_queue.h"
+#include "ecg_record.h"
+#include "ecg_render.h"
+#include "ecg_stats.h"
+
+// Reproducción de mediciones guardadas con desplazamiento y zoom. Nada de
+// esto usa el heap: los archivos se leen en bloques a buffers de ecgArena.
+
+// Muestras de un archivo como voltios intercalados (d1, d2, d3, d1, ...)
+class EcgPlaybackSource {
+public:
+  virtual ~EcgPlaybackSource() {}
+  virtual uint32_t frameCount() = 0;
+  virtual uint32_t sampleRate() = 0;
+  virtual bool seek(uint32_t frame) = 0;
+  // Muestras contiguas desde la posición; corta antes de un hueco
+  virtual uint32_t read(float *volts, uint32_t maxFrames) = 0;
+  // Si read() cortó por un hueco, lo saltea y devuelve cuántas muestras faltan
+  virtual uint32_t skipGap() { return 0; }
+};
+
+// Archivo .ecg (acceso directo por la tabla de chunks)
+class EcgRecordSource : public EcgPlaybackSource {
+public:
+  explicit EcgRecordSource(EcgRecordReader &reader) : reader(reader), next(0) {}
+  bool open(EcgFile *file) {
+    bool ok = reader.open(file);
+    next = reader.position();
+    return ok;
+  }
+  uint32_t frameCount() { return reader.frameCount(); }
+  uint32_t sampleRate() { return reader.header().sampleRate; }
+  bool seek(uint32_t frame) {
+    next = frame;
+    return reader.seek(frame);
+  }
+  uint32_t read(float *volts, uint32_t maxFrames);
+  uint32_t skipGap();
+
+private:
+  static const uint32_t batchFrames = 64;
+  EcgRecordReader &reader;
+  uint32_t next;          // Muestra que sigue para quien lee (puede caer en un hueco)
+  int16_t raw[batchFrames * ECG_LEADS];
+};
+
+// Texto de versiones anteriores ("d1,d2,d3" por línea). Al abrir se cuentan
+// las líneas y se guarda la posición de una de cada `stride` para poder
+// saltar a cualquier muestra; si el índice se llena se duplica el paso.
+const int ECG_TEXT_INDEX_MAX = 512;
+const uint32_t ECG_TEXT_BLOCK_SIZE = 512;
+
+class EcgTextSource : public EcgPlaybackSource {
+public:
+  EcgTextSource() : file(0), index(0), block(0) { memory.data = 0; memory.phase = 0; }
+  bool open(EcgFile *file, uint32_t sampleRate);
+  uint32_t frameCount() { return lines; }
+  uint32_t sampleRate() { return rate; }
+  bool seek(uint32_t frame);
+  uint32_t read(float *volts, uint32_t maxFrames);
+
+private:
+  bool refill();
+  int nextChar();
+  bool parseLine(float v[ECG_LEADS]);
+
+  EcgFile *file;
+  uint32_t rate;
+  uint32_t lines;
+  uint32_t stride;
+  uint32_t indexCount;
+  EcgArenaSlot memory;
+  uint32_t *index;   // ECG_TEXT_INDEX_MAX posiciones en bytes de la línea i * stride
+  uint8_t *block;    // ECG_TEXT_BLOCK_SIZE bytes
+  uint32_t blockLen, blockPos;
+};
+
+// Número decimal con signo, parte fraccionaria y exponente opcionales (los
+// espacios antes se saltan); devuelve dónde terminó o NULL si no hay número
+const char *ecgParseNumber(const char *p, const char *end, float &value);
+// Parsea "d1,d2,d3" sin reservar memoria; false si la línea no tiene 3 valores
+bool ecgParseTextLine(const char *line, uint32_t len, float v[ECG_LEADS]);
+
+// Visor: dibuja una pantalla de la fuente con el renderizador del barrido.
+// Cada columna resume `zoom` muestras con su mínimo y máximo. Con el índice
+// .pyr de la grabación, los zoom desde ECG_PYRAMID_BASE leen una entrada del
+// nivel que corresponde por columna en vez de todas las muestras. La escala
+// de cada franja se ajusta al rango de la pantalla (ecgAutoScale()), que sale
+// de un nivel grueso del índice o, sin él, de una pasada por las muestras.
+class EcgPlaybackViewer {
+public:
+  static const int rawZoomLevels = 7;   // 1, 2, 4, ..., 64 muestras por columna
+  static const int zoomLevels = 12;     // Hasta 2048 con índice
+
+  void open(EcgPlaybackSource *source, EcgSweepRenderer *renderer, EcgPyramidReader *pyramid = 0);
+  void draw();
+  // Avanza (o retrocede si es negativo) `halfPages` medias pantallas
+  void scroll(int halfPages);
+  // Pasa al siguiente nivel de zoom (vuelve a 1 después del último) sin mover el centro
+  void cycleZoom();
+  uint32_t position() const { return first; }
+  int zoom() const { return 1 << zoomLevel; }
+  uint32_t lastDrawUs;
+  int lastLevel;                    // Nivel del índice usado, -1 si se leyeron muestras
+
+private:
+  void clampPosition(int64_t wanted);
+  int pyramidLevel() const;
+  void drawSamples();
+  void drawEntries(int level);
+  void drawStatus();
+  void measureScreen(float lo[ECG_LEADS], float hi[ECG_LEADS]);
+  void applyScale();
+
+  EcgPlaybackSource *source;
+  EcgSweepRenderer *renderer;
+  EcgPyramidReader *pyramid;
+  uint32_t first;                   // Primera muestra a la izquierda
+  int zoomLevel;
+  char statusText[24];              // Texto mostrado (se redibuja solo si cambia)
+  EcgLeadView views[ECG_LEADS];
+  float buffer[64 * ECG_LEADS];
+  EcgPyramidEntry entries[32];
+};
+
+#endif
@@ -0,0 +1,176 @@
+#include "ecg_profile.h"
+
+#include <stdio.h>
+#include <string.h>
+
+EcgProfiler ecgProfiler;
+
+static const char *const stageName[ECG_STAGE_COUNT] = {
+    "periodo adq", "ADC", "periodo filt", "filtros", "wavelet", "QRS", "decimacion", "estadisticas",
+    "captura", "grabacion", "barrido", "serie", "escritura SD",
+};
+
+static const char *const counterName[ECG_COUNT_TOTAL] = {
+    "Periodos perdidos", "Desbordes rawQueue", "Desbordes ecgQueue",
+    "Desbordes beatQueue", "Bytes descartados SD", "Paquetes serie descartados",
+    "Muestras de eventos pisadas",
+};
+
+static int bucketOf(uint32_t v) {
+  if (v < (1u << ECG_PROFILE_SUB_BITS)) {
+    return v;
+  }
+  int e = 31 - __builtin_clz(v);
+  int shift = e - ECG_PROFILE_SUB_BITS;
+  return ((shift + 1) << ECG_PROFILE_SUB_BITS) + ((v >> shift) & ((1 << ECG_PROFILE_SUB_BITS) - 1));
+}
+
+static uint32_t bucketTop(int b) {
+  int sub = 1 << ECG_PROFILE_SUB_BITS;
+  if (b < sub) {
+    return b;
+  }
+  int shift = b / sub - 1;
+  uint64_t low = (uint64_t)(sub + b % sub) << shift;
+  uint64_t top = low + ((uint64_t)1 << shift) - 1;
+  return top > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)top;
+}
+
+void EcgCycleHistogram::reset() {
+  count = 0;
+  minCycles = 0;
+  maxCycles = 0;
+  sumCycles = 0;
+  memset(buckets, 0, sizeof(buckets));
+}
+
+void EcgCycleHistogram::add(uint32_t cycles) {
+  if (count == 0 || cycles < minCycles) {
+    minCycles = cycles;
+  }
+  if (cycles > maxCycles) {
+    maxCycles = cycles;
+  }
+  count++;
+  sumCycles += cycles;
+  buckets[bucketOf(cycles)]++;
+}
+
+uint32_t EcgCycleHistogram::percentile(float p) const {
+  if (count == 0) {
+    return 0;
+  }
+  uint32_t rank = (uint32_t)(p * count + 0.999f);
+  if (rank < 1) {
+    rank = 1;
+  }
+  uint32_t seen = 0;
+  for (int b = 0; b < ECG_PROFILE_BUCKETS; b++) {
+    seen += buckets[b];
+    if (seen >= rank) {
+      uint32_t top = bucketTop(b);
+      return top < maxCycles ? top : maxCycles;
+    }
+  }
+  return maxCycles;
+}
+
+EcgProfiler::EcgProfiler() : enabled(ECG_PROFILE != 0), overlay(false) {
+  for (int s = 0; s < ECG_STAGE_COUNT; s++) {
+    stages[s].reset();
+    resetPending[s] = false;
+  }
+  for (int c = 0; c < ECG_COUNT_TOTAL; c++) {
+    counters[c] = 0;
+  }
+}
+
+void EcgProfiler::add(int s, uint32_t cycles) {
+  if (resetPending[s]) {
+    stages[s].reset();
+    resetPending[s] = false;
+  }
+  stages[s].add(cycles);
+}
+
+void EcgProfiler::count(int c, uint32_t n) {
+  counters[c] += n;
+}
+
+void EcgProfiler::reset() {
+  for (int s = 0; s < ECG_STAGE_COUNT; s++) {
+    resetPending[s] = true;
+  }
+  for (int c = 0; c < ECG_COUNT_TOTAL; c++) {
+    counters[c] = 0;
+  }
+}
+
+void EcgProfiler::print(EcgSerial *serial) {
+#if ECG_PROFILE
+  float perUs = hal.clock->cyclesPerUs();
+  char line[96];
+  snprintf(line, sizeof(line), "Perfil (%s, %.0f ciclos/us)\r\n", enabled ? "activo" : "pausado", perUs);
+  serial->print(line);
+  serial->print("etapa              n      min    media      p50      p99      max (us)\r\n");
+  for (int s = 0; s < ECG_STAGE_COUNT; s++) {
+    const EcgCycleHistogram &h = stages[s];
+    if (resetPending[s] || h.count == 0) {
+      continue;
+    }
+    snprintf(line, sizeof(line), "%-12s %8u %8.1f %8.1f %8.1f %8.1f %8.1f\r\n", stageName[s], (unsigned)h.count,
+             h.minCycles / perUs, (double)h.sumCycles / h.count / perUs, h.percentile(0.5f) / perUs,
+             h.percentile(0.99f) / perUs, h.maxCycles / perUs);
+    serial->print(line);
+  }
+  for (int c = 0; c < ECG_COUNT_TOTAL; c++) {
+    snprintf(line, sizeof(line), "%s: %u\r\n", counterName[c], (unsigned)counters[c]);
+    serial->print(line);
+  }
+#else
+  serial->println("Perfil no compilado (ECG_PROFILE = 0)");
+#endif
+}
+
+void EcgProfiler::drawOverlay(EcgDisplay *display) {
+  float perUs = hal.clock->cyclesPerUs();
+  const EcgCycleHistogram &acq = stages[ECG_STAGE_ACQ_PERIOD];
+  const EcgCycleHistogram &capture = stages[ECG_STAGE_CAPTURE];
+  const EcgCycleHistogram &sd = stages[ECG_STAGE_SD_WRITE];
+  uint32_t lost = counters[ECG_COUNT_MISSED_PERIODS] + counters[ECG_COUNT_RAW_OVERRUNS] +
+                  counters[ECG_COUNT_FRAME_OVERRUNS];
+  // Jitter: diferencia entre el periodo más largo y el más corto
+  uint32_t jitter = acq.count > 0 ? (uint32_t)((acq.maxCycles - acq.minCycles) / perUs) : 0;
+  char top[24], bottom[24];
+  snprintf(top, sizeof(top), "p99 c%u sd%u", (unsigned)(capture.percentile(0.99f) / perUs),
+           (unsigned)(sd.percentile(0.99f) / perUs));
+  snprintf(bottom, sizeof(bottom), "jit %u perd %u", (unsigned)jitter, (unsigned)lost);
+  display->fillRect(200, 3, 120, 22, ECG_BLACK);
+  display->setTextSize(1);
+  display->setTextColor(ECG_YELLOW);
+  display->setCursor(200, 4);
+  display->print(top);
+  display->setCursor(200, 15);
+  display->print(bottom);
+}
+
+bool EcgProfiler::command(char c) {
+  switch (c) {
+    case 'p':
+      print(hal.serial);
+      return true;
+    case 'r':
+      reset();
+      hal.serial->println("Perfil reiniciado");
+      return true;
+    case 'o':
+      overlay = !overlay;
+      return true;
+    case 'e':
+      enabled = !enabled;
+      hal.serial->println(enabled ? "Perfil activo" : "Perfil pausado");
+      return true;
+    default:
+      return false;
+  }
+}
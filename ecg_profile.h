@@ -0,0 +1,151 @@
+#ifndef ECG_PROFILE_H
+#define ECG_PROFILE_H
+
+#include <stdint.h>
+
+#include "ecg_hal.h"
+
+// Medición del camino caliente. Cada etapa del pipeline se mide en ciclos con
+// hal.clock->cycleCount() y cae en un histograma de tamaño fijo: 4 cubetas
+// por potencia de 2, así que el percentil que se informa es el borde superior
+// de su cubeta (a lo sumo un 25 % por encima del valor real). Los contadores
+// acumulan muestras y bloques descartados en cada punto donde se pierden.
+//
+// Cada etapa y cada contador tiene un solo escritor (la tarea que lo mide);
+// el informe y el reinicio se hacen desde loop() sin bloquearlo: reset()
+// solo marca las etapas y cada una se vacía en su próxima medición.
+//
+// Con ECG_PROFILE en 0 (aquí o con -DECG_PROFILE=0) las mediciones no se
+// compilan; en tiempo de ejecución se apagan con ecgProfiler.enabled.
+
+#ifndef ECG_PROFILE
+#define ECG_PROFILE 1
+#endif
+
+enum EcgProfileStage {
+  ECG_STAGE_ACQ_PERIOD,     // Periodo real entre lecturas de AcquisitionTask
+  ECG_STAGE_ADC,            // Lectura de los dos AD8232
+  ECG_STAGE_FILTER_PERIOD,  // Periodo real entre vueltas de FilterTask con trabajo
+  ECG_STAGE_FILTER,         // Banco de filtros de las tres derivaciones
+  ECG_STAGE_DENOISE,        // Limpieza por wavelets de las tres derivaciones (si está activa)
+  ECG_STAGE_QRS,            // Detector de QRS
+  ECG_STAGE_DECIMATE,       // Decimación a la grabación y al barrido de una muestra
+  ECG_STAGE_STATS,          // Estadísticas de ventana (escala y banderas) de las tres derivaciones
+  ECG_STAGE_CAPTURE,        // Una vuelta de stepEKGCapture() o stepEKGMonitor() sin la espera
+  ECG_STAGE_ENCODE,         // .ecg, .pyr y paquete serie de una muestra grabada
+  ECG_STAGE_SWEEP,          // Barrido en pantalla de una muestra (incluye el envío de la tira)
+  ECG_STAGE_SERIAL,         // Envío por el puerto serie de una vuelta
+  ECG_STAGE_SD_WRITE,       // Escritura de un bloque en la SD (StorageTask)
+  ECG_STAGE_COUNT
+};
+
+enum EcgProfileCounter {
+  ECG_COUNT_MISSED_PERIODS,   // Disparos del temporizador sin atender
+  ECG_COUNT_RAW_OVERRUNS,     // rawQueue llena (muestras perdidas)
+  ECG_COUNT_FRAME_OVERRUNS,   // ecgQueue llena (muestras perdidas)
+  ECG_COUNT_BEAT_OVERRUNS,    // beatQueue llena (latidos perdidos)
+  ECG_COUNT_SD_DROPPED,       // Bytes descartados por SD lenta
+  ECG_COUNT_SERIAL_DROPPED,   // Paquetes serie descartados
+  ECG_COUNT_EVENT_LOST,       // Muestras del modo monitor pisadas antes de llegar a la SD
+  ECG_COUNT_TOTAL
+};
+
+const int ECG_PROFILE_SUB_BITS = 2;
+const int ECG_PROFILE_BUCKETS = (1 << ECG_PROFILE_SUB_BITS) * (32 - ECG_PROFILE_SUB_BITS + 1);
+
+struct EcgCycleHistogram {
+  uint32_t count;
+  uint32_t minCycles;
+  uint32_t maxCycles;
+  uint64_t sumCycles;
+  uint32_t buckets[ECG_PROFILE_BUCKETS];
+
+  void reset();
+  void add(uint32_t cycles);
+  // Borde superior de la cubeta donde cae el percentil p (0..1)
+  uint32_t percentile(float p) const;
+};
+
+class EcgProfiler {
+public:
+  EcgProfiler();
+  void add(int stage, uint32_t cycles);
+  void count(int counter, uint32_t n = 1);
+  // Vacía histogramas y contadores (cada etapa en su próxima medición)
+  void reset();
+
+  // Tabla por el puerto serie: n, mín, media, p50, p99 y máx en us
+  void print(EcgSerial *serial);
+  // Dos líneas en la parte derecha de la barra de estado del barrido
+  void drawOverlay(EcgDisplay *display);
+  // Comandos de una letra por el puerto serie: p informe, r reinicio,
+  // o overlay, e encender/apagar. Devuelve false si la letra no es de aquí.
+  bool command(char c);
+
+  const EcgCycleHistogram &stage(int s) const { return stages[s]; }
+  uint32_t counter(int c) const { return counters[c]; }
+
+  volatile bool enabled;
+  bool overlay;
+
+private:
+  EcgCycleHistogram stages[ECG_STAGE_COUNT];
+  volatile bool resetPending[ECG_STAGE_COUNT];
+  volatile uint32_t counters[ECG_COUNT_TOTAL];
+};
+
+extern EcgProfiler ecgProfiler;
+
+// Mide desde la construcción hasta el final del bloque
+class EcgProfileScope {
+public:
+#if ECG_PROFILE
+  explicit EcgProfileScope(int stage) : stage(stage), start(ecgProfiler.enabled ? hal.clock->cycleCount() : 0) {}
+  ~EcgProfileScope() {
+    if (ecgProfiler.enabled) {
+      ecgProfiler.add(stage, hal.clock->cycleCount() - start);
+    }
+  }
+
+private:
+  int stage;
+  uint32_t start;
+#else
+  explicit EcgProfileScope(int) {}
+#endif
+};
+
+// Periodo entre llamadas sucesivas (la primera solo toma la referencia)
+class EcgProfilePeriod {
+public:
+  EcgProfilePeriod(int stage) : stage(stage), last(0), started(false) {}
+  void mark() {
+#if ECG_PROFILE
+    if (!ecgProfiler.enabled) {
+      started = false;
+      return;
+    }
+    uint32_t now = hal.clock->cycleCount();
+    if (started) {
+      ecgProfiler.add(stage, now - last);
+    }
+    last = now;
+    started = true;
+#endif
+  }
+
+private:
+  int stage;
+  uint32_t last;
+  bool started;
+};
+
+inline void ecgProfileCount(int counter, uint32_t n = 1) {
+#if ECG_PROFILE
+  if (n > 0) {
+    ecgProfiler.count(counter, n);
+  }
+#endif
+}
+
+#endif
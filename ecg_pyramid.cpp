@@ -0,0 +1,248 @@
+#include "ecg_pyramid.h"
+
+#include <string.h>
+
+static void clearEntry(EcgPyramidEntry &e) {
+  for (int l = 0; l < ECG_LEADS; l++) {
+    e.lo[l] = 32767;
+    e.hi[l] = -32768;
+  }
+}
+
+static void mergeEntry(EcgPyramidEntry &into, const EcgPyramidEntry &e) {
+  for (int l = 0; l < ECG_LEADS; l++) {
+    if (e.lo[l] < into.lo[l]) {
+      into.lo[l] = e.lo[l];
+    }
+    if (e.hi[l] > into.hi[l]) {
+      into.hi[l] = e.hi[l];
+    }
+  }
+}
+
+void ecgPyramidPath(const char *recordPath, char *out, size_t size) {
+  strncpy(out, recordPath, size - 5);
+  out[size - 5] = 0;
+  char *dot = strrchr(out, '.');
+  char *slash = strrchr(out, '/');
+  if (dot && (!slash || dot > slash)) {
+    *dot = 0;
+  }
+  strcat(out, ".pyr");
+}
+
+// ---------------------------------------------------------------- Escritura
+
+void EcgPyramidBuilder::begin(const EcgRecordHeader &record, EcgRecordSink sink, void *ctx) {
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, "ECGP", 4);
+  hdr.version = ECG_PYRAMID_VERSION;
+  hdr.pageSize = ECG_PYRAMID_PAGE_SIZE;
+  hdr.leadCount = ECG_LEADS;
+  hdr.levelCount = ECG_PYRAMID_LEVELS;
+  hdr.baseFrames = ECG_PYRAMID_BASE;
+  hdr.entriesPerPage = ECG_PYRAMID_ENTRIES_PER_PAGE;
+  hdr.sampleRate = record.sampleRate;
+  hdr.complete = 1;
+  for (int i = 0; i < ECG_RECORD_MAX_LEADS; i++) {
+    hdr.gain[i] = record.gain[i];
+    hdr.offset[i] = record.offset[i];
+  }
+  this->sink = sink;
+  sinkCtx = ctx;
+  frames = 0;
+  for (int k = 0; k < ECG_PYRAMID_LEVELS; k++) {
+    clearEntry(acc[k]);
+    accCount[k] = 0;
+    pagesEmitted[k] = 0;
+  }
+
+  // La cabecera ocupa una página y se reescribe al final con los totales
+  memset(pages[0], 0, ECG_PYRAMID_PAGE_SIZE);
+  memcpy(pages[0], &hdr, sizeof(hdr));
+  if (!sink(pages[0], ECG_PYRAMID_PAGE_SIZE, sinkCtx)) {
+    hdr.complete = 0;
+  }
+  memset(pages, 0, sizeof(pages));
+  finishing = false;
+}
+
+void EcgPyramidBuilder::addFrame(const float volts[ECG_LEADS]) {
+  EcgPyramidEntry &e = acc[0];
+  for (int l = 0; l < ECG_LEADS; l++) {
+    int16_t raw = ecgQuantize(volts[l], hdr.gain[l], hdr.offset[l]);
+    if (raw < e.lo[l]) {
+      e.lo[l] = raw;
+    }
+    if (raw > e.hi[l]) {
+      e.hi[l] = raw;
+    }
+  }
+  frames++;
+  if (++accCount[0] == ECG_PYRAMID_BASE) {
+    addEntry(0, e);
+    clearEntry(e);
+    accCount[0] = 0;
+  }
+}
+
+void EcgPyramidBuilder::skipFrames(uint32_t count) {
+  // Las muestras que faltan ocupan lugar pero no cambian mínimos ni máximos
+  while (count-- > 0) {
+    frames++;
+    if (++accCount[0] == ECG_PYRAMID_BASE) {
+      addEntry(0, acc[0]);
+      clearEntry(acc[0]);
+      accCount[0] = 0;
+    }
+  }
+}
+
+void EcgPyramidBuilder::addEntry(int level, const EcgPyramidEntry &entry) {
+  EcgPyramidPageHeader *ph = (EcgPyramidPageHeader *)pages[level];
+  EcgPyramidEntry *entries = (EcgPyramidEntry *)(pages[level] + sizeof(EcgPyramidPageHeader));
+  entries[ph->entries] = entry;
+  ph->entries++;
+  // En finish() las páginas se escriben todas juntas, en orden de nivel
+  if (ph->entries == ECG_PYRAMID_ENTRIES_PER_PAGE && !finishing) {
+    emitPage(level);
+  }
+  // Cada dos entradas se completa una del nivel siguiente
+  if (level + 1 < ECG_PYRAMID_LEVELS) {
+    mergeEntry(acc[level + 1], entry);
+    if (++accCount[level + 1] == 2) {
+      addEntry(level + 1, acc[level + 1]);
+      clearEntry(acc[level + 1]);
+      accCount[level + 1] = 0;
+    }
+  }
+}
+
+void EcgPyramidBuilder::emitPage(int level) {
+  EcgPyramidPageHeader *ph = (EcgPyramidPageHeader *)pages[level];
+  ph->magic = ECG_PYRAMID_PAGE_MAGIC;
+  ph->level = level;
+  ph->firstEntry = pagesEmitted[level] * ECG_PYRAMID_ENTRIES_PER_PAGE;
+  uint32_t used = sizeof(EcgPyramidPageHeader) + ph->entries * sizeof(EcgPyramidEntry);
+  memset(pages[level] + used, 0, ECG_PYRAMID_PAGE_SIZE - used);
+  // Una página perdida corre la posición de las siguientes: el índice queda inválido
+  if (!sink(pages[level], ECG_PYRAMID_PAGE_SIZE, sinkCtx)) {
+    hdr.complete = 0;
+  }
+  pagesEmitted[level]++;
+  ph->entries = 0;
+}
+
+void EcgPyramidBuilder::finish() {
+  // Entradas a medio llenar, de abajo hacia arriba para que suban a los
+  // niveles siguientes; cada nivel recibe a lo sumo una entrada más
+  finishing = true;
+  for (int k = 0; k < ECG_PYRAMID_LEVELS; k++) {
+    if (accCount[k] > 0) {
+      EcgPyramidEntry e = acc[k];
+      clearEntry(acc[k]);
+      accCount[k] = 0;
+      addEntry(k, e);
+    }
+  }
+  for (int k = 0; k < ECG_PYRAMID_LEVELS; k++) {
+    if (((EcgPyramidPageHeader *)pages[k])->entries > 0) {
+      emitPage(k);
+    }
+  }
+  hdr.frameCount = frames;
+}
+
+// ---------------------------------------------------------------- Lectura
+
+bool ecgPyramidHeaderValid(const EcgPyramidHeader &hdr) {
+  return memcmp(hdr.magic, "ECGP", 4) == 0 && hdr.version == ECG_PYRAMID_VERSION &&
+         hdr.pageSize == ECG_PYRAMID_PAGE_SIZE && hdr.leadCount == ECG_LEADS &&
+         hdr.levelCount == ECG_PYRAMID_LEVELS && hdr.baseFrames == ECG_PYRAMID_BASE &&
+         hdr.entriesPerPage == ECG_PYRAMID_ENTRIES_PER_PAGE && hdr.complete;
+}
+
+uint32_t ecgPyramidEntryCount(const EcgPyramidHeader &hdr, int level) {
+  uint32_t size = hdr.baseFrames << level;
+  return (hdr.frameCount + size - 1) / size;
+}
+
+uint32_t ecgPyramidPageOffset(const EcgPyramidHeader &hdr, int level, uint32_t p) {
+  // Una página llena del nivel l se escribe al llegar a un múltiplo de su
+  // tramo; a igual muestra se escriben primero los niveles bajos
+  uint32_t index = 0;
+  uint32_t full = hdr.frameCount / (hdr.entriesPerPage * (hdr.baseFrames << level));
+  if (p < full) {
+    uint32_t at = (p + 1) * hdr.entriesPerPage * (hdr.baseFrames << level);
+    for (int l = 0; l < hdr.levelCount; l++) {
+      uint32_t span = hdr.entriesPerPage * (hdr.baseFrames << l);
+      index += l < level ? at / span : (l == level ? p : (at - 1) / span);
+    }
+  } else {
+    // Página incompleta: después de todas las llenas, en orden de nivel
+    for (int l = 0; l < hdr.levelCount; l++) {
+      uint32_t lfull = hdr.frameCount / (hdr.entriesPerPage * (hdr.baseFrames << l));
+      index += lfull;
+      if (l < level && ecgPyramidEntryCount(hdr, l) > lfull * hdr.entriesPerPage) {
+        index++;
+      }
+    }
+  }
+  return hdr.pageSize + index * hdr.pageSize;
+}
+
+bool EcgPyramidReader::open(EcgFile *f) {
+  file = f;
+  pageLevel = -1;
+  pageIndex = 0;
+  if (!file || file->read((uint8_t *)&hdr, sizeof(hdr)) != sizeof(hdr)) {
+    return false;
+  }
+  return ecgPyramidHeaderValid(hdr);
+}
+
+uint32_t EcgPyramidReader::entryCount(int level) const {
+  return ecgPyramidEntryCount(hdr, level);
+}
+
+bool EcgPyramidReader::loadPage(int level, uint32_t p) {
+  if (level == pageLevel && p == pageIndex) {
+    return true;
+  }
+  pageLevel = -1;
+  if (!file->seek(ecgPyramidPageOffset(hdr, level, p)) || file->read(page, hdr.pageSize) != hdr.pageSize) {
+    return false;
+  }
+  const EcgPyramidPageHeader *ph = (const EcgPyramidPageHeader *)page;
+  if (ph->magic != ECG_PYRAMID_PAGE_MAGIC || ph->level != level ||
+      ph->firstEntry != p * hdr.entriesPerPage) {
+    return false;
+  }
+  pageLevel = level;
+  pageIndex = p;
+  return true;
+}
+
+uint32_t EcgPyramidReader::read(int level, uint32_t first, EcgPyramidEntry *out, uint32_t maxEntries) {
+  if (level < 0 || level >= hdr.levelCount) {
+    return 0;
+  }
+  uint32_t total = entryCount(level);
+  uint32_t done = 0;
+  while (done < maxEntries && first + done < total) {
+    uint32_t e = first + done;
+    if (!loadPage(level, e / hdr.entriesPerPage)) {
+      break;
+    }
+    const EcgPyramidPageHeader *ph = (const EcgPyramidPageHeader *)page;
+    const EcgPyramidEntry *entries = (const EcgPyramidEntry *)(page + sizeof(EcgPyramidPageHeader));
+    uint32_t i = e % hdr.entriesPerPage;
+    while (i < ph->entries && done < maxEntries) {
+      out[done++] = entries[i++];
+    }
+    if (i < hdr.entriesPerPage) {
+      break;  // Última página
+    }
+  }
+  return done;
+}
@@ -0,0 +1,120 @@
+#ifndef ECG_PYRAMID_H
+#define ECG_PYRAMID_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ecg_hal.h"
+#include "ecg_queue.h"
+#include "ecg_record.h"
+
+// Índice de envolventes (.pyr) que acompaña a cada grabación .ecg. Cada nivel
+// guarda el mínimo y el máximo de cada derivación en bloques de
+// ECG_PYRAMID_BASE << nivel muestras, así que una pantalla con cualquier zoom
+// se dibuja leyendo tantas entradas como columnas tiene.
+//
+//   [cabecera, 512 bytes] [página] [página] ...
+//
+// Se arma mientras se graba: cada nivel llena una página de 512 bytes en RAM y
+// la escribe al completarla, de modo que las páginas de todos los niveles
+// quedan intercaladas en el orden en que se completaron. Ese orden solo
+// depende de la cantidad de muestras, y con frameCount se calcula dónde está
+// cualquier página sin guardar una tabla. Las páginas incompletas se escriben
+// al final, de nivel 0 hacia arriba.
+
+const uint32_t ECG_PYRAMID_VERSION = 1;
+const uint32_t ECG_PYRAMID_PAGE_SIZE = 512;
+// El índice empieza donde el visor deja de leer muestras (zoom 64): los
+// niveles más finos costaban más SD que la grabación y no se usaban
+const uint32_t ECG_PYRAMID_BASE = 128;     // Muestras por entrada del nivel 0
+const int ECG_PYRAMID_LEVELS = 5;          // 128, 256, ..., 2048 muestras por entrada
+const uint16_t ECG_PYRAMID_PAGE_MAGIC = 0x4750;  // "PG"
+
+struct EcgPyramidHeader {
+  char magic[4];            // "ECGP"
+  uint16_t version;
+  uint16_t pageSize;
+  uint16_t leadCount;
+  uint16_t levelCount;
+  uint32_t baseFrames;      // Muestras por entrada del nivel 0
+  uint32_t entriesPerPage;
+  uint32_t sampleRate;      // Hz, el de la grabación
+  uint32_t frameCount;      // Muestras cubiertas
+  uint32_t complete;        // 0 si faltan páginas (SD lenta o grabación cortada)
+  float gain[ECG_RECORD_MAX_LEADS];    // Misma escala que la grabación
+  float offset[ECG_RECORD_MAX_LEADS];
+};
+
+// Mínimo y máximo en cuentas; lo > hi marca un hueco sin muestras
+struct EcgPyramidEntry {
+  int16_t lo[ECG_LEADS];
+  int16_t hi[ECG_LEADS];
+};
+
+struct EcgPyramidPageHeader {
+  uint16_t magic;
+  uint8_t level;
+  uint8_t entries;
+  uint32_t firstEntry;
+};
+
+const uint32_t ECG_PYRAMID_ENTRIES_PER_PAGE =
+    (ECG_PYRAMID_PAGE_SIZE - sizeof(EcgPyramidPageHeader)) / sizeof(EcgPyramidEntry);
+
+// Nombre del índice: el de la grabación con extensión .pyr
+void ecgPyramidPath(const char *recordPath, char *out, size_t size);
+
+// Cabecera de un índice completo que este código sabe leer
+bool ecgPyramidHeaderValid(const EcgPyramidHeader &hdr);
+// Entradas del nivel (la última puede cubrir menos muestras)
+uint32_t ecgPyramidEntryCount(const EcgPyramidHeader &hdr, int level);
+// Posición en el archivo de la página `page` del nivel, por el orden de escritura
+uint32_t ecgPyramidPageOffset(const EcgPyramidHeader &hdr, int level, uint32_t page);
+
+class EcgPyramidBuilder {
+public:
+  // Toma la frecuencia y la escala de la cabecera del codificador
+  void begin(const EcgRecordHeader &record, EcgRecordSink sink, void *ctx);
+  void addFrame(const float volts[ECG_LEADS]);
+  void skipFrames(uint32_t count);
+  void finish();
+  const EcgPyramidHeader &header() const { return hdr; }
+
+private:
+  void addEntry(int level, const EcgPyramidEntry &entry);
+  void emitPage(int level);
+
+  EcgPyramidHeader hdr;
+  EcgRecordSink sink;
+  void *sinkCtx;
+  uint32_t frames;
+  bool finishing;
+  EcgPyramidEntry acc[ECG_PYRAMID_LEVELS];   // Entrada en curso de cada nivel
+  uint32_t accCount[ECG_PYRAMID_LEVELS];
+  uint32_t pagesEmitted[ECG_PYRAMID_LEVELS];
+  uint8_t pages[ECG_PYRAMID_LEVELS][ECG_PYRAMID_PAGE_SIZE];
+};
+
+class EcgPyramidReader {
+public:
+  EcgPyramidReader() : file(0) {}
+  // false si el archivo no es un índice completo
+  bool open(EcgFile *file);
+  const EcgPyramidHeader &header() const { return hdr; }
+  uint32_t entryFrames(int level) const { return hdr.baseFrames << level; }
+  uint32_t entryCount(int level) const;
+  // Lee hasta maxEntries entradas del nivel desde `first`; devuelve cuántas leyó
+  uint32_t read(int level, uint32_t first, EcgPyramidEntry *out, uint32_t maxEntries);
+  float toVolts(int16_t raw, int lead) const { return raw * hdr.gain[lead] + hdr.offset[lead]; }
+
+private:
+  bool loadPage(int level, uint32_t page);
+
+  EcgFile *file;
+  EcgPyramidHeader hdr;
+  int pageLevel;
+  uint32_t pageIndex;
+  uint8_t page[ECG_PYRAMID_PAGE_SIZE];
+};
+
+#endif
@@ -0,0 +1,193 @@
+#include "ecg_qrs.h"
+
+#include <math.h>
+#include <string.h>
+
+void EcgQrsDetector::begin(float sampleRate) {
+  fs = sampleRate;
+  n = 0;
+  highPass.setCoeffs(designHighPass(5, fs));
+  highPass.reset();
+  lowPass.setCoeffs(designSecondOrderLPF(15, 1.0 / fs));
+  lowPass.reset();
+  memset(d, 0, sizeof(d));
+  memset(window, 0, sizeof(window));
+  memset(input, 0, sizeof(input));
+  windowLen = (int)lroundf(0.150f * fs);
+  // Deja espacio en el buffer para el retardo del pasa banda al ubicar el pico R
+  const int maxLen = ECG_QRS_MAX_WINDOW * 3 / 4;
+  windowLen = windowLen < 1 ? 1 : (windowLen > maxLen ? maxLen : windowLen);
+  windowSum = 0;
+  prevMwi = 0;
+  rising = false;
+  riseSlope = 0;
+  rSpan = windowLen + (uint32_t)(0.050f * fs);
+  if (rSpan > ECG_QRS_MAX_WINDOW - 2) {
+    rSpan = ECG_QRS_MAX_WINDOW - 2;
+  }
+  rHead = 0;
+  rCount = 0;
+
+  learnSamples = (uint32_t)(2 * fs);
+  learnMax = 0;
+  learnSum = 0;
+  spki = npki = thr1 = thr2 = 0;
+
+  refractory = (uint32_t)(0.200f * fs);
+  tWaveWindow = (uint32_t)(0.360f * fs);
+  haveBeat = false;
+  lastQrs = 0;
+  rPeak = 0;
+  lastSlope = 0;
+  sbPeak = 0;
+  sbSlope = 0;
+  sbIndex = 0;
+  sbR = 0;
+
+  memset(rr, 0, sizeof(rr));
+  rrSum = 0;
+  rrCount = 0;
+  rrNext = 0;
+  irregular = false;
+}
+
+bool EcgQrsDetector::process(float x) {
+  // Los picos de la integral se ven una muestra tarde: el máximo deslizante va
+  // hasta la muestra anterior
+  if (n > 0) {
+    trackR(n - 1);
+  }
+  input[n % ECG_QRS_MAX_WINDOW] = x;
+
+  // Pasa banda 5-15 Hz y derivada de 5 puntos
+  float bp = lowPass.step(highPass.step(x));
+  float deriv = (2 * bp + d[0] - d[2] - 2 * d[3]) * 0.125f;
+  d[3] = d[2];
+  d[2] = d[1];
+  d[1] = d[0];
+  d[0] = bp;
+
+  // Cuadrado e integración en ventana móvil
+  float sq = deriv * deriv;
+  int pos = n % windowLen;
+  windowSum += sq - window[pos];
+  window[pos] = sq;
+  if (windowSum < 0) {
+    windowSum = 0;  // Error de redondeo acumulado
+  }
+  float mwi = windowSum / windowLen;
+
+  bool beat = false;
+  if (n < learnSamples) {
+    // Aprendizaje: umbrales iniciales con el máximo y la media de los primeros 2 s
+    learnMax = fmaxf(learnMax, mwi);
+    learnSum += mwi;
+    if (n + 1 == learnSamples) {
+      spki = learnMax / 3;
+      npki = learnSum / learnSamples / 2;
+      updateThresholds();
+    }
+  } else if (mwi > prevMwi) {
+    if (!rising) {
+      rising = true;
+      riseSlope = 0;
+    }
+    riseSlope = fmaxf(riseSlope, fabsf(deriv));
+  } else if (rising && mwi < prevMwi) {
+    // Pico local de la integral en la muestra anterior
+    rising = false;
+    uint32_t index = n - 1;
+    float peak = prevMwi;
+    if (!haveBeat || index - lastQrs >= refractory) {
+      bool tWave = haveBeat && index - lastQrs < tWaveWindow && riseSlope < 0.5f * lastSlope;
+      if (peak > thr1 && !tWave) {
+        acceptBeat(peak, index, riseSlope, rIndex[rHead], false);
+        beat = true;
+      } else {
+        npki = 0.125f * peak + 0.875f * npki;
+        updateThresholds();
+        // Las ondas T no son candidatas para la búsqueda hacia atrás
+        if (!tWave && peak > sbPeak) {
+          sbPeak = peak;
+          sbIndex = index;
+          sbSlope = riseSlope;
+          sbR = rIndex[rHead];
+        }
+      }
+    }
+  }
+  prevMwi = mwi;
+
+  // Búsqueda hacia atrás: 1.66 RR sin latido, se toma el mayor pico sobre thr2
+  if (!beat && haveBeat && rrCount > 0 && sbPeak > thr2 && n - lastQrs > 1.66f * rrAverage()) {
+    acceptBeat(sbPeak, sbIndex, sbSlope, sbR, true);
+    beat = true;
+  }
+  n++;
+  return beat;
+}
+
+void EcgQrsDetector::acceptBeat(float peak, uint32_t index, float slope, uint32_t r, bool searchBack) {
+  if (searchBack) {
+    spki = 0.25f * peak + 0.75f * spki;
+  } else {
+    spki = 0.125f * peak + 0.875f * spki;
+  }
+  if (haveBeat) {
+    uint32_t interval = index - lastQrs;
+    float average = rrAverage();
+    irregular = rrCount > 0 && (interval < 0.92f * average || interval > 1.16f * average);
+    // Las pausas largas (lead-off, artefactos) no entran al promedio
+    if (interval <= 2 * fs) {
+      if (rrCount == ECG_QRS_RR_HISTORY) {
+        rrSum -= rr[rrNext];
+      } else {
+        rrCount++;
+      }
+      rr[rrNext] = interval;
+      rrSum += interval;
+      rrNext = (rrNext + 1) % ECG_QRS_RR_HISTORY;
+    }
+  }
+  haveBeat = true;
+  lastQrs = index;
+  lastSlope = slope;
+  rPeak = r;
+  sbPeak = 0;
+  updateThresholds();
+}
+
+void EcgQrsDetector::updateThresholds() {
+  thr1 = npki + 0.25f * (spki - npki);
+  thr2 = 0.5f * thr1;
+  if (irregular) {
+    thr1 *= 0.5f;
+    thr2 *= 0.5f;
+  }
+}
+
+// El pico R es la muestra de mayor amplitud de la entrada entre el inicio de
+// la ventana de integración (más el retardo del pasa banda) y el pico de la
+// integral. Se agrega `index` al máximo deslizante: salen del final los que ya
+// no pueden ser máximo (ante empates queda el más antiguo) y del principio los
+// que quedaron fuera de la ventana.
+void EcgQrsDetector::trackR(uint32_t index) {
+  float v = fabsf(input[index % ECG_QRS_MAX_WINDOW]);
+  while (rCount > 0 && fabsf(input[rIndex[(rHead + rCount - 1) % ECG_QRS_MAX_WINDOW] % ECG_QRS_MAX_WINDOW]) < v) {
+    rCount--;
+  }
+  rIndex[(rHead + rCount) % ECG_QRS_MAX_WINDOW] = index;
+  rCount++;
+  while (index > rSpan && rIndex[rHead] < index - rSpan) {
+    rHead = (rHead + 1) % ECG_QRS_MAX_WINDOW;
+    rCount--;
+  }
+}
+
+float EcgQrsDetector::heartRate() const {
+  // Sin latidos en 3 s (o sin promedio aún) no hay frecuencia que mostrar
+  if (rrCount == 0 || n - lastQrs > 3 * fs) {
+    return 0;
+  }
+  return 60.0f * fs / rrAverage();
+}
@@ -0,0 +1,89 @@
+#ifndef ECG_QRS_H
+#define ECG_QRS_H
+
+#include <stdint.h>
+
+#include "ecg_filter.h"
+#include "ecg_queue.h"
+
+// Detector de QRS de Pan-Tompkins en streaming, una muestra a la vez:
+//   pasa banda 5-15 Hz -> derivada de 5 puntos -> cuadrado ->
+//   integración en ventana móvil de 150 ms -> picos con umbrales adaptivos.
+// Incluye periodo refractario de 200 ms, descarte de ondas T por pendiente
+// y búsqueda hacia atrás cuando pasa 1.66 RR sin latido. El trabajo por
+// muestra es constante (amortizado): el pico R en la señal de entrada se sigue
+// con un máximo deslizante, así que ni los latidos ni los picos de ruido que
+// quedan como candidatos para la búsqueda hacia atrás recorren el buffer.
+
+const int ECG_QRS_MAX_WINDOW = 256;   // Muestras guardadas (150 ms de ventana + retardo)
+const int ECG_QRS_RR_HISTORY = 8;
+
+class EcgQrsDetector {
+public:
+  void begin(float sampleRate);
+  // Procesa una muestra (señal ya centrada); devuelve true cuando confirma un
+  // latido, cuyo pico R queda en lastPeak()
+  bool process(float x);
+  // Índice (desde begin) de la muestra del último pico R
+  uint32_t lastPeak() const { return rPeak; }
+  // Muestras procesadas desde begin
+  uint32_t sampleCount() const { return n; }
+  // Intervalo RR promedio de los últimos latidos, en muestras (0 si aún no hay)
+  float rrAverage() const { return rrCount > 0 ? (float)rrSum / rrCount : 0; }
+  float heartRate() const;
+
+private:
+  void acceptBeat(float peak, uint32_t index, float slope, uint32_t r, bool searchBack);
+  void updateThresholds();
+  void trackR(uint32_t index);
+
+  float fs;
+  uint32_t n;
+  EcgBiquadF32 highPass, lowPass;
+  float d[4];                    // Historia de la derivada
+  float window[ECG_QRS_MAX_WINDOW];
+  float input[ECG_QRS_MAX_WINDOW];
+  int windowLen;
+  float windowSum;
+  float prevMwi;
+  bool rising;
+  float riseSlope;              // Mayor |derivada| mientras sube la integral
+
+  // Máximo deslizante de |entrada| desde el inicio de la ventana de integración
+  // (más el retardo del pasa banda): índices con |entrada| decreciente, el
+  // primero es el pico R de un pico de la integral en la última muestra agregada
+  uint32_t rSpan;
+  uint32_t rIndex[ECG_QRS_MAX_WINDOW];
+  int rHead, rCount;
+
+  // Aprendizaje inicial (2 s) y umbrales
+  uint32_t learnSamples;
+  float learnMax, learnSum;
+  float spki, npki, thr1, thr2;
+
+  uint32_t refractory, tWaveWindow;
+  bool haveBeat;
+  uint32_t lastQrs;              // Índice del pico de la integral del último latido
+  uint32_t rPeak;
+  float lastSlope;
+
+  // Candidato para la búsqueda hacia atrás: mayor pico de ruido desde el último
+  // latido, con su pico R ya ubicado (cuando se acepta, su ventana ya no está en input)
+  float sbPeak, sbSlope;
+  uint32_t sbIndex, sbR;
+
+  uint32_t rr[ECG_QRS_RR_HISTORY];
+  uint32_t rrSum;
+  int rrCount, rrNext;
+  bool irregular;                // Último RR fuera del 92-116 % del promedio: umbrales a la mitad
+};
+
+// Latido detectado en FilterTask para el lazo de captura
+struct EcgBeat {
+  uint32_t seq;        // frame.seq del pico R
+  float heartRate;     // BPM con el RR promedio del detector
+};
+
+typedef SpscQueue<EcgBeat, 16> EcgBeatQueue;
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef ECG_QUEUE_H
+#define ECG_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// Número de derivaciones que se adquieren en cada muestra
+const int ECG_LEADS = 3;
+
+// Para qué decimó FilterTask una muestra de ecgQueue (ecg_decimate.h)
+const uint8_t ECG_FRAME_STORE = 1;     // Grabación, flujo serie y eventos (storageRate)
+const uint8_t ECG_FRAME_DISPLAY = 2;   // Barrido (displayRate)
+
+// Una muestra de las 3 derivaciones con su marca de tiempo
+struct EcgFrame {
+  uint32_t seq;            // Número de muestra desde que arrancó la adquisición
+  uint32_t timeUs;         // micros() en el momento de la lectura
+  float lead[ECG_LEADS];   // Derivación 1, 2 y 3 ya filtradas
+  uint8_t use;             // ECG_FRAME_STORE y/o ECG_FRAME_DISPLAY
+};
+
+// Lectura cruda de los dos AD8232 (la derivación 3 se calcula al filtrar)
+struct EcgRawSample {
+  uint32_t seq;
+  uint32_t timeUs;
+  float volts[2];
+};
+
+// Cola circular sin bloqueos para un solo productor y un solo consumidor.
+// El productor solo escribe head, el consumidor solo escribe tail.
+// Si la cola está llena la muestra nueva se descarta y se cuenta como overrun.
+template <typename T, uint32_t N>
+class SpscQueue {
+  static_assert((N & (N - 1)) == 0, "N debe ser potencia de 2");
+
+public:
+  SpscQueue() : head(0), tail(0), overrunCount(0) {}
+
+  // Lado del productor
+  bool push(const T &item) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= N) {
+      overrunCount.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    buffer[h & (N - 1)] = item;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Lado del consumidor: copia hasta maxItems elementos y devuelve cuántos copió
+  uint32_t popBatch(T *out, uint32_t maxItems) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    uint32_t available = head.load(std::memory_order_acquire) - t;
+    uint32_t count = available < maxItems ? available : maxItems;
+    for (uint32_t i = 0; i < count; i++) {
+      out[i] = buffer[(t + i) & (N - 1)];
+    }
+    tail.store(t + count, std::memory_order_release);
+    return count;
+  }
+
+  // Lado del consumidor: descarta todo lo pendiente (p. ej. al iniciar una medición)
+  void clear() {
+    tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+  }
+
+  uint32_t size() const {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+  }
+
+  uint32_t capacity() const { return N; }
+
+  // Devuelve las muestras perdidas desde la última llamada y reinicia el contador
+  uint32_t takeOverruns() {
+    return overrunCount.exchange(0, std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<uint32_t> head;
+  std::atomic<uint32_t> tail;
+  std::atomic<uint32_t> overrunCount;
+  T buffer[N];
+};
+
+// Cola entre AcquisitionTask y FilterTask: 64 ms a 1 kHz
+typedef SpscQueue<EcgRawSample, 64> EcgRawQueue;
+
+// Cola entre FilterTask y el lazo de captura: 256 muestras ya decimadas,
+// 1 s con la grabación y el barrido a 250 Hz
+typedef SpscQueue<EcgFrame, 256> EcgFrameQueue;
+
+#endif
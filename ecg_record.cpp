@@ -0,0 +1,312 @@
+#include "ecg_record.h"
+
+#include <math.h>
+#include <string.h>
+
+// Escala por defecto: 0.1 mV por cuenta (+-3.27 V). El pasa altos del banco de
+// filtros deja las tres derivaciones centradas en 0.
+static const float defaultGain = 0.0001f;
+static const float defaultOffset[ECG_RECORD_MAX_LEADS] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+void EcgRecordEncoder::begin(uint32_t sampleRate, uint32_t startMillis, EcgRecordSink sink, void *ctx,
+                             uint8_t codec) {
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, "ECGB", 4);
+  hdr.version = ECG_RECORD_VERSION;
+  hdr.headerSize = ECG_RECORD_HEADER_SIZE;
+  hdr.sampleRate = sampleRate;
+  hdr.leadCount = ECG_LEADS;
+  hdr.chunkSize = ECG_RECORD_CHUNK_SIZE;
+  for (int i = 0; i < ECG_RECORD_MAX_LEADS; i++) {
+    hdr.gain[i] = defaultGain;
+    hdr.offset[i] = defaultOffset[i];
+  }
+  hdr.startMillis = startMillis;
+  hdr.tableStride = 1;
+  this->sink = sink;
+  sinkCtx = ctx;
+  nextFrame = 0;
+  chunkFrames = 0;
+  chunkFirstFrame = 0;
+  this->codec = codec;
+  pendingFrames = 0;
+
+  // La cabecera se escribe ahora y se vuelve a escribir completa al final
+  memset(chunk, 0, ECG_RECORD_HEADER_SIZE);
+  memcpy(chunk, &hdr, sizeof(hdr));
+  sink(chunk, ECG_RECORD_HEADER_SIZE, sinkCtx);
+  rice.begin(chunk + sizeof(EcgChunkHeader), ECG_CHUNK_PAYLOAD_MAX);
+}
+
+void EcgRecordEncoder::addFrame(const float volts[ECG_LEADS]) {
+  if (chunkFrames == 0 && pendingFrames == 0) {
+    chunkFirstFrame = nextFrame;
+  }
+  nextFrame++;
+  if (codec == ECG_CODEC_RICE) {
+    int16_t *samples = pending + pendingFrames * ECG_LEADS;
+    for (int i = 0; i < ECG_LEADS; i++) {
+      samples[i] = ecgQuantize(volts[i], hdr.gain[i], hdr.offset[i]);
+    }
+    if (++pendingFrames == (uint32_t)ECG_RICE_PARTITION) {
+      flushPartition();
+    }
+    return;
+  }
+  int16_t *samples = (int16_t *)(chunk + sizeof(EcgChunkHeader)) + chunkFrames * ECG_LEADS;
+  for (int i = 0; i < ECG_LEADS; i++) {
+    samples[i] = ecgQuantize(volts[i], hdr.gain[i], hdr.offset[i]);
+  }
+  chunkFrames++;
+  if (chunkFrames == ECG_RAW16_FRAMES_PER_CHUNK) {
+    emitChunk();
+  }
+}
+
+void EcgRecordEncoder::flushPartition() {
+  if (pendingFrames == 0) {
+    return;
+  }
+  if (!rice.addPartition(pending, pendingFrames)) {
+    // No entra: el chunk se cierra y la partición abre el siguiente. En un
+    // chunk vacío siempre entra (ECG_RICE_PARTITION_MAX_BYTES)
+    emitChunk();
+    chunkFirstFrame = nextFrame - pendingFrames;
+    rice.addPartition(pending, pendingFrames);
+  }
+  chunkFrames += pendingFrames;
+  pendingFrames = 0;
+}
+
+void EcgRecordEncoder::skipFrames(uint32_t count) {
+  // Las muestras del chunk actual son contiguas: se cierra antes del hueco
+  flushPartition();
+  if (chunkFrames > 0) {
+    emitChunk();
+  }
+  nextFrame += count;
+}
+
+void EcgRecordEncoder::emitChunk() {
+  EcgChunkHeader ch;
+  ch.magic = ECG_CHUNK_MAGIC;
+  ch.codec = codec;
+  ch.leadCount = ECG_LEADS;
+  ch.frames = chunkFrames;
+  ch.payloadBytes = codec == ECG_CODEC_RICE ? rice.bytes() : chunkFrames * ECG_LEADS * sizeof(int16_t);
+  ch.firstFrame = chunkFirstFrame;
+  ch.reserved = 0;
+  memcpy(chunk, &ch, sizeof(ch));
+  uint32_t used = sizeof(ch) + ch.payloadBytes;
+  memset(chunk + used, 0, ECG_RECORD_CHUNK_SIZE - used);
+  chunkFrames = 0;
+  rice.begin(chunk + sizeof(EcgChunkHeader), ECG_CHUNK_PAYLOAD_MAX);
+
+  // Si el destino descartó el chunk queda un hueco; los chunks siguientes
+  // conservan su posición porque solo se cuentan los escritos
+  if (!sink(chunk, ECG_RECORD_CHUNK_SIZE, sinkCtx)) {
+    return;
+  }
+  uint32_t index = hdr.chunkCount++;
+  if (index % hdr.tableStride != 0) {
+    return;
+  }
+  if (hdr.tableCount == ECG_RECORD_TABLE_MAX) {
+    // Tabla llena: se queda con una entrada de cada dos
+    for (uint32_t i = 0; i < ECG_RECORD_TABLE_MAX / 2; i++) {
+      table[i] = table[2 * i];
+    }
+    hdr.tableCount = ECG_RECORD_TABLE_MAX / 2;
+    hdr.tableStride *= 2;
+    if (index % hdr.tableStride != 0) {
+      return;
+    }
+  }
+  table[hdr.tableCount++] = ch.firstFrame;
+}
+
+void EcgRecordEncoder::finish() {
+  flushPartition();
+  if (chunkFrames > 0) {
+    emitChunk();
+  }
+  hdr.frameCount = nextFrame;
+  hdr.tableOffset = ECG_RECORD_HEADER_SIZE + hdr.chunkCount * ECG_RECORD_CHUNK_SIZE;
+  if (hdr.tableCount == 0 || !sink((const uint8_t *)table, hdr.tableCount * sizeof(uint32_t), sinkCtx)) {
+    hdr.tableOffset = 0;
+    hdr.tableCount = 0;
+  }
+}
+
+// ---------------------------------------------------------------- Lectura
+
+bool EcgRecordReader::open(EcgFile *f) {
+  file = f;
+  chunkIndex = 0;
+  chunkFirst = 0;
+  chunkFrames = 0;
+  chunkPos = 0;
+  payload = (int16_t *)ecgArena.take(memory, ECG_CHUNK_PAYLOAD_MAX, "chunk .ecg");
+  if (!payload || !file || file->read((uint8_t *)&hdr, sizeof(hdr)) != sizeof(hdr)) {
+    return false;
+  }
+  if (!ecgRecordHeaderValid(hdr)) {
+    return false;
+  }
+  if (hdr.frameCount == 0) {
+    // Grabación sin cerrar: termina en el último chunk sano. Después puede
+    // quedar la reserva en ceros de preallocate(); como los bloques de 4096
+    // bytes cortan cada chunk en dos, el último con marca antes de los ceros
+    // solo está completo si el siguiente empezó, y se descarta
+    uint32_t size = file->size();
+    uint32_t fit = size > hdr.headerSize ? (size - hdr.headerSize) / hdr.chunkSize : 0;
+    hdr.chunkCount = fit;
+    hdr.tableCount = 0;
+    while (hdr.chunkCount > 0 && !loadChunk(hdr.chunkCount - 1)) {
+      hdr.chunkCount--;
+    }
+    if (hdr.chunkCount > 0 && hdr.chunkCount < fit) {
+      hdr.chunkCount--;
+    }
+    if (hdr.chunkCount > 0 && loadChunk(hdr.chunkCount - 1)) {
+      hdr.frameCount = chunkFirst + chunkFrames;
+    }
+  }
+  if (hdr.tableCount > ECG_RECORD_TABLE_MAX) {
+    hdr.tableCount = 0;
+  }
+  if (hdr.tableCount > 0) {
+    uint32_t bytes = hdr.tableCount * sizeof(uint32_t);
+    if (!file->seek(hdr.tableOffset) || file->read((uint8_t *)table, bytes) != bytes) {
+      hdr.tableCount = 0;
+    }
+  }
+  return hdr.chunkCount > 0 ? loadChunk(0) : true;
+}
+
+bool EcgRecordReader::loadChunk(uint32_t index) {
+  if (index >= hdr.chunkCount || !file->seek(hdr.headerSize + index * hdr.chunkSize)) {
+    return false;
+  }
+  EcgChunkHeader ch;
+  if (file->read((uint8_t *)&ch, sizeof(ch)) != sizeof(ch) || !ecgChunkHeaderValid(ch)) {
+    return false;
+  }
+  if (file->read((uint8_t *)payload, ch.payloadBytes) != ch.payloadBytes) {
+    return false;
+  }
+  chunkIndex = index;
+  chunkFirst = ch.firstFrame;
+  chunkFrames = ch.frames;
+  chunkPos = 0;
+  chunkCodec = ch.codec;
+  payloadBytes = ch.payloadBytes;
+  decoder.begin((const uint8_t *)payload, payloadBytes);
+  partFirst = 0;
+  partFrames = 0;
+  return true;
+}
+
+uint32_t EcgRecordReader::decoded(const int16_t *&frames) {
+  if (chunkPos >= chunkFrames) {
+    return 0;
+  }
+  if (chunkCodec == ECG_CODEC_RAW16) {
+    frames = payload + chunkPos * ECG_LEADS;
+    return chunkFrames - chunkPos;
+  }
+  if (chunkPos < partFirst) {
+    decoder.begin((const uint8_t *)payload, payloadBytes);
+    partFirst = 0;
+    partFrames = 0;
+  }
+  while (chunkPos >= partFirst + partFrames) {
+    partFirst += partFrames;
+    uint32_t left = chunkFrames - partFirst;
+    partFrames = left < (uint32_t)ECG_RICE_PARTITION ? left : ECG_RICE_PARTITION;
+    if (!decoder.decodePartition(part, partFrames)) {
+      return 0;
+    }
+  }
+  frames = part + (chunkPos - partFirst) * ECG_LEADS;
+  return partFirst + partFrames - chunkPos;
+}
+
+bool EcgRecordReader::seek(uint32_t frame) {
+  if (hdr.chunkCount == 0) {
+    return false;
+  }
+  // Último chunk que empieza antes de `frame`: por la tabla si existe,
+  // si no por búsqueda binaria leyendo las cabeceras de los chunks
+  uint32_t lo = 0, hi = hdr.chunkCount - 1;
+  if (hdr.tableCount > 0) {
+    uint32_t k = 0;
+    while (k + 1 < hdr.tableCount && table[k + 1] <= frame) {
+      k++;
+    }
+    lo = k * hdr.tableStride;
+    hi = k + 1 < hdr.tableCount ? (k + 1) * hdr.tableStride - 1 : hdr.chunkCount - 1;
+  }
+  while (lo < hi) {
+    uint32_t mid = (lo + hi + 1) / 2;
+    if (!loadChunk(mid)) {
+      return false;
+    }
+    if (chunkFirst <= frame) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  if (!loadChunk(lo)) {
+    return false;
+  }
+  if (frame >= chunkFirst + chunkFrames) {
+    // Cae en un hueco o después del final: se sigue en el chunk siguiente
+    chunkPos = chunkFrames;
+    nextChunk();
+  } else if (frame > chunkFirst) {
+    chunkPos = frame - chunkFirst;
+  }
+  return true;
+}
+
+// Carga el siguiente chunk que se pueda leer (los dañados se saltan); false
+// si no hay más
+bool EcgRecordReader::nextChunk() {
+  for (uint32_t index = chunkIndex + 1; index < hdr.chunkCount; index++) {
+    if (loadChunk(index) && chunkFrames > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint32_t EcgRecordReader::read(int16_t *out, uint32_t maxFrames) {
+  uint32_t done = 0;
+  // El chunk actual solo queda agotado al final: al terminar uno se carga el
+  // siguiente, así position() siempre es la próxima muestra
+  while (done < maxFrames && chunkPos < chunkFrames) {
+    const int16_t *frames;
+    uint32_t n = decoded(frames);
+    if (n == 0) {
+      // Partición dañada: el resto del chunk es un hueco
+      chunkPos = chunkFrames;
+      nextChunk();
+      break;
+    }
+    if (n > maxFrames - done) {
+      n = maxFrames - done;
+    }
+    memcpy(out + done * ECG_LEADS, frames, n * ECG_LEADS * sizeof(int16_t));
+    chunkPos += n;
+    done += n;
+    if (chunkPos >= chunkFrames) {
+      uint32_t end = position();
+      if (!nextChunk() || chunkFirst != end) {
+        break;  // Final, o un hueco antes del chunk siguiente
+      }
+    }
+  }
+  return done;
+}
@@ -0,0 +1,168 @@
+#ifndef ECG_RECORD_H
+#define ECG_RECORD_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ecg_codec.h"
+#include "ecg_hal.h"
+#include "ecg_memory.h"
+#include "ecg_queue.h"
+
+// Formato binario de grabación (.ecg), versión 1. Todo en little-endian.
+//
+//   [cabecera, 512 bytes]
+//   [chunk 0, 4096 bytes] [chunk 1, 4096 bytes] ...
+//   [tabla de chunks]
+//
+// Cada chunk empieza con EcgChunkHeader seguido de las muestras int16
+// intercaladas (d1, d2, d3, d1, d2, d3, ...), en crudo (ECG_CODEC_RAW16) o
+// comprimidas sin pérdida (ECG_CODEC_RICE, ecg_codec.h). Un chunk se decodifica
+// sin los anteriores y el chunk i está en headerSize + i * chunkSize, así que
+// con la tabla (primera muestra de cada chunk) se llega a cualquier instante
+// leyendo un solo chunk. volts = raw * gain + offset.
+
+const uint32_t ECG_RECORD_VERSION = 1;
+const uint32_t ECG_RECORD_HEADER_SIZE = 512;
+const uint32_t ECG_RECORD_CHUNK_SIZE = 4096;
+const uint16_t ECG_CHUNK_MAGIC = 0x4B43;   // "CK"
+const uint8_t ECG_CODEC_RAW16 = 0;
+const uint8_t ECG_CODEC_RICE = 1;
+const int ECG_RECORD_MAX_LEADS = 4;
+const int ECG_RECORD_TABLE_MAX = 256;      // Entradas de la tabla que se guardan en RAM
+
+struct EcgRecordHeader {
+  char magic[4];            // "ECGB"
+  uint16_t version;
+  uint16_t headerSize;
+  uint32_t sampleRate;      // Hz
+  uint16_t leadCount;
+  uint16_t reserved;
+  uint32_t chunkSize;
+  float gain[ECG_RECORD_MAX_LEADS];    // Voltios por cuenta
+  float offset[ECG_RECORD_MAX_LEADS];  // Voltios
+  uint32_t startMillis;     // millis() al iniciar la grabación
+  uint32_t frameCount;      // Muestras por derivación (0 si no se cerró bien)
+  uint32_t chunkCount;
+  uint32_t tableOffset;     // Posición de la tabla, 0 si no hay
+  uint32_t tableStride;     // Chunks entre entradas de la tabla
+  uint32_t tableCount;
+  float averageBpm;         // Latidos por minuto de toda la grabación, 0 si no se midió
+};
+
+struct EcgChunkHeader {
+  uint16_t magic;
+  uint8_t codec;
+  uint8_t leadCount;
+  uint16_t frames;
+  uint16_t payloadBytes;
+  uint32_t firstFrame;      // Índice de la primera muestra del chunk
+  uint32_t reserved;
+};
+
+const uint32_t ECG_CHUNK_PAYLOAD_MAX = ECG_RECORD_CHUNK_SIZE - sizeof(EcgChunkHeader);
+const uint32_t ECG_RAW16_FRAMES_PER_CHUNK = ECG_CHUNK_PAYLOAD_MAX / (ECG_LEADS * sizeof(int16_t));
+
+// Cabecera de una grabación que este código sabe leer
+inline bool ecgRecordHeaderValid(const EcgRecordHeader &hdr) {
+  return memcmp(hdr.magic, "ECGB", 4) == 0 && hdr.version == ECG_RECORD_VERSION &&
+         hdr.chunkSize == ECG_RECORD_CHUNK_SIZE && hdr.leadCount == ECG_LEADS;
+}
+
+// Cabecera de chunk con un codec conocido y un payload que entra en el chunk
+inline bool ecgChunkHeaderValid(const EcgChunkHeader &ch) {
+  if (ch.magic != ECG_CHUNK_MAGIC) {
+    return false;
+  }
+  return ch.codec == ECG_CODEC_RAW16
+             ? ch.frames <= ECG_RAW16_FRAMES_PER_CHUNK && ch.payloadBytes == ch.frames * ECG_LEADS * sizeof(int16_t)
+             : ch.codec == ECG_CODEC_RICE && ch.payloadBytes <= ECG_CHUNK_PAYLOAD_MAX;
+}
+
+// Voltios a cuentas de 16 bits con saturación
+inline int16_t ecgQuantize(float volts, float gain, float offset) {
+  float raw = roundf((volts - offset) / gain);
+  return raw > 32767 ? 32767 : (raw < -32768 ? -32768 : (int16_t)raw);
+}
+
+// Destino de los bytes que produce el codificador (SD en streaming o un archivo)
+typedef bool (*EcgRecordSink)(const uint8_t *data, uint32_t len, void *ctx);
+
+// Arma la cabecera, los chunks y la tabla a partir de muestras en voltios.
+// La tabla guarda como máximo ECG_RECORD_TABLE_MAX entradas; si la grabación
+// es más larga se queda con una de cada dos y duplica tableStride.
+// Con ECG_CODEC_RICE las muestras se juntan de a ECG_RICE_PARTITION y cada
+// partición se comprime al completarse; la que no entra abre el chunk siguiente.
+class EcgRecordEncoder {
+public:
+  void begin(uint32_t sampleRate, uint32_t startMillis, EcgRecordSink sink, void *ctx,
+             uint8_t codec = ECG_CODEC_RICE);
+  void addFrame(const float volts[ECG_LEADS]);
+  void skipFrames(uint32_t count);  // Hueco en la grabación (muestras perdidas)
+  void finish();                    // Escribe el último chunk y la tabla
+  void setAverageBpm(float bpm) { hdr.averageBpm = bpm; }
+  const EcgRecordHeader &header() const { return hdr; }
+
+private:
+  void flushPartition();
+  void emitChunk();
+
+  EcgRecordHeader hdr;
+  EcgRecordSink sink;
+  void *sinkCtx;
+  uint32_t nextFrame;
+  uint32_t bytesOut;
+  uint32_t table[ECG_RECORD_TABLE_MAX];
+  uint8_t chunk[ECG_RECORD_CHUNK_SIZE];
+  uint16_t chunkFrames;
+  uint32_t chunkFirstFrame;
+  uint8_t codec;
+  EcgRiceEncoder rice;
+  int16_t pending[ECG_RICE_PARTITION * ECG_LEADS];   // Partición en curso
+  uint32_t pendingFrames;
+};
+
+// Lectura de chunks crudos o comprimidos. Los comprimidos se decodifican de a
+// una partición a medida que se leen; posicionarse dentro de un chunk
+// decodifica desde su comienzo.
+class EcgRecordReader {
+public:
+  EcgRecordReader() : file(0), payload(0) { memory.data = 0; memory.phase = 0; }
+  bool open(EcgFile *file);
+  const EcgRecordHeader &header() const { return hdr; }
+  uint32_t frameCount() const { return hdr.frameCount; }
+  // Posiciona la lectura en la muestra `frame` (o en la siguiente disponible)
+  bool seek(uint32_t frame);
+  // Lee hasta maxFrames muestras intercaladas; devuelve cuántas leyó (0 solo
+  // al final). Las muestras de una llamada son contiguas: si la grabación
+  // tiene un hueco (muestras descartadas, chunk dañado) se corta antes y
+  // position() queda en la primera muestra después del hueco.
+  uint32_t read(int16_t *out, uint32_t maxFrames);
+  // Índice de la próxima muestra que devolverá read()
+  uint32_t position() const { return chunkFirst + chunkPos; }
+  float toVolts(int16_t raw, int lead) const { return raw * hdr.gain[lead] + hdr.offset[lead]; }
+
+private:
+  bool loadChunk(uint32_t index);
+  bool nextChunk();
+  uint32_t decoded(const int16_t *&frames);
+
+  EcgFile *file;
+  EcgRecordHeader hdr;
+  uint32_t table[ECG_RECORD_TABLE_MAX];
+  uint32_t chunkIndex;
+  uint32_t chunkFirst;
+  uint16_t chunkFrames;
+  uint16_t chunkPos;
+  uint8_t chunkCodec;
+  uint16_t payloadBytes;
+  EcgArenaSlot memory;
+  int16_t *payload;                 // ECG_CHUNK_PAYLOAD_MAX bytes de ecgArena
+  EcgRiceDecoder decoder;
+  uint16_t partFirst;               // Primera muestra (en el chunk) de `part`
+  uint16_t partFrames;
+  int16_t part[ECG_RICE_PARTITION * ECG_LEADS];
+};
+
+#endif
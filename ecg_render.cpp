@@ -0,0 +1,297 @@
+#include "ecg_render.h"
+
+#include <stdio.h>
+
+#include "ecg_stats.h"
+
+// Rango fijo de la señal centrada en la franja de cada derivación, hasta que
+// llega una escala automática
+static const float displayMinV = -0.5f;
+static const float displayMaxV = 1.0f;
+
+static const uint16_t leadColor[ECG_LEADS] = {ECG_RED, ECG_GREEN, ECG_BLUE};
+static const char *const leadLabel[ECG_LEADS] = {"D1", "D2", "D3"};
+
+void EcgSweepRenderer::begin(float sampleRate, float columnsPerSecond) {
+  strip = (uint16_t *)ecgArena.take(
+      memory, (ECG_STRIP_COLUMNS + ECG_STRIP_GAP) * ECG_SWEEP_MAX_HEIGHT * sizeof(uint16_t), "tira del barrido", true);
+  rate = sampleRate;
+  columnRate = columnsPerSecond;
+  phase = 0;
+  width = hal.display->width();
+  height = hal.display->height() - ECG_STATUS_HEIGHT;
+  if (height > ECG_SWEEP_MAX_HEIGHT) {
+    height = ECG_SWEEP_MAX_HEIGHT;
+  }
+  laneHeight = height / ECG_LEADS;
+  for (int l = 0; l < ECG_LEADS; l++) {
+    setLeadScale(l, displayMinV, displayMaxV);
+    shownFlags[l] = 0;
+  }
+  x = 0;
+  fill = 0;
+  columnOpen = false;
+  shownBpm = -1;
+  stripsPushed = 0;
+  columnsDrawn = 0;
+  textRedraws = 0;
+  pushUsMax = 0;
+  startMs = hal.clock->millis();
+}
+
+void EcgSweepRenderer::setLeadScale(int lead, float low, float high) {
+  if (low >= high) {
+    low = displayMinV;
+    high = displayMaxV;
+  }
+  viewLow[lead] = low;
+  viewScale[lead] = (laneHeight - 5) / (high - low);
+  axisY[lead] = mapLead(lead, 0);
+  prevY[lead] = -1;  // La columna siguiente no se une con la escala anterior
+  prevTop[lead] = -1;
+}
+
+void EcgSweepRenderer::setLeadFlags(const uint8_t flags[ECG_LEADS]) {
+  bool changed = false;
+  for (int l = 0; l < ECG_LEADS; l++) {
+    changed = changed || flags[l] != shownFlags[l];
+    shownFlags[l] = flags[l];
+  }
+  if (changed) {
+    drawFlags();
+  }
+}
+
+void EcgSweepRenderer::drawFlags() {
+  // La bandera más grave de todas, con su derivación ("D2 suelto")
+  int worst = -1;
+  for (int l = 0; l < ECG_LEADS; l++) {
+    if (shownFlags[l] > (worst < 0 ? 0 : shownFlags[worst])) {
+      worst = l;
+    }
+  }
+  EcgDisplay *tft = hal.display;
+  tft->fillRect(130, 19, 70, 8, ECG_BLACK);
+  if (worst >= 0) {
+    char text[16];
+    snprintf(text, sizeof(text), "%s %s", leadLabel[worst], ecgSignalFlagText(shownFlags[worst]));
+    tft->setTextSize(1);
+    tft->setTextColor(ECG_YELLOW);
+    tft->setCursor(130, 19);
+    tft->print(text);
+  }
+  textRedraws++;
+}
+
+int EcgSweepRenderer::mapLead(int lead, float volts) const {
+  int top = ECG_STATUS_HEIGHT + lead * laneHeight;
+  // Recorte en float: fuera de escala el producto puede no entrar en un int
+  float rows = (volts - viewLow[lead]) * viewScale[lead];
+  if (rows > laneHeight - 4) {
+    rows = laneHeight - 4;
+  }
+  if (rows < -1) {
+    rows = -1;
+  }
+  return top + laneHeight - 3 - (int)rows;
+}
+
+void EcgSweepRenderer::drawLayout() {
+  EcgDisplay *tft = hal.display;
+  tft->fillScreen(ECG_BLACK);
+  for (int l = 0; l < ECG_LEADS; l++) {
+    tft->drawLine(0, axisY[l], width - 1, axisY[l], ECG_WHITE);
+  }
+  // Leyendas en la barra superior, con el color de cada trazo
+  tft->setTextSize(1);
+  for (int l = 0; l < ECG_LEADS; l++) {
+    tft->setTextColor(leadColor[l]);
+    tft->setCursor(130 + 20 * l, 10);
+    tft->print(leadLabel[l]);
+  }
+  shownBpm = -1;
+}
+
+void EcgSweepRenderer::setHeartRate(float bpm) {
+  int value = (int)(bpm + 0.5f);
+  if (value == shownBpm) {
+    return;
+  }
+  shownBpm = value;
+  char text[16];
+  snprintf(text, sizeof(text), "BPM: %d", value);
+  EcgDisplay *tft = hal.display;
+  tft->fillRect(10, 6, 110, 16, ECG_BLACK);
+  tft->setTextColor(ECG_GREEN);
+  tft->setTextSize(2);
+  tft->setCursor(10, 6);
+  tft->print(text);
+  textRedraws++;
+}
+
+void EcgSweepRenderer::addFrame(const EcgFrame &frame) {
+  for (int l = 0; l < ECG_LEADS; l++) {
+    int y = mapLead(l, frame.lead[l]);
+    if (!columnOpen || y < colMin[l]) {
+      colMin[l] = y;
+    }
+    if (!columnOpen || y > colMax[l]) {
+      colMax[l] = y;
+    }
+    colLast[l] = y;
+  }
+  columnOpen = true;
+  phase += columnRate;
+  if (phase >= rate) {
+    phase -= rate;
+    closeColumn();
+  }
+}
+
+void EcgSweepRenderer::addGap(uint32_t frames) {
+  for (; frames > 0; frames--) {
+    phase += columnRate;
+    if (phase < rate) {
+      continue;
+    }
+    phase -= rate;
+    if (!columnOpen) {
+      for (int l = 0; l < ECG_LEADS; l++) {
+        colMin[l] = 1;
+        colMax[l] = 0;
+      }
+    }
+    closeColumn();
+  }
+}
+
+void EcgSweepRenderer::addColumn(const float lo[ECG_LEADS], const float hi[ECG_LEADS]) {
+  for (int l = 0; l < ECG_LEADS; l++) {
+    if (lo[l] > hi[l]) {
+      colMin[l] = 1;
+      colMax[l] = 0;
+      prevTop[l] = -1;
+      continue;
+    }
+    int top = mapLead(l, hi[l]), bottom = mapLead(l, lo[l]);
+    colMin[l] = top;
+    colMax[l] = bottom;
+    // Las columnas resumidas solo se estiran hasta tocar la anterior
+    if (prevTop[l] >= 0) {
+      if (colMin[l] > prevBottom[l]) {
+        colMin[l] = prevBottom[l];
+      }
+      if (colMax[l] < prevTop[l]) {
+        colMax[l] = prevTop[l];
+      }
+    }
+    prevTop[l] = top;
+    prevBottom[l] = bottom;
+    prevY[l] = -1;
+    colLast[l] = -1;
+  }
+  closeColumn();
+}
+
+void EcgSweepRenderer::closeColumn() {
+  // Cada columna es un segmento vertical que también une con la columna anterior
+  for (int l = 0; l < ECG_LEADS; l++) {
+    if (colMin[l] > colMax[l]) {
+      // Hueco: no se dibuja ni se une con la siguiente
+      spanLo[fill][l] = 1;
+      spanHi[fill][l] = 0;
+      prevY[l] = -1;
+      continue;
+    }
+    if (prevY[l] < 0) {
+      spanLo[fill][l] = colMin[l];
+      spanHi[fill][l] = colMax[l];
+    } else {
+      spanLo[fill][l] = colMin[l] < prevY[l] ? colMin[l] : prevY[l];
+      spanHi[fill][l] = colMax[l] > prevY[l] ? colMax[l] : prevY[l];
+    }
+    prevY[l] = colLast[l];
+  }
+  columnOpen = false;
+  fill++;
+  columnsDrawn++;
+  if (fill == ECG_STRIP_COLUMNS || x + fill >= width) {
+    pushStrip();
+  }
+}
+
+void EcgSweepRenderer::pushStrip() {
+  if (fill == 0 || !strip) {
+    return;
+  }
+  int w = fill + ECG_STRIP_GAP;
+  if (x + w > width) {
+    w = width - x;
+  }
+  // Fondo y ejes para toda la tira (incluye las columnas de separación)
+  for (int i = 0; i < w * height; i++) {
+    strip[i] = ECG_BLACK;
+  }
+  for (int l = 0; l < ECG_LEADS; l++) {
+    uint16_t *row = strip + (axisY[l] - ECG_STATUS_HEIGHT) * w;
+    for (int c = 0; c < w; c++) {
+      row[c] = ECG_WHITE;
+    }
+  }
+  for (int c = 0; c < fill; c++) {
+    for (int l = 0; l < ECG_LEADS; l++) {
+      for (int y = spanLo[c][l]; y <= spanHi[c][l]; y++) {
+        strip[(y - ECG_STATUS_HEIGHT) * w + c] = leadColor[l];
+      }
+    }
+  }
+
+  uint32_t start = hal.clock->micros();
+  hal.display->pushRect(x, ECG_STATUS_HEIGHT, w, height, strip);
+  uint32_t elapsed = hal.clock->micros() - start;
+  if (elapsed > pushUsMax) {
+    pushUsMax = elapsed;
+  }
+  stripsPushed++;
+
+  x += fill;
+  fill = 0;
+  if (x >= width) {
+    x = 0;
+  }
+}
+
+void EcgSweepRenderer::flush() {
+  pushStrip();
+}
+
+void EcgSweepRenderer::padToEnd() {
+  // Columnas vacías (solo fondo y ejes) hasta el borde derecho; si el barrido
+  // acaba de dar la vuelta no hay nada que completar
+  if (x == 0 && fill == 0) {
+    return;
+  }
+  for (int remaining = width - (x + fill); remaining > 0; remaining--) {
+    for (int l = 0; l < ECG_LEADS; l++) {
+      spanLo[fill][l] = 1;
+      spanHi[fill][l] = 0;
+      prevY[l] = -1;
+    }
+    columnOpen = false;
+    fill++;
+    if (fill == ECG_STRIP_COLUMNS || x + fill >= width) {
+      pushStrip();
+    }
+  }
+  pushStrip();
+}
+
+float EcgSweepRenderer::stripsPerSecond() const {
+  uint32_t elapsed = hal.clock->millis() - startMs;
+  return elapsed > 0 ? stripsPushed * 1000.0f / elapsed : 0;
+}
+
+float EcgSweepRenderer::sweepsPerSecond() const {
+  uint32_t elapsed = hal.clock->millis() - startMs;
+  return elapsed > 0 && width > 0 ? (float)columnsDrawn / width * 1000.0f / elapsed : 0;
+}
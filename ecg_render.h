@@ -0,0 +1,93 @@
+#ifndef ECG_RENDER_H
+#define ECG_RENDER_H
+
+#include <stdint.h>
+
+#include "ecg_hal.h"
+#include "ecg_memory.h"
+#include "ecg_queue.h"
+
+// Barrido en vivo de las 3 derivaciones. Las columnas se arman en RAM y se
+// envían de a ECG_STRIP_COLUMNS con un solo pushRect (una ventana de
+// direcciones y una ráfaga SPI) que incluye fondo, ejes y trazos. El texto
+// (BPM y leyendas) está en una barra superior que el barrido no toca y solo
+// se redibuja cuando cambia.
+//
+// La velocidad del barrido (columnas por segundo) no depende de la frecuencia
+// de muestreo: cada columna resume con mínimo y máximo todas las muestras que
+// le tocan, así que los QRS no se pierden al comprimir en el tiempo.
+//
+// Cada derivación tiene su franja con su propia escala vertical, que el lazo
+// de captura y el visor ajustan con ecgAutoScale() (ecg_stats.h); begin()
+// vuelve a la escala fija de -0,5 a 1 V.
+
+const int ECG_STRIP_COLUMNS = 8;
+const int ECG_STRIP_GAP = 4;          // Columnas borradas delante del barrido
+const int ECG_STATUS_HEIGHT = 28;     // Barra de BPM y leyendas
+const int ECG_SWEEP_MAX_HEIGHT = 240 - ECG_STATUS_HEIGHT;
+
+class EcgSweepRenderer {
+public:
+  // sampleRate: muestras por segundo que llegan a addFrame()
+  // columnsPerSecond: velocidad del barrido
+  // La primera llamada reserva la tira en la zona permanente de ecgArena
+  void begin(float sampleRate, float columnsPerSecond);
+  // Limpia la pantalla y dibuja ejes y leyendas (sin el BPM)
+  void drawLayout();
+  void addFrame(const EcgFrame &frame);
+  // Muestras que faltan: avanzan el barrido y las columnas sin ninguna muestra
+  // quedan vacías
+  void addGap(uint32_t frames);
+  // Columna ya resumida (mínimo y máximo en voltios); lo > hi la deja vacía
+  void addColumn(const float lo[ECG_LEADS], const float hi[ECG_LEADS]);
+  // Redibuja el BPM solo si cambió el valor mostrado
+  void setHeartRate(float bpm);
+  // Voltios en el borde inferior y superior de la franja de una derivación;
+  // low >= high vuelve a la escala fija. Vale desde la próxima muestra.
+  void setLeadScale(int lead, float low, float high);
+  // Banderas de ecg_stats.h: se avisa la más grave bajo las leyendas (solo
+  // se redibuja si cambian)
+  void setLeadFlags(const uint8_t flags[ECG_LEADS]);
+  // Envía las columnas pendientes
+  void flush();
+  // Envía las pendientes y completa con columnas vacías hasta el borde derecho
+  void padToEnd();
+  // Columna de pantalla donde va la próxima columna
+  int column() const { return x + fill; }
+
+  // Estadísticas desde begin()
+  uint32_t stripsPushed;
+  uint32_t columnsDrawn;
+  uint32_t textRedraws;
+  uint32_t pushUsMax;
+  float stripsPerSecond() const;
+  float sweepsPerSecond() const;
+
+private:
+  int mapLead(int lead, float volts) const;
+  void drawFlags();
+  void closeColumn();
+  void pushStrip();
+
+  float rate;
+  float columnRate;
+  float phase;           // Acumulador de muestras -> columnas
+  int width, height;
+  int laneHeight;
+  int axisY[ECG_LEADS];  // Fila del 0 V de cada derivación
+  float viewLow[ECG_LEADS], viewScale[ECG_LEADS];  // Voltios del borde inferior y píxeles por voltio
+  uint8_t shownFlags[ECG_LEADS];
+  int x;                 // Columna de pantalla donde empieza la tira actual
+  int fill;              // Columnas listas en la tira
+  bool columnOpen;
+  int colMin[ECG_LEADS], colMax[ECG_LEADS], colLast[ECG_LEADS];
+  int prevY[ECG_LEADS];
+  int prevTop[ECG_LEADS], prevBottom[ECG_LEADS];  // Columna anterior de addColumn()
+  int16_t spanLo[ECG_STRIP_COLUMNS][ECG_LEADS], spanHi[ECG_STRIP_COLUMNS][ECG_LEADS];
+  EcgArenaSlot memory;
+  uint16_t *strip;       // (ECG_STRIP_COLUMNS + ECG_STRIP_GAP) * ECG_SWEEP_MAX_HEIGHT, permanente en ecgArena
+  int shownBpm;
+  uint32_t startMs;
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include "ecg_serial_stream.h"
+
+#include <string.h>
+
+#include "ecg_profile.h"
+
+static_assert(sizeof(EcgRecordHeader) <= ECG_SERIAL_PAYLOAD_MAX, "INFO no entra en un paquete");
+static_assert(ECG_SERIAL_FRAMES_PER_PACKET * ECG_LEADS * sizeof(int16_t) <= ECG_SERIAL_PAYLOAD_MAX,
+              "FRAMES no entra en un paquete");
+
+uint16_t ecgCrc16(const uint8_t *data, uint32_t len, uint16_t crc) {
+  for (uint32_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int b = 0; b < 8; b++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+// ---------------------------------------------------------------- Envío
+
+void EcgSerialStreamer::begin(const EcgRecordHeader &header) {
+  record = header;
+  seq = 0;
+  nextFrame = 0;
+  packetFirst = 0;
+  packetFrames = 0;
+  head = tail = 0;
+  packetsSent = 0;
+  droppedPackets = 0;
+  emit(ECG_SERIAL_INFO, 0, (const uint8_t *)&record, sizeof(record));
+}
+
+void EcgSerialStreamer::addFrame(const float volts[ECG_LEADS]) {
+  if (packetFrames == 0) {
+    packetFirst = nextFrame;
+  }
+  int16_t *frame = frames + packetFrames * ECG_LEADS;
+  for (int l = 0; l < ECG_LEADS; l++) {
+    frame[l] = ecgQuantize(volts[l], record.gain[l], record.offset[l]);
+  }
+  nextFrame++;
+  if (++packetFrames == ECG_SERIAL_FRAMES_PER_PACKET) {
+    flushFrames();
+  }
+}
+
+void EcgSerialStreamer::skipFrames(uint32_t count) {
+  // Las muestras de un paquete son contiguas: se cierra antes del hueco
+  flushFrames();
+  nextFrame += count;
+}
+
+void EcgSerialStreamer::flushFrames() {
+  if (packetFrames > 0) {
+    emit(ECG_SERIAL_FRAMES, packetFirst, (const uint8_t *)frames, packetFrames * ECG_LEADS * sizeof(int16_t));
+    packetFrames = 0;
+  }
+}
+
+void EcgSerialStreamer::finish(uint32_t frameCount, float averageBpm) {
+  flushFrames();
+  EcgSerialEnd end = {frameCount, averageBpm};
+  emit(ECG_SERIAL_END, frameCount, (const uint8_t *)&end, sizeof(end));
+}
+
+void EcgSerialStreamer::emit(uint8_t type, uint32_t firstFrame, const uint8_t *payload, uint32_t len) {
+  EcgSerialPacketHeader hdr;
+  hdr.sync[0] = ECG_SERIAL_SYNC0;
+  hdr.sync[1] = ECG_SERIAL_SYNC1;
+  hdr.type = type;
+  hdr.reserved = 0;
+  hdr.seq = seq++;
+  hdr.payloadBytes = len;
+  hdr.firstFrame = firstFrame;
+  uint16_t crc = ecgCrc16(payload, len, ecgCrc16((const uint8_t *)&hdr, sizeof(hdr)));
+  uint32_t total = sizeof(hdr) + len + sizeof(crc);
+  if (ECG_SERIAL_RING_SIZE - pending() < total) {
+    droppedPackets++;  // El receptor lo ve como un salto en seq
+    ecgProfileCount(ECG_COUNT_SERIAL_DROPPED);
+    return;
+  }
+  const uint8_t *parts[3] = {(const uint8_t *)&hdr, payload, (const uint8_t *)&crc};
+  uint32_t sizes[3] = {sizeof(hdr), len, sizeof(crc)};
+  for (int p = 0; p < 3; p++) {
+    for (uint32_t i = 0; i < sizes[p]; i++) {
+      ring[head++ % ECG_SERIAL_RING_SIZE] = parts[p][i];
+    }
+  }
+  packetsSent++;
+}
+
+void EcgSerialStreamer::service() {
+  uint32_t room = hal.serial->availableForWrite();
+  while (room > 0 && pending() > 0) {
+    // Tramo contiguo del buffer circular
+    uint32_t at = tail % ECG_SERIAL_RING_SIZE;
+    uint32_t n = ECG_SERIAL_RING_SIZE - at;
+    if (n > pending()) {
+      n = pending();
+    }
+    if (n > room) {
+      n = room;
+    }
+    uint32_t written = hal.serial->write(ring + at, n);
+    tail += written;
+    room -= written;
+    if (written < n) {
+      break;
+    }
+  }
+}
+
+// ---------------------------------------------------------------- Recepción
+
+void EcgSerialParser::begin(EcgSerialPacketHandler h, void *ctx) {
+  handler = h;
+  handlerCtx = ctx;
+  haveSeq = false;
+  nextSeq = 0;
+  have = 0;
+  packets = 0;
+  crcErrors = 0;
+  lostPackets = 0;
+  skippedBytes = 0;
+}
+
+// 1 si hay un paquete completo y válido, 0 si faltan bytes, -1 si lo que hay
+// al principio del buffer no es un paquete
+int EcgSerialParser::check() {
+  if (buffer[0] != ECG_SERIAL_SYNC0) {
+    return -1;
+  }
+  if (have < 2) {
+    return 0;
+  }
+  if (buffer[1] != ECG_SERIAL_SYNC1) {
+    return -1;
+  }
+  if (have < sizeof(EcgSerialPacketHeader)) {
+    return 0;
+  }
+  EcgSerialPacketHeader hdr;
+  memcpy(&hdr, buffer, sizeof(hdr));
+  if (hdr.type < ECG_SERIAL_INFO || hdr.type > ECG_SERIAL_END || hdr.payloadBytes > ECG_SERIAL_PAYLOAD_MAX) {
+    return -1;
+  }
+  uint32_t total = sizeof(hdr) + hdr.payloadBytes + sizeof(uint16_t);
+  if (have < total) {
+    return 0;
+  }
+  uint16_t crc;
+  memcpy(&crc, buffer + total - sizeof(crc), sizeof(crc));
+  if (crc != ecgCrc16(buffer, total - sizeof(crc))) {
+    crcErrors++;
+    return -1;
+  }
+  return 1;
+}
+
+void EcgSerialParser::feed(const uint8_t *data, uint32_t len) {
+  for (uint32_t i = 0; i < len; i++) {
+    buffer[have++] = data[i];
+    while (have > 0) {
+      int state = check();
+      if (state == 0) {
+        break;
+      }
+      if (state > 0) {
+        EcgSerialPacketHeader hdr;
+        memcpy(&hdr, buffer, sizeof(hdr));
+        // INFO empieza una grabación nueva con seq desde 0
+        if (haveSeq && hdr.seq != nextSeq && hdr.type != ECG_SERIAL_INFO) {
+          lostPackets += (uint16_t)(hdr.seq - nextSeq);
+        }
+        haveSeq = true;
+        nextSeq = hdr.seq + 1;
+        packets++;
+        handler(hdr, buffer + sizeof(hdr), handlerCtx);
+        have = 0;
+        break;
+      }
+      // Se descarta el primer byte y se vuelve a buscar el sincronismo en el resto
+      memmove(buffer, buffer + 1, --have);
+      skippedBytes++;
+    }
+  }
+}
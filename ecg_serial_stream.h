@@ -0,0 +1,110 @@
+#ifndef ECG_SERIAL_STREAM_H
+#define ECG_SERIAL_STREAM_H
+
+#include <stdint.h>
+
+#include "ecg_hal.h"
+#include "ecg_queue.h"
+#include "ecg_record.h"
+
+// Transmisión de la grabación por el puerto serie en paquetes binarios:
+//
+//   [EcgSerialPacketHeader] [payload] [CRC-16 de cabecera y payload]
+//
+// INFO lleva la EcgRecordHeader de la grabación (frecuencia y escala), cada
+// FRAMES hasta ECG_SERIAL_FRAMES_PER_PACKET muestras int16 intercaladas con
+// el índice de la primera, y END la cantidad total de muestras. El receptor
+// busca los bytes de sincronismo y descarta lo que no pasa el CRC, así que el
+// texto de depuración que se mezcle en el puerto no rompe el flujo. Un salto
+// en `seq` indica paquetes perdidos y uno en firstFrame, muestras perdidas.
+//
+// Los paquetes se arman en un buffer circular y service() envía solo lo que
+// el puerto acepta sin bloquear; si el buffer se llena el paquete se
+// descarta (y se cuenta).
+
+enum EcgSerialMode {
+  ECG_SERIAL_OFF,
+  ECG_SERIAL_ASCII,     // "d1 d2 d3" con 6 decimales, una vez por vuelta (depuración)
+  ECG_SERIAL_BINARY     // Todas las muestras grabadas, en paquetes
+};
+
+const uint8_t ECG_SERIAL_SYNC0 = 0xA5;
+const uint8_t ECG_SERIAL_SYNC1 = 0x5A;
+const uint8_t ECG_SERIAL_INFO = 1;
+const uint8_t ECG_SERIAL_FRAMES = 2;
+const uint8_t ECG_SERIAL_END = 3;
+const uint32_t ECG_SERIAL_FRAMES_PER_PACKET = 32;
+const uint32_t ECG_SERIAL_PAYLOAD_MAX = 256;
+const uint32_t ECG_SERIAL_RING_SIZE = 2048;
+
+struct EcgSerialPacketHeader {
+  uint8_t sync[2];
+  uint8_t type;
+  uint8_t reserved;
+  uint16_t seq;
+  uint16_t payloadBytes;
+  uint32_t firstFrame;      // FRAMES: índice de la primera muestra
+};
+
+struct EcgSerialEnd {
+  uint32_t frameCount;
+  float averageBpm;
+};
+
+// CRC-16/CCITT-FALSE (polinomio 0x1021, inicial 0xFFFF)
+uint16_t ecgCrc16(const uint8_t *data, uint32_t len, uint16_t crc = 0xFFFF);
+
+class EcgSerialStreamer {
+public:
+  // Manda INFO con la cabecera de la grabación
+  void begin(const EcgRecordHeader &record);
+  void addFrame(const float volts[ECG_LEADS]);
+  void skipFrames(uint32_t count);
+  // Manda lo que quede y END
+  void finish(uint32_t frameCount, float averageBpm);
+  // Envía lo pendiente que entre en el puerto sin bloquear
+  void service();
+  uint32_t pending() const { return head - tail; }
+
+  uint32_t packetsSent;
+  uint32_t droppedPackets;  // Buffer lleno
+
+private:
+  void flushFrames();
+  void emit(uint8_t type, uint32_t firstFrame, const uint8_t *payload, uint32_t len);
+
+  EcgRecordHeader record;
+  uint16_t seq;
+  uint32_t nextFrame;
+  uint32_t packetFirst;
+  uint32_t packetFrames;
+  int16_t frames[ECG_SERIAL_FRAMES_PER_PACKET * ECG_LEADS];
+  uint32_t head, tail;
+  uint8_t ring[ECG_SERIAL_RING_SIZE];
+};
+
+// Receptor: recibe bytes sueltos del puerto y entrega los paquetes válidos
+typedef void (*EcgSerialPacketHandler)(const EcgSerialPacketHeader &header, const uint8_t *payload, void *ctx);
+
+class EcgSerialParser {
+public:
+  void begin(EcgSerialPacketHandler handler, void *ctx);
+  void feed(const uint8_t *data, uint32_t len);
+
+  uint32_t packets;
+  uint32_t crcErrors;
+  uint32_t lostPackets;     // Saltos en seq
+  uint32_t skippedBytes;    // Bytes fuera de un paquete válido
+
+private:
+  int check();
+
+  EcgSerialPacketHandler handler;
+  void *handlerCtx;
+  bool haveSeq;
+  uint16_t nextSeq;
+  uint32_t have;
+  uint8_t buffer[sizeof(EcgSerialPacketHeader) + ECG_SERIAL_PAYLOAD_MAX + 2];
+};
+
+#endif
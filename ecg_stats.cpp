@@ -0,0 +1,210 @@
+#include "ecg_stats.h"
+
+#include <math.h>
+#include <string.h>
+
+EcgWindowStats::EcgWindowStats() : blockSamples(1), blocks(0), mask(0), ring(0), minQueue(0), maxQueue(0) {
+  memory.data = 0;
+  memory.phase = 0;
+  reset();
+}
+
+bool EcgWindowStats::begin(uint32_t samplesPerBlock, uint32_t windowBlocks, const char *owner, bool permanent) {
+  if (samplesPerBlock == 0 || windowBlocks == 0) {
+    return false;
+  }
+  uint32_t size = 1;
+  while (size < windowBlocks) {
+    size <<= 1;
+  }
+  uint8_t *mem = ecgArena.take(memory, ecgWindowStatsBytes(windowBlocks), owner, permanent);
+  if (!mem) {
+    ring = 0;
+    return false;
+  }
+  blockSamples = samplesPerBlock;
+  blocks = windowBlocks;
+  mask = size - 1;
+  ring = (EcgStatsBlock *)mem;
+  minQueue = (uint32_t *)(ring + size);
+  maxQueue = minQueue + size;
+  reset();
+  return true;
+}
+
+void EcgWindowStats::reset() {
+  minHead = minTail = maxHead = maxTail = 0;
+  closed = 0;
+  windowSum = windowSumSq = 0;
+  memset(&current, 0, sizeof(current));
+  fill = 0;
+}
+
+void EcgWindowStats::closeBlock() {
+  if (!ring) {
+    fill = 0;
+    current.sum = current.sumSq = 0;
+    return;
+  }
+  // El bloque que sale de la ventana deja las sumas antes de pisar su lugar
+  if (closed >= blocks) {
+    const EcgStatsBlock &old = ring[(closed - blocks) & mask];
+    windowSum -= old.sum;
+    windowSumSq -= old.sumSq;
+  }
+  ring[closed & mask] = current;
+  windowSum += current.sum;
+  windowSumSq += current.sumSq;
+
+  // Colas monótonas de números de bloque: primero salen por el frente los que
+  // dejan la ventana y después, por atrás, los que ya no pueden ser el mínimo
+  // (o el máximo) porque el nuevo es igual o más extremo y dura más
+  uint32_t oldest = closed + 1 > blocks ? closed + 1 - blocks : 0;
+  while (maxHead != maxTail && maxQueue[maxHead & mask] < oldest) {
+    maxHead++;
+  }
+  while (minHead != minTail && minQueue[minHead & mask] < oldest) {
+    minHead++;
+  }
+  while (maxTail != maxHead && ring[maxQueue[(maxTail - 1) & mask] & mask].hi <= current.hi) {
+    maxTail--;
+  }
+  maxQueue[maxTail++ & mask] = closed;
+  while (minTail != minHead && ring[minQueue[(minTail - 1) & mask] & mask].lo >= current.lo) {
+    minTail--;
+  }
+  minQueue[minTail++ & mask] = closed;
+  closed++;
+
+  memset(&current, 0, sizeof(current));
+  fill = 0;
+}
+
+uint32_t EcgWindowStats::count() const {
+  return (closed < blocks ? closed : blocks) * blockSamples + fill;
+}
+
+float EcgWindowStats::minimum() const {
+  bool haveWindow = ring && minTail != minHead;
+  int32_t v = haveWindow ? ring[minQueue[minHead & mask] & mask].lo : current.lo;
+  if (fill > 0 && current.lo < v) {
+    v = current.lo;
+  }
+  return v * 1e-6f;
+}
+
+float EcgWindowStats::maximum() const {
+  bool haveWindow = ring && maxTail != maxHead;
+  int32_t v = haveWindow ? ring[maxQueue[maxHead & mask] & mask].hi : current.hi;
+  if (fill > 0 && current.hi > v) {
+    v = current.hi;
+  }
+  return v * 1e-6f;
+}
+
+float EcgWindowStats::mean() const {
+  uint32_t n = count();
+  return n > 0 ? (float)((double)(windowSum + current.sum) / n * 1e-6) : 0;
+}
+
+float EcgWindowStats::stddev() const {
+  // En double una vez por consulta: la suma de cuadrados no entra en un float
+  uint32_t n = count();
+  if (n == 0) {
+    return 0;
+  }
+  double m = (double)(windowSum + current.sum) / n;
+  double var = (double)(windowSumSq + current.sumSq) / n - m * m;
+  return (float)(sqrt(var > 0 ? var : 0) * 1e-6);
+}
+
+// ---------------------------------------------------------------- Escala y banderas
+
+bool ecgAutoScale(float lo, float hi, EcgLeadView &view) {
+  float range = hi - lo;
+  float shown = view.high - view.low;
+  if (shown > 0 && lo >= view.low && hi <= view.high && range >= 0.4f * shown) {
+    return false;
+  }
+  float span = (range > ECG_SCALE_MIN_SPAN_V ? range : ECG_SCALE_MIN_SPAN_V) * 1.25f;
+  float center = (lo + hi) / 2;
+  view.low = center - span / 2;
+  view.high = center + span / 2;
+  return true;
+}
+
+const char *ecgSignalFlagText(uint8_t flags) {
+  if (flags & ECG_SIGNAL_LEAD_OFF) {
+    return "suelto";
+  }
+  if (flags & ECG_SIGNAL_SATURATED) {
+    return "saturada";
+  }
+  if (flags & ECG_SIGNAL_FLAT) {
+    return "plana";
+  }
+  return NULL;
+}
+
+bool EcgSignalMonitor::begin(float sampleRate) {
+  uint32_t blockSamples = (uint32_t)(sampleRate * ECG_MONITOR_BLOCK_MS / 1000 + 0.5f);
+  blockSamples = blockSamples < 1 ? 1 : blockSamples;
+  bool ok = true;
+  for (int c = 0; c < 2; c++) {
+    ok = rawStats[c].begin(blockSamples, ECG_MONITOR_BLOCKS, "estadisticas", true) && ok;
+  }
+  for (int l = 0; l < ECG_LEADS; l++) {
+    ok = leadStats[l].begin(blockSamples, ECG_MONITOR_BLOCKS, "estadisticas", true) && ok;
+  }
+  reset();
+  return ok;
+}
+
+void EcgSignalMonitor::reset() {
+  for (int c = 0; c < 2; c++) {
+    rawStats[c].reset();
+  }
+  for (int l = 0; l < ECG_LEADS; l++) {
+    leadStats[l].reset();
+    // Sin escala hasta llenar la ventana: la pantalla usa la suya
+    current.lead[l].low = current.lead[l].high = 0;
+    current.lead[l].flags = 0;
+  }
+}
+
+bool EcgSignalMonitor::update() {
+  if (!leadStats[0].full()) {
+    return false;
+  }
+  // Estado de cada AD8232: toda la ventana a menos de dos márgenes de un
+  // extremo (pegado) o alguna muestra a menos de uno (recortada)
+  uint8_t rawFlags[2];
+  for (int c = 0; c < 2; c++) {
+    float lo = rawStats[c].minimum(), hi = rawStats[c].maximum();
+    rawFlags[c] = 0;
+    if (hi <= 2 * ECG_RAIL_MARGIN_V || lo >= ECG_ADC_FULL_SCALE_V - 2 * ECG_RAIL_MARGIN_V) {
+      rawFlags[c] |= ECG_SIGNAL_LEAD_OFF;
+    }
+    if (lo <= ECG_RAIL_MARGIN_V || hi >= ECG_ADC_FULL_SCALE_V - ECG_RAIL_MARGIN_V) {
+      rawFlags[c] |= ECG_SIGNAL_SATURATED;
+    }
+  }
+  bool changed = false;
+  for (int l = 0; l < ECG_LEADS; l++) {
+    EcgLeadView &view = current.lead[l];
+    // D1 es XS1, D2 es XS2 y D3 usa las dos
+    uint8_t flags = l == 0 ? rawFlags[0] : (l == 1 ? rawFlags[1] : rawFlags[0] | rawFlags[1]);
+    if (!(flags & ECG_SIGNAL_LEAD_OFF) && leadStats[l].stddev() < ECG_FLAT_STD_V) {
+      flags |= ECG_SIGNAL_FLAT;
+    }
+    if (flags != view.flags) {
+      view.flags = flags;
+      changed = true;
+    }
+    // Sin señal útil la escala queda como estaba para no ampliar el ruido
+    if (!(flags & (ECG_SIGNAL_LEAD_OFF | ECG_SIGNAL_FLAT))) {
+      changed = ecgAutoScale(leadStats[l].minimum(), leadStats[l].maximum(), view) || changed;
+    }
+  }
+  return changed;
+}
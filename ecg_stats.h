@@ -0,0 +1,140 @@
+#ifndef ECG_STATS_H
+#define ECG_STATS_H
+
+#include <stdint.h>
+
+#include "ecg_memory.h"
+#include "ecg_queue.h"
+
+// Estadísticas de ventana deslizante con trabajo constante por muestra, para
+// la escala automática de cada franja y las banderas de calidad de señal.
+//
+// Las muestras se agrupan en bloques (mínimo, máximo, suma y suma de
+// cuadrados en microvoltios enteros); la ventana son los últimos N bloques
+// cerrados más el que se está llenando. El mínimo y el máximo salen de dos
+// colas monótonas de bloques y la media y la varianza de sumas que se
+// actualizan al entrar y salir cada bloque, sin error acumulado porque son
+// enteras. Por muestra son unas comparaciones y sumas; el resto ocurre una vez
+// por bloque.
+
+const uint32_t ECG_MONITOR_BLOCK_MS = 40;
+const uint32_t ECG_MONITOR_BLOCKS = 64;    // 2,56 s: al menos un latido a 30 BPM (potencia de 2)
+
+struct EcgStatsBlock {
+  int32_t lo, hi;
+  int64_t sum, sumSq;
+};
+
+// Bytes de ecgArena de una EcgWindowStats de `blocks` bloques
+inline uint32_t ecgWindowStatsBytes(uint32_t blocks) {
+  uint32_t ring = 1;
+  while (ring < blocks) {
+    ring <<= 1;
+  }
+  return ring * (sizeof(EcgStatsBlock) + 2 * sizeof(uint32_t));
+}
+
+class EcgWindowStats {
+public:
+  EcgWindowStats();
+  // Ventana de `blocks` bloques de blockSamples muestras; la memoria sale de
+  // ecgArena
+  bool begin(uint32_t blockSamples, uint32_t blocks, const char *owner, bool permanent = false);
+  void reset();
+  // Una muestra en voltios; true cuando cierra un bloque
+  bool add(float volts) {
+    int32_t q = (int32_t)(volts * 1e6f + (volts >= 0 ? 0.5f : -0.5f));
+    if (fill == 0 || q < current.lo) current.lo = q;
+    if (fill == 0 || q > current.hi) current.hi = q;
+    current.sum += q;
+    current.sumSq += (int64_t)q * q;
+    if (++fill < blockSamples) {
+      return false;
+    }
+    closeBlock();
+    return true;
+  }
+  // La ventana ya tiene todos sus bloques
+  bool full() const { return closed >= blocks; }
+  uint32_t count() const;
+  float minimum() const;
+  float maximum() const;
+  float mean() const;
+  float stddev() const;
+
+private:
+  void closeBlock();
+
+  uint32_t blockSamples, blocks, mask;
+  EcgArenaSlot memory;
+  EcgStatsBlock *ring;
+  uint32_t *minQueue, *maxQueue;   // Números de bloque, del más viejo al más nuevo
+  uint32_t minHead, minTail, maxHead, maxTail;
+  uint32_t closed;                 // Bloques cerrados desde reset()
+  int64_t windowSum, windowSumSq;
+  EcgStatsBlock current;
+  uint32_t fill;
+};
+
+// Banderas de calidad de una derivación
+const uint8_t ECG_SIGNAL_FLAT = 1;        // Sin actividad (desvío menor a ECG_FLAT_STD_V)
+const uint8_t ECG_SIGNAL_SATURATED = 2;   // El AD8232 toca un extremo del ADC
+const uint8_t ECG_SIGNAL_LEAD_OFF = 4;    // El AD8232 quedó pegado a un extremo: electrodo suelto
+
+const float ECG_ADC_FULL_SCALE_V = 3.3f;
+const float ECG_RAIL_MARGIN_V = 0.05f;
+const float ECG_FLAT_STD_V = 0.002f;
+// Rango mínimo de una franja con escala automática, para no ampliar el ruido
+const float ECG_SCALE_MIN_SPAN_V = 0.3f;
+
+// Lo que la pantalla necesita de cada derivación
+struct EcgLeadView {
+  float low, high;   // Voltios en el borde inferior y superior de la franja
+  uint8_t flags;
+};
+
+struct EcgSignalStatus {
+  EcgLeadView lead[ECG_LEADS];
+};
+
+// De FilterTask al lazo de captura, solo cuando algo cambia
+typedef SpscQueue<EcgSignalStatus, 4> EcgStatusQueue;
+
+// Ajusta la franja para que entre [lo, hi] con un 12,5 % de margen de cada
+// lado. Con histéresis: no la toca mientras el rango entre y use al menos el
+// 40 % de la altura. Una vista con low >= high se ajusta siempre. Devuelve
+// true si cambió.
+bool ecgAutoScale(float lo, float hi, EcgLeadView &view);
+// Texto corto de la bandera más grave (NULL si no hay)
+const char *ecgSignalFlagText(uint8_t flags);
+
+// Estadísticas de las dos entradas crudas y de las tres derivaciones que
+// calcula FilterTask; una vez por bloque actualiza las escalas y banderas
+class EcgSignalMonitor {
+public:
+  // Memoria permanente de ecgArena (FilterTask no se detiene)
+  bool begin(float sampleRate);
+  void reset();
+  // raw: voltios de los dos AD8232; lead: derivaciones como se dibujan.
+  // Devuelve true si cambió alguna escala o bandera (ver status())
+  bool add(const float raw[2], const float lead[ECG_LEADS]) {
+    bool block = false;
+    for (int c = 0; c < 2; c++) {
+      block = rawStats[c].add(raw[c]);
+    }
+    for (int l = 0; l < ECG_LEADS; l++) {
+      leadStats[l].add(lead[l]);
+    }
+    return block && update();
+  }
+  const EcgSignalStatus &status() const { return current; }
+
+private:
+  bool update();
+
+  EcgWindowStats rawStats[2];
+  EcgWindowStats leadStats[ECG_LEADS];
+  EcgSignalStatus current;
+};
+
+#endif
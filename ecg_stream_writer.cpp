@@ -0,0 +1,159 @@
+#include "ecg_stream_writer.h"
+
+#include <string.h>
+
+#include "ecg_profile.h"
+
+EcgStreamWriter streamWriter;
+EcgStreamWriter pyramidWriter;
+
+EcgStreamWriter::EcgStreamWriter()
+    : bytesWritten(0), droppedBytes(0), blocksWritten(0), maxWriteUs(0),
+      writeError(false), active(0), nextWrite(0), reserved(0), file(NULL) {
+  fill[0] = fill[1] = 0;
+  pending[0] = pending[1] = false;
+  buffers[0] = buffers[1] = NULL;
+  memory.data = NULL;
+  memory.phase = 0;
+}
+
+bool EcgStreamWriter::begin(const char *path) {
+  bytesWritten = 0;
+  droppedBytes = 0;
+  blocksWritten = 0;
+  maxWriteUs = 0;
+  writeError = false;
+  active = 0;
+  nextWrite = 0;
+  fill[0] = fill[1] = 0;
+  pending[0] = pending[1] = false;
+  reserved = 0;
+  uint8_t *blocks = ecgArena.take(memory, 2 * blockSize, "bloques SD");
+  if (!blocks) {
+    file = NULL;
+    return false;
+  }
+  buffers[0] = blocks;
+  buffers[1] = blocks + blockSize;
+  file = hal.storage->open(path, ECG_OPEN_WRITE);
+  return file != NULL;
+}
+
+bool EcgStreamWriter::append(const uint8_t *data, uint32_t len) {
+  if (!file || writeError.load()) {
+    droppedBytes += len;
+    return false;
+  }
+  // El bloque actual todavía no lo libera StorageTask
+  if (pending[active].load(std::memory_order_acquire)) {
+    droppedBytes += len;
+    return false;
+  }
+  // Cabe si alcanza lo que queda del bloque actual más el otro bloque libre
+  uint32_t room = blockSize - fill[active];
+  int other = 1 - active;
+  if (len > room && (pending[other].load(std::memory_order_acquire) || len - room > blockSize)) {
+    droppedBytes += len;
+    return false;
+  }
+  uint32_t first = len < room ? len : room;
+  memcpy(buffers[active] + fill[active], data, first);
+  fill[active] += first;
+  if (fill[active] == blockSize) {
+    // Bloque lleno: se entrega a StorageTask y se sigue en el otro
+    pending[active].store(true, std::memory_order_release);
+    active = other;
+  }
+  if (first < len) {
+    memcpy(buffers[active], data + first, len - first);
+    fill[active] = len - first;
+  }
+  return true;
+}
+
+void EcgStreamWriter::flush() {
+  if (!file || fill[active] == 0 || pending[active].load(std::memory_order_acquire)) {
+    return;
+  }
+  // Como un bloque lleno: los bloques se siguen entregando alternados
+  pending[active].store(true, std::memory_order_release);
+  active = 1 - active;
+}
+
+uint32_t EcgStreamWriter::freeBytes() const {
+  if (!file || writeError.load() || pending[active].load(std::memory_order_acquire)) {
+    return 0;
+  }
+  uint32_t room = blockSize - fill[active];
+  return pending[1 - active].load(std::memory_order_acquire) ? room : room + blockSize;
+}
+
+void EcgStreamWriter::finish(const uint8_t *head, uint32_t headLen) {
+  if (!file) {
+    return;
+  }
+  if (fill[active] > 0 && !pending[active].load()) {
+    pending[active].store(true, std::memory_order_release);
+  }
+  // Esperar a que StorageTask termine con los dos bloques, también con error
+  // (service() descarta lo pendiente sin tocar el archivo), para no cerrarlo
+  // mientras todavía lo usa
+  while (pending[0].load() || pending[1].load()) {
+    hal.clock->delayMs(1);
+  }
+  if (head && !writeError.load() && file->seek(0)) {
+    file->write(head, headLen);
+  }
+  file->close();
+  file = NULL;
+}
+
+bool EcgStreamWriter::service() {
+  // Los bloques se entregan siempre alternados (0, 1, 0, ...), así que basta
+  // con mirar el siguiente en orden
+  int b = nextWrite;
+  if (!pending[b].load(std::memory_order_acquire)) {
+    return false;
+  }
+  if (!file || writeError.load()) {
+    // Tarjeta llena o retirada: el bloque se descarta sin tocar el archivo
+    fill[b] = 0;
+    nextWrite = 1 - b;
+    pending[b].store(false, std::memory_order_release);
+    return true;
+  }
+  uint32_t len = fill[b];
+  if (bytesWritten + len > reserved) {
+    reserved += preallocateStep;
+    file->preallocate(reserved);
+  }
+  uint32_t start = hal.clock->micros();
+  size_t written;
+  {
+    EcgProfileScope scope(ECG_STAGE_SD_WRITE);
+    written = file->write(buffers[b], len);
+  }
+  uint32_t elapsed = hal.clock->micros() - start;
+  if (elapsed > maxWriteUs) {
+    maxWriteUs = elapsed;
+  }
+  if (written != len) {
+    writeError = true;  // Tarjeta llena o retirada
+  }
+  bytesWritten += written;
+  blocksWritten++;
+  fill[b] = 0;
+  nextWrite = 1 - b;
+  pending[b].store(false, std::memory_order_release);
+  return true;
+}
+
+void StorageTask(void *pv) {
+  while (!hal.tasks->stopRequested()) {
+    bool worked = streamWriter.service();
+    worked = pyramidWriter.service() || worked;
+    if (!worked) {
+      hal.tasks->delayTick();
+    }
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef ECG_STREAM_WRITER_H
+#define ECG_STREAM_WRITER_H
+
+#include <stdint.h>
+#include <atomic>
+
+#include "ecg_hal.h"
+#include "ecg_memory.h"
+
+// Escritura en streaming a la SD con doble buffer.
+// El lazo de captura llena un bloque con append() mientras StorageTask escribe
+// el otro con service(). append() nunca espera: si los dos bloques están
+// ocupados los datos se descartan y se cuentan en droppedBytes. Los bloques
+// se toman de la fase actual de ecgArena en begin().
+class EcgStreamWriter {
+public:
+  static const uint32_t blockSize = 4096;           // Múltiplo del sector de 512 bytes
+  static const uint32_t preallocateStep = 262144;   // Se reserva espacio de 256 KB en 256 KB
+
+  EcgStreamWriter();
+
+  // Lado de la captura; false si no se pudo abrir o no hay memoria
+  bool begin(const char *path);
+  bool append(const uint8_t *data, uint32_t len);  // Todo o nada
+  // Entrega a StorageTask el bloque a medio llenar sin esperar; cuando deja
+  // de estar busy() el finish() que sigue no espera
+  void flush();
+  // Vacía lo pendiente, reescribe los primeros headLen bytes del archivo con
+  // `head` (cabecera con los totales finales) y cierra
+  void finish(const uint8_t *head = NULL, uint32_t headLen = 0);
+  bool isOpen() const { return file != NULL; }
+  // Bytes que append() aceptaría ahora y si StorageTask tiene bloques pendientes
+  uint32_t freeBytes() const;
+  bool busy() const { return pending[0].load() || pending[1].load(); }
+  bool failed() const { return writeError.load(); }
+
+  // Lado de StorageTask: escribe un bloque pendiente; false si no había trabajo
+  bool service();
+
+  uint32_t bytesWritten;
+  uint32_t droppedBytes;
+  uint32_t blocksWritten;
+  uint32_t maxWriteUs;   // Peor latencia de escritura de un bloque
+
+private:
+  EcgArenaSlot memory;
+  uint8_t *buffers[2];
+  uint32_t fill[2];
+  std::atomic<bool> pending[2];
+  std::atomic<bool> writeError;
+  int active;     // Bloque que llena la captura
+  int nextWrite;  // Próximo bloque que escribe StorageTask
+  uint32_t reserved;
+  EcgFile *file;
+};
+
+// Tarea de fondo que vacía los bloques de streamWriter y pyramidWriter
+void StorageTask(void *pv);
+
+extern EcgStreamWriter streamWriter;
+extern EcgStreamWriter pyramidWriter;  // Índice .pyr de la grabación en curso
+
+#endif
@@ -0,0 +1,173 @@
+#include "ecg_wavelet.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+// Filtros de descomposición de sym4 (pywt.Wavelet('sym4').dec_lo/dec_hi); los
+// de reconstrucción son los mismos invertidos en el tiempo
+static const float decLo[ECG_WAVELET_TAPS] = {
+    -0.07576571478927333f, -0.02963552764599851f, 0.49761866763201545f, 0.8037387518059161f,
+    0.29785779560527736f,  -0.09921954357684722f, -0.012603967262037833f, 0.0322231006040427f,
+};
+static const float decHi[ECG_WAVELET_TAPS] = {
+    -0.0322231006040427f, -0.012603967262037833f, 0.09921954357684722f, 0.29785779560527736f,
+    -0.8037387518059161f, 0.49761866763201545f,   0.02963552764599851f, -0.07576571478927333f,
+};
+
+// Extensión simétrica de media muestra (x[-1] = x[0], x[n] = x[n-1])
+static inline float symmetricAt(const float *x, uint32_t n, int32_t i) {
+  int32_t period = 2 * (int32_t)n;
+  i %= period;
+  if (i < 0) {
+    i += period;
+  }
+  return x[i < (int32_t)n ? i : period - 1 - i];
+}
+
+void ecgDwt(const float *x, uint32_t n, float *approx, float *detail) {
+  uint32_t len = ecgDwtLength(n);
+  for (uint32_t o = 0; o < len; o++) {
+    // Salida o: filtro en la posición 2o + 1 de la señal extendida
+    int32_t center = 2 * o + 1;
+    float a = 0, d = 0;
+    if (center >= ECG_WAVELET_TAPS - 1 && center < (int32_t)n) {
+      const float *p = x + center;
+      for (int j = 0; j < ECG_WAVELET_TAPS; j++) {
+        a += decLo[j] * p[-j];
+        d += decHi[j] * p[-j];
+      }
+    } else {
+      for (int j = 0; j < ECG_WAVELET_TAPS; j++) {
+        float v = symmetricAt(x, n, center - j);
+        a += decLo[j] * v;
+        d += decHi[j] * v;
+      }
+    }
+    approx[o] = a;
+    detail[o] = d;
+  }
+}
+
+uint32_t ecgIdwt(const float *approx, const float *detail, uint32_t n, float *out) {
+  // Convolución "válida" con los filtros de reconstrucción sobre las bandas
+  // sobremuestreadas (upsampling_convolution_valid_sf de pywt)
+  const int half = ECG_WAVELET_TAPS / 2;
+  if (n < (uint32_t)half) {
+    return 0;
+  }
+  uint32_t o = 0;
+  for (uint32_t i = half - 1; i < n; i++, o += 2) {
+    float even = 0, odd = 0;
+    for (int j = 0; j < half; j++) {
+      // rec_lo[k] = decLo[TAPS - 1 - k], rec_hi[k] = decHi[TAPS - 1 - k]
+      float a = approx[i - j], d = detail[i - j];
+      even += decLo[ECG_WAVELET_TAPS - 1 - 2 * j] * a + decHi[ECG_WAVELET_TAPS - 1 - 2 * j] * d;
+      odd += decLo[ECG_WAVELET_TAPS - 2 - 2 * j] * a + decHi[ECG_WAVELET_TAPS - 2 - 2 * j] * d;
+    }
+    out[o] = even;
+    out[o + 1] = odd;
+  }
+  return o;
+}
+
+uint32_t ecgWavedec(const float *x, uint32_t n, int level, float *coeffs, uint32_t lengths[], float *scratch) {
+  if (level < 1 || level > ECG_WAVELET_MAX_LEVEL) {
+    return 0;
+  }
+  // Largo de cada banda y total; pywt avisa si el nivel es excesivo pero
+  // calcula igual, aquí solo se exige al menos una muestra por banda
+  uint32_t len = n;
+  uint32_t total = 0;
+  for (int k = 1; k <= level; k++) {
+    len = ecgDwtLength(len);
+    if (len == 0) {
+      return 0;
+    }
+    lengths[level + 1 - k] = len;
+    total += len;
+  }
+  lengths[0] = len;
+  total += len;
+
+  // cD_k va en su lugar definitivo y cA_k al principio de coeffs (antes de
+  // todos los detalles); la entrada de cada nivel se copia a scratch para que
+  // la salida no la pise
+  uint32_t detailEnd = total;
+  const float *input = x;
+  len = n;
+  for (int k = 1; k <= level; k++) {
+    uint32_t out = ecgDwtLength(len);
+    detailEnd -= out;
+    ecgDwt(input, len, coeffs, coeffs + detailEnd);
+    if (k < level) {
+      memcpy(scratch, coeffs, out * sizeof(float));
+      input = scratch;
+    }
+    len = out;
+  }
+  return total;
+}
+
+uint32_t ecgWaverec(const float *coeffs, const uint32_t lengths[], int level, float *out, float *scratch) {
+  const float *a = coeffs;
+  uint32_t aLen = lengths[0];
+  const float *d = coeffs + lengths[0];
+  // El nivel 1 termina en out; los anteriores alternan para no pisar su entrada
+  for (int k = level; k >= 1; k--) {
+    uint32_t dLen = lengths[level + 1 - k];
+    if (aLen == dLen + 1) {
+      aLen = dLen;
+    } else if (aLen != dLen) {
+      return 0;
+    }
+    float *dest = (k % 2 == 1) ? out : scratch;
+    aLen = ecgIdwt(a, d, dLen, dest);
+    a = dest;
+    d += dLen;
+  }
+  return aLen;
+}
+
+float ecgMedian(float *values, uint32_t n) {
+  if (n == 0) {
+    return 0;
+  }
+  uint32_t mid = n / 2;
+  std::nth_element(values, values + mid, values + n);
+  float upper = values[mid];
+  if (n % 2 == 1) {
+    return upper;
+  }
+  // Par: promedio con el mayor de la mitad de abajo
+  float lower = *std::max_element(values, values + mid);
+  return (lower + upper) / 2;
+}
+
+uint32_t ecgWaveletDenoise(const float *x, uint32_t n, float *out, float *coeffs, float *scratch, int level,
+                           float *threshold) {
+  uint32_t lengths[ECG_WAVELET_MAX_LEVEL + 1];
+  uint32_t total = ecgWavedec(x, n, level, coeffs, lengths, scratch);
+  if (total == 0) {
+    return 0;
+  }
+  // Ruido estimado con la mediana de |cD1| (la banda más fina, al final)
+  uint32_t finest = lengths[level];
+  const float *cd1 = coeffs + total - finest;
+  for (uint32_t i = 0; i < finest; i++) {
+    scratch[i] = fabsf(cd1[i]);
+  }
+  float sigma = ecgMedian(scratch, finest) / 0.6745f;
+  float t = sigma * sqrtf(2.0f * logf((float)n)) * 1.5f;
+  if (threshold) {
+    *threshold = t;
+  }
+  // Umbral suave en todos los detalles (cA queda igual)
+  for (uint32_t i = lengths[0]; i < total; i++) {
+    float v = coeffs[i];
+    float m = fabsf(v) - t;
+    coeffs[i] = m > 0 ? (v > 0 ? m : -m) : 0;
+  }
+  return ecgWaverec(coeffs, lengths, level, out, scratch);
+}
@@ -0,0 +1,49 @@
+#ifndef ECG_WAVELET_H
+#define ECG_WAVELET_H
+
+#include <stdint.h>
+
+// Transformada wavelet discreta sym4 por bloques, con las mismas cuentas que
+// PyWavelets (pywt.dwt/idwt, wavedec/waverec con mode='symmetric'), para
+// reproducir en C++ el preprocesamiento de los notebooks (IA_ISB.ipynb).
+//
+// Los coeficientes de una descomposición van en un solo arreglo en el orden
+// de pywt: [cA_n, cD_n, cD_n-1, ..., cD1], con el largo de cada banda en
+// lengths[]. Nada reserva memoria: quien llama pasa los buffers.
+
+const int ECG_WAVELET_TAPS = 8;
+const int ECG_WAVELET_MAX_LEVEL = 8;
+
+// Largo de cA (y de cD) de un nivel para n muestras de entrada
+inline uint32_t ecgDwtLength(uint32_t n) { return (n + ECG_WAVELET_TAPS - 1) / 2; }
+// Cota de los floats que ocupa la descomposición de n muestras en `level` niveles
+inline uint32_t ecgWavedecBound(uint32_t n, int level) { return n + level * (ECG_WAVELET_TAPS - 1); }
+
+// Un nivel: approx y detail tienen ecgDwtLength(n) valores
+void ecgDwt(const float *x, uint32_t n, float *approx, float *detail);
+// Inversa de un nivel a partir de n coeficientes de cada banda; escribe
+// 2 * n - ECG_WAVELET_TAPS + 2 muestras y devuelve cuántas
+uint32_t ecgIdwt(const float *approx, const float *detail, uint32_t n, float *out);
+
+// Descomposición de `level` niveles. coeffs necesita ecgWavedecBound(n, level)
+// floats y scratch ecgDwtLength(n). Devuelve cuántos floats usó (0 si la
+// señal es demasiado corta para ese nivel).
+uint32_t ecgWavedec(const float *x, uint32_t n, int level, float *coeffs, uint32_t lengths[], float *scratch);
+// Reconstrucción: out necesita 2 * lengths[level] y scratch lengths[level] + 1
+// floats (lengths[level] es cD1). Como pywt, si cA tiene un valor más que cD
+// se descarta el último. Devuelve las muestras escritas.
+uint32_t ecgWaverec(const float *coeffs, const uint32_t lengths[], int level, float *out, float *scratch);
+
+// aplicar_wavelet_denoising() de los notebooks: sym4 nivel 4 (o `level`),
+// umbral suave sigma * sqrt(2 ln n) * 1.5 en todos los detalles, con
+// sigma = mediana(|cD1|) / 0.6745. out puede ser x y necesita n + 1 floats
+// (pywt devuelve una muestra más si n es impar), coeffs
+// ecgWavedecBound(n, level) y scratch ecgDwtLength(n) + 1. Devuelve las
+// muestras escritas y, si threshold no es NULL, el umbral que usó.
+uint32_t ecgWaveletDenoise(const float *x, uint32_t n, float *out, float *coeffs, float *scratch, int level = 4,
+                           float *threshold = 0);
+
+// np.median: ordena parcialmente `values` (se modifica)
+float ecgMedian(float *values, uint32_t n);
+
+#endif
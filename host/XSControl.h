@@ -0,0 +1,34 @@
+#ifndef HOST_XSCONTROL_H
+#define HOST_XSCONTROL_H
+
+// Versión para Linux de XSFilter (la librería XSControl solo existe para Arduino).
+// SecondOrderLPF es un pasa bajos de 2do orden tipo Butterworth (zeta = 0.707)
+// discretizado con Euler hacia atrás, recalculando los coeficientes en cada
+// llamada igual que la librería original.
+//
+// No es la librería: repite la fórmula de designSecondOrderLPF(), así que en
+// el host benchmarkFilters() solo mide el error de los biquads float32/Q15/Q31
+// contra la misma recursión en double. Que el diseño coincida con XSFilter se
+// comprueba en la placa (ECG_FILTER_BENCH).
+#define XSCONTROL_HOST_STUB 1
+
+#include <math.h>
+
+class XSFilter {
+public:
+  XSFilter() : y1(0), y2(0) {}
+
+  double SecondOrderLPF(double x, double fc, double Ts) {
+    const double zeta = 0.7071067811865476;
+    double a = 2.0 * M_PI * fc * Ts;
+    double y = (a * a * x + (2.0 + 2.0 * zeta * a) * y1 - y2) / (1.0 + 2.0 * zeta * a + a * a);
+    y2 = y1;
+    y1 = y;
+    return y;
+  }
+
+private:
+  double y1, y2;
+};
+
+#endif
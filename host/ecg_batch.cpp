@@ -0,0 +1,727 @@
+// Análisis por lotes de una carpeta de registros: el preprocesamiento de los
+// notebooks (carga, aplicar_wavelet_denoising, extract_wavelet_features) más
+// el BPM del equipo, repartido entre todos los núcleos.
+//
+//   ecg_batch CARPETA SALIDA.npz [--threads N] [--csv-rate 100] [--txt-rate 200]
+//             [--lead 2] [--scaling]
+//
+// Recorre CARPETA (con subcarpetas) buscando:
+//   - *.csv de PTB como los lee el notebook (pd.read_csv con skiprows=2 y
+//     .values.flatten()), a --csv-rate Hz
+//   - ECG_*.txt del equipo ("d1,d2,d3" por línea), derivación --lead, a
+//     --txt-rate Hz; las líneas que no son muestras se saltan
+//   - *.ecg del equipo (ecg_map.h), derivación --lead, a la frecuencia de la
+//     cabecera; en los huecos se repite la última muestra
+// Cada archivo se lee con mmap y pasa por:
+//   - el banco de filtros y el detector de QRS de FilterTask (a la frecuencia
+//     del archivo; el notch queda fuera si no entra en la banda) -> latidos,
+//     BPM e intervalos RR
+//   - ecgWaveletDenoise (sym4 nivel 4) y ecgWaveletFeatures (sym4 nivel 6) ->
+//     las 35 características del notebook, sin normalizar
+//
+// SALIDA.npz tiene una columna por arreglo, en el orden del notebook para las
+// características, y se abre sin pickle:
+//   f = np.load('lote.npz'); df = pd.DataFrame({k: f[k] for k in f.files})
+//   X = normalize(df.filter(regex='^c[AD]').values)   # preprocess_data()
+// `label` sigue label_map (infarto 0, NORM 1) según la carpeta del archivo,
+// -1 si no es ninguna de las del notebook; `ok` en 0 marca los archivos que
+// no se pudieron analizar (el resto de su fila queda en 0 o NaN).
+//
+// Los archivos se ordenan de mayor a menor y se reparten entre los hilos; el
+// que se queda sin trabajo le roba al principio de la cola de otro. Con
+// --scaling repite el lote con 1, 2, 4... hilos hasta --threads e informa la
+// aceleración contra un hilo.
+
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../ecg_classifier.h"
+#include "../ecg_filter.h"
+#include "../ecg_playback.h"
+#include "../ecg_qrs.h"
+#include "../ecg_wavelet.h"
+#include "ecg_map.h"
+
+// Carpetas de IA_ISB.ipynb
+static const char *const infarctFolders[] = {"IMI",  "ASMI",  "ILMI",  "AMI",   "ALMI",  "INJAL", "INJAS",
+                                             "LMI",  "IPLMI", "IPMI",  "INJIL", "INJIN", "INJLA", "PMI"};
+
+enum BatchFormat { BATCH_CSV, BATCH_TXT, BATCH_ECG };
+
+struct BatchFile {
+  std::string path;       // Relativo a CARPETA
+  uint64_t bytes;
+  BatchFormat format;
+  int label;
+};
+
+struct BatchResult {
+  bool ok;
+  uint32_t samples;
+  float rate;
+  uint32_t beats;
+  float bpm, rrMeanMs, rrStdMs;
+  float features[ECG_MODEL_FEATURES];
+};
+
+struct BatchOptions {
+  float csvRate = 100;
+  float txtRate = 200;
+  int lead = ECG_MODEL_LEAD;
+};
+
+// ---------------------------------------------------------------- Archivos
+
+static bool hasSuffix(const char *s, const char *suffix) {
+  size_t n = strlen(s), m = strlen(suffix);
+  return n >= m && strcasecmp(s + n - m, suffix) == 0;
+}
+
+static int folderLabel(const std::string &dir) {
+  size_t slash = dir.find_last_of('/');
+  std::string name = slash == std::string::npos ? dir : dir.substr(slash + 1);
+  if (name == "NORM") {
+    return 1;
+  }
+  for (size_t i = 0; i < sizeof(infarctFolders) / sizeof(infarctFolders[0]); i++) {
+    if (name == infarctFolders[i]) {
+      return 0;
+    }
+  }
+  return -1;
+}
+
+static void collectFiles(const std::string &root, const std::string &rel, std::vector<BatchFile> &files) {
+  std::string dir = rel.empty() ? root : root + "/" + rel;
+  DIR *d = opendir(dir.c_str());
+  if (!d) {
+    return;
+  }
+  std::vector<std::string> subdirs;
+  struct dirent *e;
+  while ((e = readdir(d)) != NULL) {
+    if (e->d_name[0] == '.') {
+      continue;
+    }
+    std::string name = rel.empty() ? e->d_name : rel + "/" + e->d_name;
+    struct stat st;
+    if (stat((root + "/" + name).c_str(), &st) != 0) {
+      continue;
+    }
+    if (S_ISDIR(st.st_mode)) {
+      subdirs.push_back(name);
+      continue;
+    }
+    BatchFile f;
+    if (hasSuffix(e->d_name, ".csv")) {
+      f.format = BATCH_CSV;
+    } else if (hasSuffix(e->d_name, ".txt") && strncmp(e->d_name, "ECG_", 4) == 0) {
+      f.format = BATCH_TXT;
+    } else if (hasSuffix(e->d_name, ".ecg")) {
+      f.format = BATCH_ECG;
+    } else {
+      continue;
+    }
+    f.path = name;
+    f.bytes = st.st_size;
+    f.label = folderLabel(rel);
+    files.push_back(f);
+  }
+  closedir(d);
+  for (size_t i = 0; i < subdirs.size(); i++) {
+    collectFiles(root, subdirs[i], files);
+  }
+}
+
+// Archivo entero en memoria sin copiarlo; se suelta al salir del alcance
+class MappedFile {
+public:
+  MappedFile() : data(0), size(0) {}
+  ~MappedFile() {
+    if (data) {
+      munmap((void *)data, size);
+    }
+  }
+  bool open(const char *path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    size = ok ? st.st_size : 0;
+    if (size > 0) {
+      void *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p == MAP_FAILED) {
+        ok = false;
+      } else {
+        data = (const char *)p;
+        madvise(p, size, MADV_SEQUENTIAL);
+      }
+    }
+    ::close(fd);
+    return ok;
+  }
+
+  const char *data;
+  size_t size;
+};
+
+// ---------------------------------------------------------------- Análisis
+
+// Memoria de un hilo, reutilizada entre archivos
+struct Workspace {
+  std::vector<float> signal, denoised, coeffs, scratch;
+  std::vector<uint32_t> peaks;
+  EcgFilterBank bank;
+  EcgQrsDetector qrs;
+  uint32_t processed = 0, stolen = 0;
+  double busySeconds = 0;
+};
+
+static const char *skipLine(const char *p, const char *end) {
+  while (p < end && *p != '\n') {
+    p++;
+  }
+  return p < end ? p + 1 : end;
+}
+
+// pd.read_csv(header=None, skiprows=2).values.flatten(): todos los valores
+// en orden de filas
+static bool parseCsv(const char *p, const char *end, std::vector<float> &out) {
+  p = skipLine(skipLine(p, end), end);
+  while (p < end) {
+    while (p < end && (*p == ',' || *p == ';' || isspace((unsigned char)*p))) {
+      p++;
+    }
+    if (p == end) {
+      break;
+    }
+    float v;
+    const char *next = ecgParseNumber(p, end, v);
+    if (!next || (next < end && *next != ',' && *next != ';' && !isspace((unsigned char)*next))) {
+      return false;
+    }
+    out.push_back(v);
+    p = next;
+  }
+  return true;
+}
+
+static void parseDeviceText(const char *p, const char *end, int lead, std::vector<float> &out) {
+  while (p < end) {
+    const char *eol = (const char *)memchr(p, '\n', end - p);
+    if (!eol) {
+      eol = end;
+    }
+    float v[ECG_LEADS];
+    if (ecgParseTextLine(p, eol - p, v)) {
+      out.push_back(v[lead]);
+    }
+    p = eol < end ? eol + 1 : end;
+  }
+}
+
+// Derivación de una grabación .ecg, decodificada directo en `out`; los huecos
+// repiten la última muestra para no cortar los filtros
+static bool readRecording(const char *path, int lead, std::vector<float> &out, float &rate) {
+  EcgMap *map = ecgMapOpen(path, "");
+  if (!map) {
+    return false;
+  }
+  EcgMapInfo info;
+  ecgMapGetInfo(map, &info);
+  out.resize(info.frameCount);
+  ecgMapReadVolts(map, 0, info.frameCount, lead, out.data());
+  ecgMapClose(map);
+  float last = NAN;
+  for (uint32_t i = 0; i < info.frameCount; i++) {
+    if (isnan(out[i])) {
+      out[i] = last;
+    } else if (isnan(last)) {
+      // Hueco al comienzo: toma la primera muestra que hay
+      std::fill(out.begin(), out.begin() + i, out[i]);
+    }
+    last = out[i];
+  }
+  rate = info.sampleRate;
+  return info.sampleRate > 0 && !isnan(last);
+}
+
+static bool analyze(const std::string &root, const BatchFile &file, const BatchOptions &options, Workspace &w,
+                    BatchResult &r) {
+  memset(&r, 0, sizeof(r));
+  for (int i = 0; i < ECG_MODEL_FEATURES; i++) {
+    r.features[i] = NAN;
+  }
+  r.bpm = r.rrMeanMs = r.rrStdMs = NAN;
+  w.signal.clear();
+  std::string path = root + "/" + file.path;
+  if (file.format == BATCH_ECG) {
+    if (!readRecording(path.c_str(), options.lead, w.signal, r.rate)) {
+      fprintf(stderr, "%s: %s\n", file.path.c_str(), ecgMapLastError()[0] ? ecgMapLastError() : "sin muestras");
+      return false;
+    }
+  } else {
+    MappedFile mapped;
+    if (!mapped.open(path.c_str())) {
+      fprintf(stderr, "%s: no se pudo leer\n", file.path.c_str());
+      return false;
+    }
+    const char *end = mapped.data + mapped.size;
+    if (file.format == BATCH_CSV) {
+      if (!parseCsv(mapped.data, end, w.signal)) {
+        fprintf(stderr, "%s: valor que no es un numero\n", file.path.c_str());
+        return false;
+      }
+      r.rate = options.csvRate;
+    } else {
+      parseDeviceText(mapped.data, end, options.lead, w.signal);
+      r.rate = options.txtRate;
+    }
+  }
+  uint32_t n = w.signal.size();
+  r.samples = n;
+
+  // Filtros y QRS de FilterTask, una muestra a la vez
+  EcgFilterBankConfig config = ecgDefaultFilterConfig;
+  config.sampleRate = r.rate;
+  if (config.notchHz >= r.rate / 2) {
+    config.notchHz = 0;
+  }
+  if (config.lowPassHz >= r.rate / 2) {
+    config.lowPassHz = 0;
+  }
+  w.bank.configure(config);
+  w.qrs.begin(r.rate);
+  w.peaks.clear();
+  for (uint32_t i = 0; i < n; i++) {
+    float lead[ECG_LEADS] = {w.signal[i], 0, 0};
+    w.bank.process(lead);
+    if (w.qrs.process(lead[0])) {
+      w.peaks.push_back(w.qrs.lastPeak());
+    }
+  }
+  r.beats = w.peaks.size();
+  if (r.beats >= 2) {
+    double sum = 0, sumSq = 0;
+    for (uint32_t i = 1; i < r.beats; i++) {
+      double rr = (w.peaks[i] - w.peaks[i - 1]) * 1000.0 / r.rate;
+      sum += rr;
+      sumSq += rr * rr;
+    }
+    uint32_t count = r.beats - 1;
+    double mean = sum / count;
+    double var = sumSq / count - mean * mean;
+    r.rrMeanMs = (float)mean;
+    r.rrStdMs = (float)sqrt(var > 0 ? var : 0);
+    r.bpm = (float)(60000.0 / mean);
+  }
+
+  // Preprocesamiento del notebook; el denoising puede dar una muestra más
+  w.denoised.resize(n + 1);
+  w.coeffs.resize(ecgWavedecBound(n + 1, ECG_MODEL_FEATURE_LEVEL));
+  w.scratch.resize(ecgDwtLength(n + 1) + 1);
+  uint32_t m = ecgWaveletDenoise(w.signal.data(), n, w.denoised.data(), w.coeffs.data(), w.scratch.data(),
+                                 ECG_MODEL_DENOISE_LEVEL);
+  if (m == 0 || !ecgWaveletFeatures(w.denoised.data(), m, r.features, w.coeffs.data(), w.scratch.data())) {
+    fprintf(stderr, "%s: %u muestras no alcanzan para el nivel %d\n", file.path.c_str(), (unsigned)n,
+            ECG_MODEL_FEATURE_LEVEL);
+    for (int i = 0; i < ECG_MODEL_FEATURES; i++) {
+      r.features[i] = NAN;
+    }
+    return false;
+  }
+  r.ok = true;
+  return true;
+}
+
+// ---------------------------------------------------------------- Hilos
+
+// Una cola por hilo: el dueño toma del final y los demás roban del principio
+// (los archivos más grandes, que se repartieron primero)
+struct WorkQueue {
+  std::mutex lock;
+  std::deque<uint32_t> items;
+};
+
+static bool takeOwn(WorkQueue &q, uint32_t &item) {
+  std::lock_guard<std::mutex> guard(q.lock);
+  if (q.items.empty()) {
+    return false;
+  }
+  item = q.items.back();
+  q.items.pop_back();
+  return true;
+}
+
+static bool steal(std::vector<WorkQueue> &queues, int self, uint32_t &item) {
+  int count = queues.size();
+  for (int k = 1; k < count; k++) {
+    WorkQueue &q = queues[(self + k) % count];
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (!q.items.empty()) {
+      item = q.items.front();
+      q.items.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+// Analiza todos los archivos con `threads` hilos; devuelve los segundos
+static double runBatch(const std::string &root, const std::vector<BatchFile> &files, const BatchOptions &options,
+                       int threads, std::vector<BatchResult> &results, std::vector<Workspace> &workspaces) {
+  std::vector<uint32_t> order(files.size());
+  for (uint32_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return files[a].bytes > files[b].bytes; });
+  std::vector<WorkQueue> queues(threads);
+  for (uint32_t i = 0; i < order.size(); i++) {
+    queues[i % threads].items.push_back(order[i]);
+  }
+  results.assign(files.size(), BatchResult());
+  workspaces.clear();
+  workspaces.resize(threads);
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for (int t = 0; t < threads; t++) {
+    pool.emplace_back([&, t] {
+      Workspace &w = workspaces[t];
+      uint32_t item;
+      for (;;) {
+        bool own = takeOwn(queues[t], item);
+        if (!own && !steal(queues, t, item)) {
+          break;   // Nadie agrega trabajo: si no hay nada que robar, terminó
+        }
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        analyze(root, files[item], options, w, results[item]);
+        w.busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        w.processed++;
+        w.stolen += own ? 0 : 1;
+      }
+    });
+  }
+  for (size_t t = 0; t < pool.size(); t++) {
+    pool[t].join();
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// ---------------------------------------------------------------- .npz
+
+static uint32_t crcTable[256];
+
+static void initCrc32() {
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; k++) {
+      c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+    }
+    crcTable[i] = c;
+  }
+}
+
+static uint32_t crc32(const uint8_t *data, size_t len) {
+  uint32_t c = 0xFFFFFFFFu;
+  for (size_t i = 0; i < len; i++) {
+    c = crcTable[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+  }
+  return c ^ 0xFFFFFFFFu;
+}
+
+static void put16(std::vector<uint8_t> &b, uint16_t v) {
+  b.push_back(v & 0xFF);
+  b.push_back(v >> 8);
+}
+
+static void put32(std::vector<uint8_t> &b, uint32_t v) {
+  put16(b, v & 0xFFFF);
+  put16(b, v >> 16);
+}
+
+// Zip sin compresión con un .npy (formato 1.0) por columna, como np.savez
+class NpzWriter {
+public:
+  bool open(const char *path) {
+    f = fopen(path, "wb");
+    offset = 0;
+    return f != NULL;
+  }
+
+  void add(const std::string &name, const char *descr, uint32_t rows, const void *data, size_t itemBytes) {
+    std::string header = std::string("{'descr': '") + descr + "', 'fortran_order': False, 'shape': (" +
+                         std::to_string(rows) + ",), }";
+    // Los datos empiezan alineados a 64 bytes; la cabecera termina en '\n'
+    while ((10 + header.size() + 1) % 64 != 0) {
+      header += ' ';
+    }
+    header += '\n';
+    std::vector<uint8_t> npy;
+    const char magic[] = "\x93NUMPY\x01\x00";
+    npy.insert(npy.end(), magic, magic + 8);
+    put16(npy, header.size());
+    npy.insert(npy.end(), header.begin(), header.end());
+    const uint8_t *bytes = (const uint8_t *)data;
+    npy.insert(npy.end(), bytes, bytes + (size_t)rows * itemBytes);
+
+    Entry e;
+    e.name = name + ".npy";
+    e.crc = crc32(npy.data(), npy.size());
+    e.size = npy.size();
+    e.offset = offset;
+    std::vector<uint8_t> local;
+    put32(local, 0x04034b50);
+    put16(local, 20);
+    put16(local, 0);               // Sin flags
+    put16(local, 0);               // Sin compresión
+    put16(local, 0);               // 00:00
+    put16(local, 0x21);            // 1980-01-01
+    put32(local, e.crc);
+    put32(local, e.size);
+    put32(local, e.size);
+    put16(local, e.name.size());
+    put16(local, 0);
+    local.insert(local.end(), e.name.begin(), e.name.end());
+    write(local);
+    write(npy);
+    entries.push_back(e);
+  }
+
+  bool close() {
+    std::vector<uint8_t> dir;
+    for (size_t i = 0; i < entries.size(); i++) {
+      const Entry &e = entries[i];
+      put32(dir, 0x02014b50);
+      put16(dir, 20);
+      put16(dir, 20);
+      put16(dir, 0);
+      put16(dir, 0);
+      put16(dir, 0);
+      put16(dir, 0x21);
+      put32(dir, e.crc);
+      put32(dir, e.size);
+      put32(dir, e.size);
+      put16(dir, e.name.size());
+      put16(dir, 0);               // Extra
+      put16(dir, 0);               // Comentario
+      put16(dir, 0);               // Disco
+      put16(dir, 0);               // Atributos internos
+      put32(dir, 0);               // Atributos externos
+      put32(dir, e.offset);
+      dir.insert(dir.end(), e.name.begin(), e.name.end());
+    }
+    uint64_t dirOffset = offset;
+    uint32_t dirSize = dir.size();
+    put32(dir, 0x06054b50);
+    put16(dir, 0);
+    put16(dir, 0);
+    put16(dir, entries.size());
+    put16(dir, entries.size());
+    put32(dir, dirSize);
+    put32(dir, dirOffset);
+    put16(dir, 0);
+    write(dir);
+    // Sin zip64: hasta 4 GB, de sobra para una fila por archivo
+    bool ok = !ferror(f) && offset < 0xFFFFFFFFull;
+    return fclose(f) == 0 && ok;
+  }
+
+private:
+  struct Entry {
+    std::string name;
+    uint32_t crc, size;
+    uint64_t offset;
+  };
+
+  void write(const std::vector<uint8_t> &b) {
+    fwrite(b.data(), 1, b.size(), f);
+    offset += b.size();
+  }
+
+  FILE *f;
+  uint64_t offset;
+  std::vector<Entry> entries;
+};
+
+// UTF-8 a UTF-32 para la columna de nombres ('<U', sin pickle)
+static std::vector<uint32_t> utf32(const std::string &s) {
+  std::vector<uint32_t> out;
+  for (size_t i = 0; i < s.size();) {
+    uint8_t c = s[i];
+    int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+    uint32_t cp = extra == 0 ? c : c & (0x3F >> extra);
+    i++;
+    for (int k = 0; k < extra && i < s.size(); k++, i++) {
+      cp = (cp << 6) | (s[i] & 0x3F);
+    }
+    out.push_back(cp);
+  }
+  return out;
+}
+
+static bool writeFeatures(const char *path, const std::vector<BatchFile> &files,
+                          const std::vector<BatchResult> &results) {
+  NpzWriter npz;
+  if (!npz.open(path)) {
+    return false;
+  }
+  uint32_t rows = files.size();
+  size_t width = 1;
+  std::vector<std::vector<uint32_t> > names(rows);
+  for (uint32_t i = 0; i < rows; i++) {
+    names[i] = utf32(files[i].path);
+    width = std::max(width, names[i].size());
+  }
+  std::vector<uint32_t> nameData(rows * width, 0);
+  for (uint32_t i = 0; i < rows; i++) {
+    std::copy(names[i].begin(), names[i].end(), nameData.begin() + i * width);
+  }
+  npz.add("file", ("<U" + std::to_string(width)).c_str(), rows, nameData.data(), width * 4);
+
+  std::vector<int32_t> ints(rows);
+  std::vector<float> floats(rows);
+  for (uint32_t i = 0; i < rows; i++) ints[i] = files[i].label;
+  npz.add("label", "<i4", rows, ints.data(), 4);
+  for (uint32_t i = 0; i < rows; i++) ints[i] = results[i].ok;
+  npz.add("ok", "<i4", rows, ints.data(), 4);
+  for (uint32_t i = 0; i < rows; i++) ints[i] = results[i].samples;
+  npz.add("samples", "<i4", rows, ints.data(), 4);
+  for (uint32_t i = 0; i < rows; i++) floats[i] = results[i].rate;
+  npz.add("rate", "<f4", rows, floats.data(), 4);
+  for (uint32_t i = 0; i < rows; i++) ints[i] = results[i].beats;
+  npz.add("beats", "<i4", rows, ints.data(), 4);
+  for (uint32_t i = 0; i < rows; i++) floats[i] = results[i].bpm;
+  npz.add("bpm", "<f4", rows, floats.data(), 4);
+  for (uint32_t i = 0; i < rows; i++) floats[i] = results[i].rrMeanMs;
+  npz.add("rr_mean_ms", "<f4", rows, floats.data(), 4);
+  for (uint32_t i = 0; i < rows; i++) floats[i] = results[i].rrStdMs;
+  npz.add("rr_std_ms", "<f4", rows, floats.data(), 4);
+
+  // Orden de extract_wavelet_features: cA6, cD6, ..., cD1 y en cada banda
+  // media, desvío, máximo, mínimo y mediana
+  static const char *const stats[] = {"mean", "std", "max", "min", "median"};
+  for (int f = 0; f < ECG_MODEL_FEATURES; f++) {
+    int band = f / 5;
+    char name[32];
+    if (band == 0) {
+      snprintf(name, sizeof(name), "cA%d_%s", ECG_MODEL_FEATURE_LEVEL, stats[f % 5]);
+    } else {
+      snprintf(name, sizeof(name), "cD%d_%s", ECG_MODEL_FEATURE_LEVEL + 1 - band, stats[f % 5]);
+    }
+    for (uint32_t i = 0; i < rows; i++) floats[i] = results[i].features[f];
+    npz.add(name, "<f4", rows, floats.data(), 4);
+  }
+  return npz.close();
+}
+
+// ---------------------------------------------------------------- main
+
+static void printRun(int threads, double seconds, const std::vector<BatchFile> &files,
+                     const std::vector<BatchResult> &results, const std::vector<Workspace> &workspaces) {
+  uint64_t bytes = 0, samples = 0;
+  uint32_t ok = 0;
+  for (size_t i = 0; i < files.size(); i++) {
+    bytes += files[i].bytes;
+    samples += results[i].samples;
+    ok += results[i].ok ? 1 : 0;
+  }
+  printf("hilos               : %d\n", threads);
+  printf("archivos            : %u (%u con error)\n", (unsigned)files.size(), (unsigned)(files.size() - ok));
+  printf("tiempo              : %.3f s\n", seconds);
+  printf("rendimiento         : %.1f archivos/s, %.1f MB/s, %.2f Mmuestras/s\n", files.size() / seconds,
+         bytes / seconds / 1e6, samples / seconds / 1e6);
+  for (size_t t = 0; t < workspaces.size(); t++) {
+    const Workspace &w = workspaces[t];
+    printf("  hilo %-2u           : %u archivos (%u robados), ocupado %.0f %%\n", (unsigned)t,
+           (unsigned)w.processed, (unsigned)w.stolen, seconds > 0 ? 100.0 * w.busySeconds / seconds : 0);
+  }
+}
+
+int main(int argc, char **argv) {
+  const char *root = NULL;
+  const char *outPath = NULL;
+  BatchOptions options;
+  int threads = std::thread::hardware_concurrency();
+  bool scaling = false;
+  int leadArg = ECG_MODEL_LEAD + 1;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--csv-rate") && i + 1 < argc) {
+      options.csvRate = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--txt-rate") && i + 1 < argc) {
+      options.txtRate = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--lead") && i + 1 < argc) {
+      leadArg = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--scaling")) {
+      scaling = true;
+    } else if (argv[i][0] != '-' && !root) {
+      root = argv[i];
+    } else if (argv[i][0] != '-' && !outPath) {
+      outPath = argv[i];
+    } else {
+      root = NULL;
+      break;
+    }
+  }
+  if (!root || !outPath || leadArg < 1 || leadArg > ECG_LEADS || options.csvRate <= 0 || options.txtRate <= 0) {
+    fprintf(stderr, "uso: ecg_batch CARPETA SALIDA.npz [--threads N] [--csv-rate HZ] [--txt-rate HZ]\n"
+                    "                 [--lead 1-3] [--scaling]\n");
+    return 2;
+  }
+  options.lead = leadArg - 1;
+  threads = threads < 1 ? 1 : threads;
+  initCrc32();
+
+  std::vector<BatchFile> files;
+  collectFiles(root, "", files);
+  if (files.empty()) {
+    fprintf(stderr, "no hay .csv, ECG_*.txt ni .ecg en %s\n", root);
+    return 1;
+  }
+  // Orden estable de las filas, independiente del reparto entre hilos
+  std::sort(files.begin(), files.end(), [](const BatchFile &a, const BatchFile &b) { return a.path < b.path; });
+
+  std::vector<BatchResult> results;
+  std::vector<Workspace> workspaces;
+  if (scaling) {
+    double single = 0;
+    printf("hilos  tiempo (s)  aceleracion  eficiencia\n");
+    for (int t = 1;; t = std::min(2 * t, threads)) {
+      double seconds = runBatch(root, files, options, t, results, workspaces);
+      single = t == 1 ? seconds : single;
+      printf("%5d  %10.3f  %11.2f  %9.0f %%\n", t, seconds, single / seconds, 100.0 * single / seconds / t);
+      if (t == threads) {
+        break;
+      }
+    }
+  }
+  double seconds = runBatch(root, files, options, threads, results, workspaces);
+  printRun(threads, seconds, files, results, workspaces);
+  if (!writeFeatures(outPath, files, results)) {
+    fprintf(stderr, "no se pudo escribir %s\n", outPath);
+    return 1;
+  }
+  printf("salida              : %s (%u filas, %d columnas)\n", outPath, (unsigned)files.size(),
+         9 + ECG_MODEL_FEATURES);
+  return 0;
+}
@@ -0,0 +1,503 @@
+// Mide por separado cada parte de cálculo del sketch sobre entradas fijas y
+// compara contra una corrida anterior:
+//
+//   filtros    banco de filtros de FilterTask sobre las tres derivaciones (1 kHz)
+//   wavelet    limpieza por wavelets nivel 4 de las tres derivaciones filtradas
+//   qrs        detector de QRS sobre la derivación 1 filtrada
+//   grabar     EcgRecordEncoder + EcgPyramidBuilder de lo que se graba (200 Hz)
+//   leer-ecg   EcgRecordSource del .ecg anterior, como el visor
+//   leer-txt   EcgTextSource del mismo registro en texto
+//   barrido    EcgSweepRenderer sobre una pantalla en memoria
+//
+//   ecg_bench [--seconds 10,60,600] [--record ECG_1234.txt|.ecg] [--rate 200] [--repeat 5]
+//             [--csv resultados.csv] [--baseline anterior.csv] [--max-regression 10]
+//
+// Las entradas son señales sintéticas de cada duración (con ruido fijo, así
+// que se repiten igual) y, con --record, una medición real. Cada caso corre
+// --repeat veces (cada vez al menos 20 ms de CPU) y se queda con la más
+// rápida. El resultado sale en CSV:
+//
+//   caso,entrada,muestras,segundos,muestras_por_s,control
+//
+// `control` es un valor que no depende de la velocidad (latidos, bytes,
+// columnas): si cambia, cambió la salida. Con --baseline el programa termina
+// con 1 si algún caso bajó más de --max-regression % en muestras_por_s o si
+// cambió su control.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ecg_hal_host.h"
+#include "../ecg_denoise.h"
+#include "../ecg_filter.h"
+#include "../ecg_playback.h"
+#include "../ecg_pyramid.h"
+#include "../ecg_qrs.h"
+#include "../ecg_record.h"
+#include "../ecg_render.h"
+
+// Señal de entrada a la frecuencia de adquisición: dos canales crudos (V)
+struct Input {
+  std::string name;
+  double rate;
+  std::vector<float> raw;   // XS1, XS2 intercalados
+};
+
+struct Result {
+  std::string bench;
+  std::string input;
+  uint32_t frames;
+  double seconds;
+  uint64_t check;
+};
+
+static const int acquisitionHz = 1000;
+static const int decimation = 5;
+
+// Tiempo de CPU del hilo: lo que el sistema le quita al proceso no cuenta
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool endsWith(const char *s, const char *suffix) {
+  size_t n = strlen(s), m = strlen(suffix);
+  return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+static void synthesize(double seconds, Input &in) {
+  char name[32];
+  snprintf(name, sizeof(name), "sintetica-%gs", seconds);
+  in.name = name;
+  in.rate = acquisitionHz;
+  uint32_t frames = (uint32_t)(seconds * acquisitionHz);
+  in.raw.resize(frames * 2);
+  uint32_t noise = 1;
+  for (uint32_t i = 0; i < frames; i++) {
+    double t = (double)i / acquisitionHz;
+    for (int c = 0; c < 2; c++) {
+      noise ^= noise << 13;
+      noise ^= noise >> 17;
+      noise ^= noise << 5;
+      double v = HostSyntheticAdc::waveform(t, 72, c) + ((noise & 0xFFFF) / 65535.0 - 0.5) * 0.01;
+      in.raw[i * 2 + c] = (float)v;
+    }
+  }
+}
+
+// Medición guardada: d1 y d2 hacen de canales crudos a su frecuencia
+static bool loadRecord(const char *path, uint32_t rate, Input &in) {
+  HostStorage storage("");
+  EcgFile *file = storage.open(path, ECG_OPEN_READ);
+  if (!file) {
+    return false;
+  }
+  static EcgRecordReader reader;
+  static EcgRecordSource recordSource(reader);
+  static EcgTextSource textSource;
+  EcgPlaybackSource *source;
+  bool ok;
+  if (endsWith(path, ".ecg")) {
+    ok = recordSource.open(file);
+    source = &recordSource;
+  } else {
+    ok = textSource.open(file, rate);
+    source = &textSource;
+  }
+  if (!ok) {
+    file->close();
+    return false;
+  }
+  const char *slash = strrchr(path, '/');
+  in.name = slash ? slash + 1 : path;
+  in.rate = source->sampleRate();
+  float volts[256 * ECG_LEADS];
+  uint32_t n;
+  while ((n = source->read(volts, 256)) > 0) {
+    for (uint32_t i = 0; i < n; i++) {
+      in.raw.push_back(volts[i * ECG_LEADS]);
+      in.raw.push_back(volts[i * ECG_LEADS + 1]);
+    }
+  }
+  file->close();
+  return !in.raw.empty();
+}
+
+// Lo que produce FilterTask para la entrada (lo usan las etapas siguientes)
+static EcgFilterBank bank;
+static std::vector<float> filtered;
+
+static uint64_t runFilters(const Input &in) {
+  EcgFilterBankConfig config = ecgDefaultFilterConfig;
+  config.sampleRate = in.rate;
+  bank.configure(config);
+  uint32_t frames = in.raw.size() / 2;
+  filtered.resize(frames * ECG_LEADS);
+  for (uint32_t i = 0; i < frames; i++) {
+    float *lead = &filtered[i * ECG_LEADS];
+    lead[0] = in.raw[i * 2];
+    lead[1] = in.raw[i * 2 + 1];
+    lead[2] = lead[1] - lead[0];
+    bank.process(lead);
+  }
+  // Control: suma de la salida en pasos de 10 uV
+  int64_t sum = 0;
+  for (size_t i = 0; i < filtered.size(); i++) {
+    sum += lroundf(filtered[i] * 1e5f);
+  }
+  return (uint64_t)sum;
+}
+
+static EcgWaveletDenoiser denoisers[ECG_LEADS];
+
+static uint64_t runDenoise(const Input &in) {
+  int64_t sum = 0;
+  uint32_t frames = filtered.size() / ECG_LEADS;
+  for (int l = 0; l < ECG_LEADS; l++) {
+    denoisers[l].begin(4, ECG_DENOISE_LIVE_WINDOW);
+  }
+  for (uint32_t i = 0; i < frames; i++) {
+    for (int l = 0; l < ECG_LEADS; l++) {
+      sum += lroundf(denoisers[l].process(filtered[i * ECG_LEADS + l]) * 1e5f);
+    }
+  }
+  return (uint64_t)sum;
+}
+
+static EcgQrsDetector qrs;
+
+static uint64_t runQrs(const Input &in) {
+  qrs.begin(in.rate);
+  uint64_t beats = 0;
+  uint32_t frames = filtered.size() / ECG_LEADS;
+  for (uint32_t i = 0; i < frames; i++) {
+    beats += qrs.process(filtered[i * ECG_LEADS]);
+  }
+  return beats;
+}
+
+static std::vector<uint8_t> recordBytes;
+static std::vector<uint8_t> pyramidBytes;
+
+static bool appendTo(const uint8_t *data, uint32_t len, void *ctx) {
+  std::vector<uint8_t> &out = *(std::vector<uint8_t> *)ctx;
+  out.insert(out.end(), data, data + len);
+  return true;
+}
+
+static EcgRecordEncoder encoder;
+static EcgPyramidBuilder pyramid;
+
+static uint32_t recordStep(const Input &in) {
+  return in.rate >= acquisitionHz ? decimation : 1;
+}
+
+static uint64_t runRecord(const Input &in) {
+  recordBytes.clear();
+  pyramidBytes.clear();
+  uint32_t step = recordStep(in);
+  encoder.begin(in.rate / step, 0, appendTo, &recordBytes);
+  pyramid.begin(encoder.header(), appendTo, &pyramidBytes);
+  uint32_t frames = filtered.size() / ECG_LEADS;
+  for (uint32_t i = 0; i < frames; i += step) {
+    encoder.addFrame(&filtered[i * ECG_LEADS]);
+    pyramid.addFrame(&filtered[i * ECG_LEADS]);
+  }
+  encoder.finish();
+  pyramid.finish();
+  memcpy(&recordBytes[0], &encoder.header(), sizeof(EcgRecordHeader));
+  return recordBytes.size() + pyramidBytes.size();
+}
+
+static std::string workDir;
+
+static bool writeFile(const std::string &path, const void *data, size_t len) {
+  FILE *f = fopen(path.c_str(), "wb");
+  if (!f) {
+    return false;
+  }
+  bool ok = fwrite(data, 1, len, f) == len;
+  return fclose(f) == 0 && ok;
+}
+
+static uint64_t readAll(EcgPlaybackSource &source) {
+  float volts[256 * ECG_LEADS];
+  uint64_t frames = 0;
+  uint32_t n;
+  while ((n = source.read(volts, 256)) > 0) {
+    frames += n;
+  }
+  return frames;
+}
+
+static uint64_t runReadRecord(const Input &in) {
+  HostStorage storage(workDir.c_str());
+  EcgFile *file = storage.open("/bench.ecg", ECG_OPEN_READ);
+  static EcgRecordReader reader;
+  EcgRecordSource source(reader);
+  if (!file || !source.open(file)) {
+    return 0;
+  }
+  uint64_t frames = readAll(source);
+  file->close();
+  return frames;
+}
+
+static uint64_t runReadText(const Input &in) {
+  HostStorage storage(workDir.c_str());
+  EcgFile *file = storage.open("/bench.txt", ECG_OPEN_READ);
+  static EcgTextSource source;
+  if (!file || !source.open(file, in.rate / recordStep(in))) {
+    return 0;
+  }
+  uint64_t frames = readAll(source);
+  file->close();
+  return frames;
+}
+
+static EcgSweepRenderer sweep;
+
+static uint64_t runSweep(const Input &in) {
+  sweep.begin(in.rate, 125);
+  sweep.drawLayout();
+  uint32_t frames = filtered.size() / ECG_LEADS;
+  EcgFrame frame;
+  for (uint32_t i = 0; i < frames; i++) {
+    frame.seq = i;
+    frame.timeUs = 0;
+    for (int l = 0; l < ECG_LEADS; l++) {
+      frame.lead[l] = filtered[i * ECG_LEADS + l];
+    }
+    sweep.addFrame(frame);
+  }
+  sweep.flush();
+  return sweep.columnsDrawn;
+}
+
+typedef uint64_t (*BenchFunction)(const Input &in);
+
+static const double minSeconds = 0.02;
+
+static Result measure(const char *bench, const Input &in, BenchFunction fn, uint32_t frames, int repeat) {
+  Result r;
+  r.bench = bench;
+  r.input = in.name;
+  r.frames = frames;
+  r.seconds = 0;
+  for (int i = 0; i < repeat; i++) {
+    // Las entradas cortas se repiten hasta juntar minSeconds para que el
+    // reloj y las interrupciones no pesen en el resultado
+    double t0 = now();
+    double elapsed;
+    int runs = 0;
+    do {
+      r.check = fn(in);
+      runs++;
+      elapsed = now() - t0;
+    } while (elapsed < minSeconds);
+    elapsed /= runs;
+    if (i == 0 || elapsed < r.seconds) {
+      r.seconds = elapsed;
+    }
+  }
+  return r;
+}
+
+static void runInput(const Input &in, int repeat, std::vector<Result> &results) {
+  uint32_t frames = in.raw.size() / 2;
+  uint32_t recorded = (frames + recordStep(in) - 1) / recordStep(in);
+  results.push_back(measure("filtros", in, runFilters, frames, repeat));
+  results.push_back(measure("wavelet", in, runDenoise, frames, repeat));
+  results.push_back(measure("qrs", in, runQrs, frames, repeat));
+  results.push_back(measure("grabar", in, runRecord, recorded, repeat));
+
+  // Los lectores leen lo que se acaba de grabar, en los dos formatos
+  std::string text;
+  char line[64];
+  for (uint32_t i = 0; i < frames; i += recordStep(in)) {
+    const float *f = &filtered[i * ECG_LEADS];
+    snprintf(line, sizeof(line), "%.2f,%.2f,%.2f\r\n", f[0], f[1], f[2]);
+    text += line;
+  }
+  if (!writeFile(workDir + "/bench.ecg", &recordBytes[0], recordBytes.size()) ||
+      !writeFile(workDir + "/bench.txt", text.data(), text.size())) {
+    fprintf(stderr, "no se pudo escribir en %s\n", workDir.c_str());
+    return;
+  }
+  results.push_back(measure("leer-ecg", in, runReadRecord, recorded, repeat));
+  results.push_back(measure("leer-txt", in, runReadText, recorded, repeat));
+  results.push_back(measure("barrido", in, runSweep, frames, repeat));
+}
+
+static void printCsv(FILE *out, const std::vector<Result> &results) {
+  fprintf(out, "caso,entrada,muestras,segundos,muestras_por_s,control\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result &r = results[i];
+    fprintf(out, "%s,%s,%u,%.6f,%.0f,%llu\n", r.bench.c_str(), r.input.c_str(), (unsigned)r.frames, r.seconds,
+            r.frames / r.seconds, (unsigned long long)r.check);
+  }
+}
+
+struct Baseline {
+  double rate;
+  uint64_t check;
+};
+
+static bool loadBaseline(const char *path, std::map<std::string, Baseline> &baseline) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return false;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    char bench[64], input[128];
+    unsigned frames;
+    double seconds, rate;
+    unsigned long long check;
+    if (sscanf(line, "%63[^,],%127[^,],%u,%lf,%lf,%llu", bench, input, &frames, &seconds, &rate, &check) == 6) {
+      Baseline b = {rate, check};
+      baseline[std::string(bench) + "," + input] = b;
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+// Devuelve cuántos casos empeoraron
+static int compare(const std::vector<Result> &results, const std::map<std::string, Baseline> &baseline,
+                   double maxRegression) {
+  int failures = 0;
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result &r = results[i];
+    std::map<std::string, Baseline>::const_iterator it = baseline.find(r.bench + "," + r.input);
+    if (it == baseline.end()) {
+      continue;
+    }
+    double rate = r.frames / r.seconds;
+    double change = (rate / it->second.rate - 1) * 100;
+    const char *verdict = "ok";
+    if (r.check != it->second.check) {
+      verdict = "CAMBIO LA SALIDA";
+      failures++;
+    } else if (change < -maxRegression) {
+      verdict = "REGRESION";
+      failures++;
+    }
+    fprintf(stderr, "%-9s %-20s %+7.1f %%  %s\n", r.bench.c_str(), r.input.c_str(), change, verdict);
+  }
+  return failures;
+}
+
+static void usage() {
+  fprintf(stderr, "uso: ecg_bench [--seconds S1,S2,...] [--record ARCHIVO] [--rate HZ] [--repeat N]\n"
+                  "                [--csv ARCHIVO] [--baseline ARCHIVO] [--max-regression PCT]\n");
+}
+
+int main(int argc, char **argv) {
+  const char *secondsList = "10,60,600";
+  const char *recordPath = NULL;
+  uint32_t recordRate = 200;
+  int repeat = 5;
+  const char *csvPath = NULL;
+  const char *baselinePath = NULL;
+  double maxRegression = 10;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+      secondsList = argv[++i];
+    } else if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+      recordPath = argv[++i];
+    } else if (!strcmp(argv[i], "--rate") && i + 1 < argc) {
+      recordRate = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+      repeat = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--csv") && i + 1 < argc) {
+      csvPath = argv[++i];
+    } else if (!strcmp(argv[i], "--baseline") && i + 1 < argc) {
+      baselinePath = argv[++i];
+    } else if (!strcmp(argv[i], "--max-regression") && i + 1 < argc) {
+      maxRegression = atof(argv[++i]);
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (repeat < 1) {
+    repeat = 1;
+  }
+
+  std::map<std::string, Baseline> baseline;
+  if (baselinePath && !loadBaseline(baselinePath, baseline)) {
+    fprintf(stderr, "no se pudo leer %s\n", baselinePath);
+    return 2;
+  }
+
+  // El renderizador dibuja sobre hal.display y toma tiempos de hal.clock
+  HostClock clock(true);
+  HostFramebuffer display;
+  hal.clock = &clock;
+  hal.display = &display;
+
+  char dir[] = "/tmp/ecg_bench.XXXXXX";
+  if (!mkdtemp(dir)) {
+    fprintf(stderr, "no se pudo crear un directorio temporal\n");
+    return 1;
+  }
+  workDir = dir;
+
+  std::vector<Input> inputs;
+  for (const char *p = secondsList; *p;) {
+    double seconds = strtod(p, (char **)&p);
+    if (seconds > 0) {
+      inputs.push_back(Input());
+      synthesize(seconds, inputs.back());
+    }
+    while (*p == ',' || *p == ' ') {
+      p++;
+    }
+    if (*p && (*p < '0' || *p > '9') && *p != '.') {
+      break;
+    }
+  }
+  if (recordPath) {
+    inputs.push_back(Input());
+    if (!loadRecord(recordPath, recordRate, inputs.back())) {
+      fprintf(stderr, "no se pudo leer %s\n", recordPath);
+      return 1;
+    }
+  }
+
+  std::vector<Result> results;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    runInput(inputs[i], repeat, results);
+  }
+  unlink((workDir + "/bench.ecg").c_str());
+  unlink((workDir + "/bench.txt").c_str());
+  rmdir(workDir.c_str());
+
+  printCsv(stdout, results);
+  if (csvPath) {
+    FILE *out = fopen(csvPath, "w");
+    if (!out) {
+      fprintf(stderr, "no se pudo abrir %s\n", csvPath);
+      return 1;
+    }
+    printCsv(out, results);
+    fclose(out);
+  }
+  if (baselinePath) {
+    int failures = compare(results, baseline, maxRegression);
+    if (failures > 0) {
+      fprintf(stderr, "%d casos empeoraron respecto de %s\n", failures, baselinePath);
+      return 1;
+    }
+  }
+  return 0;
+}
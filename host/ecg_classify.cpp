@@ -0,0 +1,253 @@
+// Clasificador de infarto del equipo (ecg_classifier.h) en Linux.
+//
+//   ecg_classify --model modelo.ecgm --check referencia.ecgr [--min-agreement 0.98]
+//                [--max-error 0.05] [--max-feature-error 0.001]
+//   ecg_classify --model modelo.ecgm ECG_1234.ecg [--at S] [--replay-rate 200]
+//
+// El modelo y la referencia los escribe host/ecg_model_export.py a partir del
+// .h5 de IA_ISB.ipynb. La referencia trae, por registro, la señal cruda, las
+// características que calcula el notebook con pywt y las probabilidades de
+// Keras. --check corre cada señal por el mismo camino que el equipo y compara
+// las características (error absoluto máximo), las probabilidades y la clase;
+// sale con 1 si la coincidencia de clase o los errores no llegan a lo pedido.
+// Con una grabación (.ecg o .txt) clasifica 10 s desde el segundo S. En los
+// dos casos informa la latencia (preprocesamiento y red) y la memoria.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "ecg_hal_host.h"
+#include "../ecg_classifier.h"
+#include "../ecg_playback.h"
+#include "../ecg_record.h"
+
+static const uint32_t referenceMagic = 0x52474345;   // "ECGR"
+
+struct ReferenceHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t featureCount;
+  uint16_t classCount;
+  uint16_t reserved;
+  uint32_t count;
+};
+
+struct LatencyStats {
+  uint32_t count = 0;
+  uint64_t featureSum = 0, inferenceSum = 0;
+  uint32_t featureMax = 0, inferenceMax = 0;
+
+  void add(const EcgClassification &r) {
+    count++;
+    featureSum += r.featureUs;
+    inferenceSum += r.inferenceUs;
+    featureMax = r.featureUs > featureMax ? r.featureUs : featureMax;
+    inferenceMax = r.inferenceUs > inferenceMax ? r.inferenceUs : inferenceMax;
+  }
+  void print() const {
+    if (count == 0) {
+      return;
+    }
+    printf("preprocesamiento    : prom %.0f us, max %u us\n", (double)featureSum / count, (unsigned)featureMax);
+    printf("red                 : prom %.0f us, max %u us (%u MAC)\n", (double)inferenceSum / count,
+           (unsigned)inferenceMax, (unsigned)infarctClassifier.model.macs());
+  }
+};
+
+static void printMemory() {
+  printf("memoria por ventana : %u bytes (activaciones %u)\n", (unsigned)infarctClassifier.memoryBytes(),
+         (unsigned)infarctClassifier.model.arenaBytes());
+  printf("pico de ecgArena    : %u bytes\n", (unsigned)ecgArena.peakBytes());
+}
+
+// Los pesos se usan en el lugar: el buffer tiene que vivir lo que el modelo
+static std::vector<uint32_t> modelData;
+
+static bool loadModel(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "no se pudo abrir %s\n", path);
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  modelData.resize((size + 3) / 4);
+  bool ok = size > 0 && fread(modelData.data(), 1, size, f) == (size_t)size;
+  fclose(f);
+  if (!ok || !infarctClassifier.begin((const uint8_t *)modelData.data(), (uint32_t)size)) {
+    fprintf(stderr, "%s no es un modelo valido para %d caracteristicas\n", path, ECG_MODEL_FEATURES);
+    return false;
+  }
+  return true;
+}
+
+static int checkReference(const char *path, double minAgreement, double maxError, double maxFeatureError) {
+  FILE *f = fopen(path, "rb");
+  ReferenceHeader h;
+  if (!f || fread(&h, sizeof(h), 1, f) != 1 || h.magic != referenceMagic || h.version != 1 ||
+      h.featureCount != ECG_MODEL_FEATURES || h.classCount != infarctClassifier.model.classCount()) {
+    fprintf(stderr, "%s no es una referencia para este modelo\n", path);
+    return 1;
+  }
+  std::vector<float> signal;
+  float features[ECG_MODEL_FEATURES];
+  float expected[ECG_NN_MAX_CLASSES];
+  uint32_t agree = 0, tested = 0, confusion[ECG_NN_MAX_CLASSES][ECG_NN_MAX_CLASSES] = {};
+  double featureError = 0, probError = 0;
+  LatencyStats latency;
+  for (uint32_t r = 0; r < h.count; r++) {
+    uint32_t n;
+    int32_t label;
+    if (fread(&n, 4, 1, f) != 1 || fread(&label, 4, 1, f) != 1) {
+      break;
+    }
+    signal.resize(n);
+    if (fread(signal.data(), sizeof(float), n, f) != n ||
+        fread(features, sizeof(float), ECG_MODEL_FEATURES, f) != (size_t)ECG_MODEL_FEATURES ||
+        fread(expected, sizeof(float), h.classCount, f) != h.classCount) {
+      fprintf(stderr, "referencia cortada en el registro %u\n", (unsigned)r);
+      return 1;
+    }
+    EcgClassification result;
+    if (n > ECG_MODEL_WINDOW || !infarctClassifier.classify(signal.data(), n, result)) {
+      fprintf(stderr, "registro %u: no se pudo clasificar (%u muestras)\n", (unsigned)r, (unsigned)n);
+      continue;
+    }
+    latency.add(result);
+    tested++;
+    for (int i = 0; i < ECG_MODEL_FEATURES; i++) {
+      featureError = fmax(featureError, fabs(infarctClassifier.features[i] - features[i]));
+    }
+    int keras = 0;
+    for (uint32_t c = 0; c < h.classCount; c++) {
+      probError = fmax(probError, fabs(result.scores[c] - expected[c]));
+      keras = expected[c] > expected[keras] ? c : keras;
+    }
+    agree += result.label == keras;
+    confusion[keras][result.label]++;
+  }
+  fclose(f);
+  if (tested == 0) {
+    fprintf(stderr, "ningun registro clasificado\n");
+    return 1;
+  }
+  double agreement = (double)agree / tested;
+  printf("registros           : %u\n", (unsigned)tested);
+  printf("misma clase         : %u (%.2f %%)\n", (unsigned)agree, 100.0 * agreement);
+  printf("error caracteristica: %.2e (max)\n", featureError);
+  printf("error probabilidad  : %.4f (max)\n", probError);
+  printf("Keras \\ equipo     ");
+  for (uint32_t c = 0; c < h.classCount; c++) {
+    printf(" %9s", EcgInfarctClassifier::className(c));
+  }
+  printf("\n");
+  for (uint32_t k = 0; k < h.classCount; k++) {
+    printf("%-19s", EcgInfarctClassifier::className(k));
+    for (uint32_t c = 0; c < h.classCount; c++) {
+      printf(" %9u", (unsigned)confusion[k][c]);
+    }
+    printf("\n");
+  }
+  latency.print();
+  printMemory();
+  bool ok = agreement >= minAgreement && probError <= maxError && featureError <= maxFeatureError;
+  if (!ok) {
+    fprintf(stderr, "fuera de tolerancia (clase >= %.2f, probabilidad <= %.3f, caracteristica <= %.1e)\n",
+            minAgreement, maxError, maxFeatureError);
+  }
+  return ok ? 0 : 1;
+}
+
+static int classifyRecording(const char *path, double atSec, double textRate) {
+  HostStorage storage("");
+  hal.storage = &storage;
+  static EcgRecordReader reader;
+  static EcgRecordSource recordSource(reader);
+  static EcgTextSource textSource;
+  EcgFile *file = storage.open(path, ECG_OPEN_READ);
+  size_t len = strlen(path);
+  EcgPlaybackSource *source = NULL;
+  if (file) {
+    if (len > 4 && !strcmp(path + len - 4, ".ecg")) {
+      source = recordSource.open(file) ? &recordSource : NULL;
+    } else {
+      source = textSource.open(file, (uint32_t)textRate) ? &textSource : NULL;
+    }
+  }
+  if (!source) {
+    fprintf(stderr, "no se pudo abrir %s\n", path);
+    return 1;
+  }
+  EcgClassification result;
+  if (!infarctClassifier.classifySource(*source, (uint32_t)(atSec * source->sampleRate()), result)) {
+    fprintf(stderr, "no se pudo clasificar %s (hacen falta 10 s a %u Hz o mas)\n", path,
+            (unsigned)ECG_MODEL_RATE);
+    return 1;
+  }
+  printf("clase               : %s\n", EcgInfarctClassifier::className(result.label));
+  for (uint32_t c = 0; c < infarctClassifier.model.classCount(); c++) {
+    printf("  %-17s : %.3f\n", EcgInfarctClassifier::className(c), result.scores[c]);
+  }
+  LatencyStats latency;
+  latency.add(result);
+  latency.print();
+  printMemory();
+  file->close();
+  return 0;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "uso: ecg_classify --model ARCHIVO --check REFERENCIA [--min-agreement F] [--max-error F]\n"
+          "                  [--max-feature-error F]\n"
+          "     ecg_classify --model ARCHIVO GRABACION [--at S] [--replay-rate HZ]\n");
+}
+
+int main(int argc, char **argv) {
+  const char *modelPath = NULL;
+  const char *checkPath = NULL;
+  const char *recordPath = NULL;
+  double atSec = 0;
+  double textRate = 200;
+  double minAgreement = 0.98, maxError = 0.05, maxFeatureError = 1e-3;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--model") && i + 1 < argc) {
+      modelPath = argv[++i];
+    } else if (!strcmp(argv[i], "--check") && i + 1 < argc) {
+      checkPath = argv[++i];
+    } else if (!strcmp(argv[i], "--at") && i + 1 < argc) {
+      atSec = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--replay-rate") && i + 1 < argc) {
+      textRate = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--min-agreement") && i + 1 < argc) {
+      minAgreement = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--max-error") && i + 1 < argc) {
+      maxError = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--max-feature-error") && i + 1 < argc) {
+      maxFeatureError = atof(argv[++i]);
+    } else if (argv[i][0] != '-' && !recordPath) {
+      recordPath = argv[i];
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (!modelPath || (!checkPath && !recordPath)) {
+    usage();
+    return 2;
+  }
+  HostClock clock(true);
+  HostSerial serial(NULL);
+  hal.clock = &clock;
+  hal.serial = &serial;
+  if (!loadModel(modelPath)) {
+    return 1;
+  }
+  return checkPath ? checkReference(checkPath, minAgreement, maxError, maxFeatureError)
+                   : classifyRecording(recordPath, atSec, textRate);
+}
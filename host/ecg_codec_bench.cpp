@@ -0,0 +1,187 @@
+// Mide el codec sin pérdida de los chunks (ecg_codec.h): relación de
+// compresión contra int16 crudo y MB/s de codificación y decodificación.
+// Verifica además que la decodificación devuelva las mismas muestras.
+//
+//   ecg_codec_bench ECG_1234.ecg [--repeat 20]
+//   ecg_codec_bench ECG_1234.txt [--repeat 20]
+//
+// Los MB/s se cuentan sobre los bytes int16 de entrada (6 por muestra). Al
+// final se codifica ruido blanco, el peor caso, para ver el costo acotado por
+// partición.
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "ecg_hal_host.h"
+#include "../ecg_codec.h"
+#include "../ecg_record.h"
+
+struct Block {
+  uint32_t offset;
+  uint32_t bytes;
+  uint32_t frames;
+};
+
+static bool discard(const uint8_t *data, uint32_t len, void *ctx) {
+  return true;
+}
+
+static double now() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool endsWith(const char *s, const char *suffix) {
+  size_t n = strlen(s), m = strlen(suffix);
+  return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+static bool loadFrames(const char *path, std::vector<int16_t> &frames) {
+  if (endsWith(path, ".ecg")) {
+    HostStorage storage("");
+    EcgFile *file = storage.open(path, ECG_OPEN_READ);
+    static EcgRecordReader reader;
+    if (!file || !reader.open(file)) {
+      return false;
+    }
+    int16_t batch[256 * ECG_LEADS];
+    uint32_t n;
+    while ((n = reader.read(batch, 256)) > 0) {
+      frames.insert(frames.end(), batch, batch + n * ECG_LEADS);
+    }
+    file->close();
+    return true;
+  }
+  // Texto: misma escala que usa el codificador de grabaciones
+  static EcgRecordEncoder scale;
+  scale.begin(200, 0, discard, NULL);
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return false;
+  }
+  char line[128];
+  while (fgets(line, sizeof(line), f)) {
+    float v[ECG_LEADS];
+    if (sscanf(line, "%f,%f,%f", &v[0], &v[1], &v[2]) == 3) {
+      for (int l = 0; l < ECG_LEADS; l++) {
+        frames.push_back(ecgQuantize(v[l], scale.header().gain[l], scale.header().offset[l]));
+      }
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+// Parte las muestras en bloques del tamaño del payload de un chunk, como
+// EcgRecordEncoder
+static void encode(const std::vector<int16_t> &frames, std::vector<uint8_t> &out, std::vector<Block> &blocks) {
+  static EcgRiceEncoder rice;
+  uint32_t total = frames.size() / ECG_LEADS;
+  out.resize((total / 8 + 1) * ECG_CHUNK_PAYLOAD_MAX);
+  blocks.clear();
+  Block block = {0, 0, 0};
+  rice.begin(&out[0], ECG_CHUNK_PAYLOAD_MAX);
+  for (uint32_t i = 0; i < total; i += ECG_RICE_PARTITION) {
+    uint32_t n = total - i < (uint32_t)ECG_RICE_PARTITION ? total - i : ECG_RICE_PARTITION;
+    if (!rice.addPartition(&frames[i * ECG_LEADS], n)) {
+      block.bytes = rice.bytes();
+      blocks.push_back(block);
+      block.offset += ECG_CHUNK_PAYLOAD_MAX;
+      block.frames = 0;
+      rice.begin(&out[block.offset], ECG_CHUNK_PAYLOAD_MAX);
+      rice.addPartition(&frames[i * ECG_LEADS], n);
+    }
+    block.frames += n;
+  }
+  if (block.frames > 0) {
+    block.bytes = rice.bytes();
+    blocks.push_back(block);
+  }
+}
+
+static bool decode(const std::vector<uint8_t> &in, const std::vector<Block> &blocks, std::vector<int16_t> &frames) {
+  static EcgRiceDecoder decoder;
+  uint32_t at = 0;
+  for (size_t b = 0; b < blocks.size(); b++) {
+    decoder.begin(&in[blocks[b].offset], blocks[b].bytes);
+    for (uint32_t i = 0; i < blocks[b].frames; i += ECG_RICE_PARTITION) {
+      uint32_t n = blocks[b].frames - i < (uint32_t)ECG_RICE_PARTITION ? blocks[b].frames - i : ECG_RICE_PARTITION;
+      if (!decoder.decodePartition(&frames[(at + i) * ECG_LEADS], n)) {
+        return false;
+      }
+    }
+    at += blocks[b].frames;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "uso: ecg_codec_bench GRABACION.ecg|.txt [--repeat N]\n");
+    return 2;
+  }
+  int repeat = 20;
+  for (int i = 2; i + 1 < argc; i++) {
+    if (!strcmp(argv[i], "--repeat")) {
+      repeat = atoi(argv[++i]);
+    }
+  }
+  std::vector<int16_t> frames;
+  if (!loadFrames(argv[1], frames) || frames.empty()) {
+    fprintf(stderr, "no se pudieron leer muestras de %s\n", argv[1]);
+    return 1;
+  }
+  uint32_t total = frames.size() / ECG_LEADS;
+  double rawBytes = frames.size() * sizeof(int16_t);
+
+  std::vector<uint8_t> packed;
+  std::vector<Block> blocks;
+  double t0 = now();
+  for (int r = 0; r < repeat; r++) {
+    encode(frames, packed, blocks);
+  }
+  double encodeSec = (now() - t0) / repeat;
+
+  std::vector<int16_t> check(frames.size());
+  bool ok = true;
+  t0 = now();
+  for (int r = 0; r < repeat && ok; r++) {
+    ok = decode(packed, blocks, check);
+  }
+  double decodeSec = (now() - t0) / repeat;
+  if (!ok || check != frames) {
+    printf("ERROR: la decodificación no reproduce la entrada\n");
+    return 1;
+  }
+
+  double payload = 0;
+  for (size_t b = 0; b < blocks.size(); b++) {
+    payload += blocks[b].bytes;
+  }
+  uint32_t rawChunks = (total + ECG_RAW16_FRAMES_PER_CHUNK - 1) / ECG_RAW16_FRAMES_PER_CHUNK;
+  printf("Muestras:               %u (%.0f bytes int16)\n", (unsigned)total, rawBytes);
+  printf("Bits por muestra:       %.2f por derivación\n", payload * 8 / frames.size());
+  printf("Relación (payload):     %.2fx\n", rawBytes / payload);
+  printf("Relación (archivo):     %.2fx (%u chunks contra %u)\n", (double)rawChunks / blocks.size(),
+         (unsigned)blocks.size(), (unsigned)rawChunks);
+  printf("Codificación:           %.1f MB/s\n", rawBytes / encodeSec / 1e6);
+  printf("Decodificación:         %.1f MB/s\n", rawBytes / decodeSec / 1e6);
+
+  // Peor caso: ruido blanco en todo el rango, casi todas las muestras escapadas
+  std::vector<int16_t> noise(frames.size());
+  srand(1);
+  for (size_t i = 0; i < noise.size(); i++) {
+    noise[i] = (int16_t)(rand() & 0xFFFF);
+  }
+  t0 = now();
+  encode(noise, packed, blocks);
+  double noiseSec = now() - t0;
+  ok = decode(packed, blocks, check) && check == noise;
+  uint32_t partitions = (total + ECG_RICE_PARTITION - 1) / ECG_RICE_PARTITION;
+  printf("Peor caso (ruido):      %.2f us por partición de %d muestras, %s\n", noiseSec * 1e6 / partitions,
+         ECG_RICE_PARTITION, ok ? "sin pérdida" : "ERROR");
+  printf("Caso real:              %.2f us por partición\n", encodeSec * 1e6 / partitions);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+// Conversión entre el formato de texto anterior ("d1,d2,d3" por línea, como lo
+// escribía enterFileName) y el formato binario .ecg (ecg_record.h).
+//
+//   ecg_convert ECG_1234.txt ECG_1234.ecg [--rate 200] [--raw16]   (también escribe ECG_1234.pyr)
+//   ecg_convert ECG_1234.ecg ECG_1234.txt
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ecg_hal_host.h"
+#include "../ecg_pyramid.h"
+#include "../ecg_record.h"
+
+static bool endsWith(const char *s, const char *suffix) {
+  size_t n = strlen(s), m = strlen(suffix);
+  return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+static bool writeToFile(const uint8_t *data, uint32_t len, void *ctx) {
+  return fwrite(data, 1, len, (FILE *)ctx) == len;
+}
+
+static EcgRecordEncoder encoder;
+static EcgPyramidBuilder pyramid;
+static EcgRecordReader reader;
+
+static int textToRecord(const char *in, const char *out, uint32_t rate, uint8_t codec) {
+  FILE *src = fopen(in, "r");
+  FILE *dst = fopen(out, "wb");
+  if (!src || !dst) {
+    fprintf(stderr, "no se pudo abrir %s\n", !src ? in : out);
+    return 1;
+  }
+  char pyramidPath[512];
+  ecgPyramidPath(out, pyramidPath, sizeof(pyramidPath));
+  FILE *pyr = fopen(pyramidPath, "wb");
+  if (!pyr) {
+    fprintf(stderr, "no se pudo abrir %s\n", pyramidPath);
+    return 1;
+  }
+  encoder.begin(rate, 0, writeToFile, dst, codec);
+  pyramid.begin(encoder.header(), writeToFile, pyr);
+  char line[128];
+  while (fgets(line, sizeof(line), src)) {
+    float v[ECG_LEADS];
+    if (sscanf(line, "%f,%f,%f", &v[0], &v[1], &v[2]) == 3) {
+      encoder.addFrame(v);
+      pyramid.addFrame(v);
+    }
+  }
+  encoder.finish();
+  pyramid.finish();
+  fseek(dst, 0, SEEK_SET);
+  fwrite(&encoder.header(), sizeof(EcgRecordHeader), 1, dst);
+  fseek(pyr, 0, SEEK_SET);
+  fwrite(&pyramid.header(), sizeof(EcgPyramidHeader), 1, pyr);
+  fclose(src);
+  fclose(dst);
+  fclose(pyr);
+  printf("%u muestras a %u Hz en %u chunks\n", (unsigned)encoder.header().frameCount, (unsigned)rate,
+         (unsigned)encoder.header().chunkCount);
+  return 0;
+}
+
+static int recordToText(const char *in, const char *out) {
+  HostStorage storage("");
+  EcgFile *src = storage.open(in, ECG_OPEN_READ);
+  if (!src || !reader.open(src)) {
+    fprintf(stderr, "%s no es una grabación .ecg válida\n", in);
+    return 1;
+  }
+  FILE *dst = fopen(out, "w");
+  if (!dst) {
+    fprintf(stderr, "no se pudo abrir %s\n", out);
+    return 1;
+  }
+  int16_t frames[256 * ECG_LEADS];
+  uint32_t count;
+  uint32_t total = 0;
+  while ((count = reader.read(frames, 256)) > 0) {
+    for (uint32_t i = 0; i < count; i++) {
+      const int16_t *f = frames + i * ECG_LEADS;
+      fprintf(dst, "%.2f,%.2f,%.2f\r\n", reader.toVolts(f[0], 0), reader.toVolts(f[1], 1), reader.toVolts(f[2], 2));
+    }
+    total += count;
+  }
+  src->close();
+  fclose(dst);
+  printf("%u muestras a %u Hz\n", (unsigned)total, (unsigned)reader.header().sampleRate);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "uso: ecg_convert ENTRADA.txt SALIDA.ecg [--rate HZ] [--raw16]\n"
+                    "     ecg_convert ENTRADA.ecg SALIDA.txt\n");
+    return 2;
+  }
+  uint32_t rate = 200;
+  uint8_t codec = ECG_CODEC_RICE;
+  for (int i = 3; i < argc; i++) {
+    if (!strcmp(argv[i], "--rate") && i + 1 < argc) {
+      rate = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--raw16")) {
+      codec = ECG_CODEC_RAW16;
+    }
+  }
+  if (endsWith(argv[1], ".ecg")) {
+    return recordToText(argv[1], argv[2]);
+  }
+  return textToRecord(argv[1], argv[2], rate, codec);
+}
@@ -0,0 +1,32 @@
+// Compara y mide las versiones float32, Q15 y Q31 del biquad contra
+// XSFilter::SecondOrderLPF (benchmarkFilters() de ecg_filter.cpp), la
+// limpieza por wavelets contra la versión por bloques
+// (benchmarkWaveletDenoiser() de ecg_denoise.cpp) y la decimación
+// polifásica contra el FIR completo (benchmarkDecimator() de
+// ecg_decimate.cpp) para 500, 250 y 200 Hz.
+//
+//   ecg_filter_bench [MUESTRAS]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ecg_hal_host.h"
+#include "../ecg_decimate.h"
+#include "../ecg_denoise.h"
+#include "../ecg_filter.h"
+
+int main(int argc, char **argv) {
+  uint32_t samples = argc > 1 ? (uint32_t)atol(argv[1]) : 200000;
+  HostClock clock(true);
+  HostSerial serial(stdout);
+  hal.clock = &clock;
+  hal.serial = &serial;
+  bool filters = benchmarkFilters(samples);
+  bool wavelet = benchmarkWaveletDenoiser(samples, 1000);
+  bool decimation = true;
+  const int factors[] = {2, 4, 5};
+  for (int f : factors) {
+    decimation = benchmarkDecimator(samples, 1000, f) && decimation;
+  }
+  return filters && wavelet && decimation ? 0 : 1;
+}
@@ -0,0 +1,414 @@
+#include "ecg_hal_host.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// ---------------------------------------------------------------- Reloj
+
+HostClock::HostClock(bool realTime)
+    : realTime(realTime), start(std::chrono::steady_clock::now()), virtualUs(0), running(1) {}
+
+uint64_t HostClock::nowUs() {
+  if (realTime) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - start).count();
+  }
+  std::lock_guard<std::mutex> guard(lock);
+  return virtualUs;
+}
+
+uint32_t HostClock::millis() { return (uint32_t)(nowUs() / 1000); }
+uint32_t HostClock::micros() { return (uint32_t)nowUs(); }
+void HostClock::delayMs(uint32_t ms) { sleepUs((uint64_t)ms * 1000); }
+
+uint32_t HostClock::cycleCount() {
+#if defined(__x86_64__) || defined(__i386__)
+  return (uint32_t)__rdtsc();
+#else
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+float HostClock::cyclesPerUs() {
+#if defined(__x86_64__) || defined(__i386__)
+  static float calibrated = 0;
+  if (calibrated == 0) {
+    // 20 ms de reloj real, también con el reloj virtual
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    uint64_t c0 = __rdtsc();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    uint64_t c1 = __rdtsc();
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    calibrated = (float)((c1 - c0) / us);
+  }
+  return calibrated;
+#else
+  return 1000;
+#endif
+}
+
+void HostClock::sleepUs(uint64_t us) {
+  if (realTime) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+    return;
+  }
+  std::unique_lock<std::mutex> guard(lock);
+  uint64_t wakeAt = virtualUs + us;
+  sleepers.insert(wakeAt);
+  running--;
+  advanceLocked();
+  wake.wait(guard, [&] { return virtualUs >= wakeAt; });
+  sleepers.erase(sleepers.find(wakeAt));
+  running++;
+}
+
+void HostClock::attachThread() {
+  std::lock_guard<std::mutex> guard(lock);
+  running++;
+}
+
+void HostClock::detachThread() {
+  std::lock_guard<std::mutex> guard(lock);
+  running--;
+  advanceLocked();
+}
+
+// Si nadie está corriendo, salta al próximo despertar pendiente
+void HostClock::advanceLocked() {
+  if (realTime || running > 0 || sleepers.empty()) {
+    return;
+  }
+  uint64_t next = *sleepers.begin();
+  if (next > virtualUs) {
+    virtualUs = next;
+  }
+  wake.notify_all();
+}
+
+// ---------------------------------------------------------------- Tareas
+
+bool HostTasks::createTask(EcgTaskFunction fn, const char *name, uint32_t stackBytes,
+                           void *arg, int priority, int core) {
+  // En Linux el tamaño de pila, la prioridad y el núcleo se ignoran
+  clock.attachThread();
+  HostClock *c = &clock;
+  threads.emplace_back([fn, arg, c] {
+    fn(arg);
+    c->detachThread();
+  });
+  return true;
+}
+
+void HostTasks::stopAll() {
+  if (threads.empty()) {
+    return;
+  }
+  stop = true;
+  // El hilo principal deja de contar para que el reloj virtual siga avanzando
+  clock.detachThread();
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i].join();
+  }
+  clock.attachThread();
+  threads.clear();
+  stop = false;
+}
+
+bool HostTasks::startTimer(uint32_t periodUs) {
+  timerPeriod = periodUs;
+  timerNext = clock.nowUs() + periodUs;
+  return periodUs > 0;
+}
+
+uint32_t HostTasks::waitTimer() {
+  if (timerPeriod == 0) {
+    return 0;
+  }
+  uint64_t now = clock.nowUs();
+  if (now < timerNext) {
+    clock.sleepUs(timerNext - now);
+    timerNext += timerPeriod;
+    return 1;
+  }
+  // Ya pasó el plazo: se cuentan los periodos perdidos sin dormir
+  uint32_t ticks = (uint32_t)((now - timerNext) / timerPeriod) + 1;
+  timerNext += ticks * timerPeriod;
+  return ticks;
+}
+
+// ---------------------------------------------------------------- ADC
+
+HostReplayAdc::HostReplayAdc(EcgClock &clock, double sampleRate, bool loop)
+    : clock(clock), sampleRate(sampleRate), loop(loop) {}
+
+bool HostReplayAdc::load(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return false;
+  }
+  lead1.clear();
+  lead2.clear();
+  char line[128];
+  while (fgets(line, sizeof(line), f)) {
+    float a, b, c;
+    if (sscanf(line, "%f,%f,%f", &a, &b, &c) == 3) {
+      lead1.push_back(a);
+      lead2.push_back(b);
+    }
+  }
+  fclose(f);
+  return !lead1.empty();
+}
+
+float HostReplayAdc::readVoltage(int channel) {
+  if (lead1.empty()) {
+    return 0;
+  }
+  // Interpolación lineal entre muestras del archivo según el reloj
+  double pos = clock.micros() * sampleRate / 1e6;
+  size_t n = lead1.size();
+  size_t i = (size_t)pos;
+  double frac = pos - i;
+  if (loop) {
+    i %= n;
+  } else if (i >= n - 1) {
+    i = n - 1;
+    frac = 0;
+  }
+  size_t j = loop ? (i + 1) % n : (i + 1 < n ? i + 1 : i);
+  const std::vector<float> &lead = channel == ECG_ADC_XS1 ? lead1 : lead2;
+  return (float)(lead[i] + (lead[j] - lead[i]) * frac);
+}
+
+HostSyntheticAdc::HostSyntheticAdc(EcgClock &clock, double bpm)
+    : clock(clock), bpm(bpm), noiseState(12345) {}
+
+double HostSyntheticAdc::waveform(double t, double bpm, int channel) {
+  // Ondas P, Q, R, S y T como gaussianas: posición (fracción del latido), ancho (s), amplitud (V)
+  static const double waves[5][3] = {
+      {0.20, 0.025, 0.12}, {0.36, 0.010, -0.15}, {0.40, 0.012, 1.00},
+      {0.44, 0.010, -0.25}, {0.70, 0.040, 0.30}};
+  double period = 60.0 / bpm;
+  double phase = fmod(t, period);
+  double v = 0;
+  for (int k = 0; k < 5; k++) {
+    double d = phase - waves[k][0] * period;
+    v += waves[k][2] * exp(-d * d / (2 * waves[k][1] * waves[k][1]));
+  }
+  double gain = channel == ECG_ADC_XS1 ? 1.0 : 0.8;
+  return 1.65 + gain * v + 0.10 * sin(2 * M_PI * 0.3 * t) + 0.02 * sin(2 * M_PI * 50 * t);
+}
+
+float HostSyntheticAdc::readVoltage(int channel) {
+  double t = clock.micros() / 1e6;
+  // Ruido blanco uniforme de +-5 mV (xorshift, determinista)
+  noiseState ^= noiseState << 13;
+  noiseState ^= noiseState >> 17;
+  noiseState ^= noiseState << 5;
+  double noise = ((noiseState & 0xFFFF) / 65535.0 - 0.5) * 0.01;
+  return (float)(waveform(t, bpm, channel) + noise);
+}
+
+// ---------------------------------------------------------------- Pantalla
+
+HostFramebuffer::HostFramebuffer() : calls(0), pixelWrites(0), textChars(0) {
+  memset(pixels, 0, sizeof(pixels));
+}
+
+void HostFramebuffer::setPixel(int x, int y, uint16_t color) {
+  if (x >= 0 && x < W && y >= 0 && y < H) {
+    pixels[y * W + x] = color;
+    pixelWrites++;
+  }
+}
+
+void HostFramebuffer::fillScreen(uint16_t color) {
+  calls++;
+  for (int i = 0; i < W * H; i++) {
+    pixels[i] = color;
+  }
+  pixelWrites += W * H;
+}
+
+void HostFramebuffer::drawFastVLine(int x, int y, int h, uint16_t color) {
+  calls++;
+  for (int i = 0; i < h; i++) {
+    setPixel(x, y + i, color);
+  }
+}
+
+void HostFramebuffer::drawLine(int x0, int y0, int x1, int y1, uint16_t color) {
+  calls++;
+  // Bresenham
+  int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+  int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+  int err = dx + dy;
+  while (true) {
+    setPixel(x0, y0, color);
+    if (x0 == x1 && y0 == y1) {
+      break;
+    }
+    int e2 = 2 * err;
+    if (e2 >= dy) { err += dy; x0 += sx; }
+    if (e2 <= dx) { err += dx; y0 += sy; }
+  }
+}
+
+void HostFramebuffer::fillRect(int x, int y, int w, int h, uint16_t color) {
+  calls++;
+  for (int j = 0; j < h; j++) {
+    for (int i = 0; i < w; i++) {
+      setPixel(x + i, y + j, color);
+    }
+  }
+}
+
+void HostFramebuffer::print(const char *text) {
+  calls++;
+  textChars += strlen(text);
+}
+
+void HostFramebuffer::pushRect(int x, int y, int w, int h, const uint16_t *pixels) {
+  calls++;
+  for (int j = 0; j < h; j++) {
+    for (int i = 0; i < w; i++) {
+      setPixel(x + i, y + j, pixels[j * w + i]);
+    }
+  }
+}
+
+bool HostFramebuffer::writePPM(const char *path) const {
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    return false;
+  }
+  fprintf(f, "P6\n%d %d\n255\n", W, H);
+  for (int i = 0; i < W * H; i++) {
+    uint16_t c = pixels[i];
+    uint8_t rgb[3] = {(uint8_t)((c >> 11) << 3), (uint8_t)(((c >> 5) & 0x3F) << 2), (uint8_t)((c & 0x1F) << 3)};
+    fwrite(rgb, 1, 3, f);
+  }
+  fclose(f);
+  return true;
+}
+
+// ---------------------------------------------------------------- Almacenamiento
+
+class HostFile : public EcgFile {
+public:
+  HostFile(FILE *f, uint64_t &counter, uint64_t &readCounter) : f(f), counter(counter), readCounter(readCounter) {}
+  size_t write(const uint8_t *data, size_t len) {
+    size_t n = fwrite(data, 1, len, f);
+    counter += n;
+    return n;
+  }
+  size_t read(uint8_t *data, size_t len) {
+    size_t n = fread(data, 1, len, f);
+    readCounter += n;
+    return n;
+  }
+  bool seek(uint32_t pos) { return fseek(f, pos, SEEK_SET) == 0; }
+  uint32_t position() { return (uint32_t)ftell(f); }
+  uint32_t size() {
+    long pos = ftell(f);
+    fseek(f, 0, SEEK_END);
+    long end = ftell(f);
+    fseek(f, pos, SEEK_SET);
+    return (uint32_t)end;
+  }
+  void flush() { fflush(f); }
+  bool preallocate(uint32_t bytes) {
+    return fallocate(fileno(f), FALLOC_FL_KEEP_SIZE, 0, bytes) == 0;
+  }
+  void close() {
+    fclose(f);
+    delete this;
+  }
+
+private:
+  FILE *f;
+  uint64_t &counter;
+  uint64_t &readCounter;
+};
+
+std::string HostStorage::fullPath(const char *path) const {
+  if (root.empty()) {
+    return path;
+  }
+  return root + (path[0] == '/' ? "" : "/") + path;
+}
+
+EcgFile *HostStorage::open(const char *path, EcgOpenMode mode) {
+  const char *m = mode == ECG_OPEN_READ ? "rb"
+                  : mode == ECG_OPEN_APPEND ? "ab"
+                  : mode == ECG_OPEN_UPDATE ? "r+b" : "wb";
+  FILE *f = fopen(fullPath(path).c_str(), m);
+  if (!f) {
+    return NULL;
+  }
+  return new HostFile(f, bytesWritten, bytesRead);
+}
+
+bool HostStorage::remove(const char *path) { return ::remove(fullPath(path).c_str()) == 0; }
+
+bool HostStorage::rename(const char *from, const char *to) {
+  return ::rename(fullPath(from).c_str(), fullPath(to).c_str()) == 0;
+}
+
+bool HostStorage::exists(const char *path) {
+  struct stat st;
+  return stat(fullPath(path).c_str(), &st) == 0;
+}
+
+bool HostStorage::list(const char *dir, EcgDirVisitor visit, void *ctx) {
+  std::string base = fullPath(dir);
+  DIR *d = opendir(base.empty() ? "." : base.c_str());
+  if (!d) {
+    return false;
+  }
+  struct dirent *e;
+  while ((e = readdir(d)) != NULL) {
+    struct stat st;
+    std::string path = base + "/" + e->d_name;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+      continue;
+    }
+    if (!visit(e->d_name, (uint32_t)st.st_size, ctx)) {
+      break;
+    }
+  }
+  closedir(d);
+  return true;
+}
+
+// ---------------------------------------------------------------- Serie
+
+size_t HostSerial::write(const uint8_t *data, size_t len) {
+  bytes += len;
+  if (out) {
+    fwrite(data, 1, len, out);
+  }
+  return len;
+}
+
+void HostSerial::limitBaud(HostClock *c, uint32_t b) {
+  clock = c;
+  baud = b;
+}
+
+size_t HostSerial::availableForWrite() {
+  if (!clock || baud == 0) {
+    return EcgSerial::availableForWrite();
+  }
+  uint64_t sent = clock->nowUs() * (baud / 10) / 1000000;
+  uint64_t queued = bytes > sent ? bytes - sent : 0;
+  return queued >= 128 ? 0 : 128 - queued;
+}
@@ -0,0 +1,167 @@
+#ifndef ECG_HAL_HOST_H
+#define ECG_HAL_HOST_H
+
+// Backends de la HAL para Linux. Permiten correr el pipeline completo
+// (FilterTask -> captura -> BPM -> trazado -> guardado) sin la placa.
+
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../ecg_hal.h"
+
+// Reloj de tiempo real, o virtual para correr a máxima velocidad.
+// En modo virtual el tiempo solo avanza cuando todos los hilos registrados
+// están durmiendo, así que las relaciones de tiempo entre tareas (1 ms de
+// FilterTask, delay(5) de la captura) se respetan sin esperar de verdad.
+class HostClock : public EcgClock {
+public:
+  explicit HostClock(bool realTime);
+  uint32_t millis();
+  uint32_t micros();
+  void delayMs(uint32_t ms);
+  uint32_t cycleCount();  // TSC en x86, nanosegundos en otras arquitecturas
+  float cyclesPerUs();    // Se calibra una vez contra el reloj real
+  void sleepUs(uint64_t us);
+  uint64_t nowUs();
+  bool isRealTime() const { return realTime; }
+
+  // Registro de hilos para el modo virtual (el hilo principal ya está registrado)
+  void attachThread();
+  void detachThread();
+
+private:
+  void advanceLocked();
+
+  bool realTime;
+  std::chrono::steady_clock::time_point start;
+  std::mutex lock;
+  std::condition_variable wake;
+  uint64_t virtualUs;
+  int running;
+  std::multiset<uint64_t> sleepers;
+};
+
+class HostTasks : public EcgTasks {
+public:
+  explicit HostTasks(HostClock &clock) : clock(clock), stop(false), timerPeriod(0), timerNext(0) {}
+  ~HostTasks() { stopAll(); }
+  bool createTask(EcgTaskFunction fn, const char *name, uint32_t stackBytes,
+                  void *arg, int priority, int core);
+  void delayTick() { clock.sleepUs(1000); }
+  bool stopRequested() { return stop.load(); }
+  // Plazos absolutos: el periodo no deriva aunque el hilo se atrase
+  bool startTimer(uint32_t periodUs);
+  uint32_t waitTimer();
+  void stopTimer() { timerPeriod = 0; }
+  // Pide a las tareas que terminen y espera a que salgan
+  void stopAll();
+
+private:
+  HostClock &clock;
+  std::atomic<bool> stop;
+  std::vector<std::thread> threads;
+  uint64_t timerPeriod;
+  uint64_t timerNext;
+};
+
+// Reproduce un archivo ECG_*.txt ("d1,d2,d3" por línea) como entrada del AD8232.
+// Las derivaciones 1 y 2 del archivo alimentan XS1 y XS2; la 3 la recalcula el pipeline.
+class HostReplayAdc : public EcgAdcSource {
+public:
+  HostReplayAdc(EcgClock &clock, double sampleRate, bool loop);
+  bool load(const char *path);
+  float readVoltage(int channel);
+  size_t samples() const { return lead1.size(); }
+
+private:
+  EcgClock &clock;
+  double sampleRate;
+  bool loop;
+  std::vector<float> lead1, lead2;
+};
+
+// Señal ECG sintética (suma de gaussianas PQRST) con deriva de línea base,
+// interferencia de 50 Hz y ruido blanco
+class HostSyntheticAdc : public EcgAdcSource {
+public:
+  HostSyntheticAdc(EcgClock &clock, double bpm);
+  float readVoltage(int channel);
+  static double waveform(double t, double bpm, int channel);
+
+private:
+  EcgClock &clock;
+  double bpm;
+  uint32_t noiseState;
+};
+
+// Pantalla en memoria (RGB565, 320x240). El texto solo se contabiliza.
+class HostFramebuffer : public EcgDisplay {
+public:
+  static const int W = 320;
+  static const int H = 240;
+  HostFramebuffer();
+  int width() { return W; }
+  int height() { return H; }
+  void fillScreen(uint16_t color);
+  void drawFastVLine(int x, int y, int h, uint16_t color);
+  void drawLine(int x0, int y0, int x1, int y1, uint16_t color);
+  void fillRect(int x, int y, int w, int h, uint16_t color);
+  void setCursor(int x, int y) { calls++; }
+  void setTextColor(uint16_t color) { calls++; }
+  void setTextSize(int size) { calls++; }
+  void print(const char *text);
+  void pushRect(int x, int y, int w, int h, const uint16_t *pixels);
+  bool writePPM(const char *path) const;
+
+  uint16_t pixels[W * H];
+  uint64_t calls;        // Llamadas a la pantalla (en la placa cada una es una transacción SPI)
+  uint64_t pixelWrites;  // Píxeles escritos
+  uint64_t textChars;
+
+private:
+  void setPixel(int x, int y, uint16_t color);
+};
+
+// Almacenamiento sobre un directorio local ("" = rutas tal cual)
+class HostStorage : public EcgStorage {
+public:
+  explicit HostStorage(const char *rootDir) : bytesWritten(0), bytesRead(0), root(rootDir) {}
+  EcgFile *open(const char *path, EcgOpenMode mode);
+  bool remove(const char *path);
+  bool rename(const char *from, const char *to);
+  bool exists(const char *path);
+  bool list(const char *dir, EcgDirVisitor visit, void *ctx);
+  std::string fullPath(const char *path) const;
+  uint64_t bytesWritten;
+  uint64_t bytesRead;
+
+private:
+  std::string root;
+};
+
+// Puerto serie: descarta o copia a un FILE*, contando bytes
+class HostSerial : public EcgSerial {
+public:
+  explicit HostSerial(FILE *out) : out(out), bytes(0), clock(0), baud(0) {}
+  size_t write(const uint8_t *data, size_t len);
+  // Con un límite, availableForWrite() solo deja pasar lo que un UART a
+  // `baud` (10 bits por byte, FIFO de 128 bytes) habría enviado hasta ahora
+  void limitBaud(HostClock *clock, uint32_t baud);
+  size_t availableForWrite();
+  uint64_t bytesWritten() const { return bytes; }
+
+private:
+  FILE *out;
+  uint64_t bytes;
+  HostClock *clock;
+  uint32_t baud;
+};
+
+#endif
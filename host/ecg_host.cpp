@@ -0,0 +1,419 @@
+// Ejecuta una medición completa del sketch en Linux: AcquisitionTask y
+// FilterTask en hilos con el mismo temporizador de la HAL, captura con
+// BPM y trazado, y guardado como lo hace enterFileName().
+//
+//   ecg_host --synthetic 72 [--seconds 7.5] [--fast] [--out DIR] [--ppm pantalla.ppm] [--serial] [--notch 60]
+//            [--serial-out flujo.bin] [--baud 115200] [--profile] [--overlay] [--memory] [--wavelet 4]
+//            [--storage-rate 250] [--display-rate 250]
+//   ecg_host --replay ECG_1234.txt [--replay-rate 200] [--fast] ...
+//   ecg_host --synthetic 72 --monitor [--seconds S] [--event-at S]... [--bpm-range 40 150]
+//            [--event-window 30 30] [--event-buffer S] ...
+//   ecg_host --list [--out DIR] [--at N]
+//   ecg_host --view ECG_1234.ecg [--at S] [--zoom N] [--no-index] [--replay-rate 200] [--ppm pantalla.ppm]
+//            [--memory]
+//
+// --notch cambia la frecuencia del rechaza banda (0 lo desactiva); la señal
+// sintética trae interferencia de 50 Hz.
+// --wavelet agrega la limpieza por wavelets de ese nivel después del banco
+// (waveletDenoiseLevel, ecg_denoise.h).
+// --storage-rate y --display-rate fijan a qué frecuencia se decima lo que se
+// graba (y va por el puerto serie) y lo que dibuja el barrido (ecg_decimate.h).
+// --fast usa el reloj virtual: misma secuencia de eventos, sin esperar.
+// --serial muestra por stdout el texto de depuración (modo ASCII); sin él el
+// puerto lleva el flujo binario, que --serial-out guarda para ecg_serial_rx.
+// --baud limita el flujo binario a lo que deja pasar un UART a esa velocidad.
+// --profile informa los histogramas de ecg_profile.h al terminar y --overlay
+// los dibuja en la barra de estado; los periodos solo valen sin --fast.
+// --memory muestra al terminar lo reservado en ecgArena (ecg_memory.h).
+// --view dibuja una pantalla del visor de mediciones guardadas (.ecg o .txt)
+// desde el segundo S, después de N cambios de zoom; --no-index ignora el .pyr.
+// --list muestra una página del catálogo de DIR desde la entrada N, como la
+// lista de mediciones antiguas.
+// --monitor corre el modo monitor en lugar de una captura: --event-at
+// equivale a presionar UP en ese segundo (se puede repetir), --bpm-range fija
+// el rango del ritmo y --event-window los segundos antes y después del
+// disparo. --event-buffer pone el buffer de eventos en memoria aparte, como
+// la PSRAM, con lugar para S segundos; sin él sale de ecgArena.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "ecg_hal_host.h"
+#include "../ecg_catalog.h"
+#include "../ecg_memory.h"
+#include "../ecg_pipeline.h"
+#include "../ecg_playback.h"
+#include "../ecg_profile.h"
+#include "../ecg_stream_writer.h"
+
+static double captureSeconds = 7.5;
+static const int maxEventButtons = 16;
+static bool memoryReport = false;
+
+static void printMemory() {
+  if (memoryReport) {
+    HostSerial report(stdout);
+    ecgArena.print(&report);
+  }
+}
+
+// Equivale a presionar SELECT después de captureSeconds
+static bool captureTimeUp() {
+  return hal.clock->millis() >= captureSeconds * 1000;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "uso: ecg_host (--synthetic BPM | --replay ARCHIVO [--replay-rate HZ])\n"
+          "              [--seconds S] [--fast] [--out DIR] [--ppm ARCHIVO] [--serial] [--notch HZ]\n"
+          "              [--serial-out ARCHIVO] [--baud N] [--profile] [--overlay] [--memory]\n"
+          "              [--wavelet NIVEL] [--storage-rate HZ] [--display-rate HZ]\n"
+          "              [--monitor] [--event-at S]... [--bpm-range MIN MAX]\n"
+          "              [--event-window ANTES DESPUES] [--event-buffer S]\n"
+          "       ecg_host --list [--out DIR] [--at N]\n"
+          "       ecg_host --view ARCHIVO [--at S] [--zoom N] [--no-index] [--replay-rate HZ] [--ppm ARCHIVO]\n"
+          "                [--memory]\n");
+}
+
+// Mismo camino que setup() y displayPreviousMeasurements()
+static int listCatalog(const char *dir, uint32_t first) {
+  HostClock clock(true);
+  HostStorage storage(dir);
+  HostSerial serial(stdout);
+  hal.storage = &storage;
+  hal.clock = &clock;
+  hal.serial = &serial;
+
+  uint32_t start = clock.micros();
+  catalog.begin(catalogFile);
+  uint32_t openUs = clock.micros() - start;
+  EcgCatalogEntry page[8];
+  start = clock.micros();
+  uint32_t count = catalog.read(first, page, 8);
+  uint32_t readUs = clock.micros() - start;
+  for (uint32_t i = 0; i < count; i++) {
+    printf("%6u  %-24s %8.1f s %6.1f BPM %9u bytes\n", (unsigned)(first + i), page[i].name,
+           page[i].sampleRate ? (double)page[i].frameCount / page[i].sampleRate : 0.0,
+           page[i].averageBpm, (unsigned)page[i].sizeBytes);
+  }
+  printf("mediciones          : %u\n", (unsigned)catalog.count());
+  printf("reconstrucciones    : %u\n", (unsigned)catalog.rebuilds);
+  printf("apertura            : %u us\n", (unsigned)openUs);
+  printf("lectura de pagina   : %u us (%llu bytes leidos)\n", (unsigned)readUs,
+         (unsigned long long)storage.bytesRead);
+  return 0;
+}
+
+// Mismo camino que openSelectedFile() y handlePlaybackButtonPresses()
+static int viewFile(const char *path, double atSec, int zoomSteps, double textRate, bool useIndex,
+                    const char *ppmPath) {
+  HostClock clock(true);
+  HostFramebuffer display;
+  HostStorage storage("");
+  HostSerial serial(NULL);
+  hal.display = &display;
+  hal.storage = &storage;
+  hal.clock = &clock;
+  hal.serial = &serial;
+
+  static EcgRecordReader reader;
+  static EcgRecordSource recordSource(reader);
+  static EcgTextSource textSource;
+  static EcgPlaybackViewer viewer;
+  static EcgPyramidReader pyramidReader;
+  EcgFile *file = storage.open(path, ECG_OPEN_READ);
+  EcgFile *pyramidFile = NULL;
+  size_t len = strlen(path);
+  bool isRecord = len > 4 && !strcmp(path + len - 4, ".ecg");
+  EcgPlaybackSource *source = NULL;
+  EcgPyramidReader *pyramid = NULL;
+  uint32_t openUs = clock.micros();
+  ecgArena.beginPhase("reproduccion");
+  if (file) {
+    if (isRecord) {
+      source = recordSource.open(file) ? &recordSource : NULL;
+      char pyramidPath[512];
+      ecgPyramidPath(path, pyramidPath, sizeof(pyramidPath));
+      pyramidFile = source && useIndex ? storage.open(pyramidPath, ECG_OPEN_READ) : NULL;
+      if (pyramidFile && pyramidReader.open(pyramidFile) &&
+          pyramidReader.header().frameCount == recordSource.frameCount()) {
+        pyramid = &pyramidReader;
+      }
+    } else {
+      source = textSource.open(file, (uint32_t)textRate) ? &textSource : NULL;
+    }
+  }
+  openUs = clock.micros() - openUs;
+  if (!source) {
+    fprintf(stderr, "no se pudo abrir %s\n", path);
+    return 1;
+  }
+  viewer.open(source, &sweepRenderer, pyramid);
+  for (int i = 0; i < zoomSteps; i++) {
+    viewer.cycleZoom();
+  }
+  // Avanza de a media pantalla como con el botón DOWN
+  uint32_t target = (uint32_t)(atSec * source->sampleRate());
+  int scrolls = 0;
+  while (viewer.position() < target) {
+    uint32_t before = viewer.position();
+    viewer.scroll(1);
+    scrolls++;
+    if (viewer.position() == before) {
+      break;
+    }
+  }
+  viewer.draw();
+
+  printf("muestras            : %u (%.1f s a %u Hz)\n", (unsigned)source->frameCount(),
+         (double)source->frameCount() / source->sampleRate(), (unsigned)source->sampleRate());
+  printf("tiempo de apertura  : %u us\n", (unsigned)openUs);
+  printf("posicion            : %u (%d desplazamientos)\n", (unsigned)viewer.position(), scrolls);
+  printf("zoom                : x%d\n", viewer.zoom());
+  if (viewer.lastLevel >= 0) {
+    printf("lectura             : indice, nivel %d (%u muestras por entrada)\n", viewer.lastLevel,
+           (unsigned)pyramidReader.entryFrames(viewer.lastLevel));
+  } else {
+    printf("lectura             : muestras%s\n", pyramid ? "" : " (sin indice)");
+  }
+  printf("tiempo de dibujo    : %u us\n", (unsigned)viewer.lastDrawUs);
+  printf("bytes leidos        : %llu\n", (unsigned long long)storage.bytesRead);
+  printf("llamadas a pantalla : %llu (%llu pixeles)\n",
+         (unsigned long long)display.calls, (unsigned long long)display.pixelWrites);
+  file->close();
+  if (pyramidFile) {
+    pyramidFile->close();
+  }
+  printMemory();
+  if (ppmPath) {
+    display.writePPM(ppmPath);
+  }
+  return 0;
+}
+
+// Como el estado UI_MONITOR del sketch: botones a tiempo fijo y el mismo
+// paso del monitor hasta captureSeconds
+static int runMonitor(HostClock &clock, HostTasks &tasks, HostStorage &storage, const double *eventAt,
+                      int eventButtons, double bufferSeconds, bool profile, const char *ppmPath,
+                      HostFramebuffer &display) {
+  std::vector<uint8_t> external;
+  if (bufferSeconds > 0) {
+    external.resize(ecgEventBufferBytes((uint32_t)(bufferSeconds * storageRate)));
+    setEventMemory(external.data(), external.size());
+  }
+  startEKGMonitor();
+  int next = 0;
+  while (!captureTimeUp()) {
+    if (next < eventButtons && clock.millis() >= eventAt[next] * 1000) {
+      triggerEKGEvent(ECG_EVENT_BUTTON);
+      next++;
+    }
+    stepEKGMonitor();
+  }
+  finishEKGMonitor();
+  tasks.stopAll();
+
+  printf("tiempo simulado     : %.3f s\n", clock.nowUs() / 1e6);
+  printf("muestras grabadas   : %u (al buffer)\n", (unsigned)recordedSamples);
+  printf("muestras perdidas   : %u\n", (unsigned)droppedFrames);
+  printf("eventos             : %u guardados, %u con error\n", (unsigned)eventsSaved, (unsigned)eventsFailed);
+  printf("bytes a la SD       : %llu (descartados %u)\n", (unsigned long long)storage.bytesWritten,
+         (unsigned)streamWriter.droppedBytes);
+  printf("peor escritura      : %u us\n", (unsigned)streamWriter.maxWriteUs);
+  printf("catalogo            : %u mediciones\n", (unsigned)catalog.count());
+  if (profile) {
+    HostSerial report(stdout);
+    ecgProfiler.print(&report);
+  }
+  printMemory();
+  if (ppmPath) {
+    display.writePPM(ppmPath);
+  }
+  return eventsFailed == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  const char *replayPath = NULL;
+  double replayRate = 200;
+  double syntheticBpm = 0;
+  bool fast = false;
+  bool echoSerial = false;
+  const char *serialPath = NULL;
+  uint32_t baud = 0;
+  bool profile = false;
+  const char *outDir = ".";
+  const char *ppmPath = NULL;
+  const char *viewPath = NULL;
+  double viewAt = 0;
+  int viewZoom = 0;
+  bool useIndex = true;
+  bool listMode = false;
+  bool monitor = false;
+  double eventAt[maxEventButtons];
+  int eventButtons = 0;
+  double eventBufferSeconds = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--synthetic") && i + 1 < argc) {
+      syntheticBpm = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--replay") && i + 1 < argc) {
+      replayPath = argv[++i];
+    } else if (!strcmp(argv[i], "--replay-rate") && i + 1 < argc) {
+      replayRate = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+      captureSeconds = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--fast")) {
+      fast = true;
+    } else if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+      outDir = argv[++i];
+    } else if (!strcmp(argv[i], "--ppm") && i + 1 < argc) {
+      ppmPath = argv[++i];
+    } else if (!strcmp(argv[i], "--notch") && i + 1 < argc) {
+      filterConfig.notchHz = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--wavelet") && i + 1 < argc) {
+      waveletDenoiseLevel = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--storage-rate") && i + 1 < argc) {
+      storageRate = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--display-rate") && i + 1 < argc) {
+      displayRate = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--view") && i + 1 < argc) {
+      viewPath = argv[++i];
+    } else if (!strcmp(argv[i], "--at") && i + 1 < argc) {
+      viewAt = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--zoom") && i + 1 < argc) {
+      viewZoom = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--list")) {
+      listMode = true;
+    } else if (!strcmp(argv[i], "--no-index")) {
+      useIndex = false;
+    } else if (!strcmp(argv[i], "--serial")) {
+      echoSerial = true;
+    } else if (!strcmp(argv[i], "--serial-out") && i + 1 < argc) {
+      serialPath = argv[++i];
+    } else if (!strcmp(argv[i], "--baud") && i + 1 < argc) {
+      baud = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--profile")) {
+      profile = true;
+    } else if (!strcmp(argv[i], "--overlay")) {
+      ecgProfiler.overlay = true;
+    } else if (!strcmp(argv[i], "--memory")) {
+      memoryReport = true;
+    } else if (!strcmp(argv[i], "--monitor")) {
+      monitor = true;
+    } else if (!strcmp(argv[i], "--event-at") && i + 1 < argc && eventButtons < maxEventButtons) {
+      eventAt[eventButtons++] = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--bpm-range") && i + 2 < argc) {
+      eventMinBpm = atof(argv[++i]);
+      eventMaxBpm = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--event-window") && i + 2 < argc) {
+      eventPreSeconds = atoi(argv[++i]);
+      eventPostSeconds = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--event-buffer") && i + 1 < argc) {
+      eventBufferSeconds = atof(argv[++i]);
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (listMode) {
+    return listCatalog(outDir, (uint32_t)viewAt);
+  }
+  if (viewPath) {
+    return viewFile(viewPath, viewAt, viewZoom, replayRate, useIndex, ppmPath);
+  }
+  if (!replayPath && syntheticBpm <= 0) {
+    usage();
+    return 2;
+  }
+
+  HostClock clock(!fast);
+  HostTasks tasks(clock);
+  HostFramebuffer display;
+  HostStorage storage(outDir);
+  FILE *serialFile = serialPath ? fopen(serialPath, "wb") : NULL;
+  if (serialPath && !serialFile) {
+    fprintf(stderr, "no se pudo abrir %s\n", serialPath);
+    return 1;
+  }
+  // En el modo monitor el puerto solo lleva texto: los eventos se ven en stdout
+  HostSerial serial(echoSerial || monitor ? stdout : serialFile);
+  serialMode = echoSerial ? ECG_SERIAL_ASCII : ECG_SERIAL_BINARY;
+  if (baud > 0) {
+    serial.limitBaud(&clock, baud);
+  }
+  HostReplayAdc replayAdc(clock, replayRate, true);
+  HostSyntheticAdc syntheticAdc(clock, syntheticBpm);
+  if (replayPath && !replayAdc.load(replayPath)) {
+    fprintf(stderr, "no se pudo leer %s\n", replayPath);
+    return 1;
+  }
+
+  hal.adc = replayPath ? (EcgAdcSource *)&replayAdc : (EcgAdcSource *)&syntheticAdc;
+  hal.display = &display;
+  hal.storage = &storage;
+  hal.clock = &clock;
+  hal.tasks = &tasks;
+  hal.serial = &serial;
+
+  catalog.begin(catalogFile);
+  std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+  reservePipelineMemory();
+  ecgArena.seal();
+  drawSweepLayout();
+  tasks.createTask(AcquisitionTask, "AcquisitionTask", acquisitionStackBytes, NULL, acquisitionPriority,
+                   acquisitionCore);
+  tasks.createTask(FilterTask, "FilterTask", filterStackBytes, NULL, filterPriority, processingCore);
+  tasks.createTask(StorageTask, "StorageTask", storageStackBytes, NULL, storagePriority, processingCore);
+  if (monitor) {
+    return runMonitor(clock, tasks, storage, eventAt, eventButtons, eventBufferSeconds, profile, ppmPath, display);
+  }
+  runEKGCapture(captureTimeUp);
+  tasks.stopAll();
+
+  char fileName[32];
+  snprintf(fileName, sizeof(fileName), "/ECG_%u.ecg", (unsigned)clock.millis());
+  bool saved = keepEKGRecording(fileName);
+  double wallSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+  printf("tiempo simulado     : %.3f s\n", clock.nowUs() / 1e6);
+  printf("tiempo real         : %.3f s\n", wallSec);
+  printf("muestras adquiridas : %u\n", (unsigned)frameSeq);
+  // Sin --fast el periodo es el de un hilo de Linux con sleep: sirve para medir jitter
+  const EcgPeriodStats &period = acquisitionStats;
+  printf("periodo adquisicion : min %u / prom %.1f / max %u us (nominal %d)\n", (unsigned)period.minUs,
+         period.count ? (double)period.sumUs / period.count : 0.0, (unsigned)period.maxUs, 1000000 / acquisitionRate);
+  printf("periodos perdidos   : %u\n", (unsigned)period.missed);
+  printf("muestras grabadas   : %u (%d Hz)\n", (unsigned)recordedSamples, storageRate);
+  printf("muestras perdidas   : %u\n", (unsigned)droppedFrames);
+  printf("BPM promedio        : %.1f\n", calculateAverageBPM());
+  printf("tiras por segundo   : %.1f (%u columnas, %.2f barridos/s)\n", sweepRenderer.stripsPerSecond(),
+         (unsigned)sweepRenderer.columnsDrawn, sweepRenderer.sweepsPerSecond());
+  printf("textos redibujados  : %u\n", (unsigned)sweepRenderer.textRedraws);
+  printf("llamadas a pantalla : %llu (%llu pixeles)\n",
+         (unsigned long long)display.calls, (unsigned long long)display.pixelWrites);
+  printf("bytes por serie     : %llu\n", (unsigned long long)serial.bytesWritten());
+  if (serialMode == ECG_SERIAL_BINARY) {
+    printf("paquetes por serie  : %u (descartados %u)\n", (unsigned)serialStreamer.packetsSent,
+           (unsigned)serialStreamer.droppedPackets);
+  }
+  printf("bytes a la SD       : %llu (descartados %u)\n", (unsigned long long)storage.bytesWritten,
+         (unsigned)streamWriter.droppedBytes);
+  printf("peor escritura      : %u us\n", (unsigned)streamWriter.maxWriteUs);
+  printf("archivo             : %s\n", saved ? storage.fullPath(fileName).c_str() : "(error)");
+  printf("catalogo            : %u mediciones\n", (unsigned)catalog.count());
+  if (profile) {
+    HostSerial report(stdout);
+    ecgProfiler.print(&report);
+  }
+  printMemory();
+  if (ppmPath) {
+    display.writePPM(ppmPath);
+  }
+  if (serialFile) {
+    fclose(serialFile);
+  }
+  return saved ? 0 : 1;
+}
@@ -0,0 +1,386 @@
+#include "ecg_map.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../ecg_codec.h"
+#include "../ecg_pyramid.h"
+#include "../ecg_record.h"
+
+static_assert(sizeof(EcgMapEntry) == sizeof(EcgPyramidEntry), "EcgMapEntry distinta de EcgPyramidEntry");
+static_assert(ECG_MAP_MAX_LEADS == ECG_RECORD_MAX_LEADS, "ECG_MAP_MAX_LEADS distinto de ECG_RECORD_MAX_LEADS");
+
+struct EcgMap {
+  const uint8_t *data;
+  size_t size;
+  EcgRecordHeader hdr;          // Con frameCount y chunkCount recuperados
+  bool closed;
+  const uint8_t *pyramid;       // NULL sin índice
+  size_t pyramidSize;
+  EcgPyramidHeader pyramidHdr;
+};
+
+static thread_local char lastError[256];
+
+static void setError(const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  vsnprintf(lastError, sizeof(lastError), format, args);
+  va_end(args);
+}
+
+// Archivo entero en memoria, solo lectura; false si no existe o está vacío
+static bool mapFile(const char *path, const uint8_t *&data, size_t &size) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    setError("%s: no se pudo abrir", path);
+    return false;
+  }
+  struct stat st;
+  bool ok = fstat(fd, &st) == 0 && st.st_size > 0;
+  if (ok) {
+    size = st.st_size;
+    void *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ok = p != MAP_FAILED;
+    data = ok ? (const uint8_t *)p : NULL;
+  }
+  close(fd);
+  if (!ok) {
+    setError("%s: no se pudo mapear", path);
+  }
+  return ok;
+}
+
+// Cabecera del chunk dentro del archivo; NULL si no existe o está dañada
+static const EcgChunkHeader *chunkAt(const EcgMap *map, uint32_t index) {
+  if (index >= map->hdr.chunkCount) {
+    return NULL;
+  }
+  const EcgChunkHeader *ch =
+      (const EcgChunkHeader *)(map->data + map->hdr.headerSize + (size_t)index * map->hdr.chunkSize);
+  return ecgChunkHeaderValid(*ch) ? ch : NULL;
+}
+
+static bool openPyramid(EcgMap *map, const char *path, bool required) {
+  if (!mapFile(path, map->pyramid, map->pyramidSize)) {
+    map->pyramid = NULL;
+    return !required;
+  }
+  if (map->pyramidSize >= sizeof(EcgPyramidHeader)) {
+    memcpy(&map->pyramidHdr, map->pyramid, sizeof(EcgPyramidHeader));
+    if (ecgPyramidHeaderValid(map->pyramidHdr) && map->pyramidHdr.frameCount == map->hdr.frameCount) {
+      return true;
+    }
+  }
+  setError("%s: no es un indice completo de la grabacion", path);
+  munmap((void *)map->pyramid, map->pyramidSize);
+  map->pyramid = NULL;
+  return !required;
+}
+
+uint32_t ecgMapAbiVersion(void) {
+  return ECG_MAP_ABI_VERSION;
+}
+
+EcgMap *ecgMapOpen(const char *path, const char *pyramidPath) {
+  lastError[0] = 0;
+  EcgMap *map = new EcgMap();
+  if (!mapFile(path, map->data, map->size)) {
+    delete map;
+    return NULL;
+  }
+  EcgRecordHeader &hdr = map->hdr;
+  if (map->size >= sizeof(hdr)) {
+    memcpy(&hdr, map->data, sizeof(hdr));
+  }
+  if (map->size < sizeof(hdr) || !ecgRecordHeaderValid(hdr) || hdr.headerSize < sizeof(hdr) ||
+      hdr.headerSize > map->size) {
+    setError("%s: no es una grabacion .ecg version %u", path, (unsigned)ECG_RECORD_VERSION);
+    ecgMapClose(map);
+    return NULL;
+  }
+  // Solo los chunks que están enteros en el archivo
+  uint32_t fit = (map->size - hdr.headerSize) / hdr.chunkSize;
+  map->closed = hdr.frameCount > 0;
+  if (!map->closed) {
+    // Grabación sin cerrar: termina en el último chunk sano. Si antes hay que
+    // saltear la reserva en ceros del equipo, el último chunk con marca puede
+    // haber quedado cortado entre dos bloques y se descarta (igual que
+    // EcgRecordReader::open)
+    hdr.chunkCount = fit;
+    hdr.tableCount = 0;
+    while (hdr.chunkCount > 0 && !chunkAt(map, hdr.chunkCount - 1)) {
+      hdr.chunkCount--;
+    }
+    if (hdr.chunkCount > 0 && hdr.chunkCount < fit) {
+      hdr.chunkCount--;
+    }
+    const EcgChunkHeader *last = hdr.chunkCount > 0 ? chunkAt(map, hdr.chunkCount - 1) : NULL;
+    hdr.frameCount = last ? last->firstFrame + last->frames : 0;
+  } else if (hdr.chunkCount > fit) {
+    hdr.chunkCount = fit;   // Archivo cortado: lo que falta se lee como hueco
+  }
+
+  if (!pyramidPath) {
+    char automatic[512];
+    ecgPyramidPath(path, automatic, sizeof(automatic));
+    openPyramid(map, automatic, false);
+    lastError[0] = 0;
+  } else if (pyramidPath[0] && !openPyramid(map, pyramidPath, true)) {
+    ecgMapClose(map);
+    return NULL;
+  }
+  return map;
+}
+
+void ecgMapClose(EcgMap *map) {
+  if (!map) {
+    return;
+  }
+  if (map->data) {
+    munmap((void *)map->data, map->size);
+  }
+  if (map->pyramid) {
+    munmap((void *)map->pyramid, map->pyramidSize);
+  }
+  delete map;
+}
+
+const char *ecgMapLastError(void) {
+  return lastError;
+}
+
+void ecgMapGetInfo(const EcgMap *map, EcgMapInfo *info) {
+  const EcgRecordHeader &hdr = map->hdr;
+  memset(info, 0, sizeof(*info));
+  info->sampleRate = hdr.sampleRate;
+  info->leadCount = hdr.leadCount;
+  info->frameCount = hdr.frameCount;
+  info->chunkCount = hdr.chunkCount;
+  info->startMillis = hdr.startMillis;
+  info->averageBpm = hdr.averageBpm;
+  for (int l = 0; l < ECG_MAP_MAX_LEADS; l++) {
+    info->gain[l] = hdr.gain[l];
+    info->offset[l] = hdr.offset[l];
+  }
+  info->closed = map->closed;
+  info->pyramidLevels = map->pyramid ? map->pyramidHdr.levelCount : 0;
+  info->pyramidBaseFrames = map->pyramid ? map->pyramidHdr.baseFrames : 0;
+  info->fileBytes = map->size;
+}
+
+const void *ecgMapHeader(const EcgMap *map) {
+  return map->data;
+}
+
+// Primera muestra en el instante t o después
+static uint32_t frameAt(const EcgMap *map, double t) {
+  double f = ceil(t * map->hdr.sampleRate - 1e-6);
+  return f <= 0 ? 0 : (f >= map->hdr.frameCount ? map->hdr.frameCount : (uint32_t)f);
+}
+
+uint32_t ecgMapSlice(const EcgMap *map, double t0, double t1, uint32_t *first) {
+  uint32_t a = frameAt(map, t0), b = frameAt(map, t1);
+  *first = a;
+  return b > a ? b - a : 0;
+}
+
+int32_t ecgMapFindChunk(const EcgMap *map, uint32_t frame) {
+  // Búsqueda binaria por las cabeceras de los chunks; solo toca las páginas
+  // de las cabeceras que visita
+  if (map->hdr.chunkCount == 0) {
+    return -1;
+  }
+  uint32_t lo = 0, hi = map->hdr.chunkCount - 1;
+  while (lo < hi) {
+    uint32_t mid = (lo + hi + 1) / 2;
+    // Un chunk dañado se reemplaza por el sano anterior dentro del tramo
+    uint32_t probe = mid;
+    while (probe > lo && !chunkAt(map, probe)) {
+      probe--;
+    }
+    const EcgChunkHeader *ch = chunkAt(map, probe);
+    if (ch && ch->firstFrame <= frame) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  const EcgChunkHeader *ch = chunkAt(map, lo);
+  return ch && ch->firstFrame <= frame ? (int32_t)lo : -1;
+}
+
+int ecgMapChunk(const EcgMap *map, uint32_t index, EcgMapChunk *chunk) {
+  const EcgChunkHeader *ch = chunkAt(map, index);
+  if (!ch) {
+    return 0;
+  }
+  chunk->firstFrame = ch->firstFrame;
+  chunk->frames = ch->frames;
+  chunk->codec = ch->codec;
+  chunk->payloadBytes = ch->payloadBytes;
+  chunk->payloadOffset = (const uint8_t *)(ch + 1) - map->data;
+  return 1;
+}
+
+const void *ecgMapChunkData(const EcgMap *map, uint32_t index) {
+  const EcgChunkHeader *ch = chunkAt(map, index);
+  return ch ? (const void *)(ch + 1) : NULL;
+}
+
+// Recorre los chunks que cubren [first, first + count) y entrega las muestras
+// intercaladas a store(posición desde first, muestras, cantidad) de a tramos:
+// los chunks crudos de una vez desde el archivo, los comprimidos de a una
+// partición. Devuelve cuántas muestras entregó.
+template <typename Store>
+static uint32_t forEachRun(const EcgMap *map, uint32_t first, uint32_t count, Store store) {
+  uint64_t end = (uint64_t)first + count;
+  int32_t c = ecgMapFindChunk(map, first);
+  uint32_t done = 0;
+  for (uint32_t i = c < 0 ? 0 : c; i < map->hdr.chunkCount; i++) {
+    const EcgChunkHeader *ch = chunkAt(map, i);
+    if (!ch) {
+      continue;   // Chunk dañado: queda como hueco
+    }
+    if (ch->firstFrame >= end) {
+      break;
+    }
+    uint64_t chEnd = (uint64_t)ch->firstFrame + ch->frames;
+    if (chEnd <= first) {
+      continue;
+    }
+    uint32_t from = first > ch->firstFrame ? first - ch->firstFrame : 0;
+    uint32_t to = (uint32_t)((end < chEnd ? end : chEnd) - ch->firstFrame);
+    const uint8_t *payload = (const uint8_t *)(ch + 1);
+    if (ch->codec == ECG_CODEC_RAW16) {
+      store(ch->firstFrame + from - first, (const int16_t *)payload + from * ECG_LEADS, to - from);
+      done += to - from;
+      continue;
+    }
+    // Las particiones se decodifican en orden desde el comienzo del chunk
+    EcgRiceDecoder decoder;
+    int16_t part[ECG_RICE_PARTITION * ECG_LEADS];
+    decoder.begin(payload, ch->payloadBytes);
+    for (uint32_t p = 0; p < to;) {
+      uint32_t n = ch->frames - p < (uint32_t)ECG_RICE_PARTITION ? ch->frames - p : ECG_RICE_PARTITION;
+      if (!decoder.decodePartition(part, n)) {
+        setError("chunk %u: datos comprimidos invalidos", (unsigned)i);
+        break;
+      }
+      if (p + n > from) {
+        uint32_t a = p > from ? p : from;
+        uint32_t b = p + n < to ? p + n : to;
+        store(ch->firstFrame + a - first, part + (a - p) * ECG_LEADS, b - a);
+        done += b - a;
+      }
+      p += n;
+    }
+  }
+  return done;
+}
+
+uint32_t ecgMapReadCounts(const EcgMap *map, uint32_t first, uint32_t count, int lead, int16_t *out) {
+  if (lead >= ECG_LEADS) {
+    return 0;
+  }
+  int width = lead < 0 ? ECG_LEADS : 1;
+  for (uint64_t k = 0; k < (uint64_t)count * width; k++) {
+    out[k] = ECG_MAP_GAP_COUNTS;
+  }
+  return forEachRun(map, first, count, [&](uint32_t at, const int16_t *frames, uint32_t n) {
+    if (lead < 0) {
+      memcpy(out + (size_t)at * ECG_LEADS, frames, (size_t)n * ECG_LEADS * sizeof(int16_t));
+      return;
+    }
+    int16_t *o = out + at;
+    for (uint32_t k = 0; k < n; k++) {
+      o[k] = frames[k * ECG_LEADS + lead];
+    }
+  });
+}
+
+uint32_t ecgMapReadVolts(const EcgMap *map, uint32_t first, uint32_t count, int lead, float *out) {
+  if (lead >= ECG_LEADS) {
+    return 0;
+  }
+  int width = lead < 0 ? ECG_LEADS : 1;
+  for (uint64_t k = 0; k < (uint64_t)count * width; k++) {
+    out[k] = NAN;
+  }
+  const float *gain = map->hdr.gain, *offset = map->hdr.offset;
+  return forEachRun(map, first, count, [&](uint32_t at, const int16_t *frames, uint32_t n) {
+    if (lead < 0) {
+      float *o = out + (size_t)at * ECG_LEADS;
+      for (uint32_t k = 0; k < n * ECG_LEADS; k += ECG_LEADS) {
+        for (int l = 0; l < ECG_LEADS; l++) {
+          o[k + l] = frames[k + l] * gain[l] + offset[l];
+        }
+      }
+      return;
+    }
+    float *o = out + at;
+    for (uint32_t k = 0; k < n; k++) {
+      o[k] = frames[k * ECG_LEADS + lead] * gain[lead] + offset[lead];
+    }
+  });
+}
+
+uint32_t ecgMapPyramidEntries(const EcgMap *map, int level) {
+  if (!map->pyramid || level < 0 || level >= map->pyramidHdr.levelCount) {
+    return 0;
+  }
+  return ecgPyramidEntryCount(map->pyramidHdr, level);
+}
+
+uint32_t ecgMapPyramidEntryFrames(const EcgMap *map, int level) {
+  if (!map->pyramid || level < 0 || level >= map->pyramidHdr.levelCount) {
+    return 0;
+  }
+  return map->pyramidHdr.baseFrames << level;
+}
+
+const EcgMapEntry *ecgMapPyramidPage(const EcgMap *map, int level, uint32_t page, uint32_t *entries) {
+  *entries = 0;
+  uint32_t total = ecgMapPyramidEntries(map, level);
+  const EcgPyramidHeader &hdr = map->pyramidHdr;
+  if (total == 0 || page > (total - 1) / hdr.entriesPerPage) {
+    return NULL;
+  }
+  uint64_t at = ecgPyramidPageOffset(hdr, level, page);
+  if (at + hdr.pageSize > map->pyramidSize) {
+    return NULL;
+  }
+  const EcgPyramidPageHeader *ph = (const EcgPyramidPageHeader *)(map->pyramid + at);
+  if (ph->magic != ECG_PYRAMID_PAGE_MAGIC || ph->level != level || ph->firstEntry != page * hdr.entriesPerPage ||
+      ph->entries > hdr.entriesPerPage) {
+    setError("pagina %u del nivel %d danada", (unsigned)page, level);
+    return NULL;
+  }
+  *entries = ph->entries;
+  return (const EcgMapEntry *)(ph + 1);
+}
+
+uint32_t ecgMapPyramidRead(const EcgMap *map, int level, uint32_t first, uint32_t count, EcgMapEntry *out) {
+  uint32_t total = ecgMapPyramidEntries(map, level);
+  uint32_t done = 0;
+  while (done < count && first + done < total) {
+    uint32_t e = first + done;
+    uint32_t per = map->pyramidHdr.entriesPerPage;
+    uint32_t entries;
+    const EcgMapEntry *page = ecgMapPyramidPage(map, level, e / per, &entries);
+    if (!page || e % per >= entries) {
+      break;
+    }
+    uint32_t n = entries - e % per;
+    n = n < count - done ? n : count - done;
+    memcpy(out + done, page + e % per, n * sizeof(EcgMapEntry));
+    done += n;
+  }
+  return done;
+}
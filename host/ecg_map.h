@@ -0,0 +1,106 @@
+#ifndef ECG_MAP_H
+#define ECG_MAP_H
+
+// Lectura de grabaciones .ecg (y su índice .pyr) con mmap y una interfaz C,
+// para usarlas desde los notebooks con ctypes y desde las herramientas de
+// lote sin pasar por texto. Abrir una grabación solo lee la cabecera (y la
+// cabecera del último chunk si no se cerró), así que tarda lo mismo con
+// cualquier duración; las muestras se leen recién al pedirlas.
+//
+// Sin copias: la cabecera, el payload de cada chunk (las muestras int16
+// intercaladas de los ECG_CODEC_RAW16) y las páginas del .pyr se entregan como
+// punteros dentro del archivo mapeado, válidos hasta ecgMapClose(). Los chunks
+// ECG_CODEC_RICE hay que decodificarlos: ecgMapReadCounts/ecgMapReadVolts
+// escriben directo en el arreglo de quien llama (un arreglo de numpy, por
+// ejemplo), de a una partición por vez y sin memoria intermedia.
+//
+// Un EcgMap no cambia después de abrirlo, así que varios hilos pueden leer del
+// mismo a la vez. El último error es por hilo. Se compila como biblioteca
+// compartida (libecg_map.so, ver el README) o junto con el programa.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ECG_MAP_ABI_VERSION 1
+#define ECG_MAP_MAX_LEADS 4
+#define ECG_MAP_GAP_COUNTS (-32768)   // Muestra que falta en ecgMapReadCounts
+
+typedef struct EcgMap EcgMap;
+
+typedef struct {
+  uint32_t sampleRate;         // Hz
+  uint32_t leadCount;
+  uint32_t frameCount;         // Muestras por derivación, con los huecos
+  uint32_t chunkCount;
+  uint32_t startMillis;
+  float averageBpm;            // 0 si no se midió
+  float gain[ECG_MAP_MAX_LEADS];     // volts = raw * gain + offset
+  float offset[ECG_MAP_MAX_LEADS];
+  int32_t closed;              // 0 si no se cerró bien (recuperada de los chunks)
+  uint32_t pyramidLevels;      // 0 sin índice .pyr
+  uint32_t pyramidBaseFrames;  // Muestras por entrada del nivel 0
+  uint64_t fileBytes;
+} EcgMapInfo;
+
+typedef struct {
+  uint32_t firstFrame;
+  uint32_t frames;
+  uint32_t codec;              // ECG_CODEC_RAW16 (0) o ECG_CODEC_RICE (1)
+  uint32_t payloadBytes;
+  uint64_t payloadOffset;      // Posición del payload en el archivo
+} EcgMapChunk;
+
+// Mínimo y máximo en cuentas de un tramo del .pyr; lo > hi marca un hueco
+typedef struct {
+  int16_t lo[3];
+  int16_t hi[3];
+} EcgMapEntry;
+
+// ECG_MAP_ABI_VERSION con que se compiló la biblioteca
+uint32_t ecgMapAbiVersion(void);
+
+// Abre la grabación. pyramidPath NULL busca el .pyr junto a la grabación
+// (sin él se sigue sin índice); "" no usa índice. NULL si falla.
+EcgMap *ecgMapOpen(const char *path, const char *pyramidPath);
+void ecgMapClose(EcgMap *map);
+// Motivo del último fallo de este hilo ("" si no hubo)
+const char *ecgMapLastError(void);
+
+void ecgMapGetInfo(const EcgMap *map, EcgMapInfo *info);
+// Cabecera EcgRecordHeader tal como está en el archivo (512 bytes)
+const void *ecgMapHeader(const EcgMap *map);
+
+// Muestras entre los segundos t0 y t1 (t1 excluido), recortadas a la
+// grabación; devuelve cuántas son y la primera en *first
+uint32_t ecgMapSlice(const EcgMap *map, double t0, double t1, uint32_t *first);
+
+// Último chunk que empieza en `frame` o antes; -1 si no hay
+int32_t ecgMapFindChunk(const EcgMap *map, uint32_t frame);
+// Cabecera del chunk; 0 si el índice no existe o el chunk está dañado
+int ecgMapChunk(const EcgMap *map, uint32_t index, EcgMapChunk *chunk);
+// Payload del chunk dentro del archivo (payloadBytes bytes); NULL si no existe
+const void *ecgMapChunkData(const EcgMap *map, uint32_t index);
+
+// Lee `count` muestras desde `first`: con lead -1 las tres derivaciones
+// intercaladas (count * 3 valores), si no solo esa derivación. Los huecos y lo
+// que cae fuera de la grabación quedan en ECG_MAP_GAP_COUNTS o NaN. Devuelve
+// cuántas muestras había en la grabación.
+uint32_t ecgMapReadCounts(const EcgMap *map, uint32_t first, uint32_t count, int lead, int16_t *out);
+uint32_t ecgMapReadVolts(const EcgMap *map, uint32_t first, uint32_t count, int lead, float *out);
+
+// Índice .pyr: entradas del nivel, muestras que cubre cada una, y hasta
+// `count` entradas desde `first` (devuelve cuántas leyó)
+uint32_t ecgMapPyramidEntries(const EcgMap *map, int level);
+uint32_t ecgMapPyramidEntryFrames(const EcgMap *map, int level);
+uint32_t ecgMapPyramidRead(const EcgMap *map, int level, uint32_t first, uint32_t count, EcgMapEntry *out);
+// Entradas de la página `page` del nivel dentro del archivo; NULL si no existe
+const EcgMapEntry *ecgMapPyramidPage(const EcgMap *map, int level, uint32_t page, uint32_t *entries);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
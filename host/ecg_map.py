@@ -0,0 +1,208 @@
+#!/usr/bin/env python3
+# Grabaciones .ecg del equipo desde los notebooks, con libecg_map.so (ecg_map.h)
+# y ctypes: el archivo se mapea en memoria, abrirlo no depende de la duración y
+# las muestras se decodifican directo en arreglos de numpy, sin pasar por texto.
+#
+#   from ecg_map import EcgRecording
+#   with EcgRecording('ECG_1234.ecg') as g:
+#       d2 = g.lead(1, 10, 20)            # derivación II (0 = I) de 10 a 20 s, en voltios
+#       todo = g.leads()                  # (muestras, 3) en voltios, NaN en los huecos
+#       lo, hi = g.envelope(0)            # mín/máx del .pyr cada 128 muestras
+#
+# La biblioteca se busca en $ECG_MAP_LIB, junto a este archivo y en la carpeta
+# de arriba (donde la deja el README). Los arreglos de chunk_raw() y
+# pyramid_page() apuntan al archivo mapeado (sin copia) y lo mantienen abierto
+# mientras existan; no hay que usarlos después de close().
+
+import ctypes
+import os
+
+import numpy as np
+
+ECG_MAP_ABI_VERSION = 1
+ECG_MAP_MAX_LEADS = 4
+ECG_MAP_GAP_COUNTS = -32768
+ECG_LEADS = 3
+ECG_CODEC_RAW16 = 0
+
+
+class EcgMapInfo(ctypes.Structure):
+    _fields_ = [('sampleRate', ctypes.c_uint32), ('leadCount', ctypes.c_uint32),
+                ('frameCount', ctypes.c_uint32), ('chunkCount', ctypes.c_uint32),
+                ('startMillis', ctypes.c_uint32), ('averageBpm', ctypes.c_float),
+                ('gain', ctypes.c_float * ECG_MAP_MAX_LEADS), ('offset', ctypes.c_float * ECG_MAP_MAX_LEADS),
+                ('closed', ctypes.c_int32), ('pyramidLevels', ctypes.c_uint32),
+                ('pyramidBaseFrames', ctypes.c_uint32), ('fileBytes', ctypes.c_uint64)]
+
+
+class EcgMapChunk(ctypes.Structure):
+    _fields_ = [('firstFrame', ctypes.c_uint32), ('frames', ctypes.c_uint32), ('codec', ctypes.c_uint32),
+                ('payloadBytes', ctypes.c_uint32), ('payloadOffset', ctypes.c_uint64)]
+
+
+def _load_library():
+    here = os.path.dirname(os.path.abspath(__file__))
+    candidates = [os.environ.get('ECG_MAP_LIB'), os.path.join(here, 'libecg_map.so'),
+                  os.path.join(here, '..', 'libecg_map.so')]
+    for path in candidates:
+        if path and os.path.exists(path):
+            lib = ctypes.CDLL(path)
+            break
+    else:
+        raise OSError('no se encontro libecg_map.so (compilarla como dice el README o definir ECG_MAP_LIB)')
+
+    p, u32, i32 = ctypes.c_void_p, ctypes.c_uint32, ctypes.c_int32
+    signatures = {
+        'ecgMapAbiVersion': (u32, []),
+        'ecgMapOpen': (p, [ctypes.c_char_p, ctypes.c_char_p]),
+        'ecgMapClose': (None, [p]),
+        'ecgMapLastError': (ctypes.c_char_p, []),
+        'ecgMapGetInfo': (None, [p, ctypes.POINTER(EcgMapInfo)]),
+        'ecgMapSlice': (u32, [p, ctypes.c_double, ctypes.c_double, ctypes.POINTER(u32)]),
+        'ecgMapFindChunk': (i32, [p, u32]),
+        'ecgMapChunk': (ctypes.c_int, [p, u32, ctypes.POINTER(EcgMapChunk)]),
+        'ecgMapChunkData': (p, [p, u32]),
+        'ecgMapReadCounts': (u32, [p, u32, u32, ctypes.c_int, p]),
+        'ecgMapReadVolts': (u32, [p, u32, u32, ctypes.c_int, p]),
+        'ecgMapPyramidEntries': (u32, [p, ctypes.c_int]),
+        'ecgMapPyramidEntryFrames': (u32, [p, ctypes.c_int]),
+        'ecgMapPyramidRead': (u32, [p, ctypes.c_int, u32, u32, p]),
+        'ecgMapPyramidPage': (p, [p, ctypes.c_int, u32, ctypes.POINTER(u32)]),
+    }
+    for name, (restype, argtypes) in signatures.items():
+        f = getattr(lib, name)
+        f.restype = restype
+        f.argtypes = argtypes
+    if lib.ecgMapAbiVersion() != ECG_MAP_ABI_VERSION:
+        raise OSError('libecg_map.so con version de ABI %d, se esperaba %d' %
+                      (lib.ecgMapAbiVersion(), ECG_MAP_ABI_VERSION))
+    return lib
+
+
+_lib = None
+
+
+class EcgRecording:
+    def __init__(self, path, pyramid=None):
+        """pyramid: None busca el .pyr junto a la grabación, '' no usa índice."""
+        global _lib
+        if _lib is None:
+            _lib = _load_library()
+        self._lib = _lib
+        pyr = None if pyramid is None else os.fsencode(pyramid)
+        self._map = _lib.ecgMapOpen(os.fsencode(path), pyr)
+        if not self._map:
+            raise OSError(_lib.ecgMapLastError().decode('utf-8', 'replace'))
+        self.info = EcgMapInfo()
+        _lib.ecgMapGetInfo(self._map, ctypes.byref(self.info))
+        self.path = path
+        self.rate = self.info.sampleRate
+        self.frames = self.info.frameCount
+        self.gain = np.array(self.info.gain[:ECG_LEADS], dtype=np.float32)
+        self.offset = np.array(self.info.offset[:ECG_LEADS], dtype=np.float32)
+
+    def close(self):
+        if getattr(self, '_map', None):
+            self._lib.ecgMapClose(self._map)
+            self._map = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    @property
+    def seconds(self):
+        return self.frames / self.rate if self.rate else 0.0
+
+    @property
+    def has_pyramid(self):
+        return self.info.pyramidLevels > 0
+
+    def slice(self, t0=0.0, t1=None):
+        """(primera muestra, cantidad) entre t0 y t1 segundos, t1 excluido."""
+        first = ctypes.c_uint32()
+        count = self._lib.ecgMapSlice(self._map, t0, self.seconds if t1 is None else t1, ctypes.byref(first))
+        return first.value, count
+
+    def _read(self, reader, dtype, lead, t0, t1):
+        first, count = self.slice(t0, t1)
+        out = np.empty((count, ECG_LEADS) if lead < 0 else count, dtype=dtype)
+        reader(self._map, first, count, lead, out.ctypes.data)
+        return out
+
+    def lead(self, lead, t0=0.0, t1=None):
+        """Una derivación (0, 1 o 2) en voltios, float32 con NaN en los huecos."""
+        if not 0 <= lead < ECG_LEADS:
+            raise ValueError('derivacion %d fuera de rango' % lead)
+        return self._read(self._lib.ecgMapReadVolts, np.float32, lead, t0, t1)
+
+    def leads(self, t0=0.0, t1=None):
+        """(muestras, 3) en voltios, float32 con NaN en los huecos."""
+        return self._read(self._lib.ecgMapReadVolts, np.float32, -1, t0, t1)
+
+    def counts(self, t0=0.0, t1=None):
+        """(muestras, 3) en cuentas int16, ECG_MAP_GAP_COUNTS en los huecos."""
+        return self._read(self._lib.ecgMapReadCounts, np.int16, -1, t0, t1)
+
+    def _view(self, address, ctype, count):
+        # Arreglo de numpy sobre el archivo mapeado que mantiene viva la grabación
+        buf = (ctype * count).from_address(address)
+        buf._owner = self
+        view = np.frombuffer(buf, dtype=np.dtype(ctype))
+        view.flags.writeable = False   # El mapa es de solo lectura
+        return view
+
+    def chunks(self):
+        """Cabeceras de los chunks: (primera muestra, muestras, codec, bytes)."""
+        out = []
+        c = EcgMapChunk()
+        for i in range(self.info.chunkCount):
+            if self._lib.ecgMapChunk(self._map, i, ctypes.byref(c)):
+                out.append((c.firstFrame, c.frames, c.codec, c.payloadBytes))
+        return out
+
+    def find_chunk(self, frame):
+        return self._lib.ecgMapFindChunk(self._map, frame)
+
+    def chunk_raw(self, index):
+        """Muestras (frames, 3) de un chunk crudo sin copiarlas; None si está comprimido."""
+        c = EcgMapChunk()
+        if not self._lib.ecgMapChunk(self._map, index, ctypes.byref(c)):
+            raise IndexError('chunk %d' % index)
+        if c.codec != ECG_CODEC_RAW16 or c.frames == 0:
+            return None
+        data = self._lib.ecgMapChunkData(self._map, index)
+        return self._view(data, ctypes.c_int16, c.frames * ECG_LEADS).reshape(c.frames, ECG_LEADS)
+
+    def entry_frames(self, level):
+        return self._lib.ecgMapPyramidEntryFrames(self._map, level)
+
+    def pyramid_page(self, level, page):
+        """Entradas (n, 2, 3) [lo/hi] de una página del .pyr sin copiarlas, en cuentas."""
+        entries = ctypes.c_uint32()
+        data = self._lib.ecgMapPyramidPage(self._map, level, page, ctypes.byref(entries))
+        if not data:
+            raise IndexError('pagina %d del nivel %d' % (page, level))
+        return self._view(data, ctypes.c_int16, entries.value * 2 * ECG_LEADS).reshape(-1, 2, ECG_LEADS)
+
+    def envelope(self, level, first=0, count=None):
+        """(lo, hi) en voltios, cada uno (entradas, 3), de `count` entradas del
+        nivel desde `first`; NaN en las entradas sin muestras."""
+        total = self._lib.ecgMapPyramidEntries(self._map, level)
+        if total == 0:
+            raise ValueError('sin indice .pyr o nivel %d fuera de rango' % level)
+        count = total - first if count is None else min(count, total - first)
+        raw = np.empty((max(count, 0), 2, ECG_LEADS), dtype=np.int16)
+        n = self._lib.ecgMapPyramidRead(self._map, level, first, raw.shape[0], raw.ctypes.data)
+        raw = raw[:n]
+        lo = raw[:, 0, :] * self.gain + self.offset
+        hi = raw[:, 1, :] * self.gain + self.offset
+        empty = raw[:, 0, :] > raw[:, 1, :]
+        lo[empty] = np.nan
+        hi[empty] = np.nan
+        return lo, hi
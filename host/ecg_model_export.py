@@ -0,0 +1,236 @@
+#!/usr/bin/env python3
+# Exporta la red de IA_ISB.ipynb (el .h5 que guarda model.save) al formato
+# .ecgm de ecg_nn.h para el clasificador del equipo (ecg_classifier.h), y una
+# referencia para `ecg_classify --check` con las predicciones de Keras.
+#
+#   python ecg_model_export.py alexnet_ecg_model_augmented.h5 --data DIR --out modelo.ecgm
+#          [--header ../ecg_model_data.h] [--reference referencia.ecgr] [--max-records 500]
+#
+# DIR tiene las carpetas del notebook (IMI, ILMI, ... y NORM) con los CSV de
+# 100 Hz. Los registros se preprocesan con las mismas funciones del notebook
+# (copiadas abajo) y sirven para calibrar la escala de cada activación (máximo
+# absoluto) y como referencia. Necesita el entorno de los notebooks:
+# tensorflow, numpy, pandas y pywt.
+
+import argparse
+import os
+import struct
+import sys
+
+import numpy as np
+import pandas as pd
+import pywt
+import tensorflow as tf
+
+ECG_NN_MAGIC = 0x4D474345      # "ECGM"
+ECG_NN_VERSION = 1
+ECG_NN_MAX_TENSOR = 4096
+CONV1D, MAXPOOL, DENSE = 1, 2, 3
+RELU, FLOAT_OUT = 1, 2
+REFERENCE_MAGIC = 0x52474345   # "ECGR"
+MODEL_WINDOW = 1000            # ECG_MODEL_WINDOW
+
+INFARCT_FOLDERS = ['IMI', 'ASMI', 'ILMI', 'AMI', 'ALMI', 'INJAL', 'INJAS', 'LMI', 'IPLMI', 'IPMI', 'INJIL',
+                   'INJIN', 'INJLA', 'PMI']
+
+
+# --- Preprocesamiento de IA_ISB.ipynb (sin cambios) ---
+
+def aplicar_wavelet_denoising(datos, wavelet='sym4', nivel=4, mode='soft'):
+    coeficientes = pywt.wavedec(datos, wavelet, level=nivel)
+    sigma = np.median(np.abs(coeficientes[-1])) / 0.6745
+    umbral = sigma * np.sqrt(2 * np.log(len(datos))) * 1.5
+    coeficientes[1:] = [pywt.threshold(c, value=umbral, mode=mode) for c in coeficientes[1:]]
+    return pywt.waverec(coeficientes, wavelet)
+
+
+def extract_wavelet_features(signal, wavelet='sym4', level=6):
+    coeffs = pywt.wavedec(signal, wavelet, level=level)
+    features = []
+    for coeff in coeffs:
+        features.extend([np.mean(coeff), np.std(coeff), np.max(coeff), np.min(coeff), np.median(coeff)])
+    return np.array(features)
+
+
+def normalize(features):
+    lo = np.min(features, axis=1, keepdims=True)
+    hi = np.max(features, axis=1, keepdims=True)
+    return (features - lo) / (hi - lo)
+
+
+def load_records(data_dir, max_records):
+    # label_map del notebook: infarto = 0, NORM = 1
+    signals, labels = [], []
+    for label, folders in ((0, INFARCT_FOLDERS), (1, ['NORM'])):
+        for folder in folders:
+            path = os.path.join(data_dir, folder)
+            if not os.path.isdir(path):
+                continue
+            for name in sorted(os.listdir(path)):
+                if name.endswith('.csv'):
+                    # encoding="ansi" en el notebook solo existe en Windows
+                    signal = pd.read_csv(os.path.join(path, name), header=None, encoding='latin-1',
+                                         skiprows=2).values.flatten().astype(np.float64)
+                    signals.append(signal)
+                    labels.append(label)
+    if max_records and len(signals) > max_records:
+        pick = np.random.RandomState(42).choice(len(signals), max_records, replace=False)
+        signals = [signals[i] for i in sorted(pick)]
+        labels = [labels[i] for i in sorted(pick)]
+    return signals, labels
+
+
+# --- Capas del modelo ---
+
+def collect_layers(model):
+    """Lista de capas a exportar; cada BatchNormalization queda en la capa anterior."""
+    layers = []
+    for layer in model.layers:
+        kind = type(layer).__name__
+        if kind == 'Conv1D' or kind == 'Dense':
+            if kind == 'Conv1D' and (layer.padding != 'same' or layer.dilation_rate[0] != 1):
+                sys.exit('Conv1D %s: solo padding same sin dilatación' % layer.name)
+            activation = layer.activation.__name__
+            if activation not in ('relu', 'linear', 'softmax'):
+                sys.exit('%s: activación %s no soportada' % (layer.name, activation))
+            layers.append({'kind': kind, 'layer': layer, 'activation': activation, 'bn': None, 'output': layer})
+        elif kind == 'MaxPooling1D':
+            if layer.padding != 'same':
+                sys.exit('MaxPooling1D %s: solo padding same' % layer.name)
+            layers.append({'kind': kind, 'layer': layer, 'output': layer})
+        elif kind == 'BatchNormalization':
+            if not layers or layers[-1]['kind'] not in ('Conv1D', 'Dense') or layers[-1]['bn']:
+                sys.exit('BatchNormalization %s sin capa anterior que la absorba' % layer.name)
+            layers[-1]['bn'] = layer
+            layers[-1]['output'] = layer
+        elif kind in ('Flatten', 'Dropout', 'InputLayer'):
+            continue
+        else:
+            sys.exit('capa %s (%s) no soportada' % (layer.name, kind))
+    if layers[-1]['kind'] != 'Dense' or layers[-1]['activation'] != 'softmax' or layers[-1]['bn']:
+        sys.exit('la última capa tiene que ser Dense con softmax')
+    return layers
+
+
+def batchnorm_affine(bn, channels):
+    if bn is None:
+        return np.ones(channels), np.zeros(channels)
+    weights = bn.get_weights()
+    gamma = weights.pop(0) if bn.scale else np.ones(channels)
+    beta = weights.pop(0) if bn.center else np.zeros(channels)
+    mean, var = weights
+    a = gamma / np.sqrt(var + bn.epsilon)
+    return a, beta - mean * a
+
+
+def export(model, layers, calibration, path):
+    # Escala de cada activación: máximo absoluto sobre la calibración
+    probes = tf.keras.Model(model.inputs, [l['output'].output for l in layers])
+    outputs = probes.predict(calibration, verbose=0)
+    input_shape = model.input_shape[1:]
+    scale_in = 1.0 / 127   # Las características normalizadas están en [0, 1]
+    header = struct.pack('<IHHHHHHfI', ECG_NN_MAGIC, ECG_NN_VERSION, len(layers), input_shape[0], input_shape[1],
+                         model.output_shape[-1], 0, scale_in, 0)
+    body = b''
+    largest = input_shape[0] * input_shape[1]
+    for i, entry in enumerate(layers):
+        last = i == len(layers) - 1
+        out_shape = outputs[i].shape[1:]
+        largest = max(largest, int(np.prod(out_shape)))
+        layer = entry['layer']
+        if entry['kind'] == 'MaxPooling1D':
+            body += struct.pack('<BBHHHI', MAXPOOL, 0, layer.pool_size[0], layer.strides[0], 0, 0)
+            continue
+        kernel, bias = layer.get_weights() if layer.use_bias else (layer.get_weights()[0], None)
+        channels = kernel.shape[-1]
+        if bias is None:
+            bias = np.zeros(channels)
+        # Pesos como [salida][kernel][entrada]; la densa aplana [tiempo][canal] como Flatten
+        weights = kernel.transpose(2, 0, 1) if entry['kind'] == 'Conv1D' else kernel.T
+        weights = weights.reshape(channels, -1)
+        scale_w = np.abs(weights).max(axis=1) / 127
+        scale_w[scale_w == 0] = 1
+        wq = np.clip(np.round(weights / scale_w[:, None]), -127, 127).astype(np.int8)
+        bq = np.round(bias / (scale_in * scale_w)).astype(np.int32)
+        a, b = batchnorm_affine(entry['bn'], channels)
+        if last:
+            mult = scale_in * scale_w
+            offset = np.zeros(channels)
+            flags = FLOAT_OUT
+        else:
+            scale_out = max(float(np.abs(outputs[i]).max()), 1e-8) / 127
+            mult = a * scale_in * scale_w / scale_out
+            offset = b / scale_out
+            flags = RELU if entry['activation'] == 'relu' else 0
+            scale_in = scale_out
+        data = wq.tobytes()
+        data += b'\0' * (-len(data) % 4)
+        data += bq.astype('<i4').tobytes() + mult.astype('<f4').tobytes() + offset.astype('<f4').tobytes()
+        if entry['kind'] == 'Conv1D':
+            body += struct.pack('<BBHHHI', CONV1D, flags, layer.kernel_size[0], layer.strides[0], channels, len(data))
+        else:
+            body += struct.pack('<BBHHHI', DENSE, flags, 0, 0, channels, len(data))
+        body += data
+    if largest > ECG_NN_MAX_TENSOR:
+        sys.exit('la activación más grande (%d bytes) supera ECG_NN_MAX_TENSOR' % largest)
+    blob = bytearray(header + body)
+    struct.pack_into('<I', blob, 20, len(blob))
+    with open(path, 'wb') as f:
+        f.write(blob)
+    return bytes(blob)
+
+
+def write_header(blob, source, path):
+    with open(path, 'w') as f:
+        f.write('// Generado por host/ecg_model_export.py a partir de %s; no editar.\n' % os.path.basename(source))
+        f.write('// %d bytes en la flash (hace falta un esquema de particiones con lugar para la app).\n' % len(blob))
+        f.write('#ifndef ECG_MODEL_DATA_H\n#define ECG_MODEL_DATA_H\n\n#include <stdint.h>\n\n')
+        f.write('alignas(4) const uint8_t ecgModelData[] = {\n')
+        for i in range(0, len(blob), 16):
+            f.write('  ' + ', '.join('0x%02x' % v for v in blob[i:i + 16]) + ',\n')
+        f.write('};\n\n#endif\n')
+
+
+def write_reference(signals, labels, features, probs, path):
+    with open(path, 'wb') as f:
+        f.write(struct.pack('<IHHHHI', REFERENCE_MAGIC, 1, features.shape[1], probs.shape[1], 0, len(signals)))
+        for signal, label, feat, prob in zip(signals, labels, features, probs):
+            f.write(struct.pack('<Ii', len(signal), label))
+            f.write(np.asarray(signal, '<f4').tobytes())
+            f.write(np.asarray(feat, '<f4').tobytes())
+            f.write(np.asarray(prob, '<f4').tobytes())
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Exporta la red de IA_ISB.ipynb a .ecgm')
+    parser.add_argument('model')
+    parser.add_argument('--data', required=True, help='carpeta con IMI, ILMI, ..., NORM')
+    parser.add_argument('--out', required=True)
+    parser.add_argument('--header', help='también como arreglo C (ecg_model_data.h)')
+    parser.add_argument('--reference', help='referencia para ecg_classify --check')
+    parser.add_argument('--max-records', type=int, default=500)
+    args = parser.parse_args()
+
+    model = tf.keras.models.load_model(args.model, compile=False)
+    layers = collect_layers(model)
+    signals, labels = load_records(args.data, args.max_records)
+    if not signals:
+        sys.exit('no hay CSV en %s' % args.data)
+    features = normalize(np.array([extract_wavelet_features(aplicar_wavelet_denoising(s)) for s in signals]))
+    features = np.expand_dims(features, axis=-1).astype(np.float32)
+
+    blob = export(model, layers, features, args.out)
+    print('%s: %d bytes, %d capas' % (args.out, len(blob), len(layers)))
+    if args.header:
+        write_header(blob, args.model, args.header)
+    if args.reference:
+        # El equipo clasifica ventanas de hasta MODEL_WINDOW muestras
+        keep = [i for i, s in enumerate(signals) if len(s) <= MODEL_WINDOW]
+        probs = model.predict(features[keep], verbose=0)
+        write_reference([signals[i] for i in keep], [labels[i] for i in keep], features[keep, :, 0], probs,
+                        args.reference)
+        print('%s: %d registros' % (args.reference, len(keep)))
+
+
+if __name__ == '__main__':
+    main()
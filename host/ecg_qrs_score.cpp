@@ -0,0 +1,252 @@
+// Evalúa EcgQrsDetector contra latidos anotados: sensibilidad (Se) y valor
+// predictivo positivo (+P) con una tolerancia de 150 ms, como en EC57.
+//
+//   ecg_qrs_score --record 100.txt --annotations 100.ann [--rate 360] [--column 1]
+//   ecg_qrs_score --synthetic 72 [--seconds 300] [--noise 0.05] [--seed 1]
+//   ... [--min-se 99.5] [--min-ppv 99.5]
+//
+// El registro es texto con una muestra por línea en columnas separadas por
+// espacios (p. ej. `rdsamp -r 100 -p`). Las anotaciones son un índice de
+// muestra por línea o la salida de `rdann` (se usan solo los latidos).
+// La señal pasa por el mismo banco de filtros que FilterTask. Los latidos de
+// los primeros 2 s (aprendizaje del detector) no se cuentan. Con --min-se o
+// --min-ppv (en %) termina con código 1 si Se o +P quedan por debajo, para
+// usarlo como prueba de regresión.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "../ecg_filter.h"
+#include "../ecg_qrs.h"
+
+static const double toleranceSec = 0.150;
+static const double learningSec = 2.0;
+
+static bool loadRecord(const char *path, int column, std::vector<float> &signal) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return false;
+  }
+  char line[512];
+  while (fgets(line, sizeof(line), f)) {
+    char *p = line;
+    char *end;
+    double v = 0;
+    int c = 0;
+    bool found = false;
+    while (true) {
+      v = strtod(p, &end);
+      if (end == p) {
+        break;
+      }
+      if (c++ == column) {
+        found = true;
+        break;
+      }
+      p = end;
+    }
+    if (found) {
+      signal.push_back((float)v);
+    }
+  }
+  fclose(f);
+  return !signal.empty();
+}
+
+static bool isBeatSymbol(const char *s) {
+  return strlen(s) == 1 && strchr("NLRBAaJSVrFejnE/fQ?", s[0]) != NULL;
+}
+
+static bool loadAnnotations(const char *path, std::vector<long> &beats) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return false;
+  }
+  char line[512];
+  while (fgets(line, sizeof(line), f)) {
+    char a[64], b[64], c[64];
+    int n = sscanf(line, "%63s %63s %63s", a, b, c);
+    if (n >= 3 && strchr(a, ':')) {
+      // Formato de rdann: tiempo, muestra, tipo, ...
+      if (isBeatSymbol(c)) {
+        beats.push_back(atol(b));
+      }
+    } else if (n >= 1 && a[0] >= '0' && a[0] <= '9') {
+      beats.push_back(atol(a));
+    }
+  }
+  fclose(f);
+  return !beats.empty();
+}
+
+// Latidos gaussianos (P, Q, R, S, T) con RR variable, extrasístoles, deriva,
+// 50 Hz y ruido. Devuelve en `beats` la muestra de cada pico R.
+static void synthesize(double bpm, double seconds, double noise, unsigned seed, double rate,
+                       std::vector<float> &signal, std::vector<long> &beats) {
+  static const double waves[5][3] = {
+      {-0.20, 0.025, 0.12}, {-0.04, 0.010, -0.15}, {0.0, 0.012, 1.00},
+      {0.04, 0.010, -0.25}, {0.30, 0.040, 0.30}};
+  srand(seed);
+  long total = (long)(seconds * rate);
+  signal.assign(total, 0.0f);
+  double t = 0.5;
+  double rr = 60.0 / bpm;
+  while (t < seconds - 1) {
+    beats.push_back(lround(t * rate));
+    for (int k = 0; k < 5; k++) {
+      double center = t + waves[k][0] * rr / 0.833, width = waves[k][1];
+      long first = lround((center - 5 * width) * rate), last = lround((center + 5 * width) * rate);
+      for (long i = first < 0 ? 0 : first; i <= last && i < total; i++) {
+        double d = i / rate - center;
+        signal[i] += waves[k][2] * exp(-d * d / (2 * width * width));
+      }
+    }
+    // RR con variación lenta de +-10 % y una extrasístol cada ~20 latidos
+    double base = 60.0 / bpm * (1.0 + 0.1 * sin(t * 0.2));
+    rr = rand() % 20 == 0 ? base * 0.65 : base * (1.0 + ((rand() % 1000) / 1000.0 - 0.5) * 0.06);
+    t += rr;
+  }
+  for (long i = 0; i < total; i++) {
+    double s = i / rate;
+    double white = ((rand() % 20001) / 10000.0 - 1.0) * noise;
+    signal[i] += (float)(1.65 + 0.15 * sin(2 * M_PI * 0.3 * s) + 0.03 * sin(2 * M_PI * 50 * s) + white);
+  }
+}
+
+static void usage() {
+  fprintf(stderr,
+          "uso: ecg_qrs_score --record ARCHIVO --annotations ARCHIVO [--rate HZ] [--column N]\n"
+          "     ecg_qrs_score --synthetic BPM [--seconds S] [--noise V] [--seed N] [--rate HZ]\n"
+          "                   [--notch HZ]\n"
+          "     (ambos) [--min-se PCT] [--min-ppv PCT]\n");
+}
+
+int main(int argc, char **argv) {
+  const char *recordPath = NULL;
+  const char *annPath = NULL;
+  double rate = 0;
+  int column = 0;
+  double syntheticBpm = 0;
+  double seconds = 300;
+  double noise = 0.02;
+  unsigned seed = 1;
+  double minSe = 0, minPpv = 0;
+  EcgFilterBankConfig config = ecgDefaultFilterConfig;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+      recordPath = argv[++i];
+    } else if (!strcmp(argv[i], "--annotations") && i + 1 < argc) {
+      annPath = argv[++i];
+    } else if (!strcmp(argv[i], "--rate") && i + 1 < argc) {
+      rate = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--column") && i + 1 < argc) {
+      column = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--synthetic") && i + 1 < argc) {
+      syntheticBpm = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--noise") && i + 1 < argc) {
+      noise = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      seed = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--notch") && i + 1 < argc) {
+      config.notchHz = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--min-se") && i + 1 < argc) {
+      minSe = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--min-ppv") && i + 1 < argc) {
+      minPpv = atof(argv[++i]);
+    } else {
+      usage();
+      return 2;
+    }
+  }
+
+  std::vector<float> signal;
+  std::vector<long> reference;
+  if (syntheticBpm > 0) {
+    rate = rate > 0 ? rate : 1000;
+    config.notchHz = config.notchHz == ecgDefaultFilterConfig.notchHz ? 50 : config.notchHz;
+    synthesize(syntheticBpm, seconds, noise, seed, rate, signal, reference);
+  } else if (recordPath && annPath) {
+    rate = rate > 0 ? rate : 360;  // MIT-BIH
+    if (!loadRecord(recordPath, column, signal) || !loadAnnotations(annPath, reference)) {
+      fprintf(stderr, "no se pudo leer el registro o las anotaciones\n");
+      return 1;
+    }
+  } else {
+    usage();
+    return 2;
+  }
+
+  // Mismo camino que FilterTask: banco de filtros y detector muestra a muestra
+  config.sampleRate = rate;
+  EcgFilterBank bank;
+  bank.configure(config);
+  EcgQrsDetector detector;
+  detector.begin(rate);
+  std::vector<long> detected;
+  for (size_t i = 0; i < signal.size(); i++) {
+    float lead[ECG_LEADS] = {signal[i], 0, 0};
+    bank.process(lead);
+    if (detector.process(lead[0])) {
+      detected.push_back(detector.lastPeak());
+    }
+  }
+
+  // Emparejamiento en orden: cada referencia toma la detección más cercana
+  // dentro de la tolerancia que no se haya usado
+  long tolerance = lround(toleranceSec * rate);
+  long skip = lround(learningSec * rate);
+  long tp = 0, fn = 0, fp = 0;
+  double errorSum = 0;
+  size_t d = 0;
+  std::vector<bool> used(detected.size(), false);
+  for (size_t r = 0; r < reference.size(); r++) {
+    long ref = reference[r];
+    if (ref < skip || ref >= (long)signal.size()) {
+      continue;
+    }
+    while (d < detected.size() && detected[d] < ref - tolerance) {
+      d++;
+    }
+    long best = -1;
+    for (size_t k = d; k < detected.size() && detected[k] <= ref + tolerance; k++) {
+      if (!used[k] && (best < 0 || labs(detected[k] - ref) < labs(detected[best] - ref))) {
+        best = k;
+      }
+    }
+    if (best >= 0) {
+      used[best] = true;
+      tp++;
+      errorSum += labs(detected[best] - ref);
+    } else {
+      fn++;
+    }
+  }
+  for (size_t k = 0; k < detected.size(); k++) {
+    if (!used[k] && detected[k] >= skip) {
+      fp++;
+    }
+  }
+
+  double se = tp + fn > 0 ? 100.0 * tp / (tp + fn) : 0;
+  double ppv = tp + fp > 0 ? 100.0 * tp / (tp + fp) : 0;
+  printf("muestras            : %zu (%.1f s a %.0f Hz)\n", signal.size(), signal.size() / rate, rate);
+  printf("latidos referencia  : %ld\n", tp + fn);
+  printf("latidos detectados  : %ld\n", tp + fp);
+  printf("VP / FP / FN        : %ld / %ld / %ld\n", tp, fp, fn);
+  printf("Se                  : %.2f %%\n", se);
+  printf("+P                  : %.2f %%\n", ppv);
+  printf("error medio del R   : %.1f ms\n", tp > 0 ? errorSum / tp / rate * 1000 : 0);
+  printf("BPM final           : %.1f\n", detector.heartRate());
+  if (se < minSe || ppv < minPpv) {
+    fprintf(stderr, "por debajo del mínimo: Se %.2f %% (mín %.2f), +P %.2f %% (mín %.2f)\n", se, minSe, ppv,
+            minPpv);
+    return 1;
+  }
+  return 0;
+}
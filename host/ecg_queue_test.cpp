@@ -0,0 +1,152 @@
+// Prueba de las colas SPSC de ecg_queue.h con un hilo productor y uno
+// consumidor, como AcquisitionTask -> FilterTask -> lazo de captura. El
+// productor hace push() de muestras numeradas: la mayor parte del tiempo
+// espera a que haya lugar y en una de cada 8 ventanas empuja sin esperar,
+// anotando las que no entraron. El consumidor las saca con popBatch(), con
+// pausas en esas ventanas para que la cola se llene. Al final verifica que:
+//   - las muestras recibidas llegan en orden, sin repetir y sin datos mezclados
+//   - las que faltan son justo las que push() rechazó
+//   - takeOverruns() sumó la misma cantidad
+//
+//   ecg_queue_test [--frames 4000000]
+//
+// Termina con error si algo no coincide.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../ecg_queue.h"
+
+// Contenido que se deriva del número de muestra, para detectar lecturas a medias
+static void fill(EcgFrame &f, uint32_t seq) {
+  f.seq = seq;
+  f.timeUs = seq * 4;
+  for (int l = 0; l < ECG_LEADS; l++) {
+    f.lead[l] = (float)(seq % 1000) + l;
+  }
+  f.use = ECG_FRAME_STORE;
+}
+
+static void fill(EcgRawSample &s, uint32_t seq) {
+  s.seq = seq;
+  s.timeUs = seq;
+  s.volts[0] = (float)(seq % 1000);
+  s.volts[1] = -(float)(seq % 1000);
+}
+
+static bool intact(const EcgFrame &f) {
+  EcgFrame e;
+  fill(e, f.seq);
+  return f.timeUs == e.timeUs && f.lead[0] == e.lead[0] && f.lead[1] == e.lead[1] && f.lead[2] == e.lead[2] &&
+         f.use == e.use;
+}
+
+static bool intact(const EcgRawSample &s) {
+  EcgRawSample e;
+  fill(e, s.seq);
+  return s.timeUs == e.timeUs && s.volts[0] == e.volts[0] && s.volts[1] == e.volts[1];
+}
+
+template <typename Queue, typename T>
+static bool runQueue(const char *name, uint32_t frames) {
+  static Queue queue;
+  queue.clear();
+  queue.takeOverruns();
+  std::vector<uint32_t> dropped;        // Solo lo escribe el productor
+  std::vector<uint8_t> seen(frames, 0);  // Solo lo escribe el consumidor
+  std::atomic<bool> done(false);
+  uint64_t overruns = 0;
+  uint32_t received = 0, missing = 0, disorder = 0, torn = 0;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::thread producer([&] {
+    T item;
+    for (uint32_t seq = 0; seq < frames; seq++) {
+      fill(item, seq);
+      bool overrunWindow = (seq / 65536) % 8 == 7;
+      while (!overrunWindow && queue.size() >= queue.capacity()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(1));
+      }
+      if (!queue.push(item)) {
+        dropped.push_back(seq);
+      }
+    }
+    done.store(true, std::memory_order_release);
+  });
+  std::thread consumer([&] {
+    T batch[32];
+    uint32_t expected = 0;
+    uint32_t rounds = 0;
+    for (;;) {
+      bool finished = done.load(std::memory_order_acquire);
+      uint32_t n = queue.popBatch(batch, 32);
+      for (uint32_t i = 0; i < n; i++) {
+        uint32_t seq = batch[i].seq;
+        if (seq < expected) {
+          disorder++;
+          continue;
+        }
+        missing += seq - expected;
+        expected = seq + 1;
+        received++;
+        seen[seq] = 1;
+        torn += intact(batch[i]) ? 0 : 1;
+      }
+      // En las ventanas del productor sin espera, el consumidor se atrasa a
+      // propósito para que la cola se llene
+      if (++rounds % 256 == 0) {
+        overruns += queue.takeOverruns();
+        if ((expected / 65536) % 8 == 7) {
+          std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+      }
+      if (n == 0 && finished) {
+        break;
+      }
+    }
+    missing += frames - expected;
+  });
+  producer.join();
+  consumer.join();
+  overruns += queue.takeOverruns();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  // Cada muestra que falta tiene que estar entre las rechazadas, y ninguna
+  // rechazada puede haber llegado
+  uint32_t unexplained = 0;
+  for (size_t i = 0; i < dropped.size(); i++) {
+    unexplained += seen[dropped[i]] ? 1 : 0;
+    seen[dropped[i]] = 1;
+  }
+  for (uint32_t seq = 0; seq < frames; seq++) {
+    unexplained += seen[seq] ? 0 : 1;
+  }
+  bool ok = disorder == 0 && torn == 0 && unexplained == 0 && received + dropped.size() == frames &&
+            missing == dropped.size() && overruns == dropped.size();
+  printf("%-14s: %u enviadas, %u recibidas, %u rechazadas, %u faltantes, overruns %llu, "
+         "desorden %u, mezcladas %u, sin explicar %u (%.1f Mmuestras/s) %s\n",
+         name, frames, received, (unsigned)dropped.size(), missing, (unsigned long long)overruns, disorder, torn,
+         unexplained, frames / seconds / 1e6, ok ? "OK" : "ERROR");
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  uint32_t frames = 4000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+      frames = strtoul(argv[++i], NULL, 10);
+    } else {
+      fprintf(stderr, "uso: ecg_queue_test [--frames N]\n");
+      return 2;
+    }
+  }
+  bool ok = runQueue<EcgRawQueue, EcgRawSample>("EcgRawQueue", frames);
+  ok = runQueue<EcgFrameQueue, EcgFrame>("EcgFrameQueue", frames) && ok;
+  return ok ? 0 : 1;
+}
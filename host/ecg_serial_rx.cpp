@@ -0,0 +1,208 @@
+// Receptor del flujo binario del puerto serie (ecg_serial_stream.h). Lee de un
+// puerto (/dev/ttyUSB0), de un archivo capturado o de la entrada estándar,
+// decodifica los paquetes a medida que llegan y escribe la grabación .ecg y
+// su .pyr, igual que si se hubiera grabado en la SD.
+//
+//   ecg_serial_rx /dev/ttyUSB0 ECG_1234.ecg [--baud 921600]
+//   ecg_host --synthetic 72 --fast --serial-out flujo.bin && ecg_serial_rx flujo.bin ECG_1234.ecg
+//
+// Los bytes que no forman un paquete válido (texto de depuración, ruido) se
+// saltean. Un hueco en firstFrame queda como hueco en la grabación.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "../ecg_pyramid.h"
+#include "../ecg_record.h"
+#include "../ecg_serial_stream.h"
+
+static bool writeToFile(const uint8_t *data, uint32_t len, void *ctx) {
+  return fwrite(data, 1, len, (FILE *)ctx) == len;
+}
+
+static speed_t baudToSpeed(uint32_t baud) {
+  switch (baud) {
+    case 9600: return B9600;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    default: return 0;
+  }
+}
+
+// Puerto en modo crudo: 8N1, sin eco ni traducción de fin de línea
+static bool configurePort(int fd, uint32_t baud) {
+  speed_t speed = baudToSpeed(baud);
+  struct termios tio;
+  if (speed == 0 || tcgetattr(fd, &tio) != 0) {
+    return false;
+  }
+  cfmakeraw(&tio);
+  cfsetispeed(&tio, speed);
+  cfsetospeed(&tio, speed);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cc[VMIN] = 1;
+  tio.c_cc[VTIME] = 0;
+  return tcsetattr(fd, TCSANOW, &tio) == 0;
+}
+
+struct Receiver {
+  const char *outPath;
+  FILE *dst;
+  FILE *pyr;
+  EcgRecordEncoder encoder;
+  EcgPyramidBuilder pyramid;
+  EcgRecordHeader record;
+  uint32_t nextFrame;
+  uint32_t gapFrames;
+  bool recording;
+  bool ended;
+};
+
+static Receiver rx;
+
+static void closeRecording(Receiver &r) {
+  if (!r.recording) {
+    return;
+  }
+  r.encoder.finish();
+  r.pyramid.finish();
+  fseek(r.dst, 0, SEEK_SET);
+  fwrite(&r.encoder.header(), sizeof(EcgRecordHeader), 1, r.dst);
+  fseek(r.pyr, 0, SEEK_SET);
+  fwrite(&r.pyramid.header(), sizeof(EcgPyramidHeader), 1, r.pyr);
+  fclose(r.dst);
+  fclose(r.pyr);
+  r.recording = false;
+}
+
+static bool openRecording(Receiver &r, const EcgRecordHeader &record) {
+  char pyramidPath[512];
+  ecgPyramidPath(r.outPath, pyramidPath, sizeof(pyramidPath));
+  r.dst = fopen(r.outPath, "wb");
+  r.pyr = fopen(pyramidPath, "wb");
+  if (!r.dst || !r.pyr) {
+    fprintf(stderr, "no se pudo abrir %s\n", !r.dst ? r.outPath : pyramidPath);
+    return false;
+  }
+  r.record = record;
+  r.encoder.begin(record.sampleRate, record.startMillis, writeToFile, r.dst);
+  r.pyramid.begin(r.encoder.header(), writeToFile, r.pyr);
+  r.nextFrame = 0;
+  r.gapFrames = 0;
+  r.recording = true;
+  r.ended = false;
+  return true;
+}
+
+static void onPacket(const EcgSerialPacketHeader &header, const uint8_t *payload, void *ctx) {
+  Receiver &r = *(Receiver *)ctx;
+  if (header.type == ECG_SERIAL_INFO) {
+    EcgRecordHeader record;
+    if (header.payloadBytes != sizeof(record)) {
+      return;
+    }
+    memcpy(&record, payload, sizeof(record));
+    // Un INFO a mitad de camino es una captura nueva: se guarda sobre la anterior
+    closeRecording(r);
+    if (openRecording(r, record)) {
+      printf("grabación a %u Hz\n", (unsigned)record.sampleRate);
+    }
+    return;
+  }
+  if (!r.recording) {
+    return;
+  }
+  if (header.type == ECG_SERIAL_FRAMES) {
+    if (header.firstFrame < r.nextFrame) {
+      return;  // Repetido o viejo
+    }
+    if (header.firstFrame > r.nextFrame) {
+      uint32_t gap = header.firstFrame - r.nextFrame;
+      r.encoder.skipFrames(gap);
+      r.pyramid.skipFrames(gap);
+      r.gapFrames += gap;
+    }
+    uint32_t count = header.payloadBytes / (ECG_LEADS * sizeof(int16_t));
+    for (uint32_t i = 0; i < count; i++) {
+      int16_t raw[ECG_LEADS];
+      memcpy(raw, payload + i * sizeof(raw), sizeof(raw));
+      float volts[ECG_LEADS];
+      for (int l = 0; l < ECG_LEADS; l++) {
+        volts[l] = raw[l] * r.record.gain[l] + r.record.offset[l];
+      }
+      r.encoder.addFrame(volts);
+      r.pyramid.addFrame(volts);
+    }
+    r.nextFrame = header.firstFrame + count;
+  } else if (header.type == ECG_SERIAL_END) {
+    EcgSerialEnd end;
+    if (header.payloadBytes != sizeof(end)) {
+      return;
+    }
+    memcpy(&end, payload, sizeof(end));
+    if (end.frameCount > r.nextFrame) {
+      r.encoder.skipFrames(end.frameCount - r.nextFrame);
+      r.pyramid.skipFrames(end.frameCount - r.nextFrame);
+      r.gapFrames += end.frameCount - r.nextFrame;
+      r.nextFrame = end.frameCount;
+    }
+    r.encoder.setAverageBpm(end.averageBpm);
+    closeRecording(r);
+    r.ended = true;
+  }
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "uso: ecg_serial_rx PUERTO|ARCHIVO|- SALIDA.ecg [--baud N]\n");
+    return 2;
+  }
+  uint32_t baud = 115200;
+  for (int i = 3; i < argc; i++) {
+    if (!strcmp(argv[i], "--baud") && i + 1 < argc) {
+      baud = atoi(argv[++i]);
+    }
+  }
+  int fd = !strcmp(argv[1], "-") ? 0 : open(argv[1], O_RDONLY | O_NOCTTY);
+  if (fd < 0) {
+    fprintf(stderr, "no se pudo abrir %s\n", argv[1]);
+    return 1;
+  }
+  if (isatty(fd) && !configurePort(fd, baud)) {
+    fprintf(stderr, "no se pudo configurar %s a %u baudios\n", argv[1], (unsigned)baud);
+    return 1;
+  }
+
+  rx.outPath = argv[2];
+  rx.recording = false;
+  rx.ended = false;
+  static EcgSerialParser parser;
+  parser.begin(onPacket, &rx);
+  uint8_t buffer[4096];
+  ssize_t n;
+  // Con un puerto se sigue leyendo hasta el END de la captura
+  while (!(rx.ended && isatty(fd)) && (n = read(fd, buffer, sizeof(buffer))) > 0) {
+    parser.feed(buffer, n);
+  }
+  if (rx.recording) {
+    fprintf(stderr, "el flujo terminó sin END: se guarda lo recibido\n");
+    closeRecording(rx);
+  }
+  if (fd != 0) {
+    close(fd);
+  }
+
+  printf("paquetes            : %u\n", (unsigned)parser.packets);
+  printf("errores de CRC      : %u\n", (unsigned)parser.crcErrors);
+  printf("paquetes perdidos   : %u\n", (unsigned)parser.lostPackets);
+  printf("bytes salteados     : %u\n", (unsigned)parser.skippedBytes);
+  printf("muestras recibidas  : %u (huecos %u)\n", (unsigned)(rx.nextFrame - rx.gapFrames), (unsigned)rx.gapFrames);
+  return rx.nextFrame > 0 ? 0 : 1;
+}